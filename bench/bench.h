@@ -0,0 +1,108 @@
+/*
+ * File: bench.h
+ * Purpose: Shared helpers for the emlogo benchmarks.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* how many times each measurement is repeated */
+#define BENCH_REPS 5
+
+/* get the current time in seconds */
+static inline double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* a getchar compatible source which reads from a string */
+static const char *bench_src;
+static int bench_src_i;
+
+static inline void bench_set_source(const char *s)
+{
+    bench_src = s;
+    bench_src_i = 0;
+}
+
+static inline int bench_getchar()
+{
+    if(!bench_src[bench_src_i]) {
+        return EOF;
+    }
+    return (unsigned char) bench_src[bench_src_i++];
+}
+
+
+/* A measurement. It performs n operations and returns the seconds they
+   took, so setup and teardown can be left out of the timing. */
+typedef double (*bench_fn)(long n);
+
+static int bench_results;
+
+static inline int bench_cmp(const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* start the JSON report */
+static inline void bench_json_begin(const char *suite)
+{
+    printf("{\n  \"suite\": \"%s\",\n  \"reps\": %d,\n  \"results\": [", suite, BENCH_REPS);
+    bench_results = 0;
+}
+
+/* Run a measurement BENCH_REPS times and report the best and median
+   times. If bytes is not zero, throughput is reported too. */
+static inline void bench_json_run(const char *name, bench_fn fn, long n, double bytes)
+{
+    double t[BENCH_REPS];
+    int i;
+
+    for(i=0; i<BENCH_REPS; i++) {
+        t[i] = fn(n);
+    }
+    qsort(t, BENCH_REPS, sizeof(double), bench_cmp);
+
+    printf("%s\n    {\"name\": \"%s\", \"ops\": %ld, \"best_s\": %.6f, "
+           "\"median_s\": %.6f, \"ns_per_op\": %.2f",
+           bench_results++ ? "," : "", name, n, t[0], t[BENCH_REPS/2], t[0] * 1e9 / n);
+    if(bytes) {
+        printf(", \"mb_per_s\": %.2f", bytes / t[0] / 1e6);
+    }
+    printf("}");
+    fflush(stdout);
+}
+
+/* finish the JSON report */
+static inline void bench_json_end()
+{
+    printf("\n  ]\n}\n");
+}
+#endif
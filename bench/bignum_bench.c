@@ -0,0 +1,174 @@
+/*
+ * File: bignum_bench.c
+ * Purpose: Measure bignum multiplication and decimal conversion.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "bignum.h"
+#include "bench.h"
+
+/* factorial the way a Logo program would write it */
+static const char *FACT =
+    "to fact :n\n"
+    "  make \"f 1\n"
+    "  make \"i 0\n"
+    "  repeat :n [make \"i :i + 1 make \"f :f * :i]\n"
+    "  output :f\n"
+    "end\n";
+
+/* run a program in the interpreter */
+static void run_source(struct eml_interp *in, const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+}
+
+
+/* the product lo * (lo+1) * ... * hi, split in halves so the operands
+   of each multiplication are about the same size */
+static struct eml_word *product(int lo, int hi)
+{
+    struct eml_word *a, *b, *p;
+
+    if(lo == hi) {
+        return eml_itow(lo);
+    }
+    a = product(lo, (lo + hi) / 2);
+    b = product((lo + hi) / 2 + 1, hi);
+    p = eml_int_mul(a, b);
+    eml_free_word(a);
+    eml_free_word(b);
+    return p;
+}
+
+
+/* time n! by product tree with the given Karatsuba cutoff */
+static double tree(int n, int limbs, struct eml_word **result)
+{
+    int saved = eml_karatsuba_limbs;
+    double t0, t1;
+
+    eml_karatsuba_limbs = limbs;
+    t0 = bench_now();
+    *result = product(1, n);
+    t1 = bench_now();
+    eml_karatsuba_limbs = saved;
+    return t1 - t0;
+}
+
+
+/* count the trailing zeros of a decimal string */
+static int zeros(const char *s)
+{
+    const char *p = s + strlen(s);
+    int n = 0;
+
+    while(p > s && *--p == '0') {
+        n++;
+    }
+    return n;
+}
+
+
+/* print n! by the product tree, with and without Karatsuba, and time
+   converting it to and from decimal */
+static void big(int n)
+{
+    struct eml_word *a, *b, *c;
+    struct eml_bignum *bn;
+    double t, t0, t1;
+    const char *s;
+
+    t = tree(n, 0, &a);
+    printf("fact %6d  tree, schoolbook  %10.3f ms\n", n, t * 1e3);
+    t = tree(n, eml_karatsuba_limbs, &b);
+    printf("fact %6d  tree, karatsuba   %10.3f ms\n", n, t * 1e3);
+    if(!eml_word_equals(a, b)) {
+        fprintf(stderr, "products differ\n");
+        exit(1);
+    }
+
+    /* to decimal, which is what PRINT does */
+    bn = b->field.b;
+    t0 = bench_now();
+    s = eml_bignum_str(bn);
+    t1 = bench_now();
+    printf("fact %6d  to decimal        %10.3f ms  %d digits, %d trailing zeros\n",
+           n, (t1 - t0) * 1e3, (int) strlen(s), zeros(s));
+
+    /* and back */
+    t0 = bench_now();
+    c = eml_stow((char *) s);
+    t1 = bench_now();
+    printf("fact %6d  from decimal      %10.3f ms\n", n, (t1 - t0) * 1e3);
+    if(!eml_word_equals(b, c)) {
+        fprintf(stderr, "decimal round trip failed\n");
+        exit(1);
+    }
+
+    eml_free_word(a);
+    eml_free_word(b);
+    eml_free_word(c);
+}
+
+
+int main()
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_node *f;
+    char src[64];
+    double t0, t1;
+    int n;
+
+    /* one multiplication by a small integer per step, through the interpreter */
+    run_source(in, FACT);
+    for(n = 1000; n <= 10000; n *= 10) {
+        snprintf(src, sizeof(src), "make \"x fact %d", n);
+        t0 = bench_now();
+        run_source(in, src);
+        t1 = bench_now();
+        f = eml_interp_getvar(in, "x");
+        printf("fact %6d  logo loop         %10.3f ms  %d digits\n", n, (t1 - t0) * 1e3,
+               (int) strlen(eml_word_str(f->data)));
+    }
+    eml_interp_free(in);
+
+    /* balanced products of huge operands, where Karatsuba pays */
+    big(10000);
+    big(100000);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * File: cache_bench.c
+ * Purpose: Measure loading a program cold and warm from the parsed program cache.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "emlogo.h"
+#include "bench.h"
+#include "gen.h"
+
+/* how much source is loaded */
+#define SOURCE_BYTES (8 << 20)
+
+static char source[64], dir[64], entry[128];
+static struct eml_node *expect;
+
+
+/* load the source, checking it came out the same as a plain parse */
+static double load(const char *cache)
+{
+    struct eml_node *prog;
+    double t0, t1;
+
+    t0 = bench_now();
+    prog = eml_cache_load(cache, source);
+    t1 = bench_now();
+    if(!prog || !eml_node_equals(prog, expect)) {
+        fprintf(stderr, "%s loaded differently\n", cache ? cache : "parse");
+        exit(1);
+    }
+    eml_node_free(prog);
+    return t1 - t0;
+}
+
+
+static double parse(long n)
+{
+    return load(NULL);
+}
+
+
+/* a miss: parse and write the entry */
+static double cold(long n)
+{
+    remove(entry);
+    return load(dir);
+}
+
+
+/* a hit: the entry from the last run */
+static double warm(long n)
+{
+    return load(dir);
+}
+
+
+int main()
+{
+    struct gen_opts o = GEN_DEFAULT;
+    struct eml_lexer *lex;
+    char *text;
+    long n;
+    FILE *f;
+    int fd;
+
+    /* the source goes in a file of its own, the cache in a directory */
+    o.size = SOURCE_BYTES;
+    text = gen_logo(&o, &n);
+    strcpy(source, "/tmp/cache_benchXXXXXX");
+    strcpy(dir, "/tmp/cache_benchXXXXXX");
+    fd = mkstemp(source);
+    if(fd < 0 || !mkdtemp(dir) || !(f = fdopen(fd, "w"))) {
+        perror("cache_bench");
+        return 1;
+    }
+    fwrite(text, 1, n, f);
+    fclose(f);
+    snprintf(entry, sizeof(entry), "%s/%016llx.emc", dir,
+             (unsigned long long) eml_cache_hash(text, n));
+
+    bench_set_source(text);
+    lex = eml_alloc_lexer(bench_getchar);
+    expect = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+
+    bench_json_begin("cache");
+    bench_json_run("parse", parse, 1, n);
+    bench_json_run("cache/cold", cold, 1, n);
+    bench_json_run("cache/warm", warm, 1, n);
+    bench_json_end();
+
+    remove(entry);
+    rmdir(dir);
+    remove(source);
+    eml_node_free(expect);
+    free(text);
+    return 0;
+}
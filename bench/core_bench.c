@@ -0,0 +1,499 @@
+/*
+ * File: core_bench.c
+ * Purpose: Microbenchmarks for the core data structures, reported as JSON.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "buf.h"
+#include "bench.h"
+
+/* sizes of the generated Logo source */
+#define SOURCE_BYTES (4 << 20)
+
+static const char *vocab[] = {
+    "forward", "FD", "right", "repeat", "make", "\"size", ":size", "123",
+    "-42", "3.14159", "-x", "hello_world_this_is_a_longer_word", "0", "7.5"
+};
+#define NVOCAB (sizeof(vocab) / sizeof(vocab[0]))
+
+static char *source;       /* generated Logo text */
+static long source_len;
+static struct eml_word **words;  /* scratch space for created words */
+static struct eml_word **keys;   /* hashmap keys */
+static struct eml_lexer *lex;
+static unsigned int seed;
+
+
+/* a small deterministic generator so every run sees the same data */
+static unsigned int rnd()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+
+/* Build a few MB of Logo source, with words from the vocabulary, balanced
+   brackets nesting a few levels deep, and line breaks. */
+static void make_source()
+{
+    int depth = 0, k;
+    long n = 0;
+
+    source = malloc(SOURCE_BYTES + 256);
+    seed = 1;
+    while(n < SOURCE_BYTES) {
+        k = rnd() % 20;
+        if(k == 0 && depth < 6) {
+            source[n++] = '[';
+            depth++;
+        } else if(k == 1 && depth) {
+            source[n++] = ']';
+            depth--;
+        } else {
+            n += sprintf(source + n, "%s", vocab[rnd() % NVOCAB]);
+        }
+        source[n++] = rnd() % 12 ? ' ' : '\n';
+    }
+    while(depth--) {
+        source[n++] = ']';
+    }
+    source[n] = '\0';
+    source_len = n;
+}
+
+
+static void free_words(long n)
+{
+    long i;
+    for(i=0; i<n; i++) {
+        eml_free_word(words[i]);
+    }
+}
+
+
+/******************************************
+ * Words
+ ******************************************/
+static double stow(long n)
+{
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        words[i] = eml_stow((char*) vocab[i % NVOCAB]);
+    }
+    t1 = bench_now();
+    free_words(n);
+    return t1 - t0;
+}
+
+static double itow(long n)
+{
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        words[i] = eml_itow(i);
+    }
+    t1 = bench_now();
+    free_words(n);
+    return t1 - t0;
+}
+
+static double dtow(long n)
+{
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        words[i] = eml_dtow(i * 0.5);
+    }
+    t1 = bench_now();
+    free_words(n);
+    return t1 - t0;
+}
+
+/* compare words against a mix of equal and unequal partners */
+static double word_equals(long n)
+{
+    struct eml_word *w[6];
+    double t0, t1;
+    long i;
+    int eq = 0;
+
+    w[0] = eml_stow("forward");
+    w[1] = eml_stow("FORWARD");
+    w[2] = eml_stow("backward");
+    w[3] = eml_stow("123");
+    w[4] = eml_itow(123);
+    w[5] = eml_dtow(2.5);
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        eq += eml_word_equals(w[i % 6], w[(i / 6) % 6]);
+    }
+    t1 = bench_now();
+
+    for(i=0; i<6; i++) {
+        eml_free_word(w[i]);
+    }
+    return eq < 0 ? 0 : t1 - t0;
+}
+
+
+/******************************************
+ * Hashmaps
+ ******************************************/
+static void make_keys(long n)
+{
+    char name[32];
+    long i;
+
+    for(i=0; i<n; i++) {
+        sprintf(name, "var%ld", i);
+        keys[i] = eml_stow(name);
+    }
+}
+
+static void free_keys(long n)
+{
+    long i;
+    for(i=0; i<n; i++) {
+        eml_free_word(keys[i]);
+    }
+}
+
+/* n distinct keys into a fresh map */
+static double hashmap_set(long n)
+{
+    struct eml_hashmap *h;
+    double t0, t1;
+    long i;
+
+    make_keys(n);
+    h = eml_hashmap_alloc();
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        eml_hashmap_set(h, keys[i], (void*) (i + 1));
+    }
+    t1 = bench_now();
+    eml_hashmap_free(h);
+    free_keys(n);
+    return t1 - t0;
+}
+
+/* look up each of n keys in a map of n entries, 10 times over */
+static double hashmap_get(long n)
+{
+    struct eml_hashmap *h;
+    double t0, t1;
+    long i, sum = 0;
+
+    make_keys(n);
+    h = eml_hashmap_alloc();
+    for(i=0; i<n; i++) {
+        eml_hashmap_set(h, keys[i], (void*) (i + 1));
+    }
+    t0 = bench_now();
+    for(i=0; i<n * 10; i++) {
+        sum += (long) eml_hashmap_get(h, keys[i % n]);
+    }
+    t1 = bench_now();
+    eml_hashmap_free(h);
+    free_keys(n);
+    return sum < 0 ? 0 : (t1 - t0) / 10;
+}
+
+
+/* Resolve words to primitives, n times over the vocabulary, as evaluation
+   did through a map of the primitive names. */
+static double prim_hashmap(long n)
+{
+    struct eml_word *w[NVOCAB];
+    struct eml_hashmap *h = eml_hashmap_alloc();
+    double t0, t1;
+    long i, sum = 0;
+
+    for(i=0; i<NVOCAB; i++) {
+        w[i] = eml_stow((char*) vocab[i]);
+        if(w[i]->prim) {
+            eml_hashmap_set(h, w[i], (void*) (long) w[i]->prim);
+        }
+    }
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        sum += (long) eml_hashmap_get(h, w[i % NVOCAB]);
+    }
+    t1 = bench_now();
+    eml_hashmap_free(h);
+    for(i=0; i<NVOCAB; i++) {
+        eml_free_word(w[i]);
+    }
+    return sum < 0 ? 0 : t1 - t0;
+}
+
+/* the same through the perfect hash, as eml_stow tags each word; numbers
+   are never primitives */
+static double prim_id(long n)
+{
+    struct eml_word *w[NVOCAB];
+    double t0, t1;
+    long i, sum = 0;
+
+    for(i=0; i<NVOCAB; i++) {
+        w[i] = eml_stow((char*) vocab[i]);
+    }
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        if(w[i % NVOCAB]->type == WORD) {
+            sum += eml_prim_id(w[i % NVOCAB]->field.s, w[i % NVOCAB]->hash);
+        }
+    }
+    t1 = bench_now();
+    for(i=0; i<NVOCAB; i++) {
+        eml_free_word(w[i]);
+    }
+    return sum < 0 ? 0 : t1 - t0;
+}
+
+
+/******************************************
+ * Lexer and parser
+ ******************************************/
+/* lex the whole source, n times */
+static double lexer(long n)
+{
+    struct eml_word *w;
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        bench_set_source(source);
+        lex->cur = 0;
+        while((w = eml_lexer_next(lex))) {
+            eml_free_word(w);
+        }
+    }
+    t1 = bench_now();
+    return t1 - t0;
+}
+
+/* lex one token n bytes long, which grows the lexer's buffer many times */
+static double lexer_long(long n)
+{
+    char *text = malloc(n + 1);
+    struct eml_lexer *l;
+    struct eml_word *w;
+    double t0, t1;
+
+    memset(text, 'x', n);
+    text[n] = '\0';
+    bench_set_source(text);
+    l = eml_alloc_lexer(bench_getchar);
+    t0 = bench_now();
+    w = eml_lexer_next(l);
+    t1 = bench_now();
+    eml_free_word(w);
+    eml_free_lexer(l);
+    free(text);
+    return t1 - t0;
+}
+
+/* parse the whole source into a tree and free it, n times */
+static double parse_free(long n)
+{
+    struct eml_node *node;
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        bench_set_source(source);
+        lex->cur = 0;
+        node = eml_node_parse(lex, NULL);
+        eml_node_free(node);
+    }
+    t1 = bench_now();
+    return t1 - t0;
+}
+
+
+/******************************************
+ * Lists and buffers
+ ******************************************/
+static double list_append(long n)
+{
+    struct eml_list *l = eml_list_alloc();
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        eml_list_append(l, (void*) i);
+    }
+    t1 = bench_now();
+    eml_list_free(l);
+    return t1 - t0;
+}
+
+static long visits;
+static void visit(void *p)
+{
+    visits += (long) p;
+}
+
+/* visit a list of 1000 items, n / 1000 times */
+static double list_apply(long n)
+{
+    struct eml_list *l = eml_list_alloc();
+    double t0, t1;
+    long i;
+
+    for(i=0; i<1000; i++) {
+        eml_list_append(l, (void*) i);
+    }
+    t0 = bench_now();
+    for(i=0; i<n / 1000; i++) {
+        eml_list_apply(l, visit);
+    }
+    t1 = bench_now();
+    eml_list_free(l);
+    return t1 - t0;
+}
+
+/* n appends of 1 byte */
+static double buf_nappend_1(long n)
+{
+    char *buf = eml_buf_alloc();
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        buf = eml_buf_nappend(buf, "x", 1);
+    }
+    t1 = bench_now();
+    eml_buf_free(buf);
+    return t1 - t0;
+}
+
+/* n appends of 1 byte through a handle */
+static double buf_putc(long n)
+{
+    char *buf = eml_buf_alloc();
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        eml_buf_putc(&buf, 'x');
+    }
+    t1 = bench_now();
+    eml_buf_free(buf);
+    return t1 - t0;
+}
+
+/* n bytes written straight into the buffer, 4096 at a time */
+static double buf_span(long n)
+{
+    char *buf = eml_buf_alloc();
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i+=4096) {
+        memset(eml_buf_span(&buf, 4096), 'x', 4096);
+        eml_buf_commit(buf, 4096);
+    }
+    t1 = bench_now();
+    eml_buf_free(buf);
+    return t1 - t0;
+}
+
+/* n appends of 64 bytes */
+static double buf_nappend_64(long n)
+{
+    char *buf = eml_buf_alloc();
+    char chunk[64];
+    double t0, t1;
+    long i;
+
+    memset(chunk, 'x', sizeof(chunk));
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        buf = eml_buf_nappend(buf, chunk, sizeof(chunk));
+    }
+    t1 = bench_now();
+    eml_buf_free(buf);
+    return t1 - t0;
+}
+
+
+int main(int argc, char **argv)
+{
+    /* scale everything down for quick runs */
+    long scale = argc > 1 ? atol(argv[1]) : 1;
+    long n = 1000000 / scale;
+
+    words = malloc(n * sizeof(struct eml_word*));
+    keys = malloc(10000 * sizeof(struct eml_word*));
+    lex = eml_alloc_lexer(bench_getchar);
+    make_source();
+
+    bench_json_begin("core");
+    bench_json_run("eml_stow", stow, n, 0);
+    bench_json_run("eml_itow", itow, n, 0);
+    bench_json_run("eml_dtow", dtow, n, 0);
+    bench_json_run("eml_word_equals", word_equals, 10 * n, 0);
+    bench_json_run("eml_hashmap_set/100", hashmap_set, 100, 0);
+    bench_json_run("eml_hashmap_set/1000", hashmap_set, 1000, 0);
+    bench_json_run("eml_hashmap_set/10000", hashmap_set, 10000, 0);
+    bench_json_run("eml_hashmap_get/100", hashmap_get, 100, 0);
+    bench_json_run("eml_hashmap_get/1000", hashmap_get, 1000, 0);
+    bench_json_run("eml_hashmap_get/10000", hashmap_get, 10000, 0);
+    bench_json_run("primitive/eml_hashmap_get", prim_hashmap, 10 * n, 0);
+    bench_json_run("primitive/eml_prim_id", prim_id, 10 * n, 0);
+    bench_json_run("eml_lexer_next", lexer, 1, source_len);
+    bench_json_run("eml_list_append", list_append, n, 0);
+    bench_json_run("eml_list_apply", list_apply, 10 * n, 0);
+    bench_json_run("eml_buf_nappend/1", buf_nappend_1, n, n);
+    bench_json_run("eml_buf_nappend/64", buf_nappend_64, n, 64.0 * n);
+    bench_json_run("eml_buf_putc", buf_putc, n, n);
+    bench_json_run("eml_buf_span/4096", buf_span, 64 * n, 64.0 * n);
+    bench_json_run("eml_lexer_next/long", lexer_long, 16 * n, 16.0 * n);
+    bench_json_run("eml_node_parse+free", parse_free, 1, source_len);
+    bench_json_end();
+
+    eml_free_lexer(lex);
+    free(source);
+    free(keys);
+    free(words);
+    return 0;
+}
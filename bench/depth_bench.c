@@ -0,0 +1,149 @@
+/*
+ * File: depth_bench.c
+ * Purpose: Stress parsing, printing, and freeing of deeply nested lists.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "alloc.h"
+#include "bench.h"
+
+/* The recursive algorithms which the node functions used to use, kept here
+   as a baseline. They only run at depths the C stack can survive. */
+static struct eml_lexer *lex;
+
+static struct eml_node *rec_parse(int level)
+{
+    struct eml_list *list = eml_list_alloc();
+    struct eml_node *node;
+    struct eml_word *word;
+
+    while((word = eml_lexer_next(lex))) {
+        if(word->type == TOKEN) {
+            if(word->field.s[0] == ']') {
+                eml_free_word(word);
+                break;
+            }
+            eml_free_word(word);
+            node = rec_parse(level+1);
+        } else {
+            node = eml_node_alloc();
+            node->type = EML_WORD;
+            node->data = word;
+        }
+        eml_list_append(list, node);
+    }
+
+    node = eml_node_alloc();
+    node->type = EML_LIST;
+    node->data = list;
+    return node;
+}
+
+static FILE *rec_out;
+
+static void rec_print(struct eml_node *node)
+{
+    if(node->type == EML_WORD) {
+        fprintf(rec_out, "%s ", eml_word_str(node->data));
+    } else {
+        fputs("[ ", rec_out);
+        eml_list_apply(node->data, (eml_list_visitor)rec_print);
+        fputs("] ", rec_out);
+    }
+}
+
+static void rec_free(struct eml_node *node)
+{
+    if(node->type == EML_WORD) {
+        eml_free_word(node->data);
+    } else {
+        eml_list_apply(node->data, (eml_list_visitor)rec_free);
+        eml_list_free(node->data);
+    }
+    eml_free(EML_MEM_NODE, node);
+}
+
+
+/* build a source string with depth levels of nesting */
+static char *nested_source(int depth)
+{
+    char *s = malloc(2 * depth + 2);
+    memset(s, '[', depth);
+    s[depth] = 'x';
+    memset(s + depth + 1, ']', depth);
+    s[2 * depth + 1] = '\0';
+    return s;
+}
+
+
+static void run(int depth, int recursive, FILE *out)
+{
+    char *src = nested_source(depth);
+    struct eml_node *node;
+    double t0, t1, t2, t3;
+
+    bench_set_source(src);
+    lex->cur = 0;
+    rec_out = out;
+
+    t0 = bench_now();
+    node = recursive ? rec_parse(0) : eml_node_parse(lex, NULL);
+    t1 = bench_now();
+    if(recursive) rec_print(node); else eml_node_fprint(out, node);
+    t2 = bench_now();
+    if(recursive) rec_free(node); else eml_node_free(node);
+    t3 = bench_now();
+
+    printf("%-10s depth %8d  parse %8.2f ms  print %8.2f ms  free %8.2f ms\n",
+           recursive ? "recursive" : "iterative", depth,
+           (t1-t0)*1e3, (t2-t1)*1e3, (t3-t2)*1e3);
+    free(src);
+}
+
+
+int main(int argc, char **argv)
+{
+    int max_depth = argc > 1 ? atoi(argv[1]) : 1000000;
+    int depth;
+    FILE *out = fopen("/dev/null", "w");
+
+    lex = eml_alloc_lexer(bench_getchar);
+
+    /* the baseline, only at depths which are safe for the C stack */
+    for(depth = 1000; depth <= 10000 && depth <= max_depth; depth *= 10) {
+        run(depth, 1, out);
+        run(depth, 0, out);
+    }
+
+    /* the iterative versions are good for any depth */
+    for(depth = 100000; depth <= max_depth; depth *= 10) {
+        run(depth, 0, out);
+    }
+
+    eml_free_lexer(lex);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * File: dump_bench.c
+ * Purpose: Measure writing out a large list.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "buf.h"
+#include "bench.h"
+
+/* how much text the dump comes to */
+#define DUMP_BYTES (100 << 20)
+
+/* items in the list which the dump repeats */
+#define ITEMS 10000
+
+static struct eml_node *dump;
+static FILE *devnull;
+
+
+/* Build the dump: one list of words, integers, floats and small sublists,
+   shared as many times over as it takes to make DUMP_BYTES of text. */
+static long make_dump()
+{
+    struct eml_list *list = eml_list_alloc(), *sub, *top = eml_list_alloc();
+    struct eml_node *node;
+    struct eml_writer *w;
+    unsigned int seed = 1;
+    long len, n;
+    int i;
+
+    for(i=0; i<ITEMS; i++) {
+        seed = seed * 1103515245 + 12345;
+        switch(seed >> 8 & 3) {
+        case 0:
+            node = eml_node_word(eml_stow(i & 1 ? "forward" : "temperature"));
+            break;
+        case 1:
+            node = eml_node_word(eml_itow((int)(seed >> 10) - (1 << 20)));
+            break;
+        case 2:
+            node = eml_node_word(eml_dtow((int)(seed >> 12 & 0xffff) / 8.0));
+            break;
+        default:
+            sub = eml_list_alloc();
+            eml_list_append(sub, eml_node_word(eml_stow("x")));
+            eml_list_append(sub, eml_node_word(eml_itow(i)));
+            eml_list_append(sub, eml_node_word(eml_dtow(i / 3.0)));
+            node = eml_node_list(sub);
+        }
+        eml_list_append(list, node);
+    }
+    node = eml_node_list(list);
+
+    /* measure one copy, then share it */
+    w = eml_writer_buf();
+    eml_node_write(w, node);
+    eml_writer_flush(w);
+    len = eml_buf_length(w->text);
+    eml_writer_free(w);
+
+    for(n=0; n * len < DUMP_BYTES; n++) {
+        node->refs += n > 0;
+        eml_list_append(top, node);
+    }
+    dump = eml_node_list(top);
+    return n * len + 4;
+}
+
+
+/* eml_node_fprint as it was, a stdio call for every word and bracket */
+static void fprint_stdio(FILE *out, struct eml_node *node)
+{
+    struct eml_list_node *cur;
+
+    if(node->type == EML_WORD) {
+        fprintf(out, "%s ", eml_word_str(node->data));
+        return;
+    }
+    fputs("[ ", out);
+    for(cur = ((struct eml_list*)node->data)->head; cur; cur = cur->next) {
+        fprint_stdio(out, cur->data);
+    }
+    fputs("] ", out);
+}
+
+
+/* a sink which throws the text away, leaving only the formatting */
+static int discard(void *ctx, const char *bytes, int n)
+{
+    *(long*)ctx += n;
+    return 0;
+}
+
+
+static double stdio(long n)
+{
+    double t0 = bench_now();
+    fprint_stdio(devnull, dump);
+    fflush(devnull);
+    return bench_now() - t0;
+}
+
+
+static double file(long n)
+{
+    double t0 = bench_now();
+    eml_node_fprint(devnull, dump);
+    fflush(devnull);
+    return bench_now() - t0;
+}
+
+
+static double memory(long n)
+{
+    struct eml_writer *w = eml_writer_buf();
+    double t0, t1;
+
+    t0 = bench_now();
+    eml_node_write(w, dump);
+    eml_writer_flush(w);
+    t1 = bench_now();
+    if(eml_buf_length(w->text) != n) {
+        fprintf(stderr, "captured %d bytes, not %ld\n", eml_buf_length(w->text), n);
+        exit(1);
+    }
+    eml_writer_free(w);
+    return t1 - t0;
+}
+
+
+static double format(long n)
+{
+    long bytes = 0;
+    struct eml_writer *w = eml_writer_alloc(discard, &bytes);
+    double t0, t1;
+
+    t0 = bench_now();
+    eml_node_write(w, dump);
+    eml_writer_flush(w);
+    t1 = bench_now();
+    eml_writer_free(w);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    long bytes = make_dump();
+
+    devnull = fopen("/dev/null", "w");
+    bench_json_begin("dump");
+    bench_json_run("fprintf per word", stdio, bytes, bytes);
+    bench_json_run("eml_node_fprint", file, bytes, bytes);
+    bench_json_run("eml_node_write/memory", memory, bytes, bytes);
+    bench_json_run("eml_node_write/discard", format, bytes, bytes);
+    bench_json_end();
+
+    fclose(devnull);
+    eml_node_free(dump);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * File: fill_bench.c
+ * Purpose: Measure flood fill on large canvases with maze shaped regions.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "emlogo.h"
+#include "bench.h"
+
+#define WHITE EML_RGBA(255, 255, 255, 255)
+#define BLACK EML_RGBA(0, 0, 0, 255)
+#define RED   EML_RGBA(255, 0, 0, 255)
+
+/* The obvious fill, one pixel at a time with an explicit stack (the
+   recursive version would not survive these canvases at all). */
+static void pixel_fill(struct eml_canvas *c, int x, int y, uint32_t color)
+{
+    int cap = 1024, n = 0, w = c->width;
+    int *stack = malloc(cap * sizeof(int));
+    uint32_t old = c->pixels[y * w + x];
+    int p;
+
+    stack[n++] = y * w + x;
+    while(n) {
+        p = stack[--n];
+        if(c->pixels[p] != old) {
+            continue;
+        }
+        c->pixels[p] = color;
+        if(n + 4 > cap) {
+            cap *= 2;
+            stack = realloc(stack, cap * sizeof(int));
+        }
+        x = p % w;
+        if(x > 0) stack[n++] = p - 1;
+        if(x < w - 1) stack[n++] = p + 1;
+        if(p >= w) stack[n++] = p - w;
+        if(p < w * (c->height - 1)) stack[n++] = p + w;
+    }
+    free(stack);
+}
+
+
+/* one big empty region */
+static void blank(struct eml_canvas *c)
+{
+    eml_canvas_clear(c, WHITE);
+}
+
+
+/* one pixel wide corridors which snake up and down the whole canvas */
+static void serpentine(struct eml_canvas *c)
+{
+    int x;
+
+    eml_canvas_clear(c, WHITE);
+    for(x=1; x<c->width; x+=2) {
+        if(x % 4 == 1) {
+            eml_canvas_line(c, x, 0, x, c->height - 2, BLACK);
+        } else {
+            eml_canvas_line(c, x, 1, x, c->height - 1, BLACK);
+        }
+    }
+}
+
+
+/* a random perfect maze with one pixel corridors, carved by a random
+   depth first walk over the cells at even coordinates */
+static void maze(struct eml_canvas *c)
+{
+    int cw = c->width / 2, ch = c->height / 2;
+    int *stack = malloc(sizeof(int) * cw * ch);
+    int n = 0, cell, x, y, nx, ny, k, dir, dirs[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
+
+    eml_canvas_clear(c, BLACK);
+    srand(42);
+    stack[n++] = 0;
+    c->pixels[0] = WHITE;
+    while(n) {
+        cell = stack[n-1];
+        x = cell % cw;
+        y = cell / cw;
+
+        /* pick a random unvisited neighbour */
+        dir = rand() % 4;
+        for(k=0; k<4; k++) {
+            nx = x + dirs[(dir + k) % 4][0];
+            ny = y + dirs[(dir + k) % 4][1];
+            if(nx >= 0 && ny >= 0 && nx < cw && ny < ch
+                    && c->pixels[ny * 2 * c->width + nx * 2] == BLACK) {
+                break;
+            }
+        }
+        if(k == 4) {
+            n--;
+            continue;
+        }
+
+        c->pixels[(y + ny) * c->width + x + nx] = WHITE;
+        c->pixels[ny * 2 * c->width + nx * 2] = WHITE;
+        stack[n++] = ny * cw + nx;
+    }
+    free(stack);
+}
+
+
+static void run(const char *name, struct eml_canvas *c, void (*setup)(struct eml_canvas*))
+{
+    double t0, t1, t2;
+    long filled = 0;
+    int i;
+
+    setup(c);
+    t0 = bench_now();
+    eml_canvas_fill(c, 0, 0, RED);
+    t1 = bench_now();
+    for(i=0; i<c->width * c->height; i++) {
+        filled += c->pixels[i] == RED;
+    }
+
+    setup(c);
+    t2 = bench_now();
+    pixel_fill(c, 0, 0, RED);
+    printf("%-11s %dx%d  %ld pixels  scanline %8.2f ms  per pixel %8.2f ms\n",
+           name, c->width, c->height, filled, (t1-t0)*1e3, (bench_now()-t2)*1e3);
+}
+
+
+int main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 8192;
+    struct eml_canvas *c = eml_canvas_alloc(size, size);
+
+    run("open", c, blank);
+    run("serpentine", c, serpentine);
+    run("maze", c, maze);
+
+    eml_canvas_free(c);
+    return 0;
+}
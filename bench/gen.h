@@ -0,0 +1,97 @@
+/*
+ * File: gen.h
+ * Purpose: A generator of synthetic Logo source for the scaling benchmarks.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef GEN_H
+#define GEN_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the shape of the generated source */
+struct gen_opts {
+    long size;          /* bytes of source, give or take a token */
+    int vocab;          /* distinct words */
+    int depth;          /* deepest list nesting */
+    int numbers;        /* percent of words which are numbers */
+    unsigned seed;      /* the same seed makes the same source */
+};
+
+/* default shape: a vocabulary of a thousand, lists up to 8 deep and a
+   quarter of the words numbers */
+static const struct gen_opts GEN_DEFAULT = {1024, 1000, 8, 25, 1};
+
+static unsigned gen_state;
+
+/* xorshift, plenty for making up programs */
+static unsigned gen_rand()
+{
+    gen_state ^= gen_state << 13;
+    gen_state ^= gen_state >> 17;
+    gen_state ^= gen_state << 5;
+    return gen_state;
+}
+
+/* Generate Logo source. Returns a null terminated malloc'ed string and
+   stores its length in len. Words are w0, w1, ... up to the vocabulary,
+   numbers are integers and decimals, lists open and close at random up
+   to the nesting depth and lines hold a dozen or so words. */
+static char *gen_logo(const struct gen_opts *o, long *len)
+{
+    char *s = malloc(o->size + 64 + 2 * o->depth);
+    long n = 0;
+    int depth = 0;
+    int col = 0;
+    unsigned r;
+
+    gen_state = o->seed ? o->seed : 1;
+    while(n < o->size || depth) {
+        r = gen_rand();
+
+        /* Lists, which are closed off once the source is big enough. The
+           last word and the closing brackets can run past the size. */
+        if(depth && (n >= o->size || r % 6 == 0)) {
+            s[n++] = ']';
+            depth--;
+        } else if(depth < o->depth && r % 8 == 1) {
+            s[n++] = '[';
+            depth++;
+        } else if((int) ((r >> 8) % 100) < o->numbers) {
+            if(r & 0x10000000) {
+                n += sprintf(s + n, "%u", (r >> 4) % 100000);
+            } else {
+                n += sprintf(s + n, "%u.%02u", (r >> 4) % 1000, (r >> 20) % 100);
+            }
+        } else {
+            n += sprintf(s + n, "w%u", (r >> 4) % o->vocab);
+        }
+
+        s[n++] = ++col % 12 ? ' ' : '\n';
+    }
+    s[n] = '\0';
+
+    *len = n;
+    return s;
+}
+#endif
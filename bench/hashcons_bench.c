@@ -0,0 +1,133 @@
+/*
+ * File: hashcons_bench.c
+ * Purpose: Measure the memory saved by hash-consing a repetitive dataset.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* A dataset of polylines: each record is a list of points on a small
+   grid, followed by one of a few command blocks. */
+static char *dataset(int records, long *len)
+{
+    static const char *blocks[] = {
+        "[pu setpos :p pd]", "[repeat 4 [fd 10 rt 90]]", "[fd 1 rt 1]", "[fill]"
+    };
+    char *s = malloc(records * 160L + 1);
+    long n = 0;
+    unsigned r = 12345;
+    int i, j;
+
+    for(i=0; i<records; i++) {
+        s[n++] = '[';
+        for(j=0; j<8; j++) {
+            r = r * 1103515245u + 12345u;
+            n += sprintf(s + n, " [%u %u]", (r >> 8) % 32, (r >> 16) % 32);
+        }
+        n += sprintf(s + n, " ] %s\n", blocks[(r >> 24) % 4]);
+    }
+    s[n] = '\0';
+    *len = n;
+    return s;
+}
+
+
+/* parse the source, with or without a table, and report on it */
+static struct eml_node *parse(const char *name, const char *src, long len, struct eml_hashcons *table)
+{
+    struct eml_lexer *lex;
+    struct eml_node *tree;
+    struct eml_mem_stats s;
+    long held;
+    double t0, t1;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    eml_mem_stats(EML_MEM_KINDS, &s);
+    held = s.current;
+    eml_mem_stats_reset();
+    t0 = bench_now();
+    tree = eml_node_parse_shared(lex, NULL, table);
+    t1 = bench_now();
+    eml_free_lexer(lex);
+
+    eml_mem_stats(EML_MEM_KINDS, &s);
+    printf("%-8s %8.2f ms  %7.1f MB/s  %10ld allocs  %8.2f MB held\n", name,
+           (t1 - t0) * 1e3, len / (t1 - t0) / 1e6, s.allocs, (s.current - held) / 1048576.0);
+    return tree;
+}
+
+
+int main(int argc, char **argv)
+{
+    int records = argc > 1 ? atoi(argv[1]) : 200000;
+    struct eml_hashcons *table;
+    struct eml_hashmap *points;
+    struct eml_node *plain, *shared, *rec;
+    struct eml_list_node *cur, *pt;
+    long len;
+    char *src;
+    int distinct = 0;
+    double t0, t1;
+
+    src = dataset(records, &len);
+    printf("%d records, %.2f MB of source\n", records, len / 1048576.0);
+
+    eml_mem_instrument();
+    plain = parse("plain", src, len, NULL);
+    table = eml_hashcons_alloc();
+    shared = parse("shared", src, len, table);
+    printf("%ld of %ld nodes shared, %d distinct\n", table->shared, table->nodes, table->size);
+
+    /* the two trees must be the same */
+    printf("equal %d, hashes %08x %08x\n", eml_node_equals(plain, shared),
+           eml_node_hash(plain), eml_node_hash(shared));
+
+    /* the points of each polyline as list keys, counting the distinct ones */
+    points = eml_hashmap_alloc();
+    t0 = bench_now();
+    for(cur = ((struct eml_list*) plain->data)->head; cur; cur = cur->next) {
+        rec = cur->data;
+        if(rec->type != EML_LIST || ((struct eml_node*) ((struct eml_list*) rec->data)->head->data)->type != EML_LIST) {
+            continue;
+        }
+        for(pt = ((struct eml_list*) rec->data)->head; pt; pt = pt->next) {
+            if(!eml_hashmap_get_node(points, pt->data)) {
+                eml_hashmap_set_node(points, pt->data, pt->data);
+                distinct++;
+            }
+        }
+    }
+    t1 = bench_now();
+    printf("%d distinct points by list key in %.2f ms\n", distinct, (t1 - t0) * 1e3);
+    eml_hashmap_free(points);
+
+    eml_node_free(shared);
+    eml_hashcons_free(table);
+    eml_node_free(plain);
+    free(src);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * File: jit_bench.c
+ * Purpose: Measure numeric kernels interpreted and compiled to native code.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* numeric kernels, each a definition and a call which runs it */
+static const struct {
+    const char *name;
+    const char *def;
+    const char *call;
+} kernels[] = {
+    {"fib",
+     "to fib :n\n"
+     "  if :n < 2 [output :n]\n"
+     "  output sum fib :n - 1 fib :n - 2\n"
+     "end\n",
+     "make \"r fib 20\n"},
+    {"sumsq",
+     "to sumsq :n :acc :i\n"
+     "  repeat :n [make \"i :i + 1 make \"acc :acc + :i * :i]\n"
+     "  output :acc\n"
+     "end\n",
+     "repeat 200 [make \"r sumsq 1000 0 0]\n"},
+    {"collatz",
+     "to steps :n\n"
+     "  if :n = 1 [output 0]\n"
+     "  ifelse 0 = remainder :n 2 [output 1 + steps :n / 2] [output 1 + steps 3 * :n + 1]\n"
+     "end\n"
+     "to total :n :acc\n"
+     "  repeat :n [make \"acc :acc + steps :n make \"n :n - 1]\n"
+     "  output :acc\n"
+     "end\n",
+     "repeat 4 [make \"r total 500 0]\n"},
+    {"newton",
+     "to root :a :x\n"
+     "  repeat 30 [make \"x :x / 2 + :a / :x / 2]\n"
+     "  output :x\n"
+     "end\n",
+     "repeat 5000 [make \"r root 2 1]\n"}
+};
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static int kernel;
+static int jit;
+
+
+/* parse a program */
+static struct eml_node *parse(const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+    return prog;
+}
+
+
+/* Run the kernel n times, with or without the JIT. The first run, which
+   isn't timed, gets the calls in which compile it. */
+static double run(long n)
+{
+    struct eml_node *def = parse(kernels[kernel].def);
+    struct eml_node *call = parse(kernels[kernel].call);
+    struct eml_interp *in = eml_interp_alloc();
+    double t0, t1;
+
+    in->jit = jit;
+    eml_interp_run(in, def->data);
+    eml_interp_run(in, call->data);
+    t0 = bench_now();
+    while(n--) {
+        if(eml_interp_run(in, call->data)) {
+            fprintf(stderr, "%s\n", in->errmsg);
+            exit(1);
+        }
+    }
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(def);
+    eml_node_free(call);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    char name[64];
+
+    bench_json_begin("jit");
+    for(kernel=0; kernel<NKERNELS; kernel++) {
+        jit = 0;
+        snprintf(name, sizeof(name), "%s/interpreted", kernels[kernel].name);
+        bench_json_run(name, run, 3, 0);
+
+        jit = EML_JIT_THRESHOLD;
+        snprintf(name, sizeof(name), "%s/jit", kernels[kernel].name);
+        bench_json_run(name, run, 3, 0);
+    }
+    bench_json_end();
+    return 0;
+}
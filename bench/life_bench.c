@@ -0,0 +1,198 @@
+/*
+ * File: life_bench.c
+ * Purpose: Measure Conway's Game of Life on array boards, and ITEM on arrays and lists.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "buf.h"
+#include "bench.h"
+
+/* The board is a flat array of (N+2)^2 cells, with a border of dead ones
+   so no cell needs bounds checks. Each row slides a window of three
+   column sums along, so a cell costs three ITEMs rather than eight. */
+static const char *DEFS =
+    "to generation\n"
+    "  make \"p :w + 2\n"
+    "  repeat :n [\n"
+    "    make \"l sum item :p - :w - 1 :b sum item :p - 1 :b item :p + :w - 1 :b\n"
+    "    make \"m sum item :p - :w :b sum item :p :b item :p + :w :b\n"
+    "    repeat :n [\n"
+    "      make \"r sum item :p - :w + 1 :b sum item :p + 1 :b item :p + :w + 1 :b\n"
+    "      make \"s :l + :m + :r\n"
+    "      ifelse :s = 3 [setitem :p :c 1] [ifelse :s = 4 [setitem :p :c item :p :b] [setitem :p :c 0]]\n"
+    "      make \"l :m\n"
+    "      make \"m :r\n"
+    "      make \"p :p + 1\n"
+    "    ]\n"
+    "    make \"p :p + 2\n"
+    "  ]\n"
+    "  make \"t :b\n"
+    "  make \"b :c\n"
+    "  make \"c :t\n"
+    "end\n";
+
+/* the side of the board */
+#define N 1000
+#define W (N + 2)
+
+/* items in the lists and arrays read by the ITEM runs, and reads per run */
+#define ITEMS 1000
+#define READS 100000
+
+static const char *board;     /* the primitive making the boards */
+static const char *brackets;  /* around the items read by ITEM */
+
+
+/* parse a program */
+static struct eml_node *parse(const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+    return prog;
+}
+
+
+/* run a program, giving up on an error */
+static void run_prog(struct eml_interp *in, struct eml_node *prog)
+{
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+}
+
+
+/* the same random board every time, about a third of it alive */
+static void seed(struct eml_array *cells)
+{
+    unsigned int x = 12345;
+    int r, c;
+
+    for(r=0; r<W; r++) {
+        for(c=0; c<W; c++) {
+            x = x * 1103515245 + 12345;
+            if(r && c && r <= N && c <= N) {
+                eml_array_set(cells, r * W + c, eml_node_number((x >> 16) % 3 == 0));
+            } else {
+                eml_array_set(cells, r * W + c, eml_node_number(0));
+            }
+        }
+    }
+}
+
+
+/* play n generations on boards made by board */
+static double life(long n)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_node *def = parse(DEFS);
+    struct eml_node *boards, *prog;
+    char src[256];
+    double t0, t1;
+    long i;
+
+    snprintf(src, sizeof(src), "make \"n %d make \"w %d make \"b %s %d make \"c %s %d\n",
+             N, W, board, W * W, board, W * W);
+    boards = parse(src);
+    prog = parse("generation\n");
+    run_prog(in, def);
+    run_prog(in, boards);
+    seed(eml_interp_getvar(in, "b")->data);
+    seed(eml_interp_getvar(in, "c")->data);
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        run_prog(in, prog);
+    }
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(def);
+    eml_node_free(boards);
+    eml_node_free(prog);
+    return t1 - t0;
+}
+
+
+/* read the middle item of a list or array of ITEMS numbers n times */
+static double item(long n)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_node *setup, *prog;
+    char *src = eml_buf_alloc();
+    char num[64];
+    double t0, t1;
+    int i;
+
+    eml_buf_put(&src, "make \"x ", 8);
+    eml_buf_putc(&src, brackets[0]);
+    for(i=0; i<ITEMS; i++) {
+        snprintf(num, sizeof(num), " %d", i);
+        eml_buf_put(&src, num, strlen(num));
+    }
+    eml_buf_put(&src, " ", 1);
+    eml_buf_putc(&src, brackets[1]);
+    eml_buf_put(&src, "\n", 2);
+    setup = parse(src);
+    snprintf(num, sizeof(num), "repeat %ld [make \"y item %d :x]\n", n, ITEMS / 2);
+    prog = parse(num);
+    run_prog(in, setup);
+
+    t0 = bench_now();
+    run_prog(in, prog);
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(setup);
+    eml_node_free(prog);
+    eml_buf_free(src);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    bench_json_begin("life");
+
+    brackets = "[]";
+    bench_json_run("item/list", item, READS, 0);
+    brackets = "{}";
+    bench_json_run("item/array", item, READS, 0);
+
+    /* unboxed cells, then the same boards holding a word node per cell */
+    board = "numarray";
+    bench_json_run("life/numarray", life, 1, 0);
+    board = "array";
+    bench_json_run("life/array", life, 1, 0);
+
+    bench_json_end();
+    return 0;
+}
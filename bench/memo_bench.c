@@ -0,0 +1,108 @@
+/*
+ * File: memo_bench.c
+ * Purpose: Measure memoized against plain recursive procedures.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+static const char *FIB =
+    "to fib :n\n"
+    "  if :n < 2 [output :n]\n"
+    "  output sum fib :n - 1 fib :n - 2\n"
+    "end\n";
+
+/* run a program in the interpreter */
+static void run_source(struct eml_interp *in, const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+}
+
+
+/* Time FIB n in a fresh interpreter. If limit isn't 0 FIB is memoized
+   with a cache of that size, and the number of misses, which is how many
+   times the body ran, is stored in misses. */
+static double run(int n, int limit, long *misses)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_word *name = eml_stow("fib");
+    struct eml_proc *proc;
+    char src[64];
+    double t0, t1;
+
+    run_source(in, FIB);
+    proc = eml_hashmap_get(in->procs, name);
+    if(limit) {
+        run_source(in, "memo \"fib");
+        proc->memo->limit = limit;
+    }
+
+    snprintf(src, sizeof(src), "make \"x fib %d", n);
+    t0 = bench_now();
+    run_source(in, src);
+    t1 = bench_now();
+    *misses = proc->memo ? proc->memo->misses : 0;
+
+    eml_free_word(name);
+    eml_interp_free(in);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    int n;
+    long misses;
+    double t;
+
+    /* exponential against linear */
+    for(n=10; n<=25; n+=5) {
+        t = run(n, 0, &misses);
+        printf("fib %4d  plain            %10.3f ms\n", n, t * 1e3);
+        t = run(n, EML_MEMO_SIZE, &misses);
+        printf("fib %4d  memo             %10.3f ms  %5ld misses\n", n, t * 1e3, misses);
+    }
+
+    /* a tiny cache still works, the least recently used results go first */
+    for(n=100; n<=1000; n*=10) {
+        t = run(n, EML_MEMO_SIZE, &misses);
+        printf("fib %4d  memo             %10.3f ms  %5ld misses\n", n, t * 1e3, misses);
+        t = run(n, 4, &misses);
+        printf("fib %4d  memo, 4 entries  %10.3f ms  %5ld misses\n", n, t * 1e3, misses);
+    }
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * File: number_bench.c
+ * Purpose: Measure how fast number-heavy data is turned into words.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* how many tokens are in the generated data */
+#define NTOKENS 1000000
+
+static char *data;           /* the data file, tokens separated by spaces */
+static long data_len;
+static char **tokens;        /* the same tokens, one string each */
+static struct eml_word **words;
+static unsigned int seed;
+
+
+/* a small deterministic generator so every run sees the same data */
+static unsigned int rnd()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+
+/* Build the data: mostly integers and decimals like a table of
+   measurements, with the odd word mixed in. */
+static void make_data()
+{
+    long n = 0;
+    int i, k;
+
+    data = malloc(NTOKENS * 24);
+    tokens = malloc(NTOKENS * sizeof(char*));
+    seed = 1;
+    for(i=0; i<NTOKENS; i++) {
+        tokens[i] = data + n;
+        k = rnd() % 10;
+        if(k < 5) {
+            n += sprintf(data + n, "%d", (int)(rnd() % 2000000) - 1000000);
+        } else if(k < 9) {
+            n += sprintf(data + n, "%.*f", 1 + rnd() % 6, (rnd() % 2000000) / 7.0 - 100000);
+        } else {
+            n += sprintf(data + n, "%s", rnd() % 2 ? "-x" : "temp");
+        }
+        data[n++] = '\0';
+    }
+    data_len = n;
+}
+
+
+/* eml_stow as it was, classifying in one scan and converting in another
+   with atoi and atof */
+static struct eml_word *stow_two_pass(char *s)
+{
+    int len = strlen(s), i;
+    enum eml_word_type type;
+
+    if((len > 1 && *s == '-') || isdigit(*s)) {
+        type = INTEGER;
+    } else if(*s == '.' && len > 1) {
+        type = FLOAT;
+    } else {
+        type = WORD;
+    }
+    for(i = 1; type != WORD && i < len; i++) {
+        if(isdigit(s[i])) {
+            continue;
+        }
+        if(type == INTEGER && s[i] == '.') {
+            type = FLOAT;
+            continue;
+        }
+        type = WORD;
+    }
+
+    if(type == INTEGER) {
+        return eml_itow(atoi(s));
+    } else if(type == FLOAT) {
+        return eml_dtow(atof(s));
+    }
+    return eml_stow(s);
+}
+
+
+static void free_words()
+{
+    int i;
+    for(i=0; i<NTOKENS; i++) {
+        eml_free_word(words[i]);
+    }
+}
+
+
+static double stow_one(long n)
+{
+    double t0, t1;
+    int i;
+
+    t0 = bench_now();
+    for(i=0; i<NTOKENS; i++) {
+        words[i] = eml_stow(tokens[i]);
+    }
+    t1 = bench_now();
+    free_words();
+    return t1 - t0;
+}
+
+
+static double stow_two(long n)
+{
+    double t0, t1;
+    int i;
+
+    t0 = bench_now();
+    for(i=0; i<NTOKENS; i++) {
+        words[i] = stow_two_pass(tokens[i]);
+    }
+    t1 = bench_now();
+    free_words();
+    return t1 - t0;
+}
+
+
+/* the whole file through the lexer and parser */
+static double parse(long n)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    double t0, t1;
+
+    bench_set_source(data);
+    lex = eml_alloc_lexer(bench_getchar);
+    t0 = bench_now();
+    prog = eml_node_parse(lex, NULL);
+    t1 = bench_now();
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    struct eml_word *a, *b;
+    int i, differ = 0;
+
+    make_data();
+    words = malloc(NTOKENS * sizeof(struct eml_word*));
+
+    /* both ways must agree before their speed means anything */
+    for(i=0; i<NTOKENS; i++) {
+        a = eml_stow(tokens[i]);
+        b = stow_two_pass(tokens[i]);
+        differ += !eml_word_equals(a, b);
+        eml_free_word(a);
+        eml_free_word(b);
+    }
+    if(differ) {
+        fprintf(stderr, "%d tokens converted differently\n", differ);
+        return 1;
+    }
+
+    bench_json_begin("number");
+    bench_json_run("eml_stow/one_pass", stow_one, NTOKENS, data_len);
+    bench_json_run("eml_stow/two_pass", stow_two, NTOKENS, data_len);
+
+    /* the parser reads one long line, so join the tokens with spaces */
+    for(i=0; i<data_len - 1; i++) {
+        data[i] = data[i] ? data[i] : ' ';
+    }
+    bench_json_run("eml_node_parse", parse, NTOKENS, data_len);
+    bench_json_end();
+
+    free(words);
+    free(tokens);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * File: opt_bench.c
+ * Purpose: Measure the optimizer on generated drawing programs.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "buf.h"
+#include "bench.h"
+
+/* the shape of the generated program */
+#define WRAPPERS 8      /* procedures which output a little arithmetic */
+#define STEPS 8         /* procedures of a couple of turtle commands */
+#define SHAPES 16       /* procedures drawing with those */
+#define DRAWS 2000      /* shapes the program draws */
+
+static char *source;
+static int passes;
+
+
+/* a small deterministic generator so every run sees the same program */
+static unsigned int seed = 1;
+static unsigned int rnd(unsigned int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+
+/* Generate a drawing program the way tools write them: constant
+   arithmetic everywhere, tiny wrapper procedures and code which can't
+   run after STOP and inside IFs of constants. */
+static char *make_program()
+{
+    char *buf = eml_buf_alloc();
+    char line[256];
+    int i;
+
+    eml_buf_put(&buf, "pu\n", 3);
+    for(i=0; i<WRAPPERS; i++) {
+        snprintf(line, sizeof(line), "to w%d :a\noutput :a * %d + %d / 2\nend\n",
+                 i, 1 + rnd(4), 2 * rnd(10));
+        eml_buf_put(&buf, line, strlen(line));
+    }
+    for(i=0; i<STEPS; i++) {
+        snprintf(line, sizeof(line), "to s%d :n\nfd :n rt 360 / %d\nend\n", i, 3 + rnd(6));
+        eml_buf_put(&buf, line, strlen(line));
+    }
+    for(i=0; i<SHAPES; i++) {
+        snprintf(line, sizeof(line),
+                 "to shape%d :n\n"
+                 "repeat 2 * %d [s%d w%d :n lt 90 / %d if %d > 100 [print \"never]]\n"
+                 "stop\n"
+                 "print \"unreachable\n"
+                 "end\n",
+                 i, 2 + rnd(4), rnd(STEPS), rnd(WRAPPERS), 1 + rnd(3), rnd(50));
+        eml_buf_put(&buf, line, strlen(line));
+    }
+    for(i=0; i<DRAWS; i++) {
+        snprintf(line, sizeof(line), "shape%d %d * 2 + %d\n", rnd(SHAPES), 1 + rnd(10), rnd(5));
+        eml_buf_put(&buf, line, strlen(line));
+    }
+    eml_buf_putc(&buf, '\0');
+    return buf;
+}
+
+
+/* parse and run the program with the passes set, n times */
+static double run(long n)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    struct eml_interp *in;
+    double t0, t1;
+
+    bench_set_source(source);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    in = eml_interp_alloc();
+    in->optimize = passes;
+
+    t0 = bench_now();
+    while(n--) {
+        if(eml_optimize_run(in, prog)) {
+            fprintf(stderr, "%s\n", in->errmsg);
+            exit(1);
+        }
+    }
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    static const struct {const char *name; int passes;} runs[] = {
+        {"none", 0},
+        {"fold", EML_OPT_FOLD},
+        {"inline", EML_OPT_INLINE},
+        {"dead", EML_OPT_DEAD},
+        {"fold+inline", EML_OPT_FOLD | EML_OPT_INLINE},
+        {"all", EML_OPT_ALL}
+    };
+    int i;
+
+    source = make_program();
+    bench_json_begin("optimize");
+    for(i=0; i<sizeof(runs) / sizeof(runs[0]); i++) {
+        passes = runs[i].passes;
+        bench_json_run(runs[i].name, run, 5, 0);
+    }
+    bench_json_end();
+
+    eml_buf_free(source);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * File: pool_bench.c
+ * Purpose: Measure PMAP, PFILTER and PREDUCE on growing numbers of threads.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "pool.h"
+#include "bench.h"
+
+/* a light procedure, a test, an associative one, and a heavier one which
+   makes dozens of calls for every item */
+static const char *DEFS =
+    "to sq :x\n"
+    "  output :x * :x\n"
+    "end\n"
+    "to even :x\n"
+    "  output 0 = remainder :x 2\n"
+    "end\n"
+    "to add :a :b\n"
+    "  output :a + :b\n"
+    "end\n"
+    "to steps :n\n"
+    "  if :n = 1 [output 0]\n"
+    "  if 0 = remainder :n 2 [output 1 + steps quotient :n 2]\n"
+    "  output 1 + steps 3 * :n + 1\n"
+    "end\n";
+
+/* Each is run sequentially with MAP and FILTER, then in parallel. STEPS
+   gets a fiftieth of the items, since it does so much more with each. */
+static const struct {
+    const char *name;
+    const char *seq;
+    const char *par;
+} runs[] = {
+    {"sq", "make \"r reduce \"add map \"sq :data\n", "make \"r preduce \"add pmap \"sq :data\n"},
+    {"even", "make \"r reduce \"add filter \"even :data\n", "make \"r preduce \"add pfilter \"even :data\n"},
+    {"steps", "make \"r reduce \"add map \"steps :few\n", "make \"r preduce \"add pmap \"steps :few\n"},
+};
+#define NRUNS (sizeof(runs) / sizeof(runs[0]))
+
+
+/* parse a program */
+static struct eml_node *parse(const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+    return prog;
+}
+
+
+/* the list of the numbers 1 to n */
+static struct eml_node *numbers(int n)
+{
+    struct eml_list *list = eml_list_alloc();
+    int i;
+
+    for(i=1; i<=n; i++) {
+        eml_list_append(list, eml_node_number(i));
+    }
+    return eml_node_list(list);
+}
+
+
+/* run a program, returning its best time of three */
+static double run(struct eml_interp *in, const char *src)
+{
+    struct eml_node *prog = parse(src);
+    double t0, t1, best = 0;
+    int i;
+
+    for(i=0; i<3; i++) {
+        t0 = bench_now();
+        if(eml_interp_run(in, prog->data)) {
+            fprintf(stderr, "%s\n", in->errmsg);
+            exit(1);
+        }
+        t1 = bench_now();
+        if(!i || t1 - t0 < best) {
+            best = t1 - t0;
+        }
+    }
+
+    eml_node_free(prog);
+    return best;
+}
+
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : eml_pool_threads();
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_node *def = parse(DEFS);
+    double t, base;
+    int i, threads;
+
+    eml_interp_run(in, def->data);
+    eml_interp_setvar(in, "data", numbers(n));
+    eml_interp_setvar(in, "few", numbers(n / 50));
+    printf("%d items\n", n);
+
+    for(i=0; i<NRUNS; i++) {
+        t = run(in, runs[i].seq);
+        printf("%-6s sequential  %9.2f ms  result %s\n",
+               runs[i].name, t*1e3, eml_word_str(eml_interp_getvar(in, "r")->data));
+
+        base = 0;
+        for(threads=1; threads<=max_threads; threads*=2) {
+            in->threads = threads;
+            t = run(in, runs[i].par);
+            if(threads == 1) {
+                base = t;
+            }
+            printf("%-6s threads %3d %9.2f ms  speedup %5.2fx  result %s\n",
+                   runs[i].name, threads, t*1e3, base / t,
+                   eml_word_str(eml_interp_getvar(in, "r")->data));
+            if(threads < max_threads && threads * 2 > max_threads) {
+                threads = max_threads / 2;
+            }
+        }
+    }
+
+    eml_interp_free(in);
+    eml_node_free(def);
+    return 0;
+}
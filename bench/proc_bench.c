@@ -0,0 +1,108 @@
+/*
+ * File: proc_bench.c
+ * Purpose: Measure procedure calls with and without the profiler.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+static const char *FIB =
+    "to fib :n\n"
+    "  if :n < 2 [output :n]\n"
+    "  output sum fib :n - 1 fib :n - 2\n"
+    "end\n";
+
+/* run source through a fresh interpreter, returning the seconds it took */
+static double run(const char *src, int profile)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    struct eml_interp *in;
+    double t0, t1;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    in = eml_interp_alloc();
+    if(profile) {
+        in->profile = eml_profile_alloc();
+    }
+
+    t0 = bench_now();
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    return t1 - t0;
+}
+
+
+/* the best of a few runs */
+static double best(const char *src, int profile)
+{
+    double t, b = 0;
+    int i;
+
+    for(i=0; i<BENCH_REPS; i++) {
+        t = run(src, profile);
+        if(!i || t < b) {
+            b = t;
+        }
+    }
+    return b;
+}
+
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 22;
+    char src[256];
+    long calls;
+    int a = 0, b = 1, i;
+    double off, on;
+
+    /* fib n makes 2 fib(n+1) - 1 calls */
+    for(i=0; i<=n; i++) {
+        b = a + b;
+        a = b - a;
+    }
+    calls = 2L * a - 1;
+
+    snprintf(src, sizeof(src), "%smake \"x fib %d\n", FIB, n);
+    off = best(src, 0);
+    on = best(src, 1);
+
+    printf("fib %d, %ld calls\n", n, calls);
+    printf("profiler off %8.2f ms  %7.1f ns/call\n", off * 1e3, off * 1e9 / calls);
+    printf("profiler on  %8.2f ms  %7.1f ns/call  overhead %5.1f%%\n",
+           on * 1e3, on * 1e9 / calls, (on - off) / off * 100);
+    return 0;
+}
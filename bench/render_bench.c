@@ -0,0 +1,94 @@
+/*
+ * File: render_bench.c
+ * Purpose: Measure how tiled display list rendering scales with threads.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* a simple checksum to show every thread count draws the same picture */
+static unsigned long checksum(struct eml_canvas *c)
+{
+    unsigned long sum = 0;
+    int i;
+
+    for(i=0; i<c->width * c->height; i++) {
+        sum = sum * 31 + c->pixels[i];
+    }
+    return sum;
+}
+
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : eml_dlist_threads();
+    struct eml_canvas *c = eml_canvas_alloc(4096, 4096);
+    struct eml_turtle *t = eml_turtle_alloc(c);
+    double t0, t1, base = 0;
+    int i, threads;
+
+    /* The dragon curve fractal: the turn after step i is decided by the
+       bit above the lowest set bit of i. */
+    t0 = bench_now();
+    eml_turtle_pen(t, 0);
+    eml_turtle_setpos(t, -400, 600);
+    eml_turtle_pen(t, 1);
+    for(i=1; i<=n; i++) {
+        eml_turtle_setcolor(t, EML_RGBA(i >> 16 & 0xff, i >> 8 & 0xff, 128, 255));
+        eml_turtle_forward(t, 1.5);
+        eml_turtle_right(t, (((i & -i) << 1) & i) ? -90 : 90);
+    }
+    t1 = bench_now();
+    printf("recorded %d segments in %.2f ms\n", n, (t1-t0)*1e3);
+
+    for(threads=1; threads<=max_threads; threads*=2) {
+        t->threads = threads;
+        t0 = bench_now();
+        eml_turtle_render(t);
+        t1 = bench_now();
+        if(threads == 1) {
+            base = t1 - t0;
+        }
+        printf("threads %3d  render %9.2f ms  speedup %5.2fx  checksum %016lx\n",
+               threads, (t1-t0)*1e3, base / (t1-t0), checksum(c));
+        if(threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+
+    t0 = bench_now();
+    {
+        FILE *f = fopen("/dev/null", "w");
+        eml_dlist_write_svg(t->dlist, c->width, c->height, t->background, f);
+        fclose(f);
+    }
+    t1 = bench_now();
+    printf("svg          write  %9.2f ms\n", (t1-t0)*1e3);
+
+    eml_turtle_free(t);
+    eml_canvas_free(c);
+    return 0;
+}
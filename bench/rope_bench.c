@@ -0,0 +1,121 @@
+/*
+ * File: rope_bench.c
+ * Purpose: Measure building long words one piece at a time.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* eml_wcat as it was, copying both words into a new string every time */
+static struct eml_word *wcat_copy(struct eml_word *a, struct eml_word *b)
+{
+    int la = strlen(a->field.s), lb = strlen(b->field.s);
+    char *s = malloc(la + lb + 1);
+    struct eml_word *w;
+
+    memcpy(s, a->field.s, la);
+    memcpy(s + la, b->field.s, lb + 1);
+    w = eml_stow(s);
+    free(s);
+    return w;
+}
+
+
+/* append a short piece n times, with eml_wcat or the copying version,
+   then get the text in one piece the way PRINT would */
+static double build(long n, int copy, double *flat)
+{
+    struct eml_word *w = eml_stow("start"), *piece = eml_stow("xy"), *next;
+    double t0, t1;
+    long i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        next = copy ? wcat_copy(w, piece) : eml_wcat(w, piece);
+        eml_free_word(w);
+        w = next;
+    }
+    t1 = bench_now();
+
+    *flat = bench_now();
+    if(strlen(eml_word_str(w)) != 5 + 2 * n) {
+        fprintf(stderr, "built the wrong word\n");
+        exit(1);
+    }
+    *flat = bench_now() - *flat;
+
+    eml_free_word(w);
+    eml_free_word(piece);
+    return t1 - t0;
+}
+
+
+/* the same loop written in Logo */
+static double logo(long n)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    char src[128];
+    double t0, t1;
+
+    snprintf(src, sizeof(src), "make \"w \"start repeat %ld [make \"w word :w \"xy]", n);
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    t0 = bench_now();
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+    t1 = bench_now();
+
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    eml_interp_free(in);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    double t, flat;
+    long n;
+
+    /* copying is quadratic, 100000 steps take most of a minute */
+    for(n=10000; n<=1000000; n*=10) {
+        if(n <= 10000) {
+            t = build(n, 1, &flat);
+            printf("%8ld steps  copy   %10.3f ms\n", n, t * 1e3);
+        }
+        t = build(n, 0, &flat);
+        printf("%8ld steps  rope   %10.3f ms  flatten %8.3f ms\n", n, t * 1e3, flat * 1e3);
+        t = logo(n);
+        printf("%8ld steps  logo   %10.3f ms\n", n, t * 1e3);
+    }
+
+    return 0;
+}
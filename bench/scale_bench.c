@@ -0,0 +1,269 @@
+/*
+ * File: scale_bench.c
+ * Purpose: Run lex, parse, intern and free over growing generated sources.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emlogo.h"
+#include "bench.h"
+#include "gen.h"
+
+/* the smallest and default largest source, in bytes */
+#define MIN_SIZE 1024L
+#define MAX_SIZE (64L << 20)
+
+/* sources smaller than this are too quick to time reliably */
+#define STABLE_SIZE (64L << 10)
+
+/* the stages, run in order on each source */
+enum stage {LEX, PARSE, INTERN, FREE, STAGES};
+static const char *stage_name[] = {"lex", "parse", "intern", "free"};
+
+/* what each stage cost */
+struct measure {
+    double secs;
+    long allocs;        /* allocations made */
+    long lib_peak;      /* most library bytes in use */
+    long rss_peak;      /* peak resident set, in kB */
+};
+
+
+/* read the peak resident set size, in kB */
+static long rss_peak()
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = 0;
+
+    if(!f) {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), f)) {
+        if(sscanf(line, "VmHWM: %ld", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+
+/* start the peak resident set over from the current size */
+static void rss_reset()
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+
+    if(f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+
+/* start measuring a stage */
+static double stage_begin()
+{
+    eml_mem_stats_reset();
+    rss_reset();
+    return bench_now();
+}
+
+
+/* finish measuring a stage */
+static void stage_end(struct measure *m, double t0)
+{
+    struct eml_mem_stats s;
+
+    m->secs = bench_now() - t0;
+    eml_mem_stats(EML_MEM_KINDS, &s);
+    m->allocs = s.allocs;
+    m->lib_peak = s.peak;
+    m->rss_peak = rss_peak();
+}
+
+
+/* put every plain word of the tree into the map, as a symbol table would */
+static void intern(struct eml_hashmap *map, struct eml_node *tree)
+{
+    struct eml_list_node **stack = NULL;
+    int size = 0, cap = 0;
+    struct eml_list_node *cur = ((struct eml_list*) tree->data)->head;
+    struct eml_node *node;
+    struct eml_word *w;
+
+    for(;;) {
+        if(!cur) {
+            if(!size) {
+                break;
+            }
+            cur = stack[--size];
+            continue;
+        }
+
+        node = cur->data;
+        cur = cur->next;
+        if(node->type == EML_LIST) {
+            if(size == cap) {
+                cap = cap ? cap * 2 : 64;
+                stack = realloc(stack, cap * sizeof(*stack));
+            }
+            stack[size++] = cur;
+            cur = ((struct eml_list*) node->data)->head;
+            continue;
+        }
+
+        w = node->data;
+        if(w->type == WORD && !eml_hashmap_get(map, w)) {
+            eml_hashmap_set(map, w, w);
+        }
+    }
+
+    free(stack);
+}
+
+
+/* run every stage over a source of the given size */
+static void run(const struct gen_opts *shape, long size, struct measure *m, int *words)
+{
+    struct gen_opts o = *shape;
+    struct eml_lexer *lex;
+    struct eml_word *w;
+    struct eml_node *tree;
+    struct eml_hashmap *map;
+    char *src;
+    long len;
+    double t0;
+
+    o.size = size;
+    src = gen_logo(&o, &len);
+
+    /* lex, throwing each word away */
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    t0 = stage_begin();
+    while((w = eml_lexer_next(lex))) {
+        eml_free_word(w);
+    }
+    stage_end(m + LEX, t0);
+    eml_free_lexer(lex);
+
+    /* parse into a tree */
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    t0 = stage_begin();
+    tree = eml_node_parse(lex, NULL);
+    stage_end(m + PARSE, t0);
+    eml_free_lexer(lex);
+
+    /* build a symbol table of the words */
+    t0 = stage_begin();
+    map = eml_hashmap_alloc();
+    intern(map, tree);
+    stage_end(m + INTERN, t0);
+    *words = map->size;
+
+    /* and tear it all down */
+    t0 = stage_begin();
+    eml_hashmap_free(map);
+    eml_node_free(tree);
+    stage_end(m + FREE, t0);
+
+    free(src);
+}
+
+
+int main(int argc, char **argv)
+{
+    struct gen_opts shape = GEN_DEFAULT;
+    struct measure m[32][STAGES];
+    long sizes[32];
+    long max = MAX_SIZE;
+    long len;
+    int words;
+    int n, i, s, base;
+    char *src;
+
+    /* scale_bench [-e size] [max_bytes [vocab [depth [numbers%]]]] */
+    if(argc > 2 && strcmp(argv[1], "-e") == 0) {
+        shape.size = atol(argv[2]);
+        argc -= 2;
+        argv += 2;
+        max = 0;
+    } else if(argc > 1) {
+        max = atol(argv[1]);
+    }
+    if(argc > 2) {
+        shape.vocab = atoi(argv[2]);
+    }
+    if(argc > 3) {
+        shape.depth = atoi(argv[3]);
+    }
+    if(argc > 4) {
+        shape.numbers = atoi(argv[4]);
+    }
+
+    /* just emit a generated source */
+    if(!max) {
+        src = gen_logo(&shape, &len);
+        fwrite(src, 1, len, stdout);
+        free(src);
+        return 0;
+    }
+
+    eml_mem_instrument();
+    printf("vocabulary %d, depth %d, %d%% numbers\n", shape.vocab, shape.depth, shape.numbers);
+    printf("%12s %8s %8s %10s %8s %12s %12s %12s\n", "bytes", "words", "stage",
+           "ms", "ns/byte", "allocs", "lib peak MB", "rss peak MB");
+
+    n = 0;
+    for(len = MIN_SIZE; len <= max && n < 32; len *= 4) {
+        sizes[n] = len;
+        run(&shape, len, m[n], &words);
+        for(s=0; s<STAGES; s++) {
+            printf("%12ld %8d %8s %10.2f %8.2f %12ld %12.2f %12.2f\n", len, words,
+                   stage_name[s], m[n][s].secs * 1e3, m[n][s].secs * 1e9 / len,
+                   m[n][s].allocs, m[n][s].lib_peak / 1048576.0, m[n][s].rss_peak / 1024.0);
+        }
+        fflush(stdout);
+        n++;
+    }
+
+    /* Time grows as size^k, so k near 1 is linear. Anything much more
+       shows the stage going superlinear. */
+    for(base = 0; base < n - 1 && sizes[base] < STABLE_SIZE; base++);
+    if(base < n - 1) {
+        printf("\nscaling exponent from %ld to %ld bytes:", sizes[base], sizes[n-1]);
+        for(s=0; s<STAGES; s++) {
+            i = log(m[n-1][s].secs / m[base][s].secs) / log((double) sizes[n-1] / sizes[base]) > 1.2;
+            printf("  %s %.2f%s", stage_name[s],
+                   log(m[n-1][s].secs / m[base][s].secs) / log((double) sizes[n-1] / sizes[base]),
+                   i ? " (superlinear)" : "");
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
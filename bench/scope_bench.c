@@ -0,0 +1,117 @@
+/*
+ * File: scope_bench.c
+ * Purpose: Measure variable references through deep recursion.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* DOWN recurses to a depth, reading an input of OUTER's at every level
+   or only its own input */
+static const char *DEFS =
+    "to down :d\n"
+    "  if :d = 0 [output 0]\n"
+    "  output :a + down :d - 1\n"
+    "end\n"
+    "to own :d\n"
+    "  if :d = 0 [output 0]\n"
+    "  output :d + own :d - 1\n"
+    "end\n"
+    "to outer :a :depth\n"
+    "  output down :depth\n"
+    "end\n";
+
+/* every run makes this many calls, whatever the depth */
+#define CALLS 100000
+
+static const int depths[] = {10, 100, 1000, 4000};
+#define NDEPTHS (sizeof(depths) / sizeof(depths[0]))
+
+static int depth;
+static const char *call;
+
+
+/* parse a program */
+static struct eml_node *parse(const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+    return prog;
+}
+
+
+/* recurse to the depth often enough to make CALLS calls, n times */
+static double run(long n)
+{
+    struct eml_node *def = parse(DEFS);
+    struct eml_node *prog;
+    struct eml_interp *in = eml_interp_alloc();
+    char src[128];
+    double t0, t1;
+
+    snprintf(src, sizeof(src), "repeat %d [make \"r %s %d]\n", CALLS / depth, call, depth);
+    prog = parse(src);
+    eml_interp_run(in, def->data);
+
+    t0 = bench_now();
+    while(n--) {
+        if(eml_interp_run(in, prog->data)) {
+            fprintf(stderr, "%s\n", in->errmsg);
+            exit(1);
+        }
+    }
+    t1 = bench_now();
+
+    eml_interp_free(in);
+    eml_node_free(def);
+    eml_node_free(prog);
+    return t1 - t0;
+}
+
+
+int main()
+{
+    char name[64];
+    int i;
+
+    bench_json_begin("scope");
+    for(i=0; i<NDEPTHS; i++) {
+        depth = depths[i];
+        call = "own";
+        snprintf(name, sizeof(name), "own/%d", depth);
+        bench_json_run(name, run, 3, 0);
+
+        call = "outer 1";
+        snprintf(name, sizeof(name), "outer/%d", depth);
+        bench_json_run(name, run, 3, 0);
+    }
+    bench_json_end();
+    return 0;
+}
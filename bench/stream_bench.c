@@ -0,0 +1,110 @@
+/*
+ * File: stream_bench.c
+ * Purpose: Measure walking lazy streams and the memory they hold.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "alloc.h"
+#include "bench.h"
+
+/* a pipeline over a billion numbers, of which only the walked part is
+   ever made */
+static const char *DEFS =
+    "to sq :x\n"
+    "  output :x * :x\n"
+    "end\n"
+    "to even :x\n"
+    "  output 0 = remainder :x 2\n"
+    "end\n";
+
+static const char *PIPE = "filter \"even map \"sq iseq 1 1000000000";
+
+
+/* parse a program */
+static struct eml_node *parse(const char *src)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    bench_set_source(src);
+    lex = eml_alloc_lexer(bench_getchar);
+    prog = eml_node_parse(lex, NULL);
+    eml_free_lexer(lex);
+    return prog;
+}
+
+
+/* Walk steps items along the pipeline, dropping the start of it or
+   holding it in a variable. Prints the time per item and how far the
+   memory in use grew. */
+static void walk(long steps, int hold)
+{
+    struct eml_node *def = parse(DEFS);
+    struct eml_node *prog;
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_mem_stats st;
+    char src[256];
+    long base;
+    double t0, t1;
+
+    snprintf(src, sizeof(src),
+             "make \"s %s\n%srepeat %ld [make \"s bf :s]\n",
+             PIPE, hold ? "make \"h :s\n" : "", steps);
+    prog = parse(src);
+    eml_interp_run(in, def->data);
+
+    eml_mem_stats_reset();
+    eml_mem_stats(EML_MEM_KINDS, &st);
+    base = st.current;
+    t0 = bench_now();
+    if(eml_interp_run(in, prog->data)) {
+        fprintf(stderr, "%s\n", in->errmsg);
+        exit(1);
+    }
+    t1 = bench_now();
+    eml_mem_stats(EML_MEM_KINDS, &st);
+
+    printf("%-7s steps %9ld  %8.3f us/item  peak growth %12ld bytes\n",
+           hold ? "held" : "dropped", steps, (t1-t0)*1e6/steps,
+           st.peak - base);
+
+    eml_interp_free(in);
+    eml_node_free(def);
+    eml_node_free(prog);
+}
+
+
+int main(int argc, char **argv)
+{
+    long max_steps = argc > 1 ? atol(argv[1]) : 1000000;
+    long steps;
+
+    eml_mem_instrument();
+    for(steps = 10000; steps <= max_steps; steps *= 10) {
+        walk(steps, 0);
+        walk(steps, 1);
+    }
+    return 0;
+}
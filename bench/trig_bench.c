@@ -0,0 +1,122 @@
+/*
+ * File: trig_bench.c
+ * Purpose: Measure turtle heading trigonometry and drift.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* The way the turtle used to move, taking sin and cos of the heading in
+   radians on every step. */
+struct libm_turtle {
+    double x, y, heading;
+};
+
+static void libm_forward(struct libm_turtle *t, double d)
+{
+    double r = t->heading * (M_PI / 180.0);
+    t->x += d * sin(r);
+    t->y += d * cos(r);
+}
+
+static void libm_right(struct libm_turtle *t, double a)
+{
+    t->heading = fmod(t->heading + a, 360.0);
+    if(t->heading < 0) {
+        t->heading += 360.0;
+    }
+}
+
+
+/* REPEAT n [FD d RT a] through both turtles */
+static void steps(const char *name, int n, double d, double a)
+{
+    struct eml_turtle *t = eml_turtle_alloc(NULL);
+    struct libm_turtle lt = {0, 0, 0};
+    double t0, t1, t2;
+    int i;
+
+    eml_turtle_pen(t, 0);
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        libm_forward(&lt, d);
+        libm_right(&lt, a);
+    }
+    t1 = bench_now();
+    for(i=0; i<n; i++) {
+        eml_turtle_forward(t, d);
+        eml_turtle_right(t, a);
+    }
+    t2 = bench_now();
+
+    printf("%-12s libm %6.2f ns/step  table %6.2f ns/step  speedup %5.2fx\n",
+           name, (t1-t0)*1e9/n, (t2-t1)*1e9/n, (t1-t0)/(t2-t1));
+    printf("%-12s drift  libm (%g, %g)  table (%g, %g)\n", "",
+           lt.x, lt.y, t->x, t->y);
+
+    eml_turtle_free(t);
+}
+
+
+/* a REPEAT heavy drawing through the interpreter */
+static void program(const char *src)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_lexer *lex = eml_alloc_lexer(bench_getchar);
+    struct eml_node *prog;
+    double t0, t1;
+
+    bench_set_source(src);
+    prog = eml_node_parse(lex, NULL);
+
+    t0 = bench_now();
+    eml_interp_run(in, prog->data);
+    t1 = bench_now();
+    printf("%s\n    %d segments %.2f ms, %.1f ns/segment, ends at (%g, %g)\n", src,
+           in->turtle->dlist->size, (t1-t0)*1e3,
+           (t1-t0)*1e9/in->turtle->dlist->size, in->turtle->x, in->turtle->y);
+
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    eml_interp_free(in);
+}
+
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+
+    /* n is a multiple of 720, so every path should close */
+    n -= n % 720;
+    steps("square", n, 100, 90);
+    steps("15 degrees", n, 100, 15);
+    steps("1 degree", n, 10, 1);
+    steps("0.5 degree", n, 10, 0.5);
+
+    program("repeat 1000 [repeat 4 [fd 100 rt 90] rt 1]");
+    program("repeat 500 [repeat 24 [fd 50 rt 15] rt 3]");
+    return 0;
+}
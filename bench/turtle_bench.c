@@ -0,0 +1,90 @@
+/*
+ * File: turtle_bench.c
+ * Purpose: Measure turtle drawing speed in segments per second.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emlogo.h"
+#include "bench.h"
+
+/* a dense spiral drawn straight through the turtle API */
+static void spiral(int n)
+{
+    struct eml_canvas *c = eml_canvas_alloc(2048, 2048);
+    struct eml_turtle *t = eml_turtle_alloc(c);
+    double t0, t1, t2;
+    int i;
+
+    t0 = bench_now();
+    for(i=0; i<n; i++) {
+        eml_turtle_forward(t, 1 + (i % 2000) * 0.5);
+        eml_turtle_right(t, 91.3);
+    }
+    t1 = bench_now();
+    t->threads = 1;
+    eml_turtle_render(t);
+    t2 = bench_now();
+    printf("spiral      %9d segments  record %8.2f ms %12.0f segments/s\n",
+           n, (t1-t0)*1e3, n / (t1-t0));
+    printf("            %9s           render %8.2f ms %12.0f segments/s\n",
+           "", (t2-t1)*1e3, n / (t2-t1));
+
+    eml_turtle_free(t);
+    eml_canvas_free(c);
+}
+
+
+/* the same sort of drawing through the interpreter */
+static void repeat(int n)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    struct eml_lexer *lex = eml_alloc_lexer(bench_getchar);
+    struct eml_node *prog;
+    char src[100];
+    double t0, t1;
+
+    sprintf(src, "repeat %d [fd 390 rt 179.3]", n);
+    bench_set_source(src);
+    prog = eml_node_parse(lex, NULL);
+
+    t0 = bench_now();
+    eml_interp_run(in, prog->data);
+    t1 = bench_now();
+    printf("repeat      %9d segments  record %8.2f ms %12.0f segments/s\n",
+           n, (t1-t0)*1e3, n / (t1-t0));
+
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    eml_interp_free(in);
+}
+
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    spiral(n);
+    repeat(n);
+    return 0;
+}
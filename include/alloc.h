@@ -0,0 +1,92 @@
+/*
+ * File: alloc.h
+ * Purpose: This is the header file for the emlogo memory allocation hooks.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef ALLOC_H
+#define ALLOC_H
+#include <stddef.h>
+
+/* The subsystems which allocate memory. Every allocation is tagged with
+   one of these. */
+enum eml_mem_kind {
+    EML_MEM_WORD = 0,   /* words and their text */
+    EML_MEM_LIST,       /* lists and list nodes */
+    EML_MEM_NODE,       /* eml_node trees */
+    EML_MEM_BUF,        /* dynamic buffers */
+    EML_MEM_HASHMAP,    /* hashmaps and their buckets */
+    EML_MEM_TURTLE,     /* canvases and display lists */
+    EML_MEM_OTHER,      /* everything else */
+    EML_MEM_KINDS
+};
+
+/* An allocator. The library makes all of its allocations through the
+   current allocator, passing along the context pointer. realloc and free
+   are only ever given memory which came from the same allocator. */
+struct eml_allocator {
+    void *(*alloc)(void *ctx, size_t size, enum eml_mem_kind kind);
+    void *(*realloc)(void *ctx, void *ptr, size_t size, enum eml_mem_kind kind);
+    void (*free)(void *ctx, void *ptr, enum eml_mem_kind kind);
+    void *ctx;
+};
+
+/* Allocation statistics for one subsystem */
+struct eml_mem_stats {
+    long allocs;    /* number of allocations (including reallocations) */
+    long frees;     /* number of frees */
+    long bytes;     /* total bytes ever allocated */
+    long current;   /* bytes in use now */
+    long peak;      /* the most bytes in use at once */
+};
+
+/* Set the allocator, or pass NULL to go back to malloc. The allocator is
+   copied. It must not be changed while memory from the old allocator is
+   still in use. */
+void eml_set_allocator(const struct eml_allocator *a);
+
+/* get the current allocator */
+const struct eml_allocator *eml_get_allocator();
+
+/* allocation functions used throughout the library */
+void *eml_malloc(enum eml_mem_kind kind, size_t size);
+void *eml_calloc(enum eml_mem_kind kind, size_t n, size_t size);
+void *eml_realloc(enum eml_mem_kind kind, void *ptr, size_t size);
+void eml_free(enum eml_mem_kind kind, void *ptr);
+
+/* Install the instrumented allocator, which counts allocations for each
+   subsystem and passes them on to the current allocator. The same rule
+   applies as for eml_set_allocator. */
+void eml_mem_instrument();
+
+/* get the statistics for one subsystem, or for all of them together with
+   EML_MEM_KINDS */
+void eml_mem_stats(enum eml_mem_kind kind, struct eml_mem_stats *stats);
+
+/* Zero the counts, keeping the bytes in use. Peaks restart from the
+   current usage. */
+void eml_mem_stats_reset();
+
+/* the name of a subsystem */
+const char *eml_mem_kind_name(enum eml_mem_kind kind);
+#endif
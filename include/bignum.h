@@ -0,0 +1,81 @@
+/*
+ * File: bignum.h
+ * Purpose: This is the header file for emlogo arbitrary precision integers.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef BIGNUM_H
+#define BIGNUM_H
+#include <stdint.h>
+#include "word.h"
+
+/* Integers which don't fit in an int are kept as bignums, a sign and a
+   magnitude in base 10^9 limbs. That base makes decimal conversion
+   linear. */
+#define EML_BIGNUM_BASE 1000000000u
+#define EML_BIGNUM_DIGITS 9
+
+/* Operands with at least this many limbs are multiplied by Karatsuba's
+   method rather than the schoolbook one. 0 always uses the schoolbook. */
+extern int eml_karatsuba_limbs;
+
+struct eml_bignum {
+    int sign;           /* 1 or -1 */
+    int size;           /* limbs in use, the top one is never 0 */
+    uint32_t *limb;     /* least significant first */
+    char *text;         /* decimal text, made the first time it's wanted */
+};
+
+/* copy and destroy bignums */
+struct eml_bignum *eml_bignum_copy(struct eml_bignum *b);
+void eml_bignum_free(struct eml_bignum *b);
+
+/* the decimal text of a bignum, which belongs to the bignum */
+const char *eml_bignum_str(struct eml_bignum *b);
+
+/* the nearest double, or an infinity */
+double eml_bignum_double(struct eml_bignum *b);
+
+/* compare magnitudes and signs, returning <0, 0 or >0 */
+int eml_bignum_cmp(struct eml_bignum *a, struct eml_bignum *b);
+
+/*
+ * Exact arithmetic on INTEGER and BIGNUM words. Results which fit in an
+ * int are INTEGER words, and only larger ones become bignums, so equal
+ * values always have the same type. The inputs are not freed.
+ */
+#define eml_is_integer(w) ((w)->type == INTEGER || (w)->type == BIGNUM)
+
+/* convert an optionally signed string of digits */
+struct eml_word *eml_int_parse(const char *s);
+
+struct eml_word *eml_int_add(struct eml_word *a, struct eml_word *b);
+struct eml_word *eml_int_sub(struct eml_word *a, struct eml_word *b);
+struct eml_word *eml_int_mul(struct eml_word *a, struct eml_word *b);
+struct eml_word *eml_int_neg(struct eml_word *a);
+int eml_int_cmp(struct eml_word *a, struct eml_word *b);
+
+/* Divide a by b, which must not be 0. The quotient is truncated toward 0
+   and the remainder has the sign of a. Either q or r may be NULL. */
+void eml_int_divmod(struct eml_word *a, struct eml_word *b, struct eml_word **q, struct eml_word **r);
+#endif
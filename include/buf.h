@@ -70,4 +70,33 @@ int eml_buf_capacity(char *buf);
 
 /* Clear the buffer */
 void eml_buf_clear(char *buf);
+
+/* Make room for at least n more bytes, so that appending them won't grow
+   the buffer. This may result in reallocation:
+       buf = eml_buf_reserve(buf, n);
+ */
+char *eml_buf_reserve(char *buf, int n);
+
+/* Give back capacity beyond the length. This may result in reallocation:
+       buf = eml_buf_shrink(buf);
+ */
+char *eml_buf_shrink(char *buf);
+
+/* Handle functions. A handle is the address of the variable holding the
+   buffer. These update the variable whenever the buffer moves, so there
+   is no return value to forget to assign.
+
+   eml_buf_span returns room for at least n bytes at the end of the buffer,
+   which may be written directly. eml_buf_commit then counts the bytes that
+   were written:
+       tail = eml_buf_span(&buf, 256);
+       n = fill(tail, 256);
+       eml_buf_commit(buf, n);
+ */
+char *eml_buf_span(char **buf, int n);
+void eml_buf_commit(char *buf, int n);
+
+/* append n bytes, or a single byte, through a handle */
+void eml_buf_put(char **buf, const char *bytes, int n);
+void eml_buf_putc(char **buf, char c);
 #endif
\ No newline at end of file
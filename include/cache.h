@@ -0,0 +1,56 @@
+/*
+ * File: cache.h
+ * Purpose: This is the header file for the emlogo parsed program cache.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CACHE_H
+#define CACHE_H
+#include <stdint.h>
+#include "node.h"
+
+/* Entries written by any other version of the format are parsed again */
+#define EML_CACHE_VERSION 2
+
+/*
+ * Load a Logo source file as a parsed program, a list node. If dir isn't
+ * NULL it is a cache directory, created if need be. The program is read
+ * from there if the same text has been parsed before, and stored there
+ * if it hasn't. Entries are named by a hash of the text, so an edited
+ * file simply misses; each entry also records the text's length and the
+ * hash of its own contents, and one which doesn't check out is parsed
+ * again and replaced. Entries are written to a temporary file and renamed
+ * into place, so a reader never sees half of one. Returns NULL if the
+ * file can't be read.
+ */
+struct eml_node *eml_cache_load(const char *dir, const char *path);
+
+/* 64 bit FNV-1a of n bytes, which names cache entries */
+uint64_t eml_cache_hash(const char *bytes, long n);
+
+/* Encode a program in the cache's binary form, returning an eml_buf */
+char *eml_cache_encode(struct eml_node *prog);
+
+/* Decode a program, returning NULL if the bytes are malformed */
+struct eml_node *eml_cache_decode(const char *bytes, long n);
+#endif
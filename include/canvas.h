@@ -0,0 +1,82 @@
+/*
+ * File: canvas.h
+ * Purpose: This is the header file for the in-memory RGBA canvas the turtle
+ *          draws on.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef CANVAS_H
+#define CANVAS_H
+#include <stdio.h>
+#include <stdint.h>
+
+/* default canvas dimensions */
+#define EML_CANVAS_WIDTH 800
+#define EML_CANVAS_HEIGHT 800
+
+/* Pixels are packed with red in the low byte, so on little endian machines
+   the pixel array is plain RGBA bytes. */
+#define EML_RGBA(r, g, b, a) \
+    ((uint32_t)(r) | (uint32_t)(g) << 8 | (uint32_t)(b) << 16 | (uint32_t)(a) << 24)
+#define EML_RED(p)   ((p) & 0xff)
+#define EML_GREEN(p) (((p) >> 8) & 0xff)
+#define EML_BLUE(p)  (((p) >> 16) & 0xff)
+#define EML_ALPHA(p) (((p) >> 24) & 0xff)
+
+/* A headless framebuffer. Pixels are stored row by row, top row first. */
+struct eml_canvas {
+    int width;
+    int height;
+    uint32_t *pixels;
+};
+
+/* create a canvas cleared to opaque white */
+struct eml_canvas *eml_canvas_alloc(int width, int height);
+
+/* destroy a canvas */
+void eml_canvas_free(struct eml_canvas *c);
+
+/* fill the whole canvas with one color */
+void eml_canvas_clear(struct eml_canvas *c, uint32_t color);
+
+/* draw a line, including both end points. Parts of the line which fall off
+   the canvas are clipped. */
+void eml_canvas_line(struct eml_canvas *c, int x0, int y0, int x1, int y1, uint32_t color);
+
+/* draw a line, keeping only the pixels inside the rectangle (cx0,cy0) to
+   (cx1,cy1) inclusive. These are exactly the pixels the whole line would
+   have there, so a line may be drawn in pieces. */
+void eml_canvas_line_clip(struct eml_canvas *c, int x0, int y0, int x1, int y1,
+                          uint32_t color, int cx0, int cy0, int cx1, int cy1);
+
+/* Flood fill the 4-connected region of like colored pixels around (x, y).
+   This uses a span-based scanline fill with an explicit stack, so it
+   handles regions of any size and shape without recursion. */
+void eml_canvas_fill(struct eml_canvas *c, int x, int y, uint32_t color);
+
+/* write the canvas as a binary PPM. Returns 0 on success, -1 on error. */
+int eml_canvas_write_ppm(struct eml_canvas *c, FILE *f);
+
+/* write the canvas as an RGBA PNG. Returns 0 on success, -1 on error. */
+int eml_canvas_write_png(struct eml_canvas *c, FILE *f);
+#endif
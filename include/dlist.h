@@ -0,0 +1,89 @@
+/*
+ * File: dlist.h
+ * Purpose: This is the header file for the turtle display list.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef DLIST_H
+#define DLIST_H
+#include <stdio.h>
+#include <stdint.h>
+#include "canvas.h"
+
+/* One line drawn by the turtle, in turtle coordinates, along with the pen
+   color it was drawn in. Pen up moves are not recorded at all. */
+struct eml_segment {
+    float x0, y0;
+    float x1, y1;
+    uint32_t color;
+};
+
+/* A flood fill, which happens after the first at segments are drawn. */
+struct eml_fill {
+    int at;
+    float x, y;
+    uint32_t color;
+};
+
+/* The display list is a packed array of segments in drawing order, along
+   with the fills between them. It can be rendered any number of times, at
+   any size, in any format. */
+struct eml_dlist {
+    struct eml_segment *seg;
+    int size;
+    int cap;
+    struct eml_fill *fill;
+    int nfill;
+    int fill_cap;
+};
+
+/* create an empty display list */
+struct eml_dlist *eml_dlist_alloc();
+
+/* destroy a display list */
+void eml_dlist_free(struct eml_dlist *dl);
+
+/* remove all the segments and fills */
+void eml_dlist_clear(struct eml_dlist *dl);
+
+/* add a segment */
+void eml_dlist_add(struct eml_dlist *dl, float x0, float y0, float x1, float y1, uint32_t color);
+
+/* add a flood fill at the current point in the drawing */
+void eml_dlist_fill(struct eml_dlist *dl, float x, float y, uint32_t color);
+
+/* The number of threads to render with by default, which is the number of
+   cores. */
+int eml_dlist_threads();
+
+/* Draw the display list onto the canvas, with the turtle origin at the
+   center. With more than one thread, segments are binned into tiles and
+   the tiles are drawn in parallel. Either way the pixels are identical.
+   Fills are done in order between the batches of segments around them. */
+void eml_dlist_render(struct eml_dlist *dl, struct eml_canvas *c, int nthreads);
+
+/* Stream the display list out as an SVG of the given size. Connected runs
+   of segments in the same color become a single path. Fills are raster
+   operations and are left out. Returns 0 on success, -1 on error. */
+int eml_dlist_write_svg(struct eml_dlist *dl, int width, int height, uint32_t background, FILE *f);
+#endif
@@ -25,16 +25,16 @@
  */
 #ifndef EMLOGO_H
 #define EMLOGO_H
+#include "alloc.h"
 #include "word.h"
 #include "list.h"
 #include "hashmap.h"
 #include "lexer.h"
-
-/* This is the basic node for the emlogo language. It can be either a 
- * word or a list. */
-struct eml_node {
-    enum {EML_WORD, EML_LIST} type;
-    void *data;
-};
+#include "node.h"
+#include "interp.h"
+#include "turtle.h"
+#include "cache.h"
+#include "optimize.h"
+#include "jit.h"
 
 #endif
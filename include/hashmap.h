@@ -28,8 +28,12 @@
 #define HASHMAP_H
 #include "word.h"
 
+struct eml_node;
+
+/* A bucket holds a word key or, if that is NULL, a list key */
 struct eml_hashmap_bucket {
     struct eml_word *word;
+    struct eml_node *list;
     void *data;
 };
 
@@ -39,14 +43,29 @@ struct eml_hashmap {
     int size;
     int cap;
     int limit;
+    int tombs;  /* buckets left empty by removal */
 };
 
 /* create a hashmap */
 struct eml_hashmap *eml_hashmap_alloc();
 
+/* destroy a hashmap. Does nothing to the words or data. */
+void eml_hashmap_free(struct eml_hashmap *map);
+
 /* sets an item in the hashmap */
 void eml_hashmap_set(struct eml_hashmap *map, struct eml_word *word, void *data);
 
 /* retrieves an item from the hashmap */
 void *eml_hashmap_get(struct eml_hashmap *map, struct eml_word *word);
+
+/* Removes an item from the hashmap, returning its data. The map's word is
+   not freed, so the caller should keep hold of it first. */
+void *eml_hashmap_remove(struct eml_hashmap *map, struct eml_word *word);
+
+/* The same, keyed by a node. Word nodes are keyed by their words, and
+   list nodes by their structure, as eml_node_equals compares them. The map
+   holds on to list keys, which must not change while they are in it. */
+void eml_hashmap_set_node(struct eml_hashmap *map, struct eml_node *key, void *data);
+void *eml_hashmap_get_node(struct eml_hashmap *map, struct eml_node *key);
+void *eml_hashmap_remove_node(struct eml_hashmap *map, struct eml_node *key);
 #endif
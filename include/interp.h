@@ -0,0 +1,212 @@
+/*
+ * File: interp.h
+ * Purpose: This is the header file for the emlogo interpreter.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef INTERP_H
+#define INTERP_H
+#include <stddef.h>
+#include <stdint.h>
+#include "node.h"
+#include "hashmap.h"
+#include "profile.h"
+#include "memo.h"
+#include "writer.h"
+#include "primid.h"
+
+/* the most inputs any primitive takes */
+#define EML_MAX_ARGS 8
+
+struct eml_interp;
+struct eml_turtle;
+struct eml_jit;
+struct eml_pool;
+
+/* A primitive implementation. It receives the evaluated inputs, which are
+   owned by the interpreter, and returns its output (or NULL if it is a
+   command). */
+typedef struct eml_node *(*eml_prim_fn)(struct eml_interp *in, struct eml_node **args);
+
+/* what the optimizer may assume about a primitive */
+#define EML_PRIM_PURE 1     /* its output depends only on its inputs */
+#define EML_PRIM_COMMAND 2  /* it touches no variables and always returns */
+#define EML_PRIM_CONTROL 4  /* it runs its list inputs after the first */
+#define EML_PRIM_EXIT 8     /* it ends the running procedure */
+
+/* a primitive table entry */
+struct eml_prim {
+    const char *name;   /* the name, matched without regard to case */
+    int nargs;          /* number of inputs */
+    eml_prim_fn fn;     /* the implementation */
+    int flags;          /* EML_PRIM_*, 0 if nothing can be assumed */
+};
+
+/* An infix operator. The evaluator, the optimizer and the compiler all
+   parse expressions with this table, which runs from loosest to tightest
+   binding. */
+struct eml_infix {
+    char op;            /* the one character word it is written as */
+    int prec;           /* how tightly it binds, higher is tighter */
+    const char *prim;   /* the primitive that does the same */
+};
+#define EML_NINFIX 7
+extern const struct eml_infix EML_INFIX[EML_NINFIX];
+
+/* A variable, one for every name used as one. Its value is that of the
+   innermost running procedure input of that name, or else the global. */
+struct eml_var {
+    struct eml_word *name;      /* the name with its colon, the table key */
+    struct eml_node *value;     /* NULL when it has none */
+};
+
+/* a procedure defined with TO */
+struct eml_proc {
+    struct eml_word *name;                  /* the name, also its table key */
+    int nargs;                              /* number of inputs */
+    struct eml_word *params[EML_MAX_ARGS];  /* input names, without the colon */
+    struct eml_var *vars[EML_MAX_ARGS];     /* the variables the inputs bind */
+    struct eml_node *body;                  /* the instruction list */
+    int active;                             /* calls currently running */
+    struct eml_memo *memo;                  /* cached outputs, if MEMO'd */
+    struct eml_node *code;                  /* the optimized body, if any */
+    int optimized;                          /* the generation code is for */
+    int inline_kind;                        /* how calls may be inlined */
+    struct eml_jit *jit;                    /* native code, once compiled */
+    int calls;                              /* calls toward compiling it, -1 if it can't be */
+};
+
+/* A running procedure. Logo's dynamic scope is kept by shallow binding:
+   a call binds its inputs' variables, keeping the values they shadow
+   until it returns. Frames live on the C stack, which makes that the
+   binding stack, and a variable is found without looking through it. */
+struct eml_frame {
+    struct eml_proc *proc;
+    struct eml_node *values[EML_MAX_ARGS];  /* the inputs, until they are bound */
+    struct eml_node *saved[EML_MAX_ARGS];   /* the values the inputs shadow */
+    struct eml_frame *parent;               /* the caller's frame */
+};
+
+/* how the running procedure is finishing */
+enum eml_stop {EML_RUNNING = 0, EML_STOPPED, EML_OUTPUT};
+
+/* interpreter state */
+struct eml_interp {
+    struct eml_hashmap *prims;  /* name -> struct eml_prim* */
+    const struct eml_prim **prim_ids; /* primitive ID -> struct eml_prim* */
+    struct eml_hashmap *procs;  /* name -> struct eml_proc* */
+    struct eml_hashmap *vars;   /* :name -> struct eml_var* */
+    struct eml_frame *frame;    /* the running procedure, NULL at top level */
+    int depth;                  /* procedure calls running */
+    int max_depth;              /* the most the C stack has room for */
+    uintptr_t stack_limit;      /* the C stack address evaluation stops at */
+    enum eml_stop stop;         /* set by STOP and OUTPUT */
+    struct eml_node *output;    /* the value given to OUTPUT */
+    struct eml_profile *profile; /* call profile, NULL when not profiling */
+    struct eml_turtle *turtle;  /* the turtle and its canvas, NULL in a worker */
+    struct eml_writer *out;     /* where PRINT writes, stdout unless replaced */
+    int optimize;               /* EML_OPT_* passes, set before running anything */
+    int generation;             /* counts procedure definitions */
+    int jit;                    /* calls before a procedure is compiled, 0 for never */
+    int threads;                /* threads PMAP, PFILTER and PREDUCE run on */
+    struct eml_pool *pool;      /* their workers, NULL until they are needed */
+    struct eml_interp *parent;  /* for a worker, where globals it lacks come from */
+    int inherited;              /* for a worker, the parent's generation its procedures are from */
+    int error;                  /* set when an error has occurred */
+    char errmsg[256];           /* text of the error */
+};
+
+/* create an interpreter with all of the built in primitives */
+struct eml_interp *eml_interp_alloc();
+
+/* Create an interpreter for a pool worker. It has no turtle, so the
+   turtle primitives fail with an error. */
+struct eml_interp *eml_interp_alloc_worker();
+
+/* destroy an interpreter */
+void eml_interp_free(struct eml_interp *in);
+
+/* Add a table of primitives, terminated by an entry with a NULL name.
+   Names listed in src/prims.txt are called without a lookup. */
+void eml_interp_defprims(struct eml_interp *in, const struct eml_prim *prims);
+
+/* The C stack an interpreter can count on. That is the main thread's,
+   which worker threads are given as well. */
+size_t eml_interp_stack_size();
+
+/* Fit the interpreter to the thread about to run it, which has size bytes
+   of stack below the caller. Calls nested deeper than that has room for
+   stop with an error instead of overflowing it. */
+void eml_interp_set_stack(struct eml_interp *in, size_t size);
+
+/* Bring a worker up to date with its parent before a job. Its globals
+   are forgotten, to be copied from the parent again as they are used, and
+   once the parent has defined any procedure since last time, the worker
+   takes new copies of all of them. Nothing in the parent changes, so
+   several workers may do this at once, as long as the parent waits. */
+void eml_interp_inherit(struct eml_interp *in);
+
+/* Run a list of instructions. Returns 0 on success, -1 on error. A
+   procedure can be defined with TO name :input ... END anywhere an
+   instruction may appear. */
+int eml_interp_run(struct eml_interp *in, struct eml_list *list);
+
+/* Evaluate one expression, advancing cur past it. Returns the (owned)
+   output of the expression, or NULL if it has none. */
+struct eml_node *eml_interp_eval(struct eml_interp *in, struct eml_list_node **cur);
+
+/* Get the value of a variable, or NULL if it has none. The value still
+   belongs to the interpreter. */
+struct eml_node *eml_interp_getvar(struct eml_interp *in, const char *name);
+
+/* Set a variable, taking ownership of the value. The innermost procedure
+   input of that name is set if there is one, otherwise a global is. */
+void eml_interp_setvar(struct eml_interp *in, const char *name, struct eml_node *value);
+
+/* The infix operator at cur, as an index into EML_INFIX, if there is one
+   and it binds tighter than prec. Returns -1 otherwise. */
+int eml_infix_op(struct eml_list_node *cur, int prec);
+
+/* Flag an error. Evaluation stops as soon as the error is seen. */
+void eml_interp_error(struct eml_interp *in, const char *fmt, ...);
+
+/* clear the error flag */
+void eml_interp_clear_error(struct eml_interp *in);
+
+/* Get a numeric input. Returns 0 and flags an error if it is not a number. */
+int eml_arg_number(struct eml_interp *in, const char *who, struct eml_node *arg, double *d);
+
+/* Get a word input. Returns NULL and flags an error if it is a list. */
+struct eml_word *eml_arg_word(struct eml_interp *in, const char *who, struct eml_node *arg);
+
+/* Get a TRUE or FALSE input. Returns 0 and flags an error if it is
+   neither. */
+int eml_arg_bool(struct eml_interp *in, const char *who, struct eml_node *arg, int *b);
+
+/* Call the procedure or primitive a word names with nargs inputs, which it
+   takes. Returns its output, or NULL if there was none. Calling something
+   which doesn't exist, or which takes another number of inputs, is an
+   error in who. */
+struct eml_node *eml_interp_apply(struct eml_interp *in, const char *who, struct eml_word *name, struct eml_node **args, int nargs);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * File: jit.h
+ * Purpose: This is the header file for the emlogo native code compiler.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef JIT_H
+#define JIT_H
+#include "interp.h"
+
+/* calls a procedure gets before it is compiled, when the JIT is on */
+#define EML_JIT_THRESHOLD 50
+
+/* a procedure compiled to native code */
+struct eml_jit {
+    unsigned char *code;    /* the mapping holding it, read only once made */
+    size_t size;            /* length of the mapping */
+    int nargs;              /* number of inputs */
+    int (*entry)(const double *inputs, double *output);
+};
+
+/*
+ * Compile a procedure for x86-64 Linux by copying a template of machine
+ * code for each thing in its body. Returns NULL if the body uses
+ * anything there isn't a template for, or on other systems.
+ *
+ * Compiled procedures work on numbers only, kept unboxed as doubles.
+ * Their bodies may use the procedure's own inputs, numbers, arithmetic,
+ * comparisons, NOT, MAKE of an input, IF, IFELSE, REPEAT, OUTPUT, STOP
+ * and calls to the procedure itself. Nothing there can be seen outside
+ * the procedure, so it can be run again by the interpreter whenever the
+ * native code can't give the same answer.
+ */
+struct eml_jit *eml_jit_compile(struct eml_interp *in, struct eml_proc *proc);
+
+/*
+ * Run a compiled procedure on its evaluated inputs. Returns 1 with the
+ * output in *result (NULL if it stopped without one), 0 if the inputs
+ * weren't all numbers or -1 if it bailed out part way through. That is
+ * on errors and on numbers outside the range of integer words, where
+ * doubles would give different answers. Either way, the procedure must
+ * be run by the interpreter instead.
+ */
+int eml_jit_call(struct eml_jit *jit, struct eml_node **args, struct eml_node **result);
+
+/* destroy a compiled procedure */
+void eml_jit_free(struct eml_jit *jit);
+#endif
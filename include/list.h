@@ -49,6 +49,10 @@ void eml_list_free(struct eml_list *l);
 /* append to a list */
 void eml_list_append(struct eml_list *l, void *data);
 
+/* Move the items of more onto the end of l, in constant time. more is
+   freed. */
+void eml_list_join(struct eml_list *l, struct eml_list *more);
+
 /* insert an item at the head of a list */
 void eml_list_push(struct eml_list *l, void *data);
 
@@ -0,0 +1,88 @@
+/*
+ * File: memo.h
+ * Purpose: This is the header file for emlogo procedure memoization.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MEMO_H
+#define MEMO_H
+#include "node.h"
+
+/* default number of results a memoized procedure keeps */
+#define EML_MEMO_SIZE 10000
+
+/* The inputs to a call as a string of bytes. Each input is a tag, 'n' for
+   a number or 'w' for any other word, then its text and a 0 byte. */
+struct eml_memo_key {
+    unsigned int hash;              /* of the bytes, with regard to case */
+    int len;                        /* bytes in the key */
+    char bytes[];
+};
+
+/* a cached result, kept in least recently used order */
+struct eml_memo_entry {
+    struct eml_memo_key *key;       /* the inputs, see eml_memo_key */
+    struct eml_node *value;         /* the output */
+    struct eml_memo_entry *prev;    /* more recently used */
+    struct eml_memo_entry *next;    /* less recently used */
+    struct eml_memo_entry *chain;   /* the next entry in the same bucket */
+};
+
+/* the results of a memoized procedure */
+struct eml_memo {
+    struct eml_memo_entry **bucket; /* chains of entries by key hash */
+    int cap;                        /* number of buckets */
+    struct eml_memo_entry *head;    /* most recently used */
+    struct eml_memo_entry *tail;    /* least recently used, evicted first */
+    int size;                       /* entries held */
+    int limit;                      /* most entries held */
+    long hits;
+    long misses;
+};
+
+/* create an empty cache holding at most limit results */
+struct eml_memo *eml_memo_alloc(int limit);
+
+/* destroy a cache */
+void eml_memo_free(struct eml_memo *m);
+
+/* forget every result */
+void eml_memo_clear(struct eml_memo *m);
+
+/* Make a key from the inputs to a call, or return NULL if they can't be
+   cached. Numbers and words can; lists can't. Numbers are keyed by value,
+   so 3 and 3.0 share a result. Words are keyed by their exact text, since
+   a procedure may output them as they came in. */
+struct eml_memo_key *eml_memo_key(struct eml_node **args, int n);
+
+/* destroy a key */
+void eml_memo_key_free(struct eml_memo_key *key);
+
+/* Look up a result. Returns NULL on a miss. The value still belongs to the
+   cache. */
+struct eml_node *eml_memo_get(struct eml_memo *m, struct eml_memo_key *key);
+
+/* Add a result, taking ownership of the key and value. The least recently
+   used result is evicted if the cache is full. */
+void eml_memo_put(struct eml_memo *m, struct eml_memo_key *key, struct eml_node *value);
+#endif
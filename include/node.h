@@ -0,0 +1,191 @@
+/*
+ * File: node.h
+ * Purpose: This is the header file for emlogo nodes, the words and lists
+ *          which make up emlogo programs and data.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef NODE_H
+#define NODE_H
+#include <stdio.h>
+#include "word.h"
+#include "list.h"
+#include "lexer.h"
+#include "writer.h"
+
+/* This is the basic node for the emlogo language. It can be a word, a
+ * list, an array, or a stream. A node with refs above zero is shared, by
+ * that many owners beyond the first, and must not be changed. */
+struct eml_node {
+    enum {EML_WORD, EML_LIST, EML_ARRAY, EML_STREAM} type;
+    int refs;
+    void *data;
+};
+
+/* An array keeps its items in one block, so any of them can be reached or
+   replaced in constant time. Arrays can be changed, so they are never
+   copied: copying an array node gives another node holding the same
+   array. A numeric array keeps its items as doubles in num, until an item
+   which isn't a number is stored in it. Otherwise the items are nodes,
+   and a NULL item is an empty list. */
+struct eml_array {
+    int refs;                   /* nodes holding it, beyond the first */
+    int size;
+    struct eml_node **item;     /* the items, unless they are numbers */
+    double *num;                /* the items of a numeric array */
+};
+
+/* A hash-consing table. Parsing through one gives every distinct word and
+   sublist a single shared node. The table holds a reference to each. */
+struct eml_hashcons {
+    struct eml_hashcons_slot {
+        unsigned int hash;
+        struct eml_node *node;
+    } *slot;
+    int size;
+    int cap;
+    long nodes;     /* nodes parsed through the table */
+    long shared;    /* of those, how many were already there */
+};
+
+/* Input refill function. The parser calls this when the lexer runs out of
+   input in the middle of an open list. It should load more input into the
+   lexer and return 1, or return 0 if there is no more input to be had. */
+typedef int (*eml_refill)();
+
+/* allocate a node */
+struct eml_node* eml_node_alloc();
+
+/* wrap a word in a node */
+struct eml_node* eml_node_word(struct eml_word *word);
+
+/* wrap a list in a node */
+struct eml_node* eml_node_list(struct eml_list *list);
+
+/* A lazy stream. Its first item is known, but the rest of it is only
+   worked out, by the interpreter, once something asks for it, and is then
+   kept. Like arrays, streams are shared rather than copied, so a stream
+   nobody holds the start of any more is freed as it is walked along. */
+struct eml_stream {
+    int refs;                   /* nodes holding it, beyond the first */
+    struct eml_node *first;
+    struct eml_node *rest;      /* a stream or an empty list, once known */
+    int kind;                   /* how to work out the rest, see stream.h */
+    struct eml_node *fn;        /* the procedure making the items */
+    struct eml_node *src;       /* the list or stream they come from */
+    struct eml_list_node *cur;  /* the position in a list src */
+    double next, last;          /* the rest of a sequence of numbers */
+};
+
+/* create an array of empty lists */
+struct eml_array *eml_array_alloc(int size);
+
+/* create a numeric array of zeros */
+struct eml_array *eml_array_numeric(int size);
+
+/* Create an array holding the same items as another. Items which are
+   arrays are not copied themselves. */
+struct eml_array *eml_array_dup(struct eml_array *array);
+
+/* Create an array of a list's items. The array takes the items, and the
+   list is freed. */
+struct eml_array *eml_array_list(struct eml_list *list);
+
+/* The value of an item, counting from 0, as a new node. */
+struct eml_node *eml_array_get(struct eml_array *array, int i);
+
+/* Replace an item, counting from 0. The array takes the value. Storing
+   anything but an int or float word makes a numeric array hold nodes. */
+void eml_array_set(struct eml_array *array, int i, struct eml_node *value);
+
+/* Returns 1 if the array is the node or is anywhere inside it, 0
+   otherwise. An array stored inside itself could never be freed. Only the
+   known part of a stream is looked through. */
+int eml_node_holds(struct eml_node *node, struct eml_array *array);
+
+/* wrap an array in a node */
+struct eml_node* eml_node_array(struct eml_array *array);
+
+/* create a stream with a known first item, which it takes */
+struct eml_stream *eml_stream_alloc(struct eml_node *first);
+
+/* wrap a stream in a node */
+struct eml_node* eml_node_stream(struct eml_stream *stream);
+
+/* create a word node holding a number */
+struct eml_node *eml_node_number(double d);
+
+/* Make a deep copy of a node. Shared nodes are not copied, they just
+   gain another reference, and arrays and streams are shared by the copy. */
+struct eml_node* eml_node_copy(struct eml_node *node);
+
+/* Make a copy of a node which shares nothing with it, not even arrays, so
+   it can be handed to another thread. Nothing in the node changes, not
+   even reference counts, so several threads may clone it at once.
+   Streams can't be cloned, so this returns NULL if there is one in the
+   node. */
+struct eml_node *eml_node_clone(struct eml_node *node);
+
+/* Destroy a node and the thing it points to. A shared node just loses a
+   reference. */
+void eml_node_free(struct eml_node *node);
+
+/* Structural hash of a node. Equal nodes have equal hashes, and a word's
+   hash is the same as its node's. Arrays and streams hash by identity. */
+unsigned int eml_node_hash(struct eml_node *node);
+
+/* Returns 1 if the nodes have the same structure and equal words (in the
+   sense of eml_word_equals), 0 otherwise. Arrays and streams are only
+   equal to themselves. */
+int eml_node_equals(struct eml_node *a, struct eml_node *b);
+
+/* print a node */
+void eml_node_print(struct eml_node *node);
+
+/* print a node to the given stream */
+void eml_node_fprint(FILE *out, struct eml_node *node);
+
+/* Write a node as eml_node_fprint prints it. Nothing is flushed, so the
+   writer may gather a whole dump before passing it on. A stream is written
+   as a list of its known items, with ... for the rest. */
+void eml_node_write(struct eml_writer *w, struct eml_node *node);
+
+/* Parse the words from the lexer into a list node. Braces enclose an
+   array rather than a list. Parsing stops at the end of input or at an
+   unmatched ] or }. Lists which are still open at the end of input are
+   continued by calling refill, which may be NULL. None of these functions
+   recurse, so lists may be nested to any depth.
+ */
+struct eml_node* eml_node_parse(struct eml_lexer *lex, eml_refill refill);
+
+/* Parse as eml_node_parse does, but share identical words and sublists
+   through the table. Sharing is exact, so words differing only in case are
+   kept apart. The outermost list and arrays are never shared. */
+struct eml_node* eml_node_parse_shared(struct eml_lexer *lex, eml_refill refill, struct eml_hashcons *table);
+
+/* create an empty hash-consing table */
+struct eml_hashcons *eml_hashcons_alloc();
+
+/* destroy a table, releasing its references */
+void eml_hashcons_free(struct eml_hashcons *table);
+#endif
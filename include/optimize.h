@@ -0,0 +1,65 @@
+/*
+ * File: optimize.h
+ * Purpose: This is the header file for the emlogo optimizer.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+#include "interp.h"
+
+/* the optimizations, which may be combined */
+#define EML_OPT_FOLD 1      /* work out pure primitives of constant inputs */
+#define EML_OPT_INLINE 2    /* put small procedures' bodies in place of calls */
+#define EML_OPT_DEAD 4      /* drop instructions which can never run */
+#define EML_OPT_ALL 7
+
+/* procedures with more nodes than this in their bodies aren't inlined */
+#define EML_INLINE_MAX 32
+
+/*
+ * Optimize a list of instructions with the passes in in->optimize,
+ * returning a new list which runs the same way. The list is read as the
+ * interpreter would run it, using the primitives and procedures defined
+ * now. Where that can't be done, at a call to something undefined, the
+ * rest of the list is left as it is. Procedures defined by the list are
+ * never inlined in it. Lists given to primitives which run them are
+ * optimized too; other lists are data, and are left alone.
+ *
+ * Only procedures which call nothing but primitives are inlined, so an
+ * inlined body can't see different variables than it did as a call. Only
+ * inputs which are constants or variables are put in place of the
+ * procedure's inputs. Inlined procedures don't appear in profiles.
+ */
+struct eml_node *eml_optimize(struct eml_interp *in, struct eml_node *list);
+
+/* Run a list of instructions as eml_interp_run does, optimizing it on the
+   way. Each stretch between definitions is optimized just before it runs,
+   when the procedures defined before it can be inlined. */
+int eml_optimize_run(struct eml_interp *in, struct eml_node *list);
+
+/* Make a procedure's optimized body, which it runs instead of its own
+   from then on. The interpreter does this at a call whenever a procedure
+   has been defined since the last time. */
+void eml_optimize_proc(struct eml_interp *in, struct eml_proc *proc);
+#endif
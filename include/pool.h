@@ -0,0 +1,44 @@
+/*
+ * File: pool.h
+ * Purpose: This is the header file for the emlogo worker pool.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef POOL_H
+#define POOL_H
+
+struct eml_interp;
+struct eml_pool;
+
+/* The number of threads to run on by default, which is the number of
+   processors. */
+int eml_pool_threads();
+
+/* destroy a pool and its workers */
+void eml_pool_free(struct eml_pool *pool);
+
+/* Add PMAP, PFILTER and PREDUCE to the interpreter. They cut a list or
+   array into chunks which workers run at once, each worker being an
+   interpreter of its own on a thread of its own. */
+void eml_pool_defprims(struct eml_interp *in);
+#endif
@@ -0,0 +1,45 @@
+/*
+ * File: primid.h
+ * Purpose: This is the header file for the emlogo primitive name IDs.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PRIMID_H
+#define PRIMID_H
+
+/*
+ * Each name in src/prims.txt is a built in primitive with an ID, its place
+ * in the list. primgen turns the list into a perfect hash at build time,
+ * in the generated src/primid.c, and eml_stow tags every word with the ID
+ * of the primitive it names so that calls to built ins need no lookup.
+ * Words which aren't primitive names have the ID EML_PRIM_NONE.
+ */
+#define EML_PRIM_NONE 0
+
+/* the number of IDs, which run from 1 to eml_prim_count */
+extern const int eml_prim_count;
+
+/* The ID of the primitive named s, or EML_PRIM_NONE. hash is s's word
+   hash, which is where the perfect hash starts. */
+int eml_prim_id(const char *s, unsigned int hash);
+#endif
@@ -0,0 +1,80 @@
+/*
+ * File: profile.h
+ * Purpose: This is the header file for the emlogo procedure profiler.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <stdio.h>
+
+/* how often the running call is sampled, in microseconds of CPU time */
+#define EML_PROFILE_INTERVAL 1000
+
+/* One node of the calling context tree. There is a node for every distinct
+   chain of calls which reached a procedure or primitive, so the same
+   procedure called from two places has two nodes. */
+struct eml_prof_node {
+    const void *id;                 /* the primitive or procedure called */
+    char *name;                     /* its name when first called */
+    long calls;                     /* number of calls in this context */
+    volatile long samples;          /* samples taken while it was running */
+    long total;                     /* samples in it and its callees */
+    struct eml_prof_node *parent;
+    struct eml_prof_node *child;    /* first callee */
+    struct eml_prof_node *next;     /* next callee of the parent */
+};
+
+/* A call profile. Calls are counted exactly, but time is sampled: a
+   profiling timer charges each tick to the running call. Entering a call
+   is usually a comparison or two to find its node and leaving it is a
+   pointer move, so the profiler can be left on. Only one profile samples
+   at a time; the others just count calls. */
+struct eml_profile {
+    struct eml_prof_node root;                  /* the top level */
+    struct eml_prof_node *volatile cur;         /* the node of the running call */
+    int sampling;                               /* does this profile own the timer? */
+};
+
+/* create an empty profile and start sampling */
+struct eml_profile *eml_profile_alloc();
+
+/* stop sampling and destroy a profile */
+void eml_profile_free(struct eml_profile *p);
+
+/* Record entry into a call. id identifies the callee and must stay valid
+   for the life of the profile; name is copied. */
+void eml_profile_enter(struct eml_profile *p, const void *id, const char *name);
+
+/* record the return from the innermost call */
+void eml_profile_leave(struct eml_profile *p);
+
+/* Write the profile in the collapsed stack format read by flame graph
+   tools: one line per calling context with its exclusive sample count. */
+void eml_profile_write_folded(struct eml_profile *p, FILE *out);
+
+/* Write a flat report of calls, inclusive and exclusive time per
+   procedure and primitive, sorted by exclusive time. Recursive calls are
+   only counted once in the inclusive time. */
+void eml_profile_write_report(struct eml_profile *p, FILE *out);
+#endif
@@ -0,0 +1,52 @@
+/*
+ * File: stream.h
+ * Purpose: This is the header file for emlogo lazy streams.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef STREAM_H
+#define STREAM_H
+#include "node.h"
+
+struct eml_interp;
+
+/* How a stream works out its rest. A stream whose rest is known keeps
+   EML_STREAM_DONE, and has let go of what made it. */
+enum {
+    EML_STREAM_DONE,
+    EML_STREAM_ISEQ,        /* next up to last */
+    EML_STREAM_ITERATE,     /* fn of first */
+    EML_STREAM_MAP,         /* fn of each item of src */
+    EML_STREAM_FILTER,      /* the items of src for which fn is true */
+    EML_STREAM_BUSY,        /* working out its rest right now */
+    EML_STREAM_FAILED       /* its rest had an error */
+};
+
+/* Work out the rest of a stream, if it isn't known already. Returns the
+   rest, a stream or an empty list which still belongs to the stream, or
+   NULL after flagging an error. */
+struct eml_node *eml_stream_rest(struct eml_interp *in, struct eml_stream *stream);
+
+/* add the stream primitives to the interpreter */
+void eml_stream_defprims(struct eml_interp *in);
+#endif
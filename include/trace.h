@@ -0,0 +1,72 @@
+/*
+ * File: trace.h
+ * Purpose: This is the header file for emlogo event tracing.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdio.h>
+
+/* events kept per thread, a power of two. The oldest are overwritten. */
+#define EML_TRACE_RING 65536
+
+/* a recorded event */
+struct eml_trace_event {
+    long long ts;       /* nanoseconds on the monotonic clock */
+    const char *name;   /* a string literal */
+    long arg;           /* an event specific number */
+    char phase;         /* 'B'egin, 'E'nd or 'i'nstant */
+};
+
+/* Each thread records into its own ring, so recording takes no locks. */
+struct eml_trace_ring {
+    struct eml_trace_event event[EML_TRACE_RING];
+    unsigned long head;             /* events ever recorded */
+    int tid;                        /* small id for the thread */
+    struct eml_trace_ring *next;    /* all of the rings */
+};
+
+/* Tracing is compiled in with -DEML_TRACE (make TRACE=1). Without it the
+   macros are empty and cost nothing. */
+#ifdef EML_TRACE
+#define EML_TRACE_BEGIN(name, arg) eml_trace_event(name, 'B', arg)
+#define EML_TRACE_END(name) eml_trace_event(name, 'E', 0)
+#define EML_TRACE_INSTANT(name, arg) eml_trace_event(name, 'i', arg)
+#else
+#define EML_TRACE_BEGIN(name, arg) ((void) 0)
+#define EML_TRACE_END(name) ((void) 0)
+#define EML_TRACE_INSTANT(name, arg) ((void) 0)
+#endif
+
+/* record an event in the calling thread's ring */
+void eml_trace_event(const char *name, char phase, long arg);
+
+/* Write every ring as Chrome trace event JSON, which chrome://tracing and
+   Perfetto load. Threads should not be recording while this runs. */
+void eml_trace_write_json(FILE *out);
+
+/* Discard all of the rings at the end of the program. No thread may record
+   afterward. */
+void eml_trace_free();
+#endif
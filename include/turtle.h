@@ -0,0 +1,88 @@
+/*
+ * File: turtle.h
+ * Purpose: This is the header file for the emlogo turtle.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef TURTLE_H
+#define TURTLE_H
+#include "canvas.h"
+#include "dlist.h"
+
+struct eml_interp;
+
+/* The turtle. Positions use the Logo convention of the origin at the center
+   of the canvas with y increasing upward. Headings are in degrees, measured
+   clockwise from north. Drawing is recorded in the display list and only
+   rasterized onto the canvas when it is rendered. */
+struct eml_turtle {
+    double x;
+    double y;
+    double heading;             /* always in [0, 360) */
+    double sin_h, cos_h;        /* kept up to date with the heading */
+    int pendown;
+    uint32_t color;
+    uint32_t background;
+    struct eml_dlist *dlist;    /* everything drawn so far */
+    struct eml_canvas *canvas;  /* where the drawing is rendered */
+    int threads;                /* threads to render with */
+};
+
+/* create a turtle at home on the given canvas */
+struct eml_turtle *eml_turtle_alloc(struct eml_canvas *canvas);
+
+/* destroy a turtle and its display list. Does nothing to the canvas. */
+void eml_turtle_free(struct eml_turtle *t);
+
+/* move forward (or back, with a negative distance) */
+void eml_turtle_forward(struct eml_turtle *t, double dist);
+
+/* turn right (or left, with a negative angle) */
+void eml_turtle_right(struct eml_turtle *t, double angle);
+
+/* move to an absolute position */
+void eml_turtle_setpos(struct eml_turtle *t, double x, double y);
+
+/* turn to an absolute heading */
+void eml_turtle_setheading(struct eml_turtle *t, double heading);
+
+/* Get the sine and cosine of a heading in degrees. Whole degrees in
+   [0, 360) come from a table and are exact at the cardinal directions;
+   other headings fall back on libm. */
+void eml_heading_sincos(double heading, double *s, double *c);
+
+/* raise (0) or lower (1) the pen */
+void eml_turtle_pen(struct eml_turtle *t, int down);
+
+/* set the pen color */
+void eml_turtle_setcolor(struct eml_turtle *t, uint32_t color);
+
+/* flood fill the area around the turtle with the pen color */
+void eml_turtle_fill(struct eml_turtle *t);
+
+/* render the display list onto a freshly cleared canvas */
+void eml_turtle_render(struct eml_turtle *t);
+
+/* add the turtle primitives to the interpreter */
+void eml_turtle_defprims(struct eml_interp *in);
+#endif
@@ -29,17 +29,39 @@
 
 /* tokens and word types */
 extern const char *EML_TOKENS;
-enum eml_word_type { WORD = 0, INTEGER, FLOAT, TOKEN };
+enum eml_word_type { WORD = 0, INTEGER, FLOAT, TOKEN, BIGNUM, ROPE };
+
+struct eml_bignum;
+
+/* A long word built by concatenation is kept as a chain of chunks, so
+   each piece is added without copying what came before. Chunks never
+   change once made, and are shared by every word built on them. A ROPE
+   word is the same as a WORD with its text, and becomes one the first
+   time eml_word_str needs the text in one piece. A rope whose text is
+   an integer, written as it prints, is that integer instead, and is
+   parsed by eml_word_parse once it is used as one. */
+struct eml_rope {
+    int refs;               /* words and chunks holding this chunk */
+    int len;                /* length of the text up to the end of this chunk */
+    int n;                  /* length of this chunk */
+    int digits;             /* the text up to here is an integer as it prints */
+    struct eml_rope *prev;  /* the chunks before this one, or NULL */
+    char s[];               /* this chunk's text, not terminated */
+};
 
 union eml_word_field {
     char *s;  /* string word */
     int i;    /* integer word */
     double d; /* floating point word */
+    struct eml_bignum *b; /* integer word too big for an int */
+    struct eml_rope *r; /* long word built by concatenation */
 };
 
+/* The type and primitive ID share a word, keeping words at 16 bytes. */
 struct eml_word {
     union eml_word_field field;
-    enum eml_word_type type;
+    enum eml_word_type type : 16;
+    unsigned int prim : 16;     /* the primitive this names, see primid.h */
     unsigned int hash;
 };
 
@@ -47,13 +69,27 @@ struct eml_word {
 struct eml_word *eml_stow(char *s);  /* string to word */
 struct eml_word *eml_itow(int i);    /* integer to word */
 struct eml_word *eml_dtow(double d); /* double to word */
+struct eml_word *eml_btow(struct eml_bignum *b); /* bignum to word, which takes it */
 
-/* Concatenate two words */
+/* Copy a word */
+struct eml_word *eml_word_copy(struct eml_word *w);
+
+/* Copy a word so that the copy shares nothing with it. Nothing in the
+   original changes, not even a rope's counts, so other threads may be
+   reading it at the same time. */
+struct eml_word *eml_word_clone(struct eml_word *w);
+
+/* Concatenate two words. Long results are ropes, so building a word a
+   piece at a time costs the length of each piece, not of the whole. */
 struct eml_word *eml_wcat(struct eml_word *a, struct eml_word *b);
 
-/* Convert word to string */
+/* Convert word to string. A rope is flattened into a WORD first. */
 char *eml_word_str(struct eml_word *w);
 
+/* Turn a rope of an integer's digits into that integer, changing its
+   type and hash. Any other word is left alone. */
+void eml_word_parse(struct eml_word *w);
+
 /* word destructor */
 void eml_free_word(struct eml_word *w);
 
@@ -0,0 +1,74 @@
+/*
+ * File: writer.h
+ * Purpose: This is the header file for the emlogo buffered output writer.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef WRITER_H
+#define WRITER_H
+#include <stdio.h>
+#include "word.h"
+
+/* bytes a writer holds before passing them on */
+#define EML_WRITER_SIZE 65536
+
+/* Output sink. It is given the writer's bytes in large blocks, and
+   returns 0, or -1 if they couldn't be written. */
+typedef int (*eml_sink)(void *ctx, const char *bytes, int n);
+
+/* A buffered writer. Text is gathered in buf and handed to the sink when
+   buf fills or the writer is flushed. A writer without a sink collects
+   its output in text instead. */
+struct eml_writer {
+    eml_sink sink;
+    void *ctx;              /* passed to the sink */
+    char *text;             /* collected output, an eml_buf, when there is no sink */
+    int len;                /* bytes waiting in buf */
+    int error;              /* set once the sink has failed */
+    char buf[EML_WRITER_SIZE];
+};
+
+/* create a writer for a sink */
+struct eml_writer *eml_writer_alloc(eml_sink sink, void *ctx);
+
+/* create a writer for a stdio stream */
+struct eml_writer *eml_writer_file(FILE *f);
+
+/* Create a writer which collects its output. After a flush, text holds
+   eml_buf_length(text) bytes, without a terminator. */
+struct eml_writer *eml_writer_buf();
+
+/* flush and destroy a writer */
+void eml_writer_free(struct eml_writer *w);
+
+/* pass the waiting bytes on, returning 0, or -1 if the sink has failed */
+int eml_writer_flush(struct eml_writer *w);
+
+/* write bytes, a string, or a character */
+void eml_writer_bytes(struct eml_writer *w, const char *s, int n);
+void eml_writer_str(struct eml_writer *w, const char *s);
+void eml_writer_char(struct eml_writer *w, char c);
+
+/* write a word as eml_word_str would give it */
+void eml_writer_word(struct eml_writer *w, struct eml_word *word);
+#endif
@@ -0,0 +1,251 @@
+/*
+ * File: alloc.c
+ * Purpose: This is the implementation file for the emlogo memory allocation
+ *          hooks.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+/* helper function prototypes */
+static void *std_alloc(void *ctx, size_t size, enum eml_mem_kind kind);
+static void *std_realloc(void *ctx, void *ptr, size_t size, enum eml_mem_kind kind);
+static void std_free(void *ctx, void *ptr, enum eml_mem_kind kind);
+static void *counting_alloc(void *ctx, size_t size, enum eml_mem_kind kind);
+static void *counting_realloc(void *ctx, void *ptr, size_t size, enum eml_mem_kind kind);
+static void counting_free(void *ctx, void *ptr, enum eml_mem_kind kind);
+
+static const struct eml_allocator std_allocator = {
+    std_alloc, std_realloc, std_free, NULL
+};
+
+/* the current allocator */
+static struct eml_allocator current = {
+    std_alloc, std_realloc, std_free, NULL
+};
+
+/* The instrumented allocator puts a header in front of each block so it
+   knows the size and owner when the block is freed. The header is padded
+   to keep the block aligned for any type. */
+union counting_header {
+    struct {
+        size_t size;
+        enum eml_mem_kind kind;
+    } h;
+    long double align_ld;
+    void *align_p;
+};
+
+static struct eml_allocator counted;   /* where the counted blocks come from */
+static struct eml_mem_stats stats[EML_MEM_KINDS];
+
+static const char *kind_names[EML_MEM_KINDS] = {
+    "words", "lists", "nodes", "buffers", "hashmaps", "turtle", "other"
+};
+
+
+/* set the allocator */
+void eml_set_allocator(const struct eml_allocator *a)
+{
+    current = a ? *a : std_allocator;
+}
+
+
+/* get the current allocator */
+const struct eml_allocator *eml_get_allocator()
+{
+    return &current;
+}
+
+
+void *eml_malloc(enum eml_mem_kind kind, size_t size)
+{
+    return current.alloc(current.ctx, size, kind);
+}
+
+
+void *eml_calloc(enum eml_mem_kind kind, size_t n, size_t size)
+{
+    void *p = current.alloc(current.ctx, n * size, kind);
+
+    if(p) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+
+void *eml_realloc(enum eml_mem_kind kind, void *ptr, size_t size)
+{
+    if(!ptr) {
+        return current.alloc(current.ctx, size, kind);
+    }
+    return current.realloc(current.ctx, ptr, size, kind);
+}
+
+
+void eml_free(enum eml_mem_kind kind, void *ptr)
+{
+    if(ptr) {
+        current.free(current.ctx, ptr, kind);
+    }
+}
+
+
+/* install the instrumented allocator */
+void eml_mem_instrument()
+{
+    struct eml_allocator a = {counting_alloc, counting_realloc, counting_free, NULL};
+
+    if(current.alloc == counting_alloc) {
+        return;
+    }
+    counted = current;
+    memset(stats, 0, sizeof(stats));
+    current = a;
+}
+
+
+/* get the statistics for one subsystem, or all of them */
+void eml_mem_stats(enum eml_mem_kind kind, struct eml_mem_stats *s)
+{
+    int i;
+
+    if(kind != EML_MEM_KINDS) {
+        *s = stats[kind];
+        return;
+    }
+
+    /* the total peak is not the sum of the peaks, but it is a bound */
+    memset(s, 0, sizeof(*s));
+    for(i=0; i<EML_MEM_KINDS; i++) {
+        s->allocs += stats[i].allocs;
+        s->frees += stats[i].frees;
+        s->bytes += stats[i].bytes;
+        s->current += stats[i].current;
+        s->peak += stats[i].peak;
+    }
+}
+
+
+/* zero the counts */
+void eml_mem_stats_reset()
+{
+    int i;
+
+    for(i=0; i<EML_MEM_KINDS; i++) {
+        stats[i].allocs = 0;
+        stats[i].frees = 0;
+        stats[i].bytes = 0;
+        stats[i].peak = stats[i].current;
+    }
+}
+
+
+/* the name of a subsystem */
+const char *eml_mem_kind_name(enum eml_mem_kind kind)
+{
+    return kind < EML_MEM_KINDS ? kind_names[kind] : "all";
+}
+
+
+/******************************************
+ * The standard allocator
+ ******************************************/
+static void *std_alloc(void *ctx, size_t size, enum eml_mem_kind kind)
+{
+    return malloc(size);
+}
+
+static void *std_realloc(void *ctx, void *ptr, size_t size, enum eml_mem_kind kind)
+{
+    return realloc(ptr, size);
+}
+
+static void std_free(void *ctx, void *ptr, enum eml_mem_kind kind)
+{
+    free(ptr);
+}
+
+
+/******************************************
+ * The instrumented allocator
+ ******************************************/
+/* Worker threads allocate at the same time as each other, so the counts
+   are kept with atomic operations. */
+static void count_alloc(enum eml_mem_kind kind, size_t size)
+{
+    struct eml_mem_stats *s = stats + kind;
+    long current, peak;
+
+    __atomic_add_fetch(&s->allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->bytes, size, __ATOMIC_RELAXED);
+    current = __atomic_add_fetch(&s->current, size, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&s->peak, __ATOMIC_RELAXED);
+    while(current > peak &&
+          !__atomic_compare_exchange_n(&s->peak, &peak, current, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void *counting_alloc(void *ctx, size_t size, enum eml_mem_kind kind)
+{
+    union counting_header *h;
+
+    h = counted.alloc(counted.ctx, sizeof(union counting_header) + size, kind);
+    if(!h) {
+        return NULL;
+    }
+    h->h.size = size;
+    h->h.kind = kind;
+    count_alloc(kind, size);
+
+    return h + 1;
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t size, enum eml_mem_kind kind)
+{
+    union counting_header *h = (union counting_header*) ptr - 1;
+    size_t old = h->h.size;
+
+    kind = h->h.kind;
+    h = counted.realloc(counted.ctx, h, sizeof(union counting_header) + size, kind);
+    if(!h) {
+        return NULL;
+    }
+    h->h.size = size;
+    __atomic_sub_fetch(&stats[kind].current, old, __ATOMIC_RELAXED);
+    count_alloc(kind, size);
+
+    return h + 1;
+}
+
+static void counting_free(void *ctx, void *ptr, enum eml_mem_kind kind)
+{
+    union counting_header *h = (union counting_header*) ptr - 1;
+
+    kind = h->h.kind;
+    __atomic_add_fetch(&stats[kind].frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&stats[kind].current, h->h.size, __ATOMIC_RELAXED);
+    counted.free(counted.ctx, h, kind);
+}
@@ -0,0 +1,676 @@
+/*
+ * File: bignum.c
+ * Purpose: This is the implementation file for emlogo arbitrary precision integers.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "bignum.h"
+#include "alloc.h"
+
+#define BASE EML_BIGNUM_BASE
+
+/* below this many limbs Karatsuba's bookkeeping costs more than it saves */
+int eml_karatsuba_limbs = 32;
+
+/* helper function prototypes */
+static int trim(const uint32_t *a, int n);
+static int mag_cmp(const uint32_t *a, int na, const uint32_t *b, int nb);
+static int mag_add(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static int mag_sub(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static void mag_add_into(uint32_t *r, int n, const uint32_t *a, int na);
+static uint32_t mag_mul_small(uint32_t *r, const uint32_t *a, int na, uint32_t m);
+static uint32_t mag_div_small(uint32_t *q, const uint32_t *a, int na, uint32_t d);
+static void mag_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static void mul(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static void mul_schoolbook(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static void mul_unbalanced(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static void mul_karatsuba(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb);
+static uint32_t *limbs(int n);
+static const uint32_t *mag(struct eml_word *w, uint32_t *buf, int *n, int *sign);
+static struct eml_word *make_int(int sign, uint32_t *limb, int n);
+static struct eml_word *from_ll(long long v);
+static struct eml_word *add_signed(const uint32_t *x, int nx, int sx, const uint32_t *y, int ny, int sy);
+
+
+/* copy a bignum */
+struct eml_bignum *eml_bignum_copy(struct eml_bignum *b)
+{
+    struct eml_bignum *c = eml_malloc(EML_MEM_WORD, sizeof(struct eml_bignum));
+
+    c->sign = b->sign;
+    c->size = b->size;
+    c->limb = limbs(b->size);
+    memcpy(c->limb, b->limb, b->size * sizeof(uint32_t));
+    c->text = NULL;
+    return c;
+}
+
+
+/* destroy a bignum */
+void eml_bignum_free(struct eml_bignum *b)
+{
+    eml_free(EML_MEM_WORD, b->limb);
+    eml_free(EML_MEM_WORD, b->text);
+    eml_free(EML_MEM_WORD, b);
+}
+
+
+/* the decimal text of a bignum */
+const char *eml_bignum_str(struct eml_bignum *b)
+{
+    char *s;
+    uint32_t x;
+    int i, j;
+
+    if(b->text) {
+        return b->text;
+    }
+
+    /* every limb but the top one is exactly 9 digits */
+    s = b->text = eml_malloc(EML_MEM_WORD, (b->size + 1) * EML_BIGNUM_DIGITS + 2);
+    if(b->sign < 0) {
+        *s++ = '-';
+    }
+    s += sprintf(s, "%u", b->limb[b->size - 1]);
+    for(i = b->size - 2; i >= 0; i--) {
+        x = b->limb[i];
+        for(j = EML_BIGNUM_DIGITS - 1; j >= 0; j--) {
+            s[j] = '0' + x % 10;
+            x /= 10;
+        }
+        s += EML_BIGNUM_DIGITS;
+    }
+    *s = '\0';
+
+    return b->text;
+}
+
+
+/* the nearest double */
+double eml_bignum_double(struct eml_bignum *b)
+{
+    double d = 0;
+    int i;
+
+    for(i = b->size - 1; i >= 0; i--) {
+        d = d * BASE + b->limb[i];
+    }
+    return b->sign * d;
+}
+
+
+/* compare two bignums */
+int eml_bignum_cmp(struct eml_bignum *a, struct eml_bignum *b)
+{
+    if(a->sign != b->sign) {
+        return a->sign;
+    }
+    return a->sign * mag_cmp(a->limb, a->size, b->limb, b->size);
+}
+
+
+/* convert an optionally signed string of digits */
+struct eml_word *eml_int_parse(const char *s)
+{
+    int sign = 1, len, n, i, j;
+    uint32_t *limb, x;
+
+    if(*s == '-') {
+        sign = -1;
+        s++;
+    }
+    len = strlen(s);
+
+    /* fill the limbs 9 digits at a time, from the right */
+    n = (len + EML_BIGNUM_DIGITS - 1) / EML_BIGNUM_DIGITS;
+    limb = limbs(n);
+    for(i = 0; i < n; i++) {
+        j = len - (i + 1) * EML_BIGNUM_DIGITS;
+        for(x = 0, j = j < 0 ? 0 : j; j < len - i * EML_BIGNUM_DIGITS; j++) {
+            x = x * 10 + (s[j] - '0');
+        }
+        limb[i] = x;
+    }
+
+    return make_int(sign, limb, n);
+}
+
+
+/* a + b */
+struct eml_word *eml_int_add(struct eml_word *a, struct eml_word *b)
+{
+    uint32_t xb[2], yb[2];
+    const uint32_t *x, *y;
+    int nx, ny, sx, sy;
+
+    if(a->type == INTEGER && b->type == INTEGER) {
+        return from_ll((long long) a->field.i + b->field.i);
+    }
+    x = mag(a, xb, &nx, &sx);
+    y = mag(b, yb, &ny, &sy);
+    return add_signed(x, nx, sx, y, ny, sy);
+}
+
+
+/* a - b */
+struct eml_word *eml_int_sub(struct eml_word *a, struct eml_word *b)
+{
+    uint32_t xb[2], yb[2];
+    const uint32_t *x, *y;
+    int nx, ny, sx, sy;
+
+    if(a->type == INTEGER && b->type == INTEGER) {
+        return from_ll((long long) a->field.i - b->field.i);
+    }
+    x = mag(a, xb, &nx, &sx);
+    y = mag(b, yb, &ny, &sy);
+    return add_signed(x, nx, sx, y, ny, -sy);
+}
+
+
+/* a * b */
+struct eml_word *eml_int_mul(struct eml_word *a, struct eml_word *b)
+{
+    uint32_t xb[2], yb[2], *r;
+    const uint32_t *x, *y;
+    int nx, ny, sx, sy;
+
+    if(a->type == INTEGER && b->type == INTEGER) {
+        return from_ll((long long) a->field.i * b->field.i);
+    }
+    x = mag(a, xb, &nx, &sx);
+    y = mag(b, yb, &ny, &sy);
+    if(!nx || !ny) {
+        return eml_itow(0);
+    }
+
+    r = limbs(nx + ny);
+    mul(r, x, nx, y, ny);
+    return make_int(sx * sy, r, nx + ny);
+}
+
+
+/* -a */
+struct eml_word *eml_int_neg(struct eml_word *a)
+{
+    uint32_t *r;
+
+    if(a->type == INTEGER) {
+        return from_ll(-(long long) a->field.i);
+    }
+    r = limbs(a->field.b->size);
+    memcpy(r, a->field.b->limb, a->field.b->size * sizeof(uint32_t));
+    return make_int(-a->field.b->sign, r, a->field.b->size);
+}
+
+
+/* compare a and b, returning <0, 0 or >0 */
+int eml_int_cmp(struct eml_word *a, struct eml_word *b)
+{
+    uint32_t xb[2], yb[2];
+    const uint32_t *x, *y;
+    int nx, ny, sx, sy;
+
+    if(a->type == INTEGER && b->type == INTEGER) {
+        return (a->field.i > b->field.i) - (a->field.i < b->field.i);
+    }
+    x = mag(a, xb, &nx, &sx);
+    y = mag(b, yb, &ny, &sy);
+    if(sx != sy) {
+        return sx;
+    }
+    return sx * mag_cmp(x, nx, y, ny);
+}
+
+
+/* divide a by b */
+void eml_int_divmod(struct eml_word *a, struct eml_word *b, struct eml_word **q, struct eml_word **r)
+{
+    uint32_t xb[2], yb[2], *qr, *rr;
+    const uint32_t *x, *y;
+    int nx, ny, sx, sy;
+
+    /* in long long even INT_MIN / -1 fits */
+    if(a->type == INTEGER && b->type == INTEGER) {
+        if(q) {
+            *q = from_ll((long long) a->field.i / b->field.i);
+        }
+        if(r) {
+            *r = from_ll((long long) a->field.i % b->field.i);
+        }
+        return;
+    }
+
+    x = mag(a, xb, &nx, &sx);
+    y = mag(b, yb, &ny, &sy);
+    if(mag_cmp(x, nx, y, ny) < 0) {
+        if(q) {
+            *q = eml_itow(0);
+        }
+        if(r) {
+            *r = eml_word_copy(a);
+        }
+        return;
+    }
+
+    qr = limbs(nx - ny + 1);
+    rr = limbs(ny);
+    if(ny == 1) {
+        rr[0] = mag_div_small(qr, x, nx, y[0]);
+    } else {
+        mag_divmod(qr, rr, x, nx, y, ny);
+    }
+
+    if(q) {
+        *q = make_int(sx * sy, qr, nx - ny + 1);
+    } else {
+        eml_free(EML_MEM_WORD, qr);
+    }
+    if(r) {
+        *r = make_int(sx, rr, ny);
+    } else {
+        eml_free(EML_MEM_WORD, rr);
+    }
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* the size of a magnitude without its leading zero limbs */
+static int trim(const uint32_t *a, int n)
+{
+    while(n && !a[n - 1]) {
+        n--;
+    }
+    return n;
+}
+
+
+/* compare trimmed magnitudes */
+static int mag_cmp(const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    if(na != nb) {
+        return na < nb ? -1 : 1;
+    }
+    while(na--) {
+        if(a[na] != b[na]) {
+            return a[na] < b[na] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+
+/* r = a + b, where r has room for one limb more than the longer of them.
+   r may be a. Returns the size of r. */
+static int mag_add(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    const uint32_t *t;
+    uint32_t carry = 0, s;
+    int i;
+
+    if(na < nb) {
+        t = a;
+        a = b;
+        b = t;
+        i = na;
+        na = nb;
+        nb = i;
+    }
+
+    for(i = 0; i < na; i++) {
+        s = a[i] + carry + (i < nb ? b[i] : 0);
+        carry = s >= BASE;
+        r[i] = carry ? s - BASE : s;
+    }
+    r[na] = carry;
+    return na + carry;
+}
+
+
+/* r = a - b, where a >= b. r may be a. Returns the trimmed size of r. */
+static int mag_sub(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    uint32_t borrow = 0, s;
+    int i;
+
+    for(i = 0; i < na; i++) {
+        s = (i < nb ? b[i] : 0) + borrow;
+        borrow = a[i] < s;
+        r[i] = borrow ? a[i] + BASE - s : a[i] - s;
+    }
+    return trim(r, na);
+}
+
+
+/* r += a, where r has n limbs and the sum fits in them */
+static void mag_add_into(uint32_t *r, int n, const uint32_t *a, int na)
+{
+    uint32_t carry = 0, s;
+    int i;
+
+    for(i = 0; i < na || (carry && i < n); i++) {
+        s = r[i] + carry + (i < na ? a[i] : 0);
+        carry = s >= BASE;
+        r[i] = carry ? s - BASE : s;
+    }
+}
+
+
+/* r = a * m, returning the carry out of the top. r may be a. */
+static uint32_t mag_mul_small(uint32_t *r, const uint32_t *a, int na, uint32_t m)
+{
+    uint64_t t, carry = 0;
+    int i;
+
+    for(i = 0; i < na; i++) {
+        t = (uint64_t) a[i] * m + carry;
+        r[i] = t % BASE;
+        carry = t / BASE;
+    }
+    return carry;
+}
+
+
+/* q = a / d, returning the remainder. q may be a. */
+static uint32_t mag_div_small(uint32_t *q, const uint32_t *a, int na, uint32_t d)
+{
+    uint64_t t, rem = 0;
+    int i;
+
+    for(i = na - 1; i >= 0; i--) {
+        t = rem * BASE + a[i];
+        q[i] = t / d;
+        rem = t % d;
+    }
+    return rem;
+}
+
+
+/* Long division, Knuth's algorithm D. q = a / b and r = a % b, where
+   na >= nb >= 2. q has na - nb + 1 limbs and r has nb. */
+static void mag_divmod(uint32_t *q, uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    uint32_t *u = limbs(na + 1), *v = limbs(nb);
+    uint32_t f = BASE / (b[nb - 1] + 1);
+    uint64_t qhat, rhat, p, carry;
+    int64_t t, borrow;
+    int i, j;
+
+    /* scale both so the top limb of v is at least BASE/2, which keeps the
+       estimates below within 2 of the true quotient limb */
+    u[na] = mag_mul_small(u, a, na, f);
+    mag_mul_small(v, b, nb, f);
+
+    for(j = na - nb; j >= 0; j--) {
+        /* estimate this limb of the quotient from the top of u and v */
+        p = (uint64_t) u[j + nb] * BASE + u[j + nb - 1];
+        qhat = p / v[nb - 1];
+        rhat = p % v[nb - 1];
+        while(qhat >= BASE || qhat * v[nb - 2] > rhat * BASE + u[j + nb - 2]) {
+            qhat--;
+            rhat += v[nb - 1];
+            if(rhat >= BASE) {
+                break;
+            }
+        }
+
+        /* u -= qhat * v, shifted by j */
+        carry = 0;
+        borrow = 0;
+        for(i = 0; i < nb; i++) {
+            p = qhat * v[i] + carry;
+            carry = p / BASE;
+            t = (int64_t) u[i + j] - (int64_t)(p % BASE) - borrow;
+            borrow = t < 0;
+            u[i + j] = borrow ? t + BASE : t;
+        }
+        t = (int64_t) u[j + nb] - (int64_t) carry - borrow;
+
+        /* qhat was one too many, so add v back */
+        if(t < 0) {
+            u[j + nb] = t + BASE;
+            qhat--;
+            carry = 0;
+            for(i = 0; i < nb; i++) {
+                p = (uint64_t) u[i + j] + v[i] + carry;
+                carry = p >= BASE;
+                u[i + j] = carry ? p - BASE : p;
+            }
+            u[j + nb] = (u[j + nb] + carry) % BASE;
+        } else {
+            u[j + nb] = t;
+        }
+        q[j] = qhat;
+    }
+
+    /* what's left of u is the scaled remainder */
+    mag_div_small(r, u, nb, f);
+    eml_free(EML_MEM_WORD, u);
+    eml_free(EML_MEM_WORD, v);
+}
+
+
+/* r = a * b, where r has na + nb limbs. r must not overlap a or b. */
+static void mul(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    const uint32_t *t;
+    int n = na + nb, i;
+
+    /* work on the trimmed operands, with a the longer */
+    na = trim(a, na);
+    nb = trim(b, nb);
+    if(na < nb) {
+        t = a;
+        a = b;
+        b = t;
+        i = na;
+        na = nb;
+        nb = i;
+    }
+    memset(r + na + nb, 0, (n - na - nb) * sizeof(uint32_t));
+
+    if(!nb) {
+        memset(r, 0, (na + nb) * sizeof(uint32_t));
+    } else if(nb < 2 || eml_karatsuba_limbs <= 0 || nb < eml_karatsuba_limbs) {
+        mul_schoolbook(r, a, na, b, nb);
+    } else if(2 * nb <= na) {
+        mul_unbalanced(r, a, na, b, nb);
+    } else {
+        mul_karatsuba(r, a, na, b, nb);
+    }
+}
+
+
+/* r = a * b one limb at a time */
+static void mul_schoolbook(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    uint64_t t, carry;
+    uint32_t ai;
+    int i, j;
+
+    memset(r, 0, (na + nb) * sizeof(uint32_t));
+    for(i = 0; i < na; i++) {
+        if(!(ai = a[i])) {
+            continue;
+        }
+        carry = 0;
+        for(j = 0; j < nb; j++) {
+            t = r[i + j] + (uint64_t) ai * b[j] + carry;
+            r[i + j] = t % BASE;
+            carry = t / BASE;
+        }
+        r[i + nb] = carry;
+    }
+}
+
+
+/* r = a * b where a is at least twice as long, as a sum of nb limb
+   slices of a times b so each product is balanced */
+static void mul_unbalanced(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    uint32_t *t = limbs(2 * nb);
+    int i, n;
+
+    memset(r, 0, (na + nb) * sizeof(uint32_t));
+    for(i = 0; i < na; i += nb) {
+        n = na - i < nb ? na - i : nb;
+        mul(t, a + i, n, b, nb);
+        mag_add_into(r + i, na + nb - i, t, n + nb);
+    }
+    eml_free(EML_MEM_WORD, t);
+}
+
+
+/* Karatsuba's method, where na >= nb > na/2. Split both at m limbs, so
+   a = a1 B^m + a0 and b = b1 B^m + b0, then
+   a b = a1 b1 B^2m + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B^m + a0 b0,
+   which is three half size products instead of four. */
+static void mul_karatsuba(uint32_t *r, const uint32_t *a, int na, const uint32_t *b, int nb)
+{
+    int m = na / 2, h = na - m + 1;
+    uint32_t *sa = limbs(4 * h), *sb = sa + h, *z1 = sb + h;
+    int nsa, nsb, nz1;
+
+    /* a0 b0 and a1 b1 go straight to their places in r */
+    mul(r, a, m, b, m);
+    mul(r + 2 * m, a + m, na - m, b + m, nb - m);
+
+    /* the middle term */
+    nsa = mag_add(sa, a, m, a + m, na - m);
+    nsb = mag_add(sb, b, m, b + m, nb - m);
+    mul(z1, sa, nsa, sb, nsb);
+    nz1 = trim(z1, nsa + nsb);
+    nz1 = mag_sub(z1, z1, nz1, r, trim(r, 2 * m));
+    nz1 = mag_sub(z1, z1, nz1, r + 2 * m, trim(r + 2 * m, na + nb - 2 * m));
+    mag_add_into(r + m, na + nb - m, z1, nz1);
+
+    eml_free(EML_MEM_WORD, sa);
+}
+
+
+/* allocate n limbs */
+static uint32_t *limbs(int n)
+{
+    return eml_malloc(EML_MEM_WORD, (n ? n : 1) * sizeof(uint32_t));
+}
+
+
+/* The sign and magnitude of an integer word. Small ones are put in buf,
+   which needs 2 limbs. */
+static const uint32_t *mag(struct eml_word *w, uint32_t *buf, int *n, int *sign)
+{
+    long long v;
+
+    if(w->type == BIGNUM) {
+        *n = w->field.b->size;
+        *sign = w->field.b->sign;
+        return w->field.b->limb;
+    }
+
+    v = w->field.i;
+    *sign = v < 0 ? -1 : 1;
+    v = v < 0 ? -v : v;
+    buf[0] = v % BASE;
+    buf[1] = v / BASE;
+    *n = trim(buf, 2);
+    return buf;
+}
+
+
+/* Make an integer word from a sign and n limbs. If it fits in an int it
+   becomes an INTEGER and the limbs are freed, otherwise a bignum keeps
+   them. */
+static struct eml_word *make_int(int sign, uint32_t *limb, int n)
+{
+    struct eml_bignum *b;
+    long long v;
+
+    n = trim(limb, n);
+    if(n <= 2) {
+        v = n ? limb[0] : 0;
+        if(n > 1) {
+            v += (long long) limb[1] * BASE;
+        }
+        v *= sign;
+        if(v >= INT_MIN && v <= INT_MAX) {
+            eml_free(EML_MEM_WORD, limb);
+            return eml_itow(v);
+        }
+    }
+
+    b = eml_malloc(EML_MEM_WORD, sizeof(struct eml_bignum));
+    b->sign = sign;
+    b->size = n;
+    b->limb = limb;
+    b->text = NULL;
+    return eml_btow(b);
+}
+
+
+/* make an integer word from a long long, which is how the machine int
+   fast paths promote on overflow */
+static struct eml_word *from_ll(long long v)
+{
+    unsigned long long u;
+    uint32_t *limb;
+
+    if(v >= INT_MIN && v <= INT_MAX) {
+        return eml_itow(v);
+    }
+
+    u = v < 0 ? -(unsigned long long) v : v;
+    limb = limbs(3);
+    limb[0] = u % BASE;
+    limb[1] = u / BASE % BASE;
+    limb[2] = u / BASE / BASE;
+    return make_int(v < 0 ? -1 : 1, limb, 3);
+}
+
+
+/* the sum of two signed magnitudes */
+static struct eml_word *add_signed(const uint32_t *x, int nx, int sx, const uint32_t *y, int ny, int sy)
+{
+    uint32_t *r;
+    int c;
+
+    if(sx == sy) {
+        r = limbs((nx > ny ? nx : ny) + 1);
+        return make_int(sx, r, mag_add(r, x, nx, y, ny));
+    }
+
+    /* the smaller magnitude comes off the larger */
+    c = mag_cmp(x, nx, y, ny);
+    if(!c) {
+        return eml_itow(0);
+    }
+    r = limbs(c > 0 ? nx : ny);
+    if(c > 0) {
+        return make_int(sx, r, mag_sub(r, x, nx, y, ny));
+    }
+    return make_int(sy, r, mag_sub(r, y, ny, x, nx));
+}
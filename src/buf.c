@@ -27,21 +27,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include "buf.h"
+#include "alloc.h"
+#include "trace.h"
 
 #define INIT_CAPACITY 128
 #define BUF_INFO(p) (((struct buf_info*) (p))-1)
-#define BUF_ALLOC(n) malloc(sizeof(struct buf_info) + (n))
+#define BUF_ALLOC(n) eml_malloc(EML_MEM_BUF, sizeof(struct buf_info) + (n))
 
 struct buf_info {
     unsigned int capacity;
     unsigned int length;
 };
 
-/* static reallocation function */
+/* static reallocation function. The block is resized in place when the
+   allocator can manage it, so growing only copies when it must. */
 static char *eml_buf_grow(char *buf, unsigned int nsize)
 {
-    int ncap = BUF_INFO(buf)->capacity;
-    char *nbuf;
+    unsigned int ncap = BUF_INFO(buf)->capacity;
+    struct buf_info *info;
 
     /* detect the nothing to do case */
     if(nsize <= ncap) {
@@ -53,16 +56,11 @@ static char *eml_buf_grow(char *buf, unsigned int nsize)
         ncap *= 2;
     }
 
-    /* allocate the new buffer */
-    nbuf = BUF_ALLOC(ncap);
-    BUF_INFO(nbuf)->capacity = ncap;
-    BUF_INFO(nbuf)->length = BUF_INFO(buf)->length;
+    EML_TRACE_INSTANT("buf grow", ncap);
 
-    /* copy the old and clean up */
-    memcpy(nbuf, buf, BUF_INFO(buf)->length);
-    eml_buf_free(buf);
-
-    return nbuf;
+    info = eml_realloc(EML_MEM_BUF, BUF_INFO(buf), sizeof(struct buf_info) + ncap);
+    info->capacity = ncap;
+    return (char*) (info + 1);
 }
 
 /* Create a new character buffer. */
@@ -91,7 +89,7 @@ char *eml_buf_alloc()
 void eml_buf_free(char *buf)
 {
     /* free it up */
-    free(BUF_INFO(buf));
+    eml_free(EML_MEM_BUF, BUF_INFO(buf));
 }
 
 
@@ -142,3 +140,66 @@ void eml_buf_clear(char *buf)
 {
     BUF_INFO(buf)->length = 0;
 }
+
+
+/* Make room for at least n more bytes */
+char *eml_buf_reserve(char *buf, int n)
+{
+    return eml_buf_grow(buf, BUF_INFO(buf)->length + n);
+}
+
+
+/* Give back unused capacity */
+char *eml_buf_shrink(char *buf)
+{
+    struct buf_info *info;
+    unsigned int ncap = BUF_INFO(buf)->length;
+
+    /* keep some room, so the next append doesn't grow it straight back */
+    if(ncap < INIT_CAPACITY) {
+        ncap = INIT_CAPACITY;
+    }
+    if(ncap >= BUF_INFO(buf)->capacity) {
+        return buf;
+    }
+
+    info = eml_realloc(EML_MEM_BUF, BUF_INFO(buf), sizeof(struct buf_info) + ncap);
+    info->capacity = ncap;
+    return (char*) (info + 1);
+}
+
+
+/* Get room for n bytes at the end of the buffer */
+char *eml_buf_span(char **buf, int n)
+{
+    *buf = eml_buf_grow(*buf, BUF_INFO(*buf)->length + n);
+    return *buf + BUF_INFO(*buf)->length;
+}
+
+
+/* Count n bytes written at the end of the buffer */
+void eml_buf_commit(char *buf, int n)
+{
+    BUF_INFO(buf)->length += n;
+}
+
+
+/* Append n bytes through a handle */
+void eml_buf_put(char **buf, const char *bytes, int n)
+{
+    memcpy(eml_buf_span(buf, n), bytes, n);
+    BUF_INFO(*buf)->length += n;
+}
+
+
+/* Append a byte through a handle */
+void eml_buf_putc(char **buf, char c)
+{
+    struct buf_info *info = BUF_INFO(*buf);
+
+    if(info->length == info->capacity) {
+        *buf = eml_buf_grow(*buf, info->length + 1);
+        info = BUF_INFO(*buf);
+    }
+    (*buf)[info->length++] = c;
+}
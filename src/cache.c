@@ -0,0 +1,430 @@
+/*
+ * File: cache.c
+ * Purpose: This is the implementation file for the emlogo parsed program cache.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "bignum.h"
+#include "buf.h"
+#include "alloc.h"
+
+/* the start of every entry */
+struct entry_header {
+    char magic[4];              /* "EMLC" */
+    uint32_t version;           /* EML_CACHE_VERSION */
+    uint64_t source_hash;       /* eml_cache_hash of the source */
+    uint64_t source_len;
+    uint64_t payload_len;       /* bytes of encoded program which follow */
+    uint64_t payload_hash;      /* eml_cache_hash of them */
+};
+
+/* tags of the encoded program, each followed by its data */
+#define TAG_WORD 'W'            /* text and a terminator */
+#define TAG_INTEGER 'I'         /* an int */
+#define TAG_FLOAT 'F'           /* a double */
+#define TAG_BIGNUM 'N'          /* decimal text and a terminator */
+#define TAG_OPEN '['            /* a list, whose items follow */
+#define TAG_CLOSE ']'           /* the end of the innermost list */
+#define TAG_ARRAY '{'           /* an array, whose items follow */
+#define TAG_ARRAY_CLOSE '}'     /* the end of the innermost array */
+
+/* a list or array being encoded, and the position in it */
+struct encode_pos {
+    struct eml_list_node *cur;  /* the next item of a list */
+    struct eml_array *array;    /* or the array */
+    int i;                      /* and the index of its next item */
+};
+
+/* a list being decoded, and the tag which opened it */
+struct decode_list {
+    struct eml_list *list;
+    char tag;
+};
+
+/* the source being parsed, for the lexer */
+static const char *source;
+static long source_i, source_len;
+
+/* helper function prototypes */
+static int source_getchar();
+static char *read_file(const char *path, long *n);
+static char *entry_path(const char *dir, uint64_t hash);
+static struct eml_node *read_entry(const char *path, const char *text, long n, uint64_t hash);
+static void write_entry(const char *path, struct eml_node *prog, long n, uint64_t hash);
+static void put_word(char **buf, struct eml_word *w);
+
+
+/* load a source file, through the cache if there is one */
+struct eml_node *eml_cache_load(const char *dir, const char *path)
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog = NULL;
+    char *text, *entry = NULL;
+    uint64_t hash = 0;
+    long n;
+
+    text = read_file(path, &n);
+    if(!text) {
+        return NULL;
+    }
+
+    /* a hit needs no lexing at all */
+    if(dir) {
+        if(mkdir(dir, 0777) && errno != EEXIST) {
+            perror(dir);
+            dir = NULL;
+        } else {
+            hash = eml_cache_hash(text, n);
+            entry = entry_path(dir, hash);
+            prog = read_entry(entry, text, n, hash);
+        }
+    }
+
+    if(!prog) {
+        source = text;
+        source_i = 0;
+        source_len = n;
+        lex = eml_alloc_lexer(source_getchar);
+        prog = eml_node_parse(lex, NULL);
+        eml_free_lexer(lex);
+        if(entry) {
+            write_entry(entry, prog, n, hash);
+        }
+    }
+
+    eml_free(EML_MEM_OTHER, entry);
+    eml_free(EML_MEM_OTHER, text);
+    return prog;
+}
+
+
+/* 64 bit FNV-1a */
+uint64_t eml_cache_hash(const char *bytes, long n)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    while(n--) {
+        hash ^= (unsigned char) *bytes++;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+/* encode a program, walking it without recursion */
+char *eml_cache_encode(struct eml_node *prog)
+{
+    char *buf = eml_buf_alloc();
+    struct encode_pos *stack = NULL, pos = {NULL, NULL, 0};
+    struct eml_node *node;
+    int size = 0, cap = 0;
+
+    if(prog->type == EML_WORD) {
+        put_word(&buf, prog->data);
+        return buf;
+    }
+
+    node = prog;
+    for(;;) {
+        /* open a list or array, keeping the position in its parent */
+        if(node && node->type != EML_WORD) {
+            if(size == cap) {
+                cap = cap ? cap * 2 : 16;
+                stack = eml_realloc(EML_MEM_OTHER, stack, cap * sizeof(*stack));
+            }
+            stack[size++] = pos;
+            if(node->type == EML_LIST) {
+                eml_buf_putc(&buf, TAG_OPEN);
+                pos.cur = ((struct eml_list*)node->data)->head;
+                pos.array = NULL;
+            } else {
+                eml_buf_putc(&buf, TAG_ARRAY);
+                pos.array = node->data;
+                pos.i = 0;
+            }
+        } else if(node) {
+            put_word(&buf, node->data);
+        } else {
+            /* an empty item of an array */
+            eml_buf_putc(&buf, TAG_OPEN);
+            eml_buf_putc(&buf, TAG_CLOSE);
+        }
+
+        /* move on to the next item, closing what has run out */
+        for(;;) {
+            if(pos.array && pos.i < pos.array->size) {
+                if(pos.array->num) {
+                    node = eml_node_number(pos.array->num[pos.i++]);
+                    put_word(&buf, node->data);
+                    eml_node_free(node);
+                    continue;
+                }
+                node = pos.array->item[pos.i++];
+                break;
+            } else if(!pos.array && pos.cur) {
+                node = pos.cur->data;
+                pos.cur = pos.cur->next;
+                break;
+            }
+
+            eml_buf_putc(&buf, pos.array ? TAG_ARRAY_CLOSE : TAG_CLOSE);
+            pos = stack[--size];
+            if(!size) {
+                eml_free(EML_MEM_OTHER, stack);
+                return buf;
+            }
+        }
+    }
+}
+
+
+/* decode a program */
+struct eml_node *eml_cache_decode(const char *bytes, long n)
+{
+    const char *p = bytes, *end = bytes + n, *s;
+    struct decode_list *stack = NULL;
+    struct eml_node *node, *prog = NULL;
+    int size = 0, cap = 0, i;
+    double d;
+    char tag;
+
+    while(p < end) {
+        node = NULL;
+        switch(tag = *p++) {
+        case TAG_WORD:
+        case TAG_BIGNUM:
+            /* the text is terminated in place, so it is stowed from there */
+            s = memchr(p, '\0', end - p);
+            if(!s) {
+                goto bad;
+            }
+            node = eml_node_word(p[-1] == TAG_WORD ? eml_stow((char*) p) : eml_int_parse(p));
+            p = s + 1;
+            break;
+        case TAG_INTEGER:
+            if(end - p < sizeof(int)) {
+                goto bad;
+            }
+            memcpy(&i, p, sizeof(int));
+            node = eml_node_word(eml_itow(i));
+            p += sizeof(int);
+            break;
+        case TAG_FLOAT:
+            if(end - p < sizeof(double)) {
+                goto bad;
+            }
+            memcpy(&d, p, sizeof(double));
+            node = eml_node_word(eml_dtow(d));
+            p += sizeof(double);
+            break;
+        case TAG_OPEN:
+        case TAG_ARRAY:
+            if(size == cap) {
+                cap = cap ? cap * 2 : 16;
+                stack = eml_realloc(EML_MEM_OTHER, stack, cap * sizeof(*stack));
+            }
+            stack[size].list = eml_list_alloc();
+            stack[size++].tag = tag;
+            break;
+        case TAG_CLOSE:
+        case TAG_ARRAY_CLOSE:
+            /* closers must match their openers */
+            if(!size || (stack[size - 1].tag == TAG_ARRAY) != (tag == TAG_ARRAY_CLOSE)) {
+                goto bad;
+            }
+            size--;
+            if(tag == TAG_ARRAY_CLOSE) {
+                node = eml_node_array(eml_array_list(stack[size].list));
+            } else {
+                node = eml_node_list(stack[size].list);
+            }
+            break;
+        default:
+            goto bad;
+        }
+
+        /* a finished item goes in the enclosing list, or is the program */
+        if(node && size) {
+            eml_list_append(stack[size - 1].list, node);
+        } else if(node) {
+            prog = node;
+            if(p != end) {
+                goto bad;
+            }
+        }
+    }
+    if(size || !prog) {
+        goto bad;
+    }
+
+    eml_free(EML_MEM_OTHER, stack);
+    return prog;
+
+bad:
+    /* free the partial program; each open list holds what it has so far */
+    if(prog) {
+        eml_node_free(prog);
+    }
+    while(size) {
+        eml_node_free(eml_node_list(stack[--size].list));
+    }
+    eml_free(EML_MEM_OTHER, stack);
+    return NULL;
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* the lexer's view of the source */
+static int source_getchar()
+{
+    if(source_i >= source_len) {
+        return EOF;
+    }
+    return (unsigned char) source[source_i++];
+}
+
+
+/* read a whole file */
+static char *read_file(const char *path, long *n)
+{
+    FILE *f = fopen(path, "rb");
+    char *text;
+    long cap = 4096, k;
+
+    if(!f) {
+        return NULL;
+    }
+
+    text = eml_malloc(EML_MEM_OTHER, cap);
+    *n = 0;
+    while((k = fread(text + *n, 1, cap - *n, f)) > 0) {
+        *n += k;
+        if(*n == cap) {
+            cap *= 2;
+            text = eml_realloc(EML_MEM_OTHER, text, cap);
+        }
+    }
+    fclose(f);
+    return text;
+}
+
+
+/* the file name of the entry for a hash */
+static char *entry_path(const char *dir, uint64_t hash)
+{
+    int n = strlen(dir) + 32;
+    char *path = eml_malloc(EML_MEM_OTHER, n);
+
+    snprintf(path, n, "%s/%016llx.emc", dir, (unsigned long long) hash);
+    return path;
+}
+
+
+/* Read an entry, if it is there and is for this text. */
+static struct eml_node *read_entry(const char *path, const char *text, long n, uint64_t hash)
+{
+    struct entry_header h;
+    struct eml_node *prog = NULL;
+    char *payload;
+    long len;
+
+    payload = read_file(path, &len);
+    if(!payload) {
+        return NULL;
+    }
+
+    /* check everything the header promises before trusting the rest */
+    if(len >= sizeof(h)) {
+        memcpy(&h, payload, sizeof(h));
+        if(memcmp(h.magic, "EMLC", 4) == 0 && h.version == EML_CACHE_VERSION &&
+           h.source_hash == hash && h.source_len == n &&
+           h.payload_len == len - sizeof(h) &&
+           h.payload_hash == eml_cache_hash(payload + sizeof(h), len - sizeof(h))) {
+            prog = eml_cache_decode(payload + sizeof(h), len - sizeof(h));
+        }
+    }
+
+    eml_free(EML_MEM_OTHER, payload);
+    return prog;
+}
+
+
+/* Write an entry. It goes to a temporary file first, which is renamed
+   over the entry once it is complete. Failure just means no entry. */
+static void write_entry(const char *path, struct eml_node *prog, long n, uint64_t hash)
+{
+    struct entry_header h;
+    char *buf = eml_cache_encode(prog);
+    int len = strlen(path) + 32;
+    char *tmp = eml_malloc(EML_MEM_OTHER, len);
+    FILE *f;
+    int ok;
+
+    memcpy(h.magic, "EMLC", 4);
+    h.version = EML_CACHE_VERSION;
+    h.source_hash = hash;
+    h.source_len = n;
+    h.payload_len = eml_buf_length(buf);
+    h.payload_hash = eml_cache_hash(buf, eml_buf_length(buf));
+
+    snprintf(tmp, len, "%s.%ld.tmp", path, (long) getpid());
+    f = fopen(tmp, "wb");
+    if(f) {
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(buf, 1, eml_buf_length(buf), f) == eml_buf_length(buf);
+        ok = fclose(f) == 0 && ok;
+        if(!ok || rename(tmp, path)) {
+            remove(tmp);
+        }
+    }
+
+    eml_free(EML_MEM_OTHER, tmp);
+    eml_buf_free(buf);
+}
+
+
+/* encode a word */
+static void put_word(char **buf, struct eml_word *w)
+{
+    const char *s;
+
+    if(w->type == INTEGER) {
+        eml_buf_putc(buf, TAG_INTEGER);
+        eml_buf_put(buf, (char*) &w->field.i, sizeof(int));
+    } else if(w->type == FLOAT) {
+        eml_buf_putc(buf, TAG_FLOAT);
+        eml_buf_put(buf, (char*) &w->field.d, sizeof(double));
+    } else {
+        s = eml_word_str(w);
+        eml_buf_putc(buf, w->type == BIGNUM ? TAG_BIGNUM : TAG_WORD);
+        eml_buf_put(buf, s, strlen(s) + 1);
+    }
+}
@@ -0,0 +1,533 @@
+/*
+ * File: canvas.c
+ * Purpose: This is the implementation file for the in-memory RGBA canvas.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "canvas.h"
+#include "alloc.h"
+
+/* largest stored deflate block */
+#define DEFLATE_BLOCK 65535
+
+/* initial size of the fill stack */
+#define FILL_INIT_CAP 256
+
+/* how many rows ahead a fill walking a corridor prefetches */
+#define FILL_PREFETCH 8
+
+/* A run of pixels, x0 to x1 on row y, which was filled on the way to row
+   y + dy. */
+struct fill_span {
+    int y, x0, x1, dy;
+};
+
+/* the stack of spans left to explore */
+struct fill_stack {
+    struct fill_span *span;
+    int size;
+    int cap;
+};
+
+/* helper function prototypes */
+static void span(struct eml_canvas *c, int x0, int x1, int y, uint32_t color);
+static inline void fill_push(struct fill_stack *s, struct eml_canvas *c, int y, int x0, int x1, int dy);
+static void fill_grow(struct fill_stack *s);
+
+
+/* create a canvas cleared to opaque white */
+struct eml_canvas *eml_canvas_alloc(int width, int height)
+{
+    struct eml_canvas *c = eml_malloc(EML_MEM_TURTLE, sizeof(struct eml_canvas));
+
+    c->width = width;
+    c->height = height;
+    c->pixels = eml_malloc(EML_MEM_TURTLE, sizeof(uint32_t) * width * height);
+    eml_canvas_clear(c, EML_RGBA(255, 255, 255, 255));
+
+    return c;
+}
+
+
+/* destroy a canvas */
+void eml_canvas_free(struct eml_canvas *c)
+{
+    eml_free(EML_MEM_TURTLE, c->pixels);
+    eml_free(EML_MEM_TURTLE, c);
+}
+
+
+/* fill the whole canvas with one color */
+void eml_canvas_clear(struct eml_canvas *c, uint32_t color)
+{
+    int i, n = c->width * c->height;
+
+    for(i=0; i<n; i++) {
+        c->pixels[i] = color;
+    }
+}
+
+
+/* draw a line, including both end points */
+void eml_canvas_line(struct eml_canvas *c, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    eml_canvas_line_clip(c, x0, y0, x1, y1, color, 0, 0, c->width - 1, c->height - 1);
+}
+
+
+/* flood fill the region around (x, y) */
+void eml_canvas_fill(struct eml_canvas *c, int x, int y, uint32_t color)
+{
+    struct fill_stack stack = {0};
+    struct fill_span sp;
+    uint32_t old, *row;
+    int x0, x1, l, carry, w = c->width;
+
+    if(x < 0 || y < 0 || x >= c->width || y >= c->height) {
+        return;
+    }
+    old = c->pixels[y * w + x];
+    if(old == color) {
+        return;
+    }
+
+    /* Heckbert's seed fill. Each span remembers the row it came from, so
+       when it is popped only the new row is scanned, and the parts of the
+       span which stick out past its parent are sent back the other way.
+       The first child of a span is carried straight on to the next row
+       instead of going through the stack, so a narrow corridor is walked
+       in a tight loop. */
+    fill_push(&stack, c, y, x, x, 1);
+    fill_push(&stack, c, y + 1, x, x, -1);
+    while(stack.size) {
+        sp = stack.span[--stack.size];
+        do {
+            y = sp.y + sp.dy;
+            x0 = sp.x0;
+            x1 = sp.x1;
+            row = c->pixels + y * w;
+            carry = 0;
+
+            /* A one pixel span in a one pixel corridor just moves on. Each
+               row is a new cache line and page here, so the row a few
+               steps ahead is fetched early. */
+            if(x0 == x1 && row[x0] == old
+                    && (x0 == 0 || row[x0-1] != old) && (x0 == w - 1 || row[x0+1] != old)) {
+                row[x0] = color;
+                if(y + FILL_PREFETCH * sp.dy >= 0 && y + FILL_PREFETCH * sp.dy < c->height) {
+                    __builtin_prefetch(row + FILL_PREFETCH * sp.dy * w + x0, 1);
+                }
+                sp.y = y;
+                carry = y + sp.dy >= 0 && y + sp.dy < c->height;
+                continue;
+            }
+
+            /* Extend left from x0. If x0 is filled already, the first run
+               under the parent starts further right, if there is one. */
+            for(x = x0; x >= 0 && row[x] == old; x--) {
+                row[x] = color;
+            }
+            l = x + 1;
+            if(l < x0) {
+                fill_push(&stack, c, y, l, x0 - 1, -sp.dy);
+            }
+            if(l <= x0) {
+                x = x0 + 1;
+            } else {
+                for(x = x0 + 1; x <= x1 && row[x] != old; x++);
+                l = x;
+            }
+
+            while(l <= x1) {
+                /* fill right, then look for the next run under the parent */
+                for(; x < w && row[x] == old; x++) {
+                    row[x] = color;
+                }
+                if(!carry && y + sp.dy >= 0 && y + sp.dy < c->height) {
+                    /* sp becomes this run, keeping its direction */
+                    sp.y = y;
+                    sp.x0 = l;
+                    sp.x1 = x - 1;
+                    carry = 1;
+                } else {
+                    fill_push(&stack, c, y, l, x - 1, sp.dy);
+                }
+                if(x > x1 + 1) {
+                    fill_push(&stack, c, y, x1 + 1, x - 1, -sp.dy);
+                }
+                for(x++; x <= x1 && row[x] != old; x++);
+                l = x;
+            }
+        } while(carry);
+    }
+
+    eml_free(EML_MEM_TURTLE, stack.span);
+}
+
+
+/* write the canvas as a binary PPM */
+int eml_canvas_write_ppm(struct eml_canvas *c, FILE *f)
+{
+    unsigned char *row = eml_malloc(EML_MEM_TURTLE, c->width * 3);
+    uint32_t *p = c->pixels;
+    int x, y;
+
+    fprintf(f, "P6\n%d %d\n255\n", c->width, c->height);
+    for(y=0; y<c->height; y++) {
+        for(x=0; x<c->width; x++, p++) {
+            row[x*3] = EML_RED(*p);
+            row[x*3+1] = EML_GREEN(*p);
+            row[x*3+2] = EML_BLUE(*p);
+        }
+        fwrite(row, 3, c->width, f);
+    }
+
+    eml_free(EML_MEM_TURTLE, row);
+    return ferror(f) ? -1 : 0;
+}
+
+
+/******************************************
+ * PNG output
+ ******************************************/
+/* The PNG is written with stored (uncompressed) deflate blocks, which
+   needs nothing more than a CRC and an Adler checksum. Each block goes out
+   in its own IDAT chunk as soon as it fills. */
+struct png_writer {
+    FILE *f;
+    unsigned char block[5 + DEFLATE_BLOCK];  /* block header and data */
+    int n;                                   /* bytes of data in block */
+    int first;                               /* zlib header not yet sent */
+    uint32_t adler_a, adler_b;
+};
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init()
+{
+    uint32_t c;
+    int n, k;
+
+    for(n=0; n<256; n++) {
+        c = n;
+        for(k=0; k<8; k++) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const unsigned char *p, int n)
+{
+    while(n--) {
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* write a chunk whose data comes in two pieces */
+static void png_chunk(FILE *f, const char *type, const unsigned char *a, int na,
+                      const unsigned char *b, int nb)
+{
+    unsigned char word[4];
+    uint32_t crc;
+
+    put32(word, na + nb);
+    fwrite(word, 1, 4, f);
+    fwrite(type, 1, 4, f);
+
+    /* IEND and chunks in one part pass NULL, which fwrite mustn't get */
+    if(na) {
+        fwrite(a, 1, na, f);
+    }
+    if(nb) {
+        fwrite(b, 1, nb, f);
+    }
+
+    crc = crc_update(0xffffffffu, (const unsigned char*) type, 4);
+    crc = crc_update(crc, a, na);
+    crc = crc_update(crc, b, nb);
+    put32(word, crc ^ 0xffffffffu);
+    fwrite(word, 1, 4, f);
+}
+
+/* send the current block, with the zlib header or trailer as needed */
+static void png_flush(struct png_writer *w, int final)
+{
+    unsigned char zhead[2] = {0x78, 0x01};
+    unsigned char trailer[4];
+    int n = w->n;
+
+    w->block[0] = final;
+    w->block[1] = n & 0xff;
+    w->block[2] = n >> 8;
+    w->block[3] = ~n & 0xff;
+    w->block[4] = (~n >> 8) & 0xff;
+
+    if(w->first) {
+        png_chunk(w->f, "IDAT", zhead, 2, w->block, 5 + n);
+        w->first = 0;
+    } else {
+        png_chunk(w->f, "IDAT", w->block, 5 + n, NULL, 0);
+    }
+
+    if(final) {
+        put32(trailer, w->adler_b << 16 | w->adler_a);
+        png_chunk(w->f, "IDAT", trailer, 4, NULL, 0);
+    }
+}
+
+/* add bytes to the image data stream */
+static void png_write(struct png_writer *w, const unsigned char *p, int n)
+{
+    int i, k;
+
+    while(n) {
+        k = DEFLATE_BLOCK - w->n;
+        if(k > n) {
+            k = n;
+        }
+
+        /* keep the checksum as we go */
+        for(i=0; i<k; i++) {
+            w->adler_a = (w->adler_a + p[i]) % 65521;
+            w->adler_b = (w->adler_b + w->adler_a) % 65521;
+        }
+
+        memcpy(w->block + 5 + w->n, p, k);
+        w->n += k;
+        p += k;
+        n -= k;
+        if(w->n == DEFLATE_BLOCK) {
+            png_flush(w, 0);
+            w->n = 0;
+        }
+    }
+}
+
+/* write the canvas as an RGBA PNG */
+int eml_canvas_write_png(struct eml_canvas *c, FILE *f)
+{
+    static const unsigned char sig[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    struct png_writer *w = eml_calloc(EML_MEM_TURTLE, 1, sizeof(struct png_writer));
+    unsigned char *row = eml_malloc(EML_MEM_TURTLE, c->width * 4 + 1);
+    unsigned char ihdr[13];
+    uint32_t *p = c->pixels;
+    int x, y;
+
+    pthread_once(&crc_once, crc_init);
+    w->f = f;
+    w->first = 1;
+    w->adler_a = 1;
+
+    fwrite(sig, 1, 8, f);
+    put32(ihdr, c->width);
+    put32(ihdr + 4, c->height);
+    ihdr[8] = 8;    /* bit depth */
+    ihdr[9] = 6;    /* RGBA */
+    ihdr[10] = 0;   /* deflate */
+    ihdr[11] = 0;   /* adaptive filtering */
+    ihdr[12] = 0;   /* no interlace */
+    png_chunk(f, "IHDR", ihdr, 13, NULL, 0);
+
+    /* every row starts with filter type 0, none */
+    row[0] = 0;
+    for(y=0; y<c->height; y++) {
+        for(x=0; x<c->width; x++, p++) {
+            row[1 + x*4] = EML_RED(*p);
+            row[2 + x*4] = EML_GREEN(*p);
+            row[3 + x*4] = EML_BLUE(*p);
+            row[4 + x*4] = EML_ALPHA(*p);
+        }
+        png_write(w, row, c->width * 4 + 1);
+    }
+    png_flush(w, 1);
+    png_chunk(f, "IEND", NULL, 0, NULL, 0);
+
+    eml_free(EML_MEM_TURTLE, row);
+    eml_free(EML_MEM_TURTLE, w);
+    return ferror(f) ? -1 : 0;
+}
+
+
+/******************************************
+ * Scanline fill
+ ******************************************/
+/* push a span, if the row it leads to is on the canvas */
+static inline void fill_push(struct fill_stack *s, struct eml_canvas *c, int y, int x0, int x1, int dy)
+{
+    struct fill_span *sp;
+
+    if(y + dy < 0 || y + dy >= c->height) {
+        return;
+    }
+    if(s->size == s->cap) {
+        fill_grow(s);
+    }
+
+    sp = s->span + s->size++;
+    sp->y = y;
+    sp->x0 = x0;
+    sp->x1 = x1;
+    sp->dy = dy;
+}
+
+
+/* make room for more spans, kept out of fill_push so it inlines */
+static void fill_grow(struct fill_stack *s)
+{
+    s->cap = s->cap ? s->cap * 2 : FILL_INIT_CAP;
+    s->span = eml_realloc(EML_MEM_TURTLE, s->span, s->cap * sizeof(struct fill_span));
+}
+
+
+/* fill a horizontal run of pixels */
+static void span(struct eml_canvas *c, int x0, int x1, int y, uint32_t color)
+{
+    uint32_t *p = c->pixels + y * c->width + x0;
+    uint32_t *end = p + (x1 - x0);
+
+    while(p <= end) {
+        *p++ = color;
+    }
+}
+
+
+/******************************************
+ * Line rasterization
+ ******************************************/
+/* Draw a line clipped to the rectangle (cx0,cy0)-(cx1,cy1), inclusive.
+   This is Bresenham's algorithm, except the error term is computed
+   directly for the first visible step along the major axis. The pixels
+   inside the clip rectangle are exactly those the unclipped line would
+   have, so a line drawn in pieces looks the same as one drawn whole. */
+void eml_canvas_line_clip(struct eml_canvas *c, int x0, int y0, int x1, int y1,
+                          uint32_t color, int cx0, int cy0, int cx1, int cy1)
+{
+    long long dx, dy, t, num, e, dmaj2;
+    int x, y, end, step, sy, w = c->width;
+    uint32_t *p;
+
+    /* always run in the positive direction of the major axis */
+    dx = x1 - x0;
+    dy = y1 - y0;
+    if((llabs(dx) >= llabs(dy) && dx < 0) || (llabs(dy) > llabs(dx) && dy < 0)) {
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dx = -dx;
+        dy = -dy;
+    }
+
+    /* horizontal lines */
+    if(dy == 0) {
+        if(y0 < cy0 || y0 > cy1 || x1 < cx0 || x0 > cx1) {
+            return;
+        }
+        span(c, x0 < cx0 ? cx0 : x0, x1 > cx1 ? cx1 : x1, y0, color);
+        return;
+    }
+
+    /* vertical lines */
+    if(dx == 0) {
+        if(x0 < cx0 || x0 > cx1 || y1 < cy0 || y0 > cy1) {
+            return;
+        }
+        y = y0 < cy0 ? cy0 : y0;
+        end = y1 > cy1 ? cy1 : y1;
+        for(p = c->pixels + y * w + x0; y <= end; y++, p += w) {
+            *p = color;
+        }
+        return;
+    }
+
+    sy = 1;
+    if(dx >= llabs(dy)) {
+        /* x major: minor coordinate is y0 + round((x - x0) * dy / dx) */
+        if(x1 < cx0 || x0 > cx1) {
+            return;
+        }
+        if(dy < 0) {
+            sy = -1;
+            dy = -dy;
+        }
+        x = x0 < cx0 ? cx0 : x0;
+        end = x1 > cx1 ? cx1 : x1;
+
+        /* position and error at the first step */
+        dmaj2 = 2 * dx;
+        num = 2LL * (x - x0) * dy + dx;
+        y = y0 + sy * (int) (num / dmaj2);
+        e = num % dmaj2;
+
+        for(; x <= end; x++) {
+            if(y >= cy0 && y <= cy1) {
+                c->pixels[y * w + x] = color;
+            }
+            e += 2 * dy;
+            if(e >= dmaj2) {
+                e -= dmaj2;
+                y += sy;
+            }
+        }
+    } else {
+        /* y major, the same with the axes swapped */
+        if(y1 < cy0 || y0 > cy1) {
+            return;
+        }
+        step = 1;
+        if(dx < 0) {
+            step = -1;
+            dx = -dx;
+        }
+        y = y0 < cy0 ? cy0 : y0;
+        end = y1 > cy1 ? cy1 : y1;
+
+        dmaj2 = 2 * dy;
+        num = 2LL * (y - y0) * dx + dy;
+        x = x0 + step * (int) (num / dmaj2);
+        e = num % dmaj2;
+
+        for(; y <= end; y++) {
+            if(x >= cx0 && x <= cx1) {
+                c->pixels[y * w + x] = color;
+            }
+            e += 2 * dx;
+            if(e >= dmaj2) {
+                e -= dmaj2;
+                x += step;
+            }
+        }
+    }
+}
@@ -0,0 +1,429 @@
+/*
+ * File: dlist.c
+ * Purpose: This is the implementation file for the turtle display list.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dlist.h"
+#include "alloc.h"
+
+#define DLIST_INIT_CAP 1024
+
+/* edge length of a render tile, in pixels */
+#define TILE 128
+
+/* lists smaller than this are not worth the threads */
+#define MIN_PARALLEL 4096
+
+/* pixel coordinates are clamped well inside the range of an int */
+#define PIXEL_LIMIT 1e8
+
+/* Tiled rendering state. Rendering happens in three parallel phases:
+   each thread counts the tiles touched by its share of the segments, then
+   each thread writes its segment indices into the tile bins, then the
+   threads take whole tiles and draw them. Since the shares are contiguous
+   and written in order, every bin lists its segments in drawing order. */
+struct render_job {
+    struct eml_dlist *dl;
+    struct eml_canvas *c;
+    int first, last;    /* the range of segments to draw */
+    int nthreads;
+    int tiles_x, tiles_y, ntiles;
+    int *count;     /* nthreads x ntiles counts, then write positions */
+    int *start;     /* ntiles + 1 offsets into index */
+    int *index;     /* binned segment indices */
+    int next_tile;  /* next tile to draw, taken atomically */
+};
+
+struct render_thread {
+    struct render_job *job;
+    int id;
+    int phase;
+    pthread_t tid;
+    int started;    /* tid is a running thread to join */
+};
+
+/* helper function prototypes */
+static int pixel(double v);
+static void seg_pixels(struct eml_canvas *c, struct eml_segment *s, int *p);
+static int seg_tiles(struct render_job *job, struct eml_segment *s, int *p, int *t);
+static void row_tiles(struct render_job *job, int *p, int ty, int *t);
+static void *render_worker(void *arg);
+static void run_phase(struct render_thread *th, int n, int phase);
+static void render_range(struct eml_dlist *dl, struct eml_canvas *c, int first, int last, int nthreads);
+
+
+/* create an empty display list */
+struct eml_dlist *eml_dlist_alloc()
+{
+    return eml_calloc(EML_MEM_TURTLE, 1, sizeof(struct eml_dlist));
+}
+
+
+/* destroy a display list */
+void eml_dlist_free(struct eml_dlist *dl)
+{
+    eml_free(EML_MEM_TURTLE, dl->seg);
+    eml_free(EML_MEM_TURTLE, dl->fill);
+    eml_free(EML_MEM_TURTLE, dl);
+}
+
+
+/* remove all the segments and fills */
+void eml_dlist_clear(struct eml_dlist *dl)
+{
+    dl->size = 0;
+    dl->nfill = 0;
+}
+
+
+/* add a segment */
+void eml_dlist_add(struct eml_dlist *dl, float x0, float y0, float x1, float y1, uint32_t color)
+{
+    struct eml_segment *s;
+
+    if(dl->size == dl->cap) {
+        dl->cap = dl->cap ? dl->cap * 2 : DLIST_INIT_CAP;
+        dl->seg = eml_realloc(EML_MEM_TURTLE, dl->seg, dl->cap * sizeof(struct eml_segment));
+    }
+
+    s = dl->seg + dl->size++;
+    s->x0 = x0;
+    s->y0 = y0;
+    s->x1 = x1;
+    s->y1 = y1;
+    s->color = color;
+}
+
+
+/* add a flood fill */
+void eml_dlist_fill(struct eml_dlist *dl, float x, float y, uint32_t color)
+{
+    struct eml_fill *f;
+
+    if(dl->nfill == dl->fill_cap) {
+        dl->fill_cap = dl->fill_cap ? dl->fill_cap * 2 : 16;
+        dl->fill = eml_realloc(EML_MEM_TURTLE, dl->fill, dl->fill_cap * sizeof(struct eml_fill));
+    }
+
+    f = dl->fill + dl->nfill++;
+    f->at = dl->size;
+    f->x = x;
+    f->y = y;
+    f->color = color;
+}
+
+
+/* the number of threads to render with by default */
+int eml_dlist_threads()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+
+/* draw the display list onto the canvas */
+void eml_dlist_render(struct eml_dlist *dl, struct eml_canvas *c, int nthreads)
+{
+    struct eml_fill *f;
+    int i, first = 0;
+
+    /* fills depend on everything drawn before them, so they divide the
+       segments into batches */
+    for(i=0; i<dl->nfill; i++) {
+        f = dl->fill + i;
+        render_range(dl, c, first, f->at, nthreads);
+        eml_canvas_fill(c, pixel(c->width / 2 + (double) f->x),
+                        pixel(c->height / 2 - (double) f->y), f->color);
+        first = f->at;
+    }
+    render_range(dl, c, first, dl->size, nthreads);
+}
+
+
+/* stream the display list out as an SVG */
+int eml_dlist_write_svg(struct eml_dlist *dl, int width, int height, uint32_t background, FILE *f)
+{
+    struct eml_segment *s, *prev = NULL;
+    double cx = width / 2.0, cy = height / 2.0;
+    int i;
+
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+            "viewBox=\"0 0 %d %d\">\n", width, height, width, height);
+    fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#%02x%02x%02x\"/>\n",
+            EML_RED(background), EML_GREEN(background), EML_BLUE(background));
+    fprintf(f, "<g fill=\"none\" stroke-width=\"1\" stroke-linecap=\"square\">\n");
+
+    for(i=0; i<dl->size; i++) {
+        s = dl->seg + i;
+
+        /* continue the current path where possible */
+        if(prev && s->color == prev->color && s->x0 == prev->x1 && s->y0 == prev->y1) {
+            fprintf(f, " %.2f %.2f", cx + s->x1, cy - s->y1);
+        } else {
+            if(prev) {
+                fprintf(f, "\"/>\n");
+            }
+            fprintf(f, "<path stroke=\"#%02x%02x%02x\" d=\"M%.2f %.2f L%.2f %.2f",
+                    EML_RED(s->color), EML_GREEN(s->color), EML_BLUE(s->color),
+                    cx + s->x0, cy - s->y0, cx + s->x1, cy - s->y1);
+        }
+        prev = s;
+    }
+    if(prev) {
+        fprintf(f, "\"/>\n");
+    }
+    fprintf(f, "</g>\n</svg>\n");
+
+    return ferror(f) ? -1 : 0;
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* convert turtle coordinates to pixels */
+static int pixel(double v)
+{
+    if(v > PIXEL_LIMIT) {
+        v = PIXEL_LIMIT;
+    } else if(v < -PIXEL_LIMIT) {
+        v = -PIXEL_LIMIT;
+    }
+    return (int) floor(v + 0.5);
+}
+
+
+/* get the pixel end points of a segment */
+static void seg_pixels(struct eml_canvas *c, struct eml_segment *s, int *p)
+{
+    p[0] = pixel(c->width / 2 + (double) s->x0);
+    p[1] = pixel(c->height / 2 - (double) s->y0);
+    p[2] = pixel(c->width / 2 + (double) s->x1);
+    p[3] = pixel(c->height / 2 - (double) s->y1);
+}
+
+
+/* Get the pixel end points of a segment and the range of tile rows its
+   bounding box covers as ty0, ty1. Returns 0 if the segment is off the
+   canvas. */
+static int seg_tiles(struct render_job *job, struct eml_segment *s, int *p, int *t)
+{
+    int x0, y0, x1, y1;
+
+    seg_pixels(job->c, s, p);
+    x0 = p[0] < p[2] ? p[0] : p[2];
+    x1 = p[0] < p[2] ? p[2] : p[0];
+    y0 = p[1] < p[3] ? p[1] : p[3];
+    y1 = p[1] < p[3] ? p[3] : p[1];
+    if(x1 < 0 || y1 < 0 || x0 >= job->c->width || y0 >= job->c->height) {
+        return 0;
+    }
+
+    t[0] = y0 < 0 ? 0 : y0 / TILE;
+    t[1] = y1 >= job->c->height ? job->tiles_y - 1 : y1 / TILE;
+    return 1;
+}
+
+
+/* Get the range of tiles in tile row ty which the line between pixels p
+   crosses as tx0, tx1. The drawn pixels are within half a pixel of the
+   true line, so the row band is widened by a pixel on each side. The
+   range is empty (tx0 > tx1) when the line misses the canvas there. */
+static void row_tiles(struct render_job *job, int *p, int ty, int *t)
+{
+    double ya, yb, lo, hi, xa, xb;
+
+    lo = p[1] < p[3] ? p[1] : p[3];
+    hi = p[1] < p[3] ? p[3] : p[1];
+    ya = (double) ty * TILE - 1;
+    yb = (double) (ty + 1) * TILE;
+    ya = ya < lo ? lo : ya;
+    yb = yb > hi ? hi : yb;
+
+    if(p[1] == p[3]) {
+        xa = p[0];
+        xb = p[2];
+    } else {
+        xa = p[0] + (ya - p[1]) * (p[2] - p[0]) / (p[3] - p[1]);
+        xb = p[0] + (yb - p[1]) * (p[2] - p[0]) / (p[3] - p[1]);
+    }
+    if(xa > xb) {
+        lo = xa; xa = xb; xb = lo;
+    }
+    xa -= 1;
+    xb += 1;
+
+    if(xb < 0 || xa >= job->c->width) {
+        t[0] = 1;
+        t[1] = 0;
+        return;
+    }
+    t[0] = xa < 0 ? 0 : (int) xa / TILE;
+    t[1] = xb >= job->c->width ? job->tiles_x - 1 : (int) xb / TILE;
+}
+
+
+/* draw segments first through last - 1 */
+static void render_range(struct eml_dlist *dl, struct eml_canvas *c, int first, int last, int nthreads)
+{
+    struct render_job job;
+    struct render_thread *th;
+    int i, j, n, pos, p[4];
+
+    /* small jobs are drawn directly */
+    if(nthreads <= 1 || last - first < MIN_PARALLEL) {
+        for(i=first; i<last; i++) {
+            seg_pixels(c, dl->seg + i, p);
+            eml_canvas_line(c, p[0], p[1], p[2], p[3], dl->seg[i].color);
+        }
+        return;
+    }
+
+    job.dl = dl;
+    job.c = c;
+    job.first = first;
+    job.last = last;
+    job.nthreads = nthreads;
+    job.tiles_x = (c->width + TILE - 1) / TILE;
+    job.tiles_y = (c->height + TILE - 1) / TILE;
+    job.ntiles = job.tiles_x * job.tiles_y;
+    job.count = eml_calloc(EML_MEM_TURTLE, (size_t) nthreads * job.ntiles, sizeof(int));
+    job.start = eml_malloc(EML_MEM_TURTLE, (job.ntiles + 1) * sizeof(int));
+    job.next_tile = 0;
+    th = eml_malloc(EML_MEM_TURTLE, nthreads * sizeof(struct render_thread));
+    for(i=0; i<nthreads; i++) {
+        th[i].job = &job;
+        th[i].id = i;
+    }
+
+    /* count, then turn the counts into write positions */
+    run_phase(th, nthreads, 0);
+    pos = 0;
+    for(j=0; j<job.ntiles; j++) {
+        job.start[j] = pos;
+        for(i=0; i<nthreads; i++) {
+            n = job.count[i * job.ntiles + j];
+            job.count[i * job.ntiles + j] = pos;
+            pos += n;
+        }
+    }
+    job.start[job.ntiles] = pos;
+    job.index = eml_malloc(EML_MEM_TURTLE, ((size_t) pos + 1) * sizeof(int));
+
+    /* bin and draw */
+    run_phase(th, nthreads, 1);
+    run_phase(th, nthreads, 2);
+
+    eml_free(EML_MEM_TURTLE, th);
+    eml_free(EML_MEM_TURTLE, job.index);
+    eml_free(EML_MEM_TURTLE, job.start);
+    eml_free(EML_MEM_TURTLE, job.count);
+}
+
+
+/* do one phase of the work for one thread */
+static void *render_worker(void *arg)
+{
+    struct render_thread *th = arg;
+    struct render_job *job = th->job;
+    struct eml_segment *s;
+    int *count = job->count + th->id * job->ntiles;
+    int first, last, n, i, j, tile, tx, ty, t[4], p[4];
+
+    /* each thread bins a contiguous share of the segments */
+    n = job->last - job->first;
+    first = job->first + (int) ((long long) n * th->id / job->nthreads);
+    last = job->first + (int) ((long long) n * (th->id + 1) / job->nthreads);
+
+    if(th->phase == 0) {
+        for(i=first; i<last; i++) {
+            if(!seg_tiles(job, job->dl->seg + i, p, t)) {
+                continue;
+            }
+            for(ty=t[0]; ty<=t[1]; ty++) {
+                row_tiles(job, p, ty, t + 2);
+                for(tx=t[2]; tx<=t[3]; tx++) {
+                    count[ty * job->tiles_x + tx]++;
+                }
+            }
+        }
+    } else if(th->phase == 1) {
+        for(i=first; i<last; i++) {
+            if(!seg_tiles(job, job->dl->seg + i, p, t)) {
+                continue;
+            }
+            for(ty=t[0]; ty<=t[1]; ty++) {
+                row_tiles(job, p, ty, t + 2);
+                for(tx=t[2]; tx<=t[3]; tx++) {
+                    job->index[count[ty * job->tiles_x + tx]++] = i;
+                }
+            }
+        }
+    } else {
+        while((tile = __atomic_fetch_add(&job->next_tile, 1, __ATOMIC_RELAXED)) < job->ntiles) {
+            tx = (tile % job->tiles_x) * TILE;
+            ty = (tile / job->tiles_x) * TILE;
+            for(j=job->start[tile]; j<job->start[tile+1]; j++) {
+                s = job->dl->seg + job->index[j];
+                seg_pixels(job->c, s, p);
+                eml_canvas_line_clip(job->c, p[0], p[1], p[2], p[3], s->color,
+                                     tx, ty,
+                                     tx + TILE > job->c->width ? job->c->width - 1 : tx + TILE - 1,
+                                     ty + TILE > job->c->height ? job->c->height - 1 : ty + TILE - 1);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/* run one phase on all threads, the calling thread doing the first share */
+static void run_phase(struct render_thread *th, int n, int phase)
+{
+    int i;
+
+    for(i=0; i<n; i++) {
+        th[i].phase = phase;
+    }
+    for(i=1; i<n; i++) {
+        th[i].started = !pthread_create(&th[i].tid, NULL, render_worker, th + i);
+    }
+    render_worker(th);
+
+    /* a share whose thread couldn't be started is done here instead */
+    for(i=1; i<n; i++) {
+        if(th[i].started) {
+            pthread_join(th[i].tid, NULL);
+        } else {
+            render_worker(th + i);
+        }
+    }
+}
@@ -25,13 +25,19 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "emlogo.h"
 #include "buf.h"
+#include "trace.h"
+
+/* how much room each read of a line asks for */
+#define READ_BLOCK 4096
 
 /* global variables */
 char *buf; /* buffer for input */
 int buf_i;        /* buffer position */
 struct eml_lexer *lex;
+struct eml_interp *interp;
 
 
 /* retrieve the next character from the buffer */
@@ -40,35 +46,109 @@ static int buf_getchar();
 /* read a line into our buffer */
 static void eml_repl_readline();
 
+/* continue reading an unfinished list */
+static int eml_repl_continue();
+
 /* process a line of input */
-static struct eml_node* eml_repl_process_line(int level);
+static struct eml_node* eml_repl_process_line();
+
+/* does the list hold a TO without its END? */
+static int eml_repl_open_definition(struct eml_list *list);
+
+/* write the profile out */
+static void eml_repl_write_profile(const char *path);
 
-/* allocate a node */
-struct eml_node* eml_node_alloc();
+/* write the event trace out */
+static void eml_repl_write_trace(const char *path);
 
-/* destroy a node and the thing it points to */
-void eml_node_free(struct eml_node *node);
+/* the optimization passes named in a comma separated list, or -1 */
+static int eml_repl_passes(const char *names);
 
-/* print a node */
-void eml_node_print(struct eml_node *node);
+/* run a program, optimizing it if we are */
+static int eml_repl_run(struct eml_node *prog);
 
 
 
-int main()
+int main(int argc, char **argv)
 {
     struct eml_node *prog_node;
+    const char *profile = NULL;
+    const char *trace = NULL;
+    const char *cache = NULL;
+    int i, nfiles = 0, optimize = 0, jit = 0;
+
+    /* emlogo [-c cachedir] [-j] [-O passes] [-p profile.folded] [-t trace.json] [file ...] */
+    for(i=1; i<argc; i++) {
+        if(i+1 < argc && strcmp(argv[i], "-c") == 0) {
+            cache = argv[++i];
+        } else if(strcmp(argv[i], "-j") == 0) {
+            jit = EML_JIT_THRESHOLD;
+        } else if(i+1 < argc && strcmp(argv[i], "-O") == 0) {
+            optimize = eml_repl_passes(argv[++i]);
+            if(optimize < 0) {
+                fprintf(stderr, "%s: no optimization called %s\n", argv[0], argv[i]);
+                return 1;
+            }
+        } else if(i+1 < argc && strcmp(argv[i], "-p") == 0) {
+            profile = argv[++i];
+        } else if(i+1 < argc && strcmp(argv[i], "-t") == 0) {
+            trace = argv[++i];
+        } else if(argv[i][0] != '-') {
+            /* files are gathered at the front, to be loaded in order */
+            argv[1 + nfiles++] = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [-c cachedir] [-j] [-O all|fold,inline,dead] [-p profile.folded] [-t trace.json] [file ...]\n", argv[0]);
+            return 1;
+        }
+    }
+#ifndef EML_TRACE
+    if(trace) {
+        fprintf(stderr, "%s: built without tracing, rebuild with make TRACE=1\n", argv[0]);
+    }
+#endif
 
-    /* initialize the input buffer and lexer */
+    /* initialize the input buffer, lexer, and interpreter */
     buf = eml_buf_alloc();
     lex = eml_alloc_lexer(buf_getchar);
+    interp = eml_interp_alloc();
+    interp->optimize = optimize;
+    interp->jit = jit;
+    if(profile) {
+        interp->profile = eml_profile_alloc();
+    }
+
+    /* run the files, then take input from the user */
+    for(i=1; i<=nfiles; i++) {
+        prog_node = eml_cache_load(cache, argv[i]);
+        if(!prog_node) {
+            perror(argv[i]);
+            continue;
+        }
+        if(eml_repl_run(prog_node)) {
+            printf("%s\n", interp->errmsg);
+            eml_interp_clear_error(interp);
+        }
+        eml_node_free(prog_node);
+    }
 
     while(!feof(stdin)) {
-        prog_node = eml_repl_process_line(0);
-        eml_node_print(prog_node);
-        printf("\n");
+        prog_node = eml_repl_process_line();
+        EML_TRACE_BEGIN("run", 0);
+        if(eml_repl_run(prog_node)) {
+            printf("%s\n", interp->errmsg);
+            eml_interp_clear_error(interp);
+        }
+        EML_TRACE_END("run");
         eml_node_free(prog_node);
     }
 
+    if(profile) {
+        eml_repl_write_profile(profile);
+    }
+    if(trace) {
+        eml_repl_write_trace(trace);
+    }
+    eml_interp_free(interp);
     eml_free_lexer(lex); 
     eml_buf_free(buf);
 }
@@ -88,113 +168,154 @@ static int buf_getchar()
 /* read a line into our buffer */
 static void eml_repl_readline()
 {
-    int ic;
-    char c;
+    char *tail;
+    int n;
 
     /* start with an empty buffer */
+    EML_TRACE_BEGIN("readline", 0);
     eml_buf_clear(buf);
     buf_i = 0;
-    while((ic=getchar()) != EOF && ic != '\n') {
-        c = (char) ic;
-        buf = eml_buf_nappend(buf, &c, 1);
-    }
-    if(ic != EOF) {
-        c = (char) ic;
-        buf = eml_buf_nappend(buf, &c, 1);
-    }
+
+    /* read straight into the buffer, a block at a time */
+    do {
+        tail = eml_buf_span(&buf, READ_BLOCK);
+        if(!fgets(tail, eml_buf_capacity(buf) - eml_buf_length(buf), stdin)) {
+            break;
+        }
+        n = strlen(tail);
+        eml_buf_commit(buf, n);
+    } while(n && tail[n - 1] != '\n');
 
     /* put in the null terminator */
-    buf = eml_buf_nappend(buf, "\0", 1);
+    eml_buf_putc(&buf, '\0');
 
     /* reset the lexer */
     lex->cur = 0;
+    EML_TRACE_END("readline");
 }
 
 
-/* process a line of input */
-static struct eml_node* eml_repl_process_line(int level)
+/* continue reading an unfinished list */
+static int eml_repl_continue()
 {
-    struct eml_list *list;
+    printf("> ");
+    if(feof(stdin)) {
+        return 0;
+    }
+    eml_repl_readline();
+    return 1;
+}
+
+
+/* process a line of input, along with the rest of any procedure it starts */
+static struct eml_node* eml_repl_process_line()
+{
+    struct eml_node *prog_node, *more;
+    struct eml_list *prog;
+
+    eml_repl_readline();
+    prog_node = eml_node_parse(lex, eml_repl_continue);
+    prog = prog_node->data;
+
+    while(eml_repl_open_definition(prog) && eml_repl_continue()) {
+        more = eml_node_parse(lex, eml_repl_continue);
+
+        /* move the new line onto the end of the program, leaving the node
+           an empty list to free */
+        eml_list_join(prog, more->data);
+        more->data = eml_list_alloc();
+        eml_node_free(more);
+    }
+
+    return prog_node;
+}
+
+
+/* does the list hold a TO without its END? */
+static int eml_repl_open_definition(struct eml_list *list)
+{
+    struct eml_list_node *cur;
     struct eml_node *node;
-    struct eml_word *word;
-    int done = 0;
-
-    /* create the lexer and the list */
-    if(!level) eml_repl_readline();
-    list = eml_list_alloc();
-    
-    /* process the line */
-    while(!done) {
-        word = eml_lexer_next(lex);
-        if(!word) {
-            if(!level) {
-                done = 1;
-                continue;
-            }
-            printf("> ");
-            if(feof(stdin)) {
-                done = 1;
-                continue;
-            }
-            eml_repl_readline();
+    int open = 0;
+
+    for(cur = list->head; cur; cur = cur->next) {
+        node = cur->data;
+        if(node->type != EML_WORD) {
             continue;
         }
-
-        if(word->type == TOKEN) {
-            if(word->field.s[0] == '[') {
-                node = eml_repl_process_line(level+1);
-            } else if(word->field.s[0] == ']') {
-                /* TODO: Handle error on unexpected ] */
-                done = 1;
-                continue;
-            }
-        } else {
-            node = eml_node_alloc();
-            node->type = EML_WORD;
-            node->data = word;
+        if(strcasecmp(eml_word_str(node->data), "to") == 0) {
+            open = 1;
+        } else if(strcasecmp(eml_word_str(node->data), "end") == 0) {
+            open = 0;
         }
-        eml_list_append(list, node);
     }
 
-    node = eml_node_alloc();
-    node->type = EML_LIST;
-    node->data = list;
-    return node;
+    return open;
+}
+
+
+/* write the profile: collapsed stacks to the file, a summary to stderr */
+static void eml_repl_write_profile(const char *path)
+{
+    FILE *out = fopen(path, "w");
+
+    if(!out) {
+        perror(path);
+    } else {
+        eml_profile_write_folded(interp->profile, out);
+        fclose(out);
+    }
+    eml_profile_write_report(interp->profile, stderr);
 }
 
 
 
-/* allocate a node */
-struct eml_node* eml_node_alloc()
+/* write the event trace as Chrome trace JSON */
+static void eml_repl_write_trace(const char *path)
 {
-    return calloc(1, sizeof(struct eml_node));
+    FILE *out = fopen(path, "w");
+
+    if(!out) {
+        perror(path);
+    } else {
+        eml_trace_write_json(out);
+        fclose(out);
+    }
+    eml_trace_free();
 }
 
 
-/* destroy a node and the thing it points to */
-void eml_node_free(struct eml_node *node)
+/* parse a list of optimization passes */
+static int eml_repl_passes(const char *names)
 {
-    if(node->type == EML_WORD) {
-        /* handle the freeing of the word */
-        eml_free_word(node->data);
-    } else if(node->type == EML_LIST) {
-        /* free the list of nodes */
-        eml_list_apply(node->data, (eml_list_visitor)eml_node_free);
-        eml_list_free(node->data);
-    }
-    free(node);
+    static const char *const pass[] = {"fold", "inline", "dead"};
+    int flags = 0, len, i;
+
+    if(strcmp(names, "all") == 0) {
+        return EML_OPT_ALL;
+    }
+    while(*names) {
+        len = strcspn(names, ",");
+        for(i=0; i<3; i++) {
+            if(strlen(pass[i]) == len && strncmp(names, pass[i], len) == 0) {
+                break;
+            }
+        }
+        if(i == 3) {
+            return -1;
+        }
+        flags |= 1 << i;
+        names += len + (names[len] == ',');
+    }
+    return flags;
 }
 
 
-/* print a node */
-void eml_node_print(struct eml_node *node)
+/* run a program, optimizing it if we are */
+static int eml_repl_run(struct eml_node *prog)
 {
-    if(node->type == EML_WORD) {
-        printf("%s", eml_word_str(node->data));
-        putchar(' ');
-    } else {
-        printf("%s", "[ ");
-        eml_list_apply(node->data, (eml_list_visitor)eml_node_print);
-        printf("%s", "] ");
+    if(interp->optimize) {
+        return eml_optimize_run(interp, prog);
     }
+    return eml_interp_run(interp, prog->data);
 }
@@ -27,13 +27,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hashmap.h"
+#include "node.h"
+#include "alloc.h"
+#include "trace.h"
 #define EML_HASHMAP_INIT_CAP 256
 #define EML_HASHMAP_LOADFACTOR 80
 
+/* Removed entries leave a tombstone, an empty key with this as its data,
+   so that probing carries on past them. */
+static char tombstone;
+#define TOMBSTONE ((void*) &tombstone)
+
 /* Helper function to allocate buckets and initialize them to null */
 static struct eml_hashmap_bucket *eml_alloc_bucket(int n)
 {
-    return calloc(n, sizeof(struct eml_hashmap_bucket));
+    return eml_calloc(EML_MEM_HASHMAP, n, sizeof(struct eml_hashmap_bucket));
 }
 
 
@@ -42,13 +50,20 @@ static struct eml_hashmap_bucket *eml_alloc_bucket(int n)
  */
 static void eml_hashmap_setup(struct eml_hashmap *h, int n) 
 {
-    h->bucket = calloc(n, sizeof(struct eml_hashmap_bucket));
+    h->bucket = eml_alloc_bucket(n);
     h->cap = n;
     h->limit = (h->cap * EML_HASHMAP_LOADFACTOR) / 100;
+    h->tombs = 0;
 }
 
 
-/* Helper function to rehash the map, doubling the number of buckets */
+/* helper function prototypes */
+static void eml_hashmap_put(struct eml_hashmap *map, struct eml_word *word, struct eml_node *list, void *data);
+
+
+/* Helper function to rehash the map. The number of buckets doubles,
+ * unless the map is mostly tombstones, which are simply cleared out.
+ */
 static void eml_hashmap_rehash(struct eml_hashmap *h)
 {
     struct eml_hashmap_bucket *obucket;
@@ -58,35 +73,50 @@ static void eml_hashmap_rehash(struct eml_hashmap *h)
     /* get the old information from the table */
     obucket = h->bucket;
     ocap = h->cap;
+    EML_TRACE_BEGIN("rehash", ocap);
 
-    /* create the the new table */
-    eml_hashmap_setup(h, ocap * 2);
+    /* create the the new table, which is refilled from empty */
+    eml_hashmap_setup(h, h->size * 2 >= h->limit ? ocap * 2 : ocap);
+    h->size = 0;
 
     /* insert all the items from the old */
     for(i=0; i<ocap; i++) {
-        if(obucket[i].word) {
-            eml_hashmap_set(h, obucket[i].word, obucket[i].data);
+        if(obucket[i].word || obucket[i].list) {
+            eml_hashmap_put(h, obucket[i].word, obucket[i].list, obucket[i].data);
         }
     }
 
     /* destroy the old bucket list */
-    free(obucket);
+    eml_free(EML_MEM_HASHMAP, obucket);
+    EML_TRACE_END("rehash");
+}
+
+
+/* does the bucket end the probe for the key, by holding it or being empty? */
+static int eml_hashmap_stop(struct eml_hashmap_bucket *b, struct eml_word *word, struct eml_node *list)
+{
+    if(b->word) {
+        return word && eml_word_equals(b->word, word);
+    } else if(b->list) {
+        return list && eml_node_equals(b->list, list);
+    }
+    return b->data != TOMBSTONE;
 }
 
 
-/* find the bucket fornthe given word */
-static int eml_hashmap_probe(struct eml_hashmap *map, struct eml_word *word) 
+/* find the bucket fornthe given word or list */
+static int eml_hashmap_probe(struct eml_hashmap *map, struct eml_word *word, struct eml_node *list) 
 {
-    int key;
-    int pd=1;
+    unsigned int hash = word ? word->hash : eml_node_hash(list);
+    unsigned int key;
+    unsigned int pd=1;
 
     /* get the initial key */
-    key = word->hash % map->cap;
+    key = hash % map->cap;
 
-    /* probe as needed */
-    while(map->bucket[key].word && ! eml_word_equals(map->bucket[key].word, word)) {
-        key = word->hash + (pd + pd*pd)/2;
-        key %= map->cap;
+    /* probe as needed, past other keys and tombstones */
+    while(!eml_hashmap_stop(map->bucket + key, word, list)) {
+        key = (hash + (pd + pd*pd)/2) % map->cap;
 
         pd++;
     }
@@ -95,41 +125,119 @@ static int eml_hashmap_probe(struct eml_hashmap *map, struct eml_word *word)
 }
 
 
+/* set the item for a word or list key */
+static void eml_hashmap_put(struct eml_hashmap *map, struct eml_word *word, struct eml_node *list, void *data)
+{
+    int key = eml_hashmap_probe(map, word, list);
+
+    /* set the data */
+    map->bucket[key].data = data;
+
+    /* handle growth */
+    if(!map->bucket[key].word && !map->bucket[key].list) {
+        map->bucket[key].word = word;
+        map->bucket[key].list = list;
+        map->size++;
+        if(map->size + map->tombs >= map->limit) {
+           eml_hashmap_rehash(map); 
+        }
+    }
+}
+
+
+/* remove the item for a word or list key */
+static void *eml_hashmap_take(struct eml_hashmap *map, struct eml_word *word, struct eml_node *list)
+{
+    int key = eml_hashmap_probe(map, word, list);
+    void *data = map->bucket[key].data;
+
+    if(!map->bucket[key].word && !map->bucket[key].list) {
+        return NULL;
+    }
+
+    map->bucket[key].word = NULL;
+    map->bucket[key].list = NULL;
+    map->bucket[key].data = TOMBSTONE;
+    map->size--;
+    map->tombs++;
+    return data;
+}
+
+
 /* create a hashmap */
 struct eml_hashmap *eml_hashmap_alloc()
 {
     struct eml_hashmap *h;
 
     /* create the initial hashmap */
-    h = malloc(sizeof(struct eml_hashmap));
+    h = eml_malloc(EML_MEM_HASHMAP, sizeof(struct eml_hashmap));
+    h->size = 0;
     eml_hashmap_setup(h, EML_HASHMAP_INIT_CAP);
 
     return h;
 }
 
 
-/* sets an item in the hashmap */
-void eml_hashmap_set(struct eml_hashmap *map, struct eml_word *word, void *data)
+/* destroy a hashmap. Does nothing to the words or data. */
+void eml_hashmap_free(struct eml_hashmap *map)
 {
-    int key = eml_hashmap_probe(map, word);
+    eml_free(EML_MEM_HASHMAP, map->bucket);
+    eml_free(EML_MEM_HASHMAP, map);
+}
 
-    /* set the data */
-    map->bucket[key].data = data;
 
-    /* handle growth */
-    if(!map->bucket[key].word) {
-        map->bucket[key].word = word;
-        map->size++;
-        if(map->size >= map->limit) {
-           eml_hashmap_rehash(map); 
-        }
-    }
+/* sets an item in the hashmap */
+void eml_hashmap_set(struct eml_hashmap *map, struct eml_word *word, void *data)
+{
+    eml_hashmap_put(map, word, NULL, data);
 }
 
 
 /* retrieves an item from the hashmap */
 void *eml_hashmap_get(struct eml_hashmap *map, struct eml_word *word)
 {
-    int key = eml_hashmap_probe(map, word);
+    int key = eml_hashmap_probe(map, word, NULL);
     return map->bucket[key].data;
 }
+
+
+/* removes an item from the hashmap */
+void *eml_hashmap_remove(struct eml_hashmap *map, struct eml_word *word)
+{
+    return eml_hashmap_take(map, word, NULL);
+}
+
+
+/* sets an item with a word or list key */
+void eml_hashmap_set_node(struct eml_hashmap *map, struct eml_node *key, void *data)
+{
+    if(key->type == EML_WORD) {
+        eml_hashmap_put(map, key->data, NULL, data);
+    } else {
+        eml_hashmap_put(map, NULL, key, data);
+    }
+}
+
+
+/* retrieves an item with a word or list key */
+void *eml_hashmap_get_node(struct eml_hashmap *map, struct eml_node *key)
+{
+    int i;
+
+    if(key->type == EML_WORD) {
+        i = eml_hashmap_probe(map, key->data, NULL);
+    } else {
+        i = eml_hashmap_probe(map, NULL, key);
+    }
+    return map->bucket[i].data;
+}
+
+
+/* removes an item with a word or list key */
+void *eml_hashmap_remove_node(struct eml_hashmap *map, struct eml_node *key)
+{
+    if(key->type == EML_WORD) {
+        return eml_hashmap_take(map, key->data, NULL);
+    }
+    return eml_hashmap_take(map, NULL, key);
+}
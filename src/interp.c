@@ -0,0 +1,1738 @@
+/*
+ * File: interp.c
+ * Purpose: This is the implementation file for the emlogo interpreter.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "interp.h"
+#include "turtle.h"
+#include "stream.h"
+#include "pool.h"
+#include "alloc.h"
+#include "bignum.h"
+#include "optimize.h"
+#include "jit.h"
+
+/* C stack allowed for each procedure call, enough for one which runs its
+   recursive call from inside a control primitive or two */
+#define CALL_STACK 1280
+
+/* stack kept back below the deepest call, for the primitives it runs */
+#define STACK_RESERVE (256 * 1024)
+
+/* the stack assumed when it has no limit, or the limit can't be had */
+#define STACK_DEFAULT (8 * 1024 * 1024)
+
+/* helper function prototypes */
+static struct eml_node *eval_expr(struct eml_interp *in, struct eml_list_node **cur, int prec);
+static struct eml_node *eval_primary(struct eml_interp *in, struct eml_list_node **cur);
+static int eval_args(struct eml_interp *in, const char *who, int nargs, struct eml_node **args, struct eml_list_node **cur);
+static struct eml_node *eval_call(struct eml_interp *in, struct eml_prim *prim, struct eml_list_node **cur);
+static struct eml_node *eval_proc(struct eml_interp *in, struct eml_proc *proc, struct eml_list_node **cur);
+static struct eml_node *run_proc(struct eml_interp *in, struct eml_frame *frame);
+static struct eml_node *call_prim(struct eml_interp *in, const struct eml_prim *prim, struct eml_node **args);
+static int run_native(struct eml_interp *in, struct eml_proc *proc, struct eml_node **args, struct eml_node **result);
+static void define_proc(struct eml_interp *in, struct eml_list_node **cur);
+static void free_proc(struct eml_proc *proc);
+static struct eml_proc *arg_proc(struct eml_interp *in, const char *who, struct eml_node *arg);
+static void bind_inputs(struct eml_frame *frame);
+static void unbind_inputs(struct eml_frame *frame);
+static struct eml_var *find_var(struct eml_interp *in, struct eml_word *ref, int create);
+static struct eml_var *named_var(struct eml_interp *in, const char *name, int create);
+static struct eml_var *inherit_var(struct eml_interp *in, const char *name);
+static int is_word(struct eml_node *node, const char *s);
+static int int_args(struct eml_node **args, int n);
+static int arg_size(struct eml_interp *in, const char *who, struct eml_node *arg, int *n);
+static struct eml_node *bool_node(int b);
+static const char *node_text(struct eml_node *node);
+
+/* control primitives */
+static struct eml_node *prim_repeat(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_if(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_ifelse(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_output(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_stop(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_print(struct eml_interp *in, struct eml_node **args);
+
+/* variable primitives */
+static struct eml_node *prim_make(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_thing(struct eml_interp *in, struct eml_node **args);
+
+/* word primitives */
+static struct eml_node *prim_word(struct eml_interp *in, struct eml_node **args);
+
+/* list primitives */
+static struct eml_node *prim_first(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_butfirst(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_emptyp(struct eml_interp *in, struct eml_node **args);
+
+/* array primitives */
+static struct eml_node *prim_array(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_numarray(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_mdarray(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_item(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_setitem(struct eml_interp *in, struct eml_node **args);
+
+/* procedure primitives */
+static struct eml_node *prim_memo(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_unmemo(struct eml_interp *in, struct eml_node **args);
+
+/* arithmetic and logic primitives */
+static struct eml_node *prim_sum(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_difference(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_product(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_quotient(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_remainder(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_minus(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_equalp(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_lessp(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_greaterp(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_not(struct eml_interp *in, struct eml_node **args);
+
+static const struct eml_prim control_prims[] = {
+    {"repeat", 2, prim_repeat, EML_PRIM_CONTROL},
+    {"if", 2, prim_if, EML_PRIM_CONTROL},
+    {"ifelse", 3, prim_ifelse, EML_PRIM_CONTROL},
+    {"output", 1, prim_output, EML_PRIM_EXIT},
+    {"op", 1, prim_output, EML_PRIM_EXIT},
+    {"stop", 0, prim_stop, EML_PRIM_EXIT},
+    {"print", 1, prim_print, EML_PRIM_COMMAND},
+    {"pr", 1, prim_print, EML_PRIM_COMMAND},
+    {"make", 2, prim_make, 0},
+    {"thing", 1, prim_thing, 0},
+    {"word", 2, prim_word, EML_PRIM_PURE},
+    {"first", 1, prim_first, EML_PRIM_PURE},
+    {"butfirst", 1, prim_butfirst, 0},
+    {"bf", 1, prim_butfirst, 0},
+    {"emptyp", 1, prim_emptyp, EML_PRIM_PURE},
+    {"array", 1, prim_array, 0},
+    {"numarray", 1, prim_numarray, 0},
+    {"mdarray", 1, prim_mdarray, 0},
+    {"item", 2, prim_item, 0},
+    {"setitem", 3, prim_setitem, 0},
+    {"memo", 1, prim_memo, 0},
+    {"unmemo", 1, prim_unmemo, 0},
+    {"sum", 2, prim_sum, EML_PRIM_PURE},
+    {"difference", 2, prim_difference, EML_PRIM_PURE},
+    {"product", 2, prim_product, EML_PRIM_PURE},
+    {"quotient", 2, prim_quotient, EML_PRIM_PURE},
+    {"remainder", 2, prim_remainder, EML_PRIM_PURE},
+    {"minus", 1, prim_minus, EML_PRIM_PURE},
+    {"equalp", 2, prim_equalp, EML_PRIM_PURE},
+    {"lessp", 2, prim_lessp, EML_PRIM_PURE},
+    {"greaterp", 2, prim_greaterp, EML_PRIM_PURE},
+    {"not", 1, prim_not, EML_PRIM_PURE},
+    {NULL, 0, NULL}
+};
+
+/* infix operators, from loosest to tightest binding */
+const struct eml_infix EML_INFIX[EML_NINFIX] = {
+    {'=', 1, "equalp"}, {'<', 1, "lessp"}, {'>', 1, "greaterp"},
+    {'+', 2, "sum"}, {'-', 2, "difference"},
+    {'*', 3, "product"}, {'/', 3, "quotient"}
+};
+
+/* Their primitives, in the same order. Each is a primitive of its own so
+   that it shows up under its own name in profiles. */
+static const struct eml_prim infix_prims[EML_NINFIX] = {
+    {"=", 2, prim_equalp, EML_PRIM_PURE},
+    {"<", 2, prim_lessp, EML_PRIM_PURE},
+    {">", 2, prim_greaterp, EML_PRIM_PURE},
+    {"+", 2, prim_sum, EML_PRIM_PURE},
+    {"-", 2, prim_difference, EML_PRIM_PURE},
+    {"*", 2, prim_product, EML_PRIM_PURE},
+    {"/", 2, prim_quotient, EML_PRIM_PURE}
+};
+
+
+/* create an interpreter with all of the built in primitives */
+struct eml_interp *eml_interp_alloc()
+{
+    struct eml_interp *in = eml_interp_alloc_worker();
+
+    /* the turtle lives on its own canvas */
+    in->turtle = eml_turtle_alloc(eml_canvas_alloc(EML_CANVAS_WIDTH, EML_CANVAS_HEIGHT));
+    return in;
+}
+
+
+/* create an interpreter without a turtle */
+struct eml_interp *eml_interp_alloc_worker()
+{
+    struct eml_interp *in = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_interp));
+
+    in->prims = eml_hashmap_alloc();
+    in->prim_ids = eml_calloc(EML_MEM_OTHER, eml_prim_count + 1, sizeof(*in->prim_ids));
+    in->procs = eml_hashmap_alloc();
+    in->vars = eml_hashmap_alloc();
+    eml_interp_defprims(in, control_prims);
+    eml_turtle_defprims(in);
+    eml_stream_defprims(in);
+    eml_pool_defprims(in);
+
+    in->out = eml_writer_file(stdout);
+    in->threads = eml_pool_threads();
+    eml_interp_set_stack(in, eml_interp_stack_size());
+    return in;
+}
+
+
+/* destroy an interpreter */
+void eml_interp_free(struct eml_interp *in)
+{
+    struct eml_var *var;
+    int i;
+
+    /* the workers go first, since they may still hold copies of our things */
+    if(in->pool) {
+        eml_pool_free(in->pool);
+    }
+
+    /* the primitive table owns its name words */
+    for(i=0; i<in->prims->cap; i++) {
+        if(in->prims->bucket[i].word) {
+            eml_free_word(in->prims->bucket[i].word);
+        }
+    }
+    eml_hashmap_free(in->prims);
+    eml_free(EML_MEM_OTHER, in->prim_ids);
+
+    /* variables own their names and values */
+    for(i=0; i<in->vars->cap; i++) {
+        if(in->vars->bucket[i].word) {
+            var = in->vars->bucket[i].data;
+            eml_free_word(var->name);
+            if(var->value) {
+                eml_node_free(var->value);
+            }
+            eml_free(EML_MEM_OTHER, var);
+        }
+    }
+    eml_hashmap_free(in->vars);
+
+    /* procedures own their names */
+    for(i=0; i<in->procs->cap; i++) {
+        if(in->procs->bucket[i].word) {
+            free_proc(in->procs->bucket[i].data);
+        }
+    }
+    eml_hashmap_free(in->procs);
+
+    if(in->output) {
+        eml_node_free(in->output);
+    }
+    if(in->profile) {
+        eml_profile_free(in->profile);
+    }
+    if(in->turtle) {
+        eml_canvas_free(in->turtle->canvas);
+        eml_turtle_free(in->turtle);
+    }
+    eml_writer_free(in->out);
+    eml_free(EML_MEM_OTHER, in);
+}
+
+
+/* add a table of primitives, terminated by an entry with a NULL name */
+void eml_interp_defprims(struct eml_interp *in, const struct eml_prim *prims)
+{
+    struct eml_word *name;
+
+    for(; prims->name; prims++) {
+        name = eml_stow((char*) prims->name);
+        if(name->prim) {
+            in->prim_ids[name->prim] = prims;
+        }
+        if(eml_hashmap_get(in->prims, name)) {
+            /* redefinition, the map keeps the original key */
+            eml_hashmap_set(in->prims, name, (void*) prims);
+            eml_free_word(name);
+        } else {
+            eml_hashmap_set(in->prims, name, (void*) prims);
+        }
+    }
+}
+
+
+/* the main thread's stack */
+size_t eml_interp_stack_size()
+{
+    struct rlimit rl;
+
+    if(getrlimit(RLIMIT_STACK, &rl) || rl.rlim_cur == RLIM_INFINITY) {
+        return STACK_DEFAULT;
+    }
+    return rl.rlim_cur;
+}
+
+
+/* fit the interpreter to the stack of the calling thread */
+void eml_interp_set_stack(struct eml_interp *in, size_t size)
+{
+    size_t reserve = size / 4 < STACK_RESERVE ? size / 4 : STACK_RESERVE;
+    char here;
+
+    in->stack_limit = (uintptr_t) &here - (size - reserve);
+    in->max_depth = (int) ((size - reserve) / CALL_STACK);
+}
+
+
+/* bring a worker up to date with its parent */
+void eml_interp_inherit(struct eml_interp *in)
+{
+    struct eml_interp *parent = in->parent;
+    struct eml_proc *from, *proc;
+    struct eml_var *var;
+    int i, j;
+
+    for(i=0; i<in->vars->cap; i++) {
+        if(in->vars->bucket[i].word) {
+            var = in->vars->bucket[i].data;
+            if(var->value) {
+                eml_node_free(var->value);
+                var->value = NULL;
+            }
+        }
+    }
+
+    if(in->inherited == parent->generation) {
+        return;
+    }
+
+    /* any definition may have been inlined anywhere, so all are copied */
+    for(i=0; i<in->procs->cap; i++) {
+        if(in->procs->bucket[i].word) {
+            free_proc(in->procs->bucket[i].data);
+        }
+    }
+    eml_hashmap_free(in->procs);
+    in->procs = eml_hashmap_alloc();
+
+    for(i=0; i<parent->procs->cap; i++) {
+        if(!parent->procs->bucket[i].word) {
+            continue;
+        }
+        from = parent->procs->bucket[i].data;
+        proc = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_proc));
+        proc->name = eml_word_clone(from->name);
+        proc->nargs = from->nargs;
+        for(j=0; j<from->nargs; j++) {
+            proc->params[j] = eml_word_clone(from->params[j]);
+            proc->vars[j] = find_var(in, from->vars[j]->name, 1);
+        }
+        proc->body = eml_node_clone(from->body);
+        if(from->memo) {
+            proc->memo = eml_memo_alloc(EML_MEMO_SIZE);
+        }
+        eml_hashmap_set(in->procs, proc->name, proc);
+    }
+
+    in->generation++;
+    in->inherited = parent->generation;
+}
+
+
+/* run a list of instructions */
+int eml_interp_run(struct eml_interp *in, struct eml_list *list)
+{
+    struct eml_list_node *cur = list->head;
+    struct eml_node *result;
+
+    while(cur && !in->error && !in->stop) {
+        result = eml_interp_eval(in, &cur);
+        if(result) {
+            eml_interp_error(in, "You don't say what to do with %s", node_text(result));
+            eml_node_free(result);
+        }
+    }
+
+    return in->error ? -1 : 0;
+}
+
+
+/* evaluate one expression, advancing the position past it */
+struct eml_node *eml_interp_eval(struct eml_interp *in, struct eml_list_node **cur)
+{
+    return eval_expr(in, cur, 0);
+}
+
+
+/* get the value of a variable */
+struct eml_node *eml_interp_getvar(struct eml_interp *in, const char *name)
+{
+    struct eml_var *var = named_var(in, name, 0);
+
+    if((!var || !var->value) && in->parent) {
+        var = inherit_var(in, name);
+    }
+    return var ? var->value : NULL;
+}
+
+
+/* set a variable, taking ownership of the value */
+void eml_interp_setvar(struct eml_interp *in, const char *name, struct eml_node *value)
+{
+    struct eml_var *var = named_var(in, name, 1);
+
+    if(var->value) {
+        eml_node_free(var->value);
+    }
+    var->value = value;
+}
+
+
+/* the infix operator at cur that binds tighter than prec */
+int eml_infix_op(struct eml_list_node *cur, int prec)
+{
+    struct eml_node *node;
+    struct eml_word *w;
+    int i;
+
+    if(!cur) {
+        return -1;
+    }
+    node = cur->data;
+    w = node->data;
+    if(node->type != EML_WORD || w->type != WORD || !w->field.s[0] || w->field.s[1]) {
+        return -1;
+    }
+    for(i=0; i<EML_NINFIX; i++) {
+        if(EML_INFIX[i].op == w->field.s[0]) {
+            return EML_INFIX[i].prec > prec ? i : -1;
+        }
+    }
+    return -1;
+}
+
+
+/* flag an error */
+void eml_interp_error(struct eml_interp *in, const char *fmt, ...)
+{
+    va_list ap;
+
+    /* the first error is the interesting one */
+    if(in->error) {
+        return;
+    }
+
+    va_start(ap, fmt);
+    vsnprintf(in->errmsg, sizeof(in->errmsg), fmt, ap);
+    va_end(ap);
+    in->error = 1;
+}
+
+
+/* clear the error flag */
+void eml_interp_clear_error(struct eml_interp *in)
+{
+    in->error = 0;
+    in->errmsg[0] = '\0';
+    in->stop = EML_RUNNING;
+    if(in->output) {
+        eml_node_free(in->output);
+        in->output = NULL;
+    }
+}
+
+
+/* get a numeric input */
+int eml_arg_number(struct eml_interp *in, const char *who, struct eml_node *arg, double *d)
+{
+    struct eml_word *w = arg->data;
+
+    if(arg->type == EML_WORD) {
+        eml_word_parse(w);
+    }
+    if(arg->type == EML_WORD && w->type == INTEGER) {
+        *d = w->field.i;
+        return 1;
+    } else if(arg->type == EML_WORD && w->type == FLOAT) {
+        *d = w->field.d;
+        return 1;
+    } else if(arg->type == EML_WORD && w->type == BIGNUM) {
+        *d = eml_bignum_double(w->field.b);
+        return 1;
+    }
+
+    eml_interp_error(in, "%s doesn't like %s as input", who, node_text(arg));
+    return 0;
+}
+
+
+/* get a true or false input */
+int eml_arg_bool(struct eml_interp *in, const char *who, struct eml_node *arg, int *b)
+{
+    if(is_word(arg, "true")) {
+        *b = 1;
+        return 1;
+    } else if(is_word(arg, "false")) {
+        *b = 0;
+        return 1;
+    }
+
+    eml_interp_error(in, "%s doesn't like %s as input", who, node_text(arg));
+    return 0;
+}
+
+
+/* get a word input */
+struct eml_word *eml_arg_word(struct eml_interp *in, const char *who, struct eml_node *arg)
+{
+    if(arg->type == EML_WORD) {
+        return arg->data;
+    }
+
+    eml_interp_error(in, "%s doesn't like %s as input", who, node_text(arg));
+    return NULL;
+}
+
+
+/* call a procedure or primitive by name with inputs, which it takes */
+struct eml_node *eml_interp_apply(struct eml_interp *in, const char *who, struct eml_word *name, struct eml_node **args, int nargs)
+{
+    struct eml_frame frame = {NULL, {NULL}, {NULL}, in->frame};
+    const struct eml_prim *prim = NULL;
+    struct eml_node *result = NULL;
+    int i;
+
+    if(name->type == WORD && name->prim) {
+        prim = in->prim_ids[name->prim];
+    } else if(name->type == WORD) {
+        prim = eml_hashmap_get(in->prims, name);
+    }
+    if(!prim && name->type == WORD) {
+        frame.proc = eml_hashmap_get(in->procs, name);
+    }
+
+    if(!prim && !frame.proc) {
+        eml_interp_error(in, "I don't know how to %s", eml_word_str(name));
+    } else if((prim ? prim->nargs : frame.proc->nargs) != nargs) {
+        eml_interp_error(in, "%s doesn't like %s as input", who, eml_word_str(name));
+    } else if(prim) {
+        result = call_prim(in, prim, args);
+    } else {
+        memcpy(frame.values, args, nargs * sizeof(struct eml_node*));
+        return run_proc(in, &frame);
+    }
+
+    /* primitives may keep an input by setting it to NULL */
+    for(i=0; i<nargs; i++) {
+        if(args[i]) {
+            eml_node_free(args[i]);
+        }
+    }
+    return result;
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* evaluate an expression whose infix operators bind tighter than prec */
+static struct eml_node *eval_expr(struct eml_interp *in, struct eml_list_node **cur, int prec)
+{
+    struct eml_node *args[2];
+    struct eml_node *result;
+    int op;
+
+    args[0] = eval_primary(in, cur);
+    while(args[0] && !in->error && (op = eml_infix_op(*cur, prec)) >= 0) {
+        *cur = (*cur)->next;
+        if(!*cur) {
+            eml_interp_error(in, "not enough inputs to %s", infix_prims[op].name);
+            break;
+        }
+        args[1] = eval_expr(in, cur, EML_INFIX[op].prec);
+        if(!args[1]) {
+            if(!in->error) {
+                eml_interp_error(in, "not enough inputs to %s", infix_prims[op].name);
+            }
+            break;
+        }
+
+        result = call_prim(in, infix_prims + op, args);
+        eml_node_free(args[0]);
+        eml_node_free(args[1]);
+        args[0] = result;
+    }
+
+    if(in->error && args[0]) {
+        eml_node_free(args[0]);
+        args[0] = NULL;
+    }
+    return args[0];
+}
+
+
+/* evaluate a single value, call or variable reference */
+static struct eml_node *eval_primary(struct eml_interp *in, struct eml_list_node **cur)
+{
+    struct eml_node *node = (*cur)->data;
+    struct eml_word *word;
+    struct eml_prim *prim;
+    struct eml_proc *proc;
+    struct eml_var *var;
+
+    *cur = (*cur)->next;
+
+    /* Expressions and lists can nest without procedure calls, as in a
+       long line of MINUS or IFs inside IFs, so the stack is checked too. */
+    if((uintptr_t) &var < in->stack_limit) {
+        eml_interp_error(in, "stack overflow");
+        return NULL;
+    }
+
+    /* lists and numbers are their own values, and each evaluation of an
+       array makes a new one, so changing it leaves the program alone */
+    if(node->type == EML_ARRAY) {
+        return eml_node_array(eml_array_dup(node->data));
+    } else if(node->type != EML_WORD) {
+        return eml_node_copy(node);
+    }
+    word = node->data;
+    if(word->type != WORD) {
+        return eml_node_copy(node);
+    }
+
+    /* quoted words */
+    if(word->field.s[0] == '"') {
+        return eml_node_word(eml_stow(word->field.s + 1));
+    }
+
+    /* variables, found by the word referring to them */
+    if(word->field.s[0] == ':') {
+        var = eml_hashmap_get(in->vars, word);
+        if((!var || !var->value) && in->parent) {
+            var = inherit_var(in, word->field.s + 1);
+        }
+        if(!var || !var->value) {
+            eml_interp_error(in, "%s has no value", word->field.s + 1);
+            return NULL;
+        }
+        return eml_node_copy(var->value);
+    }
+
+    /* procedure calls, where words naming built ins come tagged with them */
+    if(word->prim) {
+        prim = (struct eml_prim*) in->prim_ids[word->prim];
+    } else {
+        prim = eml_hashmap_get(in->prims, word);
+    }
+    if(prim) {
+        return eval_call(in, prim, cur);
+    }
+    proc = eml_hashmap_get(in->procs, word);
+    if(proc) {
+        return eval_proc(in, proc, cur);
+    }
+    if(is_word(node, "to")) {
+        define_proc(in, cur);
+        return NULL;
+    }
+
+    eml_interp_error(in, "I don't know how to %s", word->field.s);
+    return NULL;
+}
+
+
+/* Evaluate the inputs to a call. Returns 1 if they were all there, or 0
+   after flagging an error. Inputs already evaluated are left in args. */
+static int eval_args(struct eml_interp *in, const char *who, int nargs, struct eml_node **args, struct eml_list_node **cur)
+{
+    struct eml_node *src;
+    int i;
+
+    for(i=0; i<nargs; i++) {
+        if(!*cur) {
+            eml_interp_error(in, "not enough inputs to %s", who);
+            return 0;
+        }
+        src = (*cur)->data;
+        args[i] = eml_interp_eval(in, cur);
+        if(in->error || in->stop) {
+            return 0;
+        }
+        if(!args[i]) {
+            eml_interp_error(in, "%s didn't output to %s", node_text(src), who);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* gather the inputs for a primitive and call it */
+static struct eml_node *eval_call(struct eml_interp *in, struct eml_prim *prim, struct eml_list_node **cur)
+{
+    struct eml_node *args[EML_MAX_ARGS] = {NULL};
+    struct eml_node *result = NULL;
+    int i;
+
+    if(eval_args(in, prim->name, prim->nargs, args, cur)) {
+        result = call_prim(in, prim, args);
+    }
+
+    /* primitives may keep an input by setting it to NULL */
+    for(i=0; i<prim->nargs; i++) {
+        if(args[i]) {
+            eml_node_free(args[i]);
+        }
+    }
+
+    return result;
+}
+
+
+/* gather the inputs for a procedure and run its body */
+static struct eml_node *eval_proc(struct eml_interp *in, struct eml_proc *proc, struct eml_list_node **cur)
+{
+    struct eml_frame frame = {proc, {NULL}, {NULL}, in->frame};
+    int i;
+
+    if(eval_args(in, proc->name->field.s, proc->nargs, frame.values, cur)) {
+        return run_proc(in, &frame);
+    }
+
+    for(i=0; i<proc->nargs; i++) {
+        if(frame.values[i]) {
+            eml_node_free(frame.values[i]);
+        }
+    }
+    return NULL;
+}
+
+
+/* run a procedure's body in a frame holding its inputs, which are freed */
+static struct eml_node *run_proc(struct eml_interp *in, struct eml_frame *frame)
+{
+    struct eml_proc *proc = frame->proc;
+    struct eml_node *result = NULL;
+    struct eml_memo_key *key = NULL;
+    int i;
+
+    /* a memoized procedure may already know the answer */
+    if(proc->memo && (key = eml_memo_key(frame->values, proc->nargs))) {
+        result = eml_memo_get(proc->memo, key);
+        if(result) {
+            result = eml_node_copy(result);
+            eml_memo_key_free(key);
+            key = NULL;
+            goto done;
+        }
+    }
+
+    /* the optimized body is made again once any procedure changes */
+    if(in->optimize && proc->optimized != in->generation) {
+        eml_optimize_proc(in, proc);
+    }
+    if(in->jit && run_native(in, proc, frame->values, &result)) {
+        goto done;
+    }
+
+    /* the C stack only has room for so many calls */
+    if(in->depth >= in->max_depth) {
+        eml_interp_error(in, "stack overflow in %s", proc->name->field.s);
+        goto done;
+    }
+
+    if(in->profile) {
+        eml_profile_enter(in->profile, proc, proc->name->field.s);
+    }
+    in->frame = frame;
+    bind_inputs(frame);
+    proc->active++;
+    in->depth++;
+    eml_interp_run(in, (proc->code ? proc->code : proc->body)->data);
+    in->depth--;
+    proc->active--;
+    unbind_inputs(frame);
+    in->frame = frame->parent;
+    if(in->profile) {
+        eml_profile_leave(in->profile);
+    }
+
+    if(in->stop == EML_OUTPUT) {
+        result = in->output;
+        in->output = NULL;
+    }
+    in->stop = EML_RUNNING;
+
+    /* remember outputs, but not errors or commands */
+    if(key && result && !in->error && proc->memo) {
+        eml_memo_put(proc->memo, key, eml_node_copy(result));
+        key = NULL;
+    }
+
+done:
+    if(key) {
+        eml_memo_key_free(key);
+    }
+    for(i=0; i<proc->nargs; i++) {
+        if(frame->values[i]) {
+            eml_node_free(frame->values[i]);
+        }
+    }
+
+    return result;
+}
+
+
+/* call a primitive, recording it in the profile */
+static struct eml_node *call_prim(struct eml_interp *in, const struct eml_prim *prim, struct eml_node **args)
+{
+    struct eml_node *result;
+
+    if(!in->profile) {
+        return prim->fn(in, args);
+    }
+
+    eml_profile_enter(in->profile, prim, prim->name);
+    result = prim->fn(in, args);
+    eml_profile_leave(in->profile);
+    return result;
+}
+
+
+/* Run a procedure as native code, compiling it once it has been called
+   often enough. Returns 1 if it ran, or 0 if it has to be interpreted. */
+static int run_native(struct eml_interp *in, struct eml_proc *proc, struct eml_node **args, struct eml_node **result)
+{
+    int ran;
+
+    /* memos and profiles only see interpreted calls */
+    if(proc->memo || in->profile || proc->calls < 0) {
+        return 0;
+    }
+    if(!proc->jit) {
+        if(++proc->calls < in->jit) {
+            return 0;
+        }
+        proc->jit = eml_jit_compile(in, proc);
+        if(!proc->jit) {
+            proc->calls = -1;
+            return 0;
+        }
+    }
+
+    ran = eml_jit_call(proc->jit, args, result);
+    if(ran < 0) {
+        /* it would likely bail out again, wasting the work each time */
+        eml_jit_free(proc->jit);
+        proc->jit = NULL;
+        proc->calls = -1;
+    }
+    return ran > 0;
+}
+
+
+/* define a procedure from TO name :inputs ... END */
+static void define_proc(struct eml_interp *in, struct eml_list_node **cur)
+{
+    struct eml_proc *proc;
+    struct eml_node *node;
+    struct eml_word *name, *w;
+    struct eml_word *params[EML_MAX_ARGS];
+    struct eml_var *vars[EML_MAX_ARGS];
+    struct eml_list *body;
+    int nargs = 0;
+    int i;
+
+    if(in->frame) {
+        eml_interp_error(in, "can't use to inside a procedure");
+        return;
+    }
+
+    /* the name */
+    if(!*cur || ((struct eml_node*)(*cur)->data)->type != EML_WORD) {
+        eml_interp_error(in, "not enough inputs to to");
+        return;
+    }
+    name = ((struct eml_node*)(*cur)->data)->data;
+    if(name->type != WORD || strchr("\":", name->field.s[0])) {
+        eml_interp_error(in, "to doesn't like %s as input", eml_word_str(name));
+        return;
+    }
+    if(eml_hashmap_get(in->prims, name)) {
+        eml_interp_error(in, "%s is already defined", name->field.s);
+        return;
+    }
+    *cur = (*cur)->next;
+
+    /* the inputs */
+    while(*cur) {
+        node = (*cur)->data;
+        w = node->data;
+        if(node->type != EML_WORD || w->type != WORD || w->field.s[0] != ':') {
+            break;
+        }
+        if(nargs == EML_MAX_ARGS) {
+            eml_interp_error(in, "too many inputs to %s", name->field.s);
+            break;
+        }
+        vars[nargs] = find_var(in, w, 1);
+        params[nargs++] = eml_stow(w->field.s + 1);
+        *cur = (*cur)->next;
+    }
+
+    /* the body */
+    body = eml_list_alloc();
+    while(*cur && !is_word((*cur)->data, "end")) {
+        eml_list_append(body, eml_node_copy((*cur)->data));
+        *cur = (*cur)->next;
+    }
+    if(!*cur) {
+        eml_interp_error(in, "to %s without end", name->field.s);
+    } else {
+        *cur = (*cur)->next;
+    }
+
+    /* install it, reusing the old entry on redefinition */
+    proc = eml_hashmap_get(in->procs, name);
+    if(proc && proc->active) {
+        eml_interp_error(in, "can't redefine %s while it is running", name->field.s);
+    }
+    if(in->error) {
+        for(i=0; i<nargs; i++) {
+            eml_free_word(params[i]);
+        }
+        eml_node_free(eml_node_list(body));
+        return;
+    }
+
+    if(proc) {
+        for(i=0; i<proc->nargs; i++) {
+            eml_free_word(proc->params[i]);
+        }
+        eml_node_free(proc->body);
+        if(proc->code) {
+            eml_node_free(proc->code);
+            proc->code = NULL;
+        }
+        if(proc->jit) {
+            eml_jit_free(proc->jit);
+            proc->jit = NULL;
+        }
+        proc->calls = 0;
+
+        /* it stays memoized, but the old outputs may be wrong now */
+        if(proc->memo) {
+            eml_memo_clear(proc->memo);
+        }
+    } else {
+        proc = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_proc));
+        proc->name = eml_word_copy(name);
+        eml_hashmap_set(in->procs, proc->name, proc);
+    }
+    proc->nargs = nargs;
+    memcpy(proc->params, params, nargs * sizeof(struct eml_word*));
+    memcpy(proc->vars, vars, nargs * sizeof(struct eml_var*));
+    proc->body = eml_node_list(body);
+
+    /* anything inlined from the old definition is out of date */
+    in->generation++;
+}
+
+
+/* destroy a procedure */
+static void free_proc(struct eml_proc *proc)
+{
+    int i;
+
+    for(i=0; i<proc->nargs; i++) {
+        eml_free_word(proc->params[i]);
+    }
+    eml_node_free(proc->body);
+    if(proc->code) {
+        eml_node_free(proc->code);
+    }
+    if(proc->jit) {
+        eml_jit_free(proc->jit);
+    }
+    eml_free_word(proc->name);
+    if(proc->memo) {
+        eml_memo_free(proc->memo);
+    }
+    eml_free(EML_MEM_OTHER, proc);
+}
+
+
+/* get a procedure name input */
+static struct eml_proc *arg_proc(struct eml_interp *in, const char *who, struct eml_node *arg)
+{
+    struct eml_word *name = eml_arg_word(in, who, arg);
+    struct eml_proc *proc;
+
+    if(!name) {
+        return NULL;
+    }
+
+    proc = eml_hashmap_get(in->procs, name);
+    if(!proc) {
+        eml_interp_error(in, "I don't know how to %s", eml_word_str(name));
+    }
+    return proc;
+}
+
+
+/* bind a procedure's inputs to their variables */
+static void bind_inputs(struct eml_frame *frame)
+{
+    struct eml_proc *proc = frame->proc;
+    int i;
+
+    /* backwards, so the first of a repeated input name is the one seen */
+    for(i=proc->nargs - 1; i>=0; i--) {
+        frame->saved[i] = proc->vars[i]->value;
+        proc->vars[i]->value = frame->values[i];
+        frame->values[i] = NULL;
+    }
+}
+
+
+/* give the variables back the values the inputs shadowed */
+static void unbind_inputs(struct eml_frame *frame)
+{
+    struct eml_proc *proc = frame->proc;
+    int i;
+
+    for(i=0; i<proc->nargs; i++) {
+        if(proc->vars[i]->value) {
+            eml_node_free(proc->vars[i]->value);
+        }
+        proc->vars[i]->value = frame->saved[i];
+    }
+}
+
+
+/* the variable a :name word refers to, made if create is set */
+static struct eml_var *find_var(struct eml_interp *in, struct eml_word *ref, int create)
+{
+    struct eml_var *var = eml_hashmap_get(in->vars, ref);
+
+    if(!var && create) {
+        var = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_var));
+        var->name = eml_word_copy(ref);
+        var->value = NULL;
+        eml_hashmap_set(in->vars, var->name, var);
+    }
+    return var;
+}
+
+
+/* the variable with the given name, made if create is set */
+static struct eml_var *named_var(struct eml_interp *in, const char *name, int create)
+{
+    char *s = eml_malloc(EML_MEM_OTHER, strlen(name) + 2);
+    struct eml_word *ref;
+    struct eml_var *var;
+
+    s[0] = ':';
+    strcpy(s + 1, name);
+    ref = eml_stow(s);
+    eml_free(EML_MEM_OTHER, s);
+
+    var = find_var(in, ref, create);
+    eml_free_word(ref);
+    return var;
+}
+
+
+/* A worker's copy of its parent's value for a variable, kept until its
+   next job. Returns NULL if the parent has no value either. */
+static struct eml_var *inherit_var(struct eml_interp *in, const char *name)
+{
+    struct eml_var *from = named_var(in->parent, name, 0);
+    struct eml_var *var;
+    struct eml_node *value;
+
+    if(!from || !from->value) {
+        return NULL;
+    }
+    value = eml_node_clone(from->value);
+    if(!value) {
+        eml_interp_error(in, "%s holds a stream, which can't be passed to another thread", name);
+        return NULL;
+    }
+
+    var = named_var(in, name, 1);
+    var->value = value;
+    return var;
+}
+
+
+/* is the node the given word? */
+static int is_word(struct eml_node *node, const char *s)
+{
+    struct eml_word *w = node->data;
+
+    return node->type == EML_WORD && w->type == WORD && strcasecmp(w->field.s, s) == 0;
+}
+
+
+/* are the first n inputs all integer words? */
+static int int_args(struct eml_node **args, int n)
+{
+    int i, integer = 1;
+
+    /* every word is parsed, so numbers built as ropes are numbers after */
+    for(i=0; i<n; i++) {
+        if(args[i]->type != EML_WORD) {
+            return 0;
+        }
+        eml_word_parse(args[i]->data);
+        integer = integer && eml_is_integer((struct eml_word*) args[i]->data);
+    }
+    return integer;
+}
+
+
+/* get a size or index input, a whole number from 0 up */
+static int arg_size(struct eml_interp *in, const char *who, struct eml_node *arg, int *n)
+{
+    double d;
+
+    if(!eml_arg_number(in, who, arg, &d)) {
+        return 0;
+    }
+    if(d < 0 || d > INT_MAX || d != (int) d) {
+        eml_interp_error(in, "%s doesn't like %s as input", who, node_text(arg));
+        return 0;
+    }
+
+    *n = (int) d;
+    return 1;
+}
+
+
+/* create a true or false word */
+static struct eml_node *bool_node(int b)
+{
+    return eml_node_word(eml_stow(b ? "true" : "false"));
+}
+
+
+/* text of a node for error messages */
+static const char *node_text(struct eml_node *node)
+{
+    if(node->type == EML_WORD) {
+        return eml_word_str(node->data);
+    } else if(node->type == EML_ARRAY) {
+        return "{...}";
+    }
+    return "[...]";
+}
+
+
+/******************************************
+ * Control primitives
+ ******************************************/
+/* REPEAT count instructionlist */
+static struct eml_node *prim_repeat(struct eml_interp *in, struct eml_node **args)
+{
+    double count;
+    int i;
+
+    if(!eml_arg_number(in, "repeat", args[0], &count)) {
+        return NULL;
+    }
+    if(args[1]->type != EML_LIST) {
+        eml_interp_error(in, "repeat doesn't like %s as input", node_text(args[1]));
+        return NULL;
+    }
+
+    /* clamp before the cast; NaN and negative counts run nothing */
+    if(!(count > 0)) {
+        count = 0;
+    } else if(count > INT_MAX) {
+        count = INT_MAX;
+    }
+
+    for(i=0; i<(int) count && !in->error && !in->stop; i++) {
+        eml_interp_run(in, args[1]->data);
+    }
+
+    return NULL;
+}
+
+
+/* IF tf instructionlist */
+static struct eml_node *prim_if(struct eml_interp *in, struct eml_node **args)
+{
+    int b;
+
+    if(!eml_arg_bool(in, "if", args[0], &b)) {
+        return NULL;
+    }
+    if(args[1]->type != EML_LIST) {
+        eml_interp_error(in, "if doesn't like %s as input", node_text(args[1]));
+        return NULL;
+    }
+
+    if(b) {
+        eml_interp_run(in, args[1]->data);
+    }
+    return NULL;
+}
+
+
+/* IFELSE tf instructionlist instructionlist */
+static struct eml_node *prim_ifelse(struct eml_interp *in, struct eml_node **args)
+{
+    int b;
+
+    if(!eml_arg_bool(in, "ifelse", args[0], &b)) {
+        return NULL;
+    }
+    if(args[1]->type != EML_LIST || args[2]->type != EML_LIST) {
+        eml_interp_error(in, "ifelse doesn't like %s as input",
+                         node_text(args[1]->type != EML_LIST ? args[1] : args[2]));
+        return NULL;
+    }
+
+    eml_interp_run(in, args[b ? 1 : 2]->data);
+    return NULL;
+}
+
+
+/* OUTPUT value */
+static struct eml_node *prim_output(struct eml_interp *in, struct eml_node **args)
+{
+    if(!in->frame) {
+        eml_interp_error(in, "Can only use output inside a procedure");
+        return NULL;
+    }
+
+    /* keep the input, it is the procedure's output */
+    in->output = args[0];
+    args[0] = NULL;
+    in->stop = EML_OUTPUT;
+    return NULL;
+}
+
+
+/* STOP */
+static struct eml_node *prim_stop(struct eml_interp *in, struct eml_node **args)
+{
+    if(!in->frame) {
+        eml_interp_error(in, "Can only use stop inside a procedure");
+        return NULL;
+    }
+
+    in->stop = EML_STOPPED;
+    return NULL;
+}
+
+
+/* PRINT thing, lists are printed without their outer brackets, arrays
+   and streams with theirs */
+static struct eml_node *prim_print(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list_node *cur;
+
+    if(args[0]->type == EML_WORD) {
+        eml_writer_word(in->out, args[0]->data);
+    } else if(args[0]->type != EML_LIST) {
+        eml_node_write(in->out, args[0]);
+    } else {
+        for(cur = ((struct eml_list*)args[0]->data)->head; cur; cur = cur->next) {
+            eml_node_write(in->out, cur->data);
+        }
+    }
+
+    /* a line at a time, so it keeps its place among other output */
+    eml_writer_char(in->out, '\n');
+    eml_writer_flush(in->out);
+    return NULL;
+}
+
+
+/******************************************
+ * Variable primitives
+ ******************************************/
+/* MAKE varname value */
+static struct eml_node *prim_make(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *name = eml_arg_word(in, "make", args[0]);
+
+    if(!name) {
+        return NULL;
+    }
+
+    /* the variable keeps the input */
+    eml_interp_setvar(in, eml_word_str(name), args[1]);
+    args[1] = NULL;
+    return NULL;
+}
+
+
+/* THING varname */
+static struct eml_node *prim_thing(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *name = eml_arg_word(in, "thing", args[0]);
+    struct eml_node *value;
+
+    if(!name) {
+        return NULL;
+    }
+
+    value = eml_interp_getvar(in, eml_word_str(name));
+    if(!value) {
+        eml_interp_error(in, "%s has no value", eml_word_str(name));
+        return NULL;
+    }
+    return eml_node_copy(value);
+}
+
+
+/******************************************
+ * Word primitives
+ ******************************************/
+/* WORD a b, a and b joined together */
+static struct eml_node *prim_word(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *a = eml_arg_word(in, "word", args[0]);
+    struct eml_word *b = a ? eml_arg_word(in, "word", args[1]) : NULL;
+
+    if(!b) {
+        return NULL;
+    }
+    return eml_node_word(eml_wcat(a, b));
+}
+
+
+/******************************************
+ * List primitives
+ ******************************************/
+/* FIRST thing, the first item of a list or stream, or character of a word */
+static struct eml_node *prim_first(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list *list = args[0]->data;
+    const char *s;
+    char c[2];
+
+    if(args[0]->type == EML_STREAM) {
+        return eml_node_copy(((struct eml_stream*) args[0]->data)->first);
+    } else if(args[0]->type == EML_LIST && list->head) {
+        return eml_node_copy(list->head->data);
+    } else if(args[0]->type == EML_WORD && *(s = eml_word_str(args[0]->data))) {
+        c[0] = s[0];
+        c[1] = '\0';
+        return eml_node_word(eml_stow(c));
+    }
+
+    eml_interp_error(in, "first doesn't like %s as input", node_text(args[0]));
+    return NULL;
+}
+
+
+/* BUTFIRST thing, all but the first, working out the rest of a stream */
+static struct eml_node *prim_butfirst(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list *list = args[0]->data, *rest;
+    struct eml_list_node *cur;
+    struct eml_node *node;
+    const char *s;
+
+    if(args[0]->type == EML_STREAM) {
+        node = eml_stream_rest(in, args[0]->data);
+        return node ? eml_node_copy(node) : NULL;
+    } else if(args[0]->type == EML_LIST && list->head) {
+        rest = eml_list_alloc();
+        for(cur = list->head->next; cur; cur = cur->next) {
+            eml_list_append(rest, eml_node_copy(cur->data));
+        }
+        return eml_node_list(rest);
+    } else if(args[0]->type == EML_WORD && *(s = eml_word_str(args[0]->data))) {
+        return eml_node_word(eml_stow((char*) s + 1));
+    }
+
+    eml_interp_error(in, "butfirst doesn't like %s as input", node_text(args[0]));
+    return NULL;
+}
+
+
+/* EMPTYP thing, is it the empty list or the empty word? */
+static struct eml_node *prim_emptyp(struct eml_interp *in, struct eml_node **args)
+{
+    if(args[0]->type == EML_LIST) {
+        return bool_node(!((struct eml_list*) args[0]->data)->head);
+    } else if(args[0]->type == EML_WORD) {
+        return bool_node(!*eml_word_str(args[0]->data));
+    }
+    return bool_node(0);
+}
+
+
+/******************************************
+ * Array primitives
+ ******************************************/
+/* ARRAY size, an array of empty lists */
+static struct eml_node *prim_array(struct eml_interp *in, struct eml_node **args)
+{
+    int n;
+
+    if(!arg_size(in, "array", args[0], &n)) {
+        return NULL;
+    }
+    return eml_node_array(eml_array_alloc(n));
+}
+
+
+/* NUMARRAY size, an array of zeros which keeps its numbers unboxed */
+static struct eml_node *prim_numarray(struct eml_interp *in, struct eml_node **args)
+{
+    int n;
+
+    if(!arg_size(in, "numarray", args[0], &n)) {
+        return NULL;
+    }
+    return eml_node_array(eml_array_numeric(n));
+}
+
+
+/* MDARRAY [size1 size2 ...], an array of arrays of the later sizes */
+static struct eml_node *prim_mdarray(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list_node *cur;
+    struct eml_array **level, **next;
+    struct eml_node *result;
+    long count = 1;
+    int i, j, k, n, size;
+
+    if(args[0]->type != EML_LIST || !((struct eml_list*)args[0]->data)->head) {
+        eml_interp_error(in, "mdarray doesn't like %s as input", node_text(args[0]));
+        return NULL;
+    }
+
+    /* check every size before building anything */
+    for(cur = ((struct eml_list*)args[0]->data)->head; cur; cur = cur->next) {
+        if(!arg_size(in, "mdarray", cur->data, &n)) {
+            return NULL;
+        }
+        if(cur->next && (count *= n) > INT_MAX) {
+            eml_interp_error(in, "mdarray doesn't like %s as input", node_text(args[0]));
+            return NULL;
+        }
+    }
+
+    /* build a level at a time, each array holding those of the next */
+    cur = ((struct eml_list*)args[0]->data)->head;
+    arg_size(in, "mdarray", cur->data, &size);
+    result = eml_node_array(eml_array_alloc(size));
+    level = eml_malloc(EML_MEM_OTHER, sizeof(*level));
+    level[0] = result->data;
+    count = 1;
+    for(cur = cur->next; cur; cur = cur->next) {
+        arg_size(in, "mdarray", cur->data, &n);
+        next = eml_malloc(EML_MEM_OTHER, (count * size ? count * size : 1) * sizeof(*next));
+        for(i=0, k=0; i<count; i++) {
+            for(j=0; j<size; j++, k++) {
+                next[k] = eml_array_alloc(n);
+                level[i]->item[j] = eml_node_array(next[k]);
+            }
+        }
+        eml_free(EML_MEM_OTHER, level);
+        level = next;
+        count *= size;
+        size = n;
+    }
+
+    eml_free(EML_MEM_OTHER, level);
+    return result;
+}
+
+
+/* ITEM index thing, counting from 1, in constant time for an array */
+static struct eml_node *prim_item(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_array *array = args[1]->data;
+    struct eml_list_node *cur;
+    int i, n;
+
+    if(!arg_size(in, "item", args[0], &i)) {
+        return NULL;
+    }
+
+    if(args[1]->type == EML_ARRAY) {
+        if(i >= 1 && i <= array->size) {
+            return eml_array_get(array, i - 1);
+        }
+        eml_interp_error(in, "item doesn't like %s as input", node_text(args[0]));
+        return NULL;
+    } else if(args[1]->type == EML_LIST) {
+        cur = ((struct eml_list*)args[1]->data)->head;
+        for(n = 1; cur && n < i; n++) {
+            cur = cur->next;
+        }
+        if(i >= 1 && cur) {
+            return eml_node_copy(cur->data);
+        }
+        eml_interp_error(in, "item doesn't like %s as input", node_text(args[0]));
+        return NULL;
+    }
+
+    eml_interp_error(in, "item doesn't like %s as input", node_text(args[1]));
+    return NULL;
+}
+
+
+/* SETITEM index array value */
+static struct eml_node *prim_setitem(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_array *array = args[1]->data;
+    int i;
+
+    if(args[1]->type != EML_ARRAY) {
+        eml_interp_error(in, "setitem doesn't like %s as input", node_text(args[1]));
+        return NULL;
+    }
+    if(!arg_size(in, "setitem", args[0], &i)) {
+        return NULL;
+    }
+    if(i < 1 || i > array->size) {
+        eml_interp_error(in, "setitem doesn't like %s as input", node_text(args[0]));
+        return NULL;
+    }
+    if(eml_node_holds(args[2], array)) {
+        eml_interp_error(in, "setitem can't put an array inside itself");
+        return NULL;
+    }
+
+    /* the array keeps the input */
+    eml_array_set(array, i - 1, args[2]);
+    args[2] = NULL;
+    return NULL;
+}
+
+
+/******************************************
+ * Procedure primitives
+ ******************************************/
+/* MEMO procname, declares that the procedure's output depends only on its
+   inputs, so it may be cached */
+static struct eml_node *prim_memo(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_proc *proc = arg_proc(in, "memo", args[0]);
+
+    if(proc && !proc->memo) {
+        proc->memo = eml_memo_alloc(EML_MEMO_SIZE);
+    }
+    return NULL;
+}
+
+
+/* UNMEMO procname */
+static struct eml_node *prim_unmemo(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_proc *proc = arg_proc(in, "unmemo", args[0]);
+
+    if(proc && proc->memo) {
+        eml_memo_free(proc->memo);
+        proc->memo = NULL;
+    }
+    return NULL;
+}
+
+
+/******************************************
+ * Arithmetic and logic primitives
+ ******************************************/
+/* SUM a b */
+static struct eml_node *prim_sum(struct eml_interp *in, struct eml_node **args)
+{
+    double a, b;
+
+    if(int_args(args, 2)) {
+        return eml_node_word(eml_int_add(args[0]->data, args[1]->data));
+    }
+    if(!eml_arg_number(in, "sum", args[0], &a) || !eml_arg_number(in, "sum", args[1], &b)) {
+        return NULL;
+    }
+    return eml_node_number(a + b);
+}
+
+
+/* DIFFERENCE a b */
+static struct eml_node *prim_difference(struct eml_interp *in, struct eml_node **args)
+{
+    double a, b;
+
+    if(int_args(args, 2)) {
+        return eml_node_word(eml_int_sub(args[0]->data, args[1]->data));
+    }
+    if(!eml_arg_number(in, "difference", args[0], &a) || !eml_arg_number(in, "difference", args[1], &b)) {
+        return NULL;
+    }
+    return eml_node_number(a - b);
+}
+
+
+/* PRODUCT a b */
+static struct eml_node *prim_product(struct eml_interp *in, struct eml_node **args)
+{
+    double a, b;
+
+    if(int_args(args, 2)) {
+        return eml_node_word(eml_int_mul(args[0]->data, args[1]->data));
+    }
+    if(!eml_arg_number(in, "product", args[0], &a) || !eml_arg_number(in, "product", args[1], &b)) {
+        return NULL;
+    }
+    return eml_node_number(a * b);
+}
+
+
+/* QUOTIENT a b, which is exact when integers divide evenly */
+static struct eml_node *prim_quotient(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *q, *r;
+    double a, b;
+    int exact;
+
+    if(!eml_arg_number(in, "quotient", args[0], &a) || !eml_arg_number(in, "quotient", args[1], &b)) {
+        return NULL;
+    }
+    if(b == 0) {
+        eml_interp_error(in, "quotient doesn't like 0 as input");
+        return NULL;
+    }
+    if(int_args(args, 2)) {
+        eml_int_divmod(args[0]->data, args[1]->data, &q, &r);
+        exact = r->type == INTEGER && r->field.i == 0;
+        eml_free_word(r);
+        if(exact) {
+            return eml_node_word(q);
+        }
+        eml_free_word(q);
+    }
+    return eml_node_number(a / b);
+}
+
+
+/* REMAINDER a b, with the sign of a */
+static struct eml_node *prim_remainder(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *r;
+    double a, b;
+
+    if(!eml_arg_number(in, "remainder", args[0], &a) || !eml_arg_number(in, "remainder", args[1], &b)) {
+        return NULL;
+    }
+    if(b == 0) {
+        eml_interp_error(in, "remainder doesn't like 0 as input");
+        return NULL;
+    }
+    if(int_args(args, 2)) {
+        eml_int_divmod(args[0]->data, args[1]->data, NULL, &r);
+        return eml_node_word(r);
+    }
+    return eml_node_number(fmod(a, b));
+}
+
+
+/* MINUS a */
+static struct eml_node *prim_minus(struct eml_interp *in, struct eml_node **args)
+{
+    double a;
+
+    if(int_args(args, 1)) {
+        return eml_node_word(eml_int_neg(args[0]->data));
+    }
+    if(!eml_arg_number(in, "minus", args[0], &a)) {
+        return NULL;
+    }
+    return eml_node_number(-a);
+}
+
+
+/* EQUALP a b, numbers are compared by value, words without case, lists
+   by their structure as eml_node_equals compares them, and arrays and
+   streams by identity */
+static struct eml_node *prim_equalp(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_word *a = args[0]->data, *b = args[1]->data;
+    double x, y;
+
+    if(args[0]->type != EML_WORD || args[1]->type != EML_WORD) {
+        return bool_node(eml_node_equals(args[0], args[1]));
+    }
+
+    if(int_args(args, 2)) {
+        return bool_node(eml_int_cmp(a, b) == 0);
+    } else if((eml_is_integer(a) || a->type == FLOAT) && (eml_is_integer(b) || b->type == FLOAT)) {
+        eml_arg_number(in, "equalp", args[0], &x);
+        eml_arg_number(in, "equalp", args[1], &y);
+        return bool_node(x == y);
+    }
+    return bool_node(eml_word_equals(a, b));
+}
+
+
+/* LESSP a b */
+static struct eml_node *prim_lessp(struct eml_interp *in, struct eml_node **args)
+{
+    double a, b;
+
+    if(int_args(args, 2)) {
+        return bool_node(eml_int_cmp(args[0]->data, args[1]->data) < 0);
+    }
+    if(!eml_arg_number(in, "lessp", args[0], &a) || !eml_arg_number(in, "lessp", args[1], &b)) {
+        return NULL;
+    }
+    return bool_node(a < b);
+}
+
+
+/* GREATERP a b */
+static struct eml_node *prim_greaterp(struct eml_interp *in, struct eml_node **args)
+{
+    double a, b;
+
+    if(int_args(args, 2)) {
+        return bool_node(eml_int_cmp(args[0]->data, args[1]->data) > 0);
+    }
+    if(!eml_arg_number(in, "greaterp", args[0], &a) || !eml_arg_number(in, "greaterp", args[1], &b)) {
+        return NULL;
+    }
+    return bool_node(a > b);
+}
+
+
+/* NOT tf */
+static struct eml_node *prim_not(struct eml_interp *in, struct eml_node **args)
+{
+    int b;
+
+    if(!eml_arg_bool(in, "not", args[0], &b)) {
+        return NULL;
+    }
+    return bool_node(!b);
+}
@@ -0,0 +1,763 @@
+/*
+ * File: jit.c
+ * Purpose: This is the implementation file for the emlogo native code compiler.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
+#include "jit.h"
+#include "alloc.h"
+#include "buf.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+
+/* what compiled code leaves in xmm0, T_NONE when it can't be compiled */
+enum jit_type {T_NONE = 0, T_NUM, T_BOOL};
+
+/* the primitives there are templates for */
+enum jit_op {OP_EQ, OP_LT, OP_GT, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_REM, OP_MINUS,
+             OP_NOT, OP_OUTPUT, OP_STOP, OP_IF, OP_IFELSE, OP_REPEAT, OP_MAKE};
+static const struct {
+    const char *name;
+    enum jit_op op;
+} jit_prims[] = {
+    {"equalp", OP_EQ}, {"lessp", OP_LT}, {"greaterp", OP_GT}, {"sum", OP_ADD},
+    {"difference", OP_SUB}, {"product", OP_MUL}, {"quotient", OP_DIV},
+    {"remainder", OP_REM}, {"minus", OP_MINUS}, {"not", OP_NOT},
+    {"output", OP_OUTPUT}, {"op", OP_OUTPUT}, {"stop", OP_STOP}, {"if", OP_IF},
+    {"ifelse", OP_IFELSE}, {"repeat", OP_REPEAT}, {"make", OP_MAKE}
+};
+#define NPRIMS (sizeof(jit_prims) / sizeof(jit_prims[0]))
+
+/* the C stack compiling may use before a procedure is left uncompiled */
+#define COMPILE_STACK (64 * 1024)
+
+/*
+ * The code starts with constants and the shared ways out, so everything
+ * after them can jump back to them:
+ *
+ *   RANGE_MAX, RANGE_MIN, ONE   doubles
+ *   BAIL    mov eax, 2
+ *   RET     dec the interpreter's depth; lea rsp, [rbp-16]; pop r12; pop rbx; pop rbp; ret
+ *   ENTRY   the procedure
+ *
+ * The procedure is int f(const double *inputs, double *output), which
+ * returns 0 when it outputs, 1 when it stops and 2 when it bails out.
+ * Its frame holds the inputs and a place for the output of calls to
+ * itself. xmm0 holds the value being computed, the machine stack the
+ * values waiting on it, rbx the count of the innermost REPEAT and r12
+ * where the output goes. Each call counts itself in the interpreter's
+ * depth as an interpreted one would, and bails out past its max_depth,
+ * so that the interpreter reports the overflow at the same depth.
+ */
+#define RANGE_MAX 0
+#define RANGE_MIN 8
+#define ONE 16
+#define BAIL 24
+#define RET 29
+#define ENTRY 50
+
+/* the frame offset of an input, the one after the last is for outputs */
+#define SLOT(i) (-24 - 8 * (i))
+
+/* machine code templates, with the operand which follows, if any */
+#define ASM_BAIL "\xB8\x02\x00\x00\x00"             /* mov eax, 2 */
+#define ASM_RET "\x48\x8D\x65\xF0\x41\x5C\x5B\x5D\xC3"
+#define ASM_PROLOGUE "\x55\x48\x89\xE5\x53\x41\x54\x48\x83\xEC" /* ... sub rsp, imm8 */
+#define ASM_SAVE_OUTPUT "\x49\x89\xF4"              /* mov r12, rsi */
+#define ASM_MOV_RCX "\x48\xB9"                      /* mov rcx, imm64 */
+#define ASM_LEAVE_CALL "\xFF\x09"                   /* dec dword [rcx] */
+#define ASM_ENTER_CALL "\xFF\x01\x8B\x01\x3B\x41" /* inc dword [rcx]; mov eax, [rcx]; cmp eax, [rcx+disp8] */
+#define ASM_INPUT "\xF2\x0F\x10\x47"                /* movsd xmm0, [rdi+disp8] */
+#define ASM_LOAD "\xF2\x0F\x10\x45"                 /* movsd xmm0, [rbp+disp8] */
+#define ASM_STORE "\xF2\x0F\x11\x45"                /* movsd [rbp+disp8], xmm0 */
+#define ASM_LOAD_CONST "\xF2\x0F\x10\x05"           /* movsd xmm0, [rip+disp32] */
+#define ASM_CMP_CONST "\x66\x0F\x2E\x05"            /* ucomisd xmm0, [rip+disp32] */
+#define ASM_MOV_RAX "\x48\xB8"                      /* mov rax, imm64 */
+#define ASM_RAX_XMM0 "\x66\x48\x0F\x6E\xC0"         /* movq xmm0, rax */
+#define ASM_CALL_RAX "\xFF\xD0"                     /* call rax */
+#define ASM_PUSH "\x48\x83\xEC\x08\xF2\x0F\x11\x04\x24"  /* sub rsp, 8; movsd [rsp], xmm0 */
+#define ASM_POP "\x66\x0F\x28\xC8\xF2\x0F\x10\x04\x24\x48\x83\xC4\x08" /* xmm1 = xmm0, pop xmm0 */
+#define ASM_ADD "\xF2\x0F\x58\xC1"                  /* addsd xmm0, xmm1 */
+#define ASM_SUB "\xF2\x0F\x5C\xC1"                  /* subsd xmm0, xmm1 */
+#define ASM_MUL "\xF2\x0F\x59\xC1"                  /* mulsd xmm0, xmm1 */
+#define ASM_DIV "\xF2\x0F\x5E\xC1"                  /* divsd xmm0, xmm1 */
+#define ASM_ZERO "\x66\x0F\x57\xD2\x66\x0F\x2E\xCA" /* xorpd xmm2, xmm2; ucomisd xmm1, xmm2 */
+#define ASM_MINUS "\x66\x0F\x57\xC9\xF2\x0F\x5C\xC8\x66\x0F\x28\xC1" /* xmm0 = 0 - xmm0 */
+#define ASM_MOVE "\x66\x0F\x28\xC8"                 /* movapd xmm1, xmm0 */
+#define ASM_CMP "\x66\x0F\x2E\xC1"                  /* ucomisd xmm0, xmm1 */
+#define ASM_SETE "\x0F\x94\xC0"                     /* sete al */
+#define ASM_SETB "\x0F\x92\xC0"                     /* setb al */
+#define ASM_SETA "\x0F\x97\xC0"                     /* seta al */
+#define ASM_BOOL "\x0F\xB6\xC0\xF2\x0F\x2A\xC0"     /* movzx eax, al; cvtsi2sd xmm0, eax */
+#define ASM_TEST "\x66\x0F\x57\xC9\x66\x0F\x2E\xC1" /* xorpd xmm1, xmm1; ucomisd xmm0, xmm1 */
+#define ASM_OUTPUT "\xF2\x41\x0F\x11\x04\x24\x31\xC0"  /* movsd [r12], xmm0; xor eax, eax */
+#define ASM_STOP "\xB8\x01\x00\x00\x00"             /* mov eax, 1 */
+#define ASM_PUSH_RBX "\x53"
+#define ASM_POP_RBX "\x5B"
+#define ASM_COUNT "\xF2\x0F\x2C\xD8"                /* cvttsd2si ebx, xmm0 */
+#define ASM_TEST_RBX "\x85\xDB"                     /* test ebx, ebx */
+#define ASM_DEC_RBX "\xFF\xCB"                      /* dec ebx */
+#define ASM_ALIGN "\x48\x83\xEC\x08"                /* sub rsp, 8 */
+#define ASM_UNALIGN "\x48\x83\xC4\x08"              /* add rsp, 8 */
+#define ASM_RESERVE "\x48\x83\xEC"                  /* sub rsp, imm8 */
+#define ASM_RELEASE "\x48\x83\xC4"                  /* add rsp, imm8 */
+#define ASM_ARG "\xF2\x0F\x11\x44\x24"              /* movsd [rsp+disp8], xmm0 */
+#define ASM_CALL_ARGS "\x48\x89\xE7\x48\x8D\x75"    /* mov rdi, rsp; lea rsi, [rbp+disp8] */
+#define ASM_TEST_EAX "\x85\xC0"                     /* test eax, eax */
+#define ASM_JMP "\xE9"
+#define ASM_CALL "\xE8"
+#define ASM_JE "\x0F\x84"
+#define ASM_JNE "\x0F\x85"
+#define ASM_JA "\x0F\x87"
+#define ASM_JB "\x0F\x82"
+#define ASM_JLE "\x0F\x8E"
+#define ASM_JG "\x0F\x8F"
+
+/* copy a template, or one ending in a 32 bit displacement to an offset */
+#define EMIT(j, t) emit(j, t, sizeof(t) - 1)
+#define REL(j, t, target) emit_rel(j, t, sizeof(t) - 1, target)
+#define FORWARD(j, t) emit_forward(j, t, sizeof(t) - 1)
+
+/* a procedure being compiled */
+struct jit {
+    struct eml_interp *in;
+    struct eml_proc *proc;
+    char *code;     /* the machine code so far */
+    int depth;      /* values pushed on the machine stack */
+    int loops;      /* REPEATs around the code being compiled */
+    uintptr_t stack; /* where the C stack was when compiling began */
+};
+
+static int compile_list(struct jit *j, struct eml_list *list);
+static int compile_statement(struct jit *j, struct eml_list_node **cur, int *exits);
+static int compile_block(struct jit *j, struct eml_list_node **cur);
+static enum jit_type compile_expr(struct jit *j, struct eml_list_node **cur, int prec);
+static enum jit_type compile_primary(struct jit *j, struct eml_list_node **cur);
+static enum jit_type compile_op(struct jit *j, enum jit_op op, struct eml_list_node **cur);
+static enum jit_type compile_binary(struct jit *j, enum jit_op op, enum jit_type a, enum jit_type b);
+static enum jit_type compile_call(struct jit *j, struct eml_list_node **cur);
+static enum jit_type compile_arg(struct jit *j, struct eml_list_node **cur);
+static void emit(struct jit *j, const char *bytes, int n);
+static void emit_byte(struct jit *j, int b);
+static void emit_rel(struct jit *j, const char *bytes, int n, int target);
+static int emit_forward(struct jit *j, const char *bytes, int n);
+static void patch(struct jit *j, int at);
+static void emit_guard(struct jit *j);
+static int lookup_op(struct jit *j, struct eml_word *w);
+static int find_template(const char *name);
+static int find_input(struct jit *j, const char *name);
+
+
+/* compile a procedure */
+struct eml_jit *eml_jit_compile(struct eml_interp *in, struct eml_proc *proc)
+{
+    static const double constants[] = {INT_MAX, INT_MIN, 1};
+    struct jit j = {in, proc, eml_buf_alloc(), 0, 0, 0};
+    struct eml_jit *jit = NULL;
+    int *depth = &in->depth;
+    unsigned char *code;
+    size_t size;
+    int i;
+
+    j.stack = (uintptr_t) &j;
+
+    /* what the code jumps back to */
+    emit(&j, (const char*) constants, sizeof(constants));
+    EMIT(&j, ASM_BAIL);
+    EMIT(&j, ASM_MOV_RCX);
+    emit(&j, (const char*) &depth, sizeof(depth));
+    EMIT(&j, ASM_LEAVE_CALL);
+    EMIT(&j, ASM_RET);
+
+    /* the call is counted, and bails out once there are too many */
+    EMIT(&j, ASM_PROLOGUE);
+    emit_byte(&j, (8 * (proc->nargs + 1) + 15) & ~15);
+    EMIT(&j, ASM_SAVE_OUTPUT);
+    EMIT(&j, ASM_MOV_RCX);
+    emit(&j, (const char*) &depth, sizeof(depth));
+    EMIT(&j, ASM_ENTER_CALL);
+    emit_byte(&j, offsetof(struct eml_interp, max_depth) - offsetof(struct eml_interp, depth));
+    REL(&j, ASM_JG, BAIL);
+
+    /* the inputs are copied into the frame, where MAKE can change them */
+    for(i=0; i<proc->nargs; i++) {
+        EMIT(&j, ASM_INPUT);
+        emit_byte(&j, 8 * i);
+        EMIT(&j, ASM_STORE);
+        emit_byte(&j, SLOT(i));
+    }
+
+    if(compile_list(&j, (proc->code ? proc->code : proc->body)->data)) {
+        /* running off the end stops */
+        EMIT(&j, ASM_STOP);
+        REL(&j, ASM_JMP, RET);
+
+        /* the mapping is writable or executable, never both */
+        size = eml_buf_length(j.code);
+        code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(code != MAP_FAILED) {
+            memcpy(code, j.code, size);
+            if(mprotect(code, size, PROT_READ | PROT_EXEC) == 0) {
+                jit = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_jit));
+                jit->code = code;
+                jit->size = size;
+                jit->nargs = proc->nargs;
+                jit->entry = (int (*)(const double*, double*)) (code + ENTRY);
+            } else {
+                munmap(code, size);
+            }
+        }
+    }
+
+    eml_buf_free(j.code);
+    return jit;
+}
+
+
+/* run a compiled procedure */
+int eml_jit_call(struct eml_jit *jit, struct eml_node **args, struct eml_node **result)
+{
+    double inputs[EML_MAX_ARGS], output;
+    struct eml_word *w;
+    int i;
+
+    for(i=0; i<jit->nargs; i++) {
+        w = args[i]->data;
+        if(args[i]->type != EML_WORD) {
+            return 0;
+        } else if(w->type == INTEGER) {
+            inputs[i] = w->field.i;
+        } else if(w->type == FLOAT && w->field.d >= INT_MIN && w->field.d <= INT_MAX) {
+            inputs[i] = w->field.d;
+        } else {
+            return 0;
+        }
+    }
+
+    switch(jit->entry(inputs, &output)) {
+    case 0:
+        *result = eml_node_number(output);
+        return 1;
+    case 1:
+        *result = NULL;
+        return 1;
+    }
+    return -1;
+}
+
+
+/* destroy a compiled procedure */
+void eml_jit_free(struct eml_jit *jit)
+{
+    munmap(jit->code, jit->size);
+    eml_free(EML_MEM_OTHER, jit);
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* compile a list of instructions, returning 0 if it can't be */
+static int compile_list(struct jit *j, struct eml_list *list)
+{
+    struct eml_list_node *cur = list->head;
+    int exits = 0;
+
+    /* what comes after OUTPUT or STOP never runs */
+    while(cur && !exits) {
+        if(!compile_statement(j, &cur, &exits)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* compile an instruction, setting *exits if it always leaves the procedure */
+static int compile_statement(struct jit *j, struct eml_list_node **cur, int *exits)
+{
+    struct eml_node *node = (*cur)->data;
+    struct eml_word *name;
+    int op, top, at, end, i;
+
+    *cur = (*cur)->next;
+    op = node->type == EML_WORD ? lookup_op(j, node->data) : -1;
+    switch(op) {
+    case OP_OUTPUT:
+        if(compile_arg(j, cur) != T_NUM) {
+            return 0;
+        }
+        EMIT(j, ASM_OUTPUT);
+        REL(j, ASM_JMP, RET);
+        *exits = 1;
+        return 1;
+
+    case OP_STOP:
+        EMIT(j, ASM_STOP);
+        REL(j, ASM_JMP, RET);
+        *exits = 1;
+        return 1;
+
+    case OP_IF:
+        if(compile_arg(j, cur) != T_BOOL) {
+            return 0;
+        }
+        EMIT(j, ASM_TEST);
+        at = FORWARD(j, ASM_JE);
+        if(!compile_block(j, cur)) {
+            return 0;
+        }
+        patch(j, at);
+        return 1;
+
+    case OP_IFELSE:
+        if(compile_arg(j, cur) != T_BOOL) {
+            return 0;
+        }
+        EMIT(j, ASM_TEST);
+        at = FORWARD(j, ASM_JE);
+        if(!compile_block(j, cur)) {
+            return 0;
+        }
+        end = FORWARD(j, ASM_JMP);
+        patch(j, at);
+        if(!compile_block(j, cur)) {
+            return 0;
+        }
+        patch(j, end);
+        return 1;
+
+    case OP_REPEAT:
+        /* the count lives in rbx, saving the count of any loop outside */
+        if(compile_arg(j, cur) != T_NUM) {
+            return 0;
+        }
+        if(j->loops) {
+            EMIT(j, ASM_PUSH_RBX);
+            j->depth++;
+        }
+        EMIT(j, ASM_COUNT);
+        top = eml_buf_length(j->code);
+        EMIT(j, ASM_TEST_RBX);
+        at = FORWARD(j, ASM_JLE);
+        j->loops++;
+        if(!compile_block(j, cur)) {
+            return 0;
+        }
+        j->loops--;
+        EMIT(j, ASM_DEC_RBX);
+        REL(j, ASM_JMP, top);
+        patch(j, at);
+        if(j->loops) {
+            EMIT(j, ASM_POP_RBX);
+            j->depth--;
+        }
+        return 1;
+
+    case OP_MAKE:
+        /* only the procedure's own inputs, anything else is seen outside */
+        if(!*cur || ((struct eml_node*) (*cur)->data)->type != EML_WORD) {
+            return 0;
+        }
+        name = ((struct eml_node*) (*cur)->data)->data;
+        *cur = (*cur)->next;
+        if(name->type != WORD || name->field.s[0] != '"'
+           || (i = find_input(j, name->field.s + 1)) < 0
+           || compile_arg(j, cur) != T_NUM) {
+            return 0;
+        }
+        EMIT(j, ASM_STORE);
+        emit_byte(j, SLOT(i));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* compile a list given to a primitive which runs it */
+static int compile_block(struct jit *j, struct eml_list_node **cur)
+{
+    struct eml_node *node;
+
+    if(!*cur || ((struct eml_node*) (*cur)->data)->type != EML_LIST) {
+        return 0;
+    }
+    node = (*cur)->data;
+    *cur = (*cur)->next;
+    return compile_list(j, node->data);
+}
+
+
+/* compile an expression whose infix operators bind tighter than prec */
+static enum jit_type compile_expr(struct jit *j, struct eml_list_node **cur, int prec)
+{
+    enum jit_type a, b;
+    int op, t;
+
+    a = compile_primary(j, cur);
+    while(a && (op = eml_infix_op(*cur, prec)) >= 0) {
+        *cur = (*cur)->next;
+        if(!*cur || (t = find_template(EML_INFIX[op].prim)) < 0) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_PUSH);
+        j->depth++;
+        b = compile_expr(j, cur, EML_INFIX[op].prec);
+        if(!b) {
+            return T_NONE;
+        }
+        a = compile_binary(j, t, a, b);
+    }
+    return a;
+}
+
+
+/* compile a single value, call or input */
+static enum jit_type compile_primary(struct jit *j, struct eml_list_node **cur)
+{
+    struct eml_node *node = (*cur)->data;
+    struct eml_word *w = node->data;
+    double d;
+    int i;
+
+    /* code nested too deeply to compile on the stack is left to the interpreter */
+    if(j->stack - (uintptr_t) &d > COMPILE_STACK) {
+        return T_NONE;
+    }
+
+    *cur = (*cur)->next;
+    if(node->type != EML_WORD) {
+        return T_NONE;
+    }
+
+    /* numbers in the range of integer words */
+    if(w->type == INTEGER || (w->type == FLOAT && w->field.d >= INT_MIN && w->field.d <= INT_MAX)) {
+        d = w->type == INTEGER ? w->field.i : w->field.d;
+        EMIT(j, ASM_MOV_RAX);
+        emit(j, (const char*) &d, sizeof(d));
+        EMIT(j, ASM_RAX_XMM0);
+        return T_NUM;
+    }
+    if(w->type != WORD || w->field.s[0] == '"') {
+        return T_NONE;
+    }
+
+    /* the procedure's inputs, other variables belong to its callers */
+    if(w->field.s[0] == ':') {
+        if((i = find_input(j, w->field.s + 1)) < 0) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_LOAD);
+        emit_byte(j, SLOT(i));
+        return T_NUM;
+    }
+
+    if((i = lookup_op(j, w)) >= 0) {
+        return compile_op(j, i, cur);
+    }
+    if(i == -1 && eml_hashmap_get(j->in->procs, w) == j->proc) {
+        return compile_call(j, cur);
+    }
+    return T_NONE;
+}
+
+
+/* compile a call to a primitive which outputs */
+static enum jit_type compile_op(struct jit *j, enum jit_op op, struct eml_list_node **cur)
+{
+    enum jit_type a, b;
+
+    switch(op) {
+    case OP_MINUS:
+        if(compile_arg(j, cur) != T_NUM) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_MINUS);
+        emit_guard(j);
+        return T_NUM;
+
+    case OP_NOT:
+        if(compile_arg(j, cur) != T_BOOL) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_MOVE);
+        REL(j, ASM_LOAD_CONST, ONE);
+        EMIT(j, ASM_SUB);
+        return T_BOOL;
+
+    case OP_OUTPUT: case OP_STOP: case OP_IF: case OP_IFELSE: case OP_REPEAT: case OP_MAKE:
+        return T_NONE;
+
+    default:
+        if(!(a = compile_arg(j, cur))) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_PUSH);
+        j->depth++;
+        if(!(b = compile_arg(j, cur))) {
+            return T_NONE;
+        }
+        return compile_binary(j, op, a, b);
+    }
+}
+
+
+/* Compile a binary operator, whose first input was pushed and whose
+   second is in xmm0. Results out of range bail out, as do errors. */
+static enum jit_type compile_binary(struct jit *j, enum jit_op op, enum jit_type a, enum jit_type b)
+{
+    double (*rem)(double, double) = fmod;
+
+    EMIT(j, ASM_POP);
+    j->depth--;
+    if(op == OP_EQ ? a != b : a != T_NUM || b != T_NUM) {
+        return T_NONE;
+    }
+
+    switch(op) {
+    case OP_EQ:
+        EMIT(j, ASM_CMP);
+        EMIT(j, ASM_SETE);
+        EMIT(j, ASM_BOOL);
+        return T_BOOL;
+    case OP_LT:
+        EMIT(j, ASM_CMP);
+        EMIT(j, ASM_SETB);
+        EMIT(j, ASM_BOOL);
+        return T_BOOL;
+    case OP_GT:
+        EMIT(j, ASM_CMP);
+        EMIT(j, ASM_SETA);
+        EMIT(j, ASM_BOOL);
+        return T_BOOL;
+    case OP_ADD:
+        EMIT(j, ASM_ADD);
+        break;
+    case OP_SUB:
+        EMIT(j, ASM_SUB);
+        break;
+    case OP_MUL:
+        EMIT(j, ASM_MUL);
+        break;
+    case OP_DIV:
+        EMIT(j, ASM_ZERO);
+        REL(j, ASM_JE, BAIL);
+        EMIT(j, ASM_DIV);
+        break;
+    case OP_REM:
+        /* the same as the remainder of integers, and always in range */
+        EMIT(j, ASM_ZERO);
+        REL(j, ASM_JE, BAIL);
+        if(j->depth % 2) {
+            EMIT(j, ASM_ALIGN);
+        }
+        EMIT(j, ASM_MOV_RAX);
+        emit(j, (const char*) &rem, sizeof(rem));
+        EMIT(j, ASM_CALL_RAX);
+        if(j->depth % 2) {
+            EMIT(j, ASM_UNALIGN);
+        }
+        return T_NUM;
+    default:
+        return T_NONE;
+    }
+
+    emit_guard(j);
+    return T_NUM;
+}
+
+
+/* compile a call of the procedure to itself */
+static enum jit_type compile_call(struct jit *j, struct eml_list_node **cur)
+{
+    int n = j->proc->nargs;
+    int pad = (j->depth + n) % 2;
+    int i;
+
+    /* the inputs go in a block on the stack, which is aligned for the call */
+    if(pad) {
+        EMIT(j, ASM_ALIGN);
+    }
+    if(n) {
+        EMIT(j, ASM_RESERVE);
+        emit_byte(j, 8 * n);
+    }
+    j->depth += pad + n;
+    for(i=0; i<n; i++) {
+        if(compile_arg(j, cur) != T_NUM) {
+            return T_NONE;
+        }
+        EMIT(j, ASM_ARG);
+        emit_byte(j, 8 * i);
+    }
+
+    /* a call which bails or doesn't output, which is an error, bails */
+    EMIT(j, ASM_CALL_ARGS);
+    emit_byte(j, SLOT(n));
+    REL(j, ASM_CALL, ENTRY);
+    EMIT(j, ASM_TEST_EAX);
+    REL(j, ASM_JNE, BAIL);
+    if(pad + n) {
+        EMIT(j, ASM_RELEASE);
+        emit_byte(j, 8 * (pad + n));
+    }
+    j->depth -= pad + n;
+    EMIT(j, ASM_LOAD);
+    emit_byte(j, SLOT(n));
+    return T_NUM;
+}
+
+
+/* compile an input to a call */
+static enum jit_type compile_arg(struct jit *j, struct eml_list_node **cur)
+{
+    return *cur ? compile_expr(j, cur, 0) : T_NONE;
+}
+
+
+/* append bytes to the code */
+static void emit(struct jit *j, const char *bytes, int n)
+{
+    eml_buf_put(&j->code, bytes, n);
+}
+
+
+/* append one byte, an 8 bit operand */
+static void emit_byte(struct jit *j, int b)
+{
+    eml_buf_putc(&j->code, (char) b);
+}
+
+
+/* append an instruction ending in a displacement to an earlier offset */
+static void emit_rel(struct jit *j, const char *bytes, int n, int target)
+{
+    int rel;
+
+    emit(j, bytes, n);
+    rel = target - (eml_buf_length(j->code) + 4);
+    emit(j, (const char*) &rel, sizeof(rel));
+}
+
+
+/* append a jump to a later offset, returning where to patch it */
+static int emit_forward(struct jit *j, const char *bytes, int n)
+{
+    int rel = 0;
+
+    emit(j, bytes, n);
+    emit(j, (const char*) &rel, sizeof(rel));
+    return eml_buf_length(j->code) - 4;
+}
+
+
+/* point the forward jump at the end of the code */
+static void patch(struct jit *j, int at)
+{
+    int rel = eml_buf_length(j->code) - (at + 4);
+
+    memcpy(j->code + at, &rel, sizeof(rel));
+}
+
+
+/* Bail out if xmm0 is outside the range of integer words. Inside it the
+   interpreter's integers and doubles agree; outside it integers become
+   bignums. */
+static void emit_guard(struct jit *j)
+{
+    REL(j, ASM_CMP_CONST, RANGE_MAX);
+    REL(j, ASM_JA, BAIL);
+    REL(j, ASM_CMP_CONST, RANGE_MIN);
+    REL(j, ASM_JB, BAIL);
+}
+
+
+/* The template for the primitive a word names, -1 if it doesn't name one
+   or -2 if it names a primitive there isn't a template for. */
+static int lookup_op(struct jit *j, struct eml_word *w)
+{
+    const struct eml_prim *prim;
+
+    if(w->type != WORD) {
+        return -1;
+    }
+    prim = w->prim ? j->in->prim_ids[w->prim] : eml_hashmap_get(j->in->prims, w);
+    if(!prim) {
+        return -1;
+    }
+    return find_template(prim->name);
+}
+
+
+/* the template for the primitive with the given name, or -2 */
+static int find_template(const char *name)
+{
+    int i;
+
+    for(i=0; i<NPRIMS; i++) {
+        if(strcmp(name, jit_prims[i].name) == 0) {
+            return jit_prims[i].op;
+        }
+    }
+    return -2;
+}
+
+
+/* the number of the procedure's input with the given name, or -1 */
+static int find_input(struct jit *j, const char *name)
+{
+    int i;
+
+    for(i=0; i<j->proc->nargs; i++) {
+        if(strcasecmp(j->proc->params[i]->field.s, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+#else
+/* there are only templates for x86-64, elsewhere everything is interpreted */
+struct eml_jit *eml_jit_compile(struct eml_interp *in, struct eml_proc *proc)
+{
+    return NULL;
+}
+
+
+int eml_jit_call(struct eml_jit *jit, struct eml_node **args, struct eml_node **result)
+{
+    return 0;
+}
+
+
+void eml_jit_free(struct eml_jit *jit)
+{
+}
+#endif
@@ -30,9 +30,11 @@
 #include <string.h>
 #include "lexer.h"
 #include "buf.h"
+#include "alloc.h"
+#include "trace.h"
 
 /* constants */
-const char* STOP_SYM = "[]";
+const char* STOP_SYM = "[]{}";
 
 
 /* helper function prototypes */
@@ -47,7 +49,7 @@ static int stop_word(struct eml_lexer *lex);
 struct eml_lexer* eml_alloc_lexer(eml_getchar getchar)
 {
     /* create the basic structure */
-    struct eml_lexer *lex = malloc(sizeof(struct eml_lexer));
+    struct eml_lexer *lex = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_lexer));
 
     /* initialize the fields */
     lex->line = 1;
@@ -67,7 +69,7 @@ void eml_free_lexer(struct eml_lexer *lex)
     eml_buf_free(lex->buf);
 
     /* finish the job */
-    free(lex);
+    eml_free(EML_MEM_OTHER, lex);
 }
 
 
@@ -93,7 +95,8 @@ struct eml_word* eml_lexer_next(struct eml_lexer *lex)
     } while(!done);
 
     /* null terminate the string */
-    eml_buf_append(lex->buf, "");
+    eml_buf_putc(&lex->buf, '\0');
+    EML_TRACE_INSTANT("token", eml_buf_length(lex->buf) - 1);
 
     return eml_stow(lex->buf);
 }
@@ -143,11 +146,8 @@ static void skip_to_word(struct eml_lexer *lex)
 
 static void consume(struct eml_lexer *lex)
 {
-    char *buf;  /* buffer for reallocation, if needed. */
-    char c = lex->cur;
-
-    /* add the character to the end */
-    eml_buf_nappend(lex->buf, &c, 1);
+    /* add the character to the end, the buffer may move */
+    eml_buf_putc(&lex->buf, lex->cur);
     next_char(lex);
 }
 
@@ -156,8 +156,8 @@ static int stop_word(struct eml_lexer *lex)
 {
     const char *sym = STOP_SYM;
 
-    /* stop on space */
-    if(isspace(lex->cur)) {
+    /* stop on space or the end of input */
+    if(lex->cur == EOF || isspace(lex->cur)) {
         return 1;
     }
 
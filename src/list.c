@@ -26,12 +26,13 @@
  */
 #include <stdlib.h>
 #include "list.h"
+#include "alloc.h"
 
 /************  Static Helper Functions ************************/
 static struct eml_list_node *alloc_node()
 {
     struct eml_list_node *node;
-    node = malloc(sizeof(struct eml_list_node));
+    node = eml_malloc(EML_MEM_LIST, sizeof(struct eml_list_node));
     node->next = NULL;
 
     return node;
@@ -62,7 +63,7 @@ void destroy_node(struct eml_list *l, struct eml_list_node *prev, struct eml_lis
     }
 
     /* destroy the node */
-    free(cur);
+    eml_free(EML_MEM_LIST, cur);
 }
 
 
@@ -70,7 +71,7 @@ void destroy_node(struct eml_list *l, struct eml_list_node *prev, struct eml_lis
 /* create a list */
 struct eml_list *eml_list_alloc()
 {
-    struct eml_list *l = malloc(sizeof(struct eml_list));
+    struct eml_list *l = eml_malloc(EML_MEM_LIST, sizeof(struct eml_list));
 
     l->head = NULL;
     l->tail = NULL;
@@ -88,9 +89,10 @@ void eml_list_free(struct eml_list *l)
     cur = l->head;
     while(cur) {
         next = cur->next;
-        free(cur);
+        eml_free(EML_MEM_LIST, cur);
         cur = next;
     }
+    eml_free(EML_MEM_LIST, l);
 }
 
 
@@ -113,6 +115,21 @@ void eml_list_append(struct eml_list *l, void *data)
 }
 
 
+/* move another list's items onto the end, freeing the other list */
+void eml_list_join(struct eml_list *l, struct eml_list *more)
+{
+    if(more->head) {
+        if(l->tail) {
+            l->tail->next = more->head;
+        } else {
+            l->head = more->head;
+        }
+        l->tail = more->tail;
+    }
+    eml_free(EML_MEM_LIST, more);
+}
+
+
 /* insert an item at the head of a list */
 void eml_list_push(struct eml_list *l, void *data)
 {
@@ -0,0 +1,280 @@
+/*
+ * File: memo.c
+ * Purpose: This is the implementation file for emlogo procedure memoization.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "memo.h"
+#include "alloc.h"
+#include "bignum.h"
+
+/* the longest key; calls with longer inputs are not cached */
+#define KEY_MAX 256
+
+/* buckets in a new cache */
+#define MEMO_INIT_CAP 16
+
+/* helper function prototypes */
+static unsigned int key_hash(const char *bytes, int len);
+static int key_equals(struct eml_memo_key *a, struct eml_memo_key *b);
+static struct eml_memo_entry **find_entry(struct eml_memo *m, struct eml_memo_key *key);
+static void grow(struct eml_memo *m);
+static void free_entry(struct eml_memo_entry *e);
+static void unlink_entry(struct eml_memo *m, struct eml_memo_entry *e);
+static void push_entry(struct eml_memo *m, struct eml_memo_entry *e);
+
+
+/* create an empty cache */
+struct eml_memo *eml_memo_alloc(int limit)
+{
+    struct eml_memo *m = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_memo));
+
+    m->cap = MEMO_INIT_CAP;
+    m->bucket = eml_calloc(EML_MEM_OTHER, m->cap, sizeof(struct eml_memo_entry *));
+    m->limit = limit;
+    return m;
+}
+
+
+/* destroy a cache */
+void eml_memo_free(struct eml_memo *m)
+{
+    eml_memo_clear(m);
+    eml_free(EML_MEM_OTHER, m->bucket);
+    eml_free(EML_MEM_OTHER, m);
+}
+
+
+/* forget every result */
+void eml_memo_clear(struct eml_memo *m)
+{
+    struct eml_memo_entry *e, *next;
+
+    for(e = m->head; e; e = next) {
+        next = e->next;
+        free_entry(e);
+    }
+    m->head = m->tail = NULL;
+    m->size = 0;
+    memset(m->bucket, 0, m->cap * sizeof(struct eml_memo_entry *));
+}
+
+
+/* make a key from the inputs to a call */
+struct eml_memo_key *eml_memo_key(struct eml_node **args, int n)
+{
+    char bytes[KEY_MAX];
+    struct eml_memo_key *key;
+    struct eml_word *w;
+    int len = 0;
+    int i;
+
+    for(i=0; i<n; i++) {
+        if(args[i]->type != EML_WORD) {
+            return NULL;
+        }
+        w = args[i]->data;
+        eml_word_parse(w);
+
+        if(w->type == INTEGER) {
+            len += snprintf(bytes + len, KEY_MAX - len, "n%d", w->field.i);
+        } else if(w->type == FLOAT) {
+            /* enough digits to get the same double back */
+            len += snprintf(bytes + len, KEY_MAX - len, "n%.17g", w->field.d);
+        } else if(w->type == BIGNUM) {
+            len += snprintf(bytes + len, KEY_MAX - len, "n%s", eml_bignum_str(w->field.b));
+        } else {
+            len += snprintf(bytes + len, KEY_MAX - len, "w%s", eml_word_str(w));
+        }
+
+        /* the 0 byte ends each input, so "ab "c and "a "bc differ */
+        if(len >= KEY_MAX - 1) {
+            return NULL;
+        }
+        bytes[len++] = '\0';
+    }
+
+    key = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_memo_key) + len);
+    key->len = len;
+    memcpy(key->bytes, bytes, len);
+    key->hash = key_hash(bytes, len);
+    return key;
+}
+
+
+/* destroy a key */
+void eml_memo_key_free(struct eml_memo_key *key)
+{
+    eml_free(EML_MEM_OTHER, key);
+}
+
+
+/* look up a result */
+struct eml_node *eml_memo_get(struct eml_memo *m, struct eml_memo_key *key)
+{
+    struct eml_memo_entry *e = *find_entry(m, key);
+
+    if(!e) {
+        m->misses++;
+        return NULL;
+    }
+
+    /* it's the most recently used now */
+    m->hits++;
+    if(e != m->head) {
+        unlink_entry(m, e);
+        push_entry(m, e);
+    }
+    return e->value;
+}
+
+
+/* add a result */
+void eml_memo_put(struct eml_memo *m, struct eml_memo_key *key, struct eml_node *value)
+{
+    struct eml_memo_entry **slot = find_entry(m, key);
+    struct eml_memo_entry *e;
+
+    /* a result computed while the call was running */
+    if(*slot) {
+        eml_memo_key_free(key);
+        eml_node_free(value);
+        return;
+    }
+
+    /* make room */
+    if(m->size >= m->limit && m->tail) {
+        e = m->tail;
+        unlink_entry(m, e);
+        *find_entry(m, e->key) = e->chain;
+        free_entry(e);
+        m->size--;
+    }
+    if(m->size >= m->cap) {
+        grow(m);
+    }
+
+    e = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_memo_entry));
+    e->key = key;
+    e->value = value;
+    push_entry(m, e);
+    e->chain = m->bucket[key->hash % m->cap];
+    m->bucket[key->hash % m->cap] = e;
+    m->size++;
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* FNV-1a over the bytes of a key, which unlike word hashes keeps case */
+static unsigned int key_hash(const char *bytes, int len)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for(i=0; i<len; i++) {
+        hash ^= (unsigned char) bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/* returns 1 if two keys hold the same bytes, 0 otherwise */
+static int key_equals(struct eml_memo_key *a, struct eml_memo_key *b)
+{
+    return a->hash == b->hash && a->len == b->len
+        && !memcmp(a->bytes, b->bytes, a->len);
+}
+
+
+/* Find the link to the entry with key in its bucket's chain. The link
+   holds NULL if there isn't one. */
+static struct eml_memo_entry **find_entry(struct eml_memo *m, struct eml_memo_key *key)
+{
+    struct eml_memo_entry **link = m->bucket + key->hash % m->cap;
+
+    while(*link && !key_equals((*link)->key, key)) {
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+
+/* double the number of buckets, moving every entry to its new bucket */
+static void grow(struct eml_memo *m)
+{
+    struct eml_memo_entry *e;
+    int b;
+
+    eml_free(EML_MEM_OTHER, m->bucket);
+    m->cap *= 2;
+    m->bucket = eml_calloc(EML_MEM_OTHER, m->cap, sizeof(struct eml_memo_entry *));
+    for(e = m->head; e; e = e->next) {
+        b = e->key->hash % m->cap;
+        e->chain = m->bucket[b];
+        m->bucket[b] = e;
+    }
+}
+
+
+/* free an entry with its key and value */
+static void free_entry(struct eml_memo_entry *e)
+{
+    eml_memo_key_free(e->key);
+    eml_node_free(e->value);
+    eml_free(EML_MEM_OTHER, e);
+}
+
+
+/* take an entry out of the recently used list */
+static void unlink_entry(struct eml_memo *m, struct eml_memo_entry *e)
+{
+    if(e->prev) {
+        e->prev->next = e->next;
+    } else {
+        m->head = e->next;
+    }
+    if(e->next) {
+        e->next->prev = e->prev;
+    } else {
+        m->tail = e->prev;
+    }
+}
+
+
+/* put an entry at the front of the recently used list */
+static void push_entry(struct eml_memo *m, struct eml_memo_entry *e)
+{
+    e->prev = NULL;
+    e->next = m->head;
+    if(m->head) {
+        m->head->prev = e;
+    } else {
+        m->tail = e;
+    }
+    m->head = e;
+}
@@ -0,0 +1,1041 @@
+/*
+ * File: node.c
+ * Purpose: This is the implementation file for emlogo nodes.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "node.h"
+#include "alloc.h"
+#include "trace.h"
+#include "bignum.h"
+
+/* All of the tree walks in this file use explicit heap stacks rather than
+   the C stack, so machine generated data with huge nesting depths can be
+   parsed, printed, and freed without overflowing. */
+
+#define STACK_INIT_CAP 32
+#define HASHCONS_INIT_CAP 1024
+
+/* FNV-1a steps for the structural hashes */
+#define HASH_INIT 2166136261u
+#define HASH_MIX(h, x) (((h) ^ (x)) * 16777619u)
+
+/* where the writer is in a stream whose rest isn't known yet */
+static struct eml_stream unknown_rest;
+
+/* a simple growable stack of pointers */
+struct ptr_stack {
+    void **item;
+    int size;
+    int cap;
+};
+
+
+/* push an item onto the stack */
+static void stack_push(struct ptr_stack *s, void *p)
+{
+    if(s->size == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : STACK_INIT_CAP;
+        s->item = eml_realloc(EML_MEM_NODE, s->item, s->cap * sizeof(void*));
+    }
+    s->item[s->size++] = p;
+}
+
+
+/* pop an item from the stack */
+static void *stack_pop(struct ptr_stack *s)
+{
+    return s->item[--s->size];
+}
+
+/* array and stream helper prototypes */
+static struct eml_node *share_data(struct eml_node *node);
+static unsigned int identity_hash(struct eml_node *node);
+static struct eml_node *clone_start(struct eml_node *node, struct ptr_stack *stack, int *failed);
+static struct eml_word *number_word(double d);
+static void free_tree(struct eml_node *node, struct ptr_stack *items);
+static void free_leaf(struct eml_node *node, struct ptr_stack *items);
+static struct eml_node *close_list(struct eml_hashcons *table, struct eml_list *list, int open);
+
+/* hash-consing helper prototypes */
+static struct eml_node *share(struct eml_hashcons *table, struct eml_node *node);
+static unsigned int shallow_hash(struct eml_node *node);
+static int shallow_equals(struct eml_node *a, struct eml_node *b);
+static void hashcons_grow(struct eml_hashcons *table);
+
+
+/* allocate a node */
+struct eml_node* eml_node_alloc()
+{
+    return eml_calloc(EML_MEM_NODE, 1, sizeof(struct eml_node));
+}
+
+
+/* wrap a list in a node */
+struct eml_node* eml_node_list(struct eml_list *list)
+{
+    struct eml_node *node = eml_node_alloc();
+    node->type = EML_LIST;
+    node->data = list;
+    return node;
+}
+
+
+/* wrap a word in a node */
+struct eml_node* eml_node_word(struct eml_word *word)
+{
+    struct eml_node *node = eml_node_alloc();
+    node->type = EML_WORD;
+    node->data = word;
+    return node;
+}
+
+
+/* wrap an array in a node */
+struct eml_node* eml_node_array(struct eml_array *array)
+{
+    struct eml_node *node = eml_node_alloc();
+    node->type = EML_ARRAY;
+    node->data = array;
+    return node;
+}
+
+
+/* create a stream with a known first item */
+struct eml_stream *eml_stream_alloc(struct eml_node *first)
+{
+    struct eml_stream *stream = eml_calloc(EML_MEM_NODE, 1, sizeof(struct eml_stream));
+
+    stream->first = first;
+    return stream;
+}
+
+
+/* wrap a stream in a node */
+struct eml_node* eml_node_stream(struct eml_stream *stream)
+{
+    struct eml_node *node = eml_node_alloc();
+    node->type = EML_STREAM;
+    node->data = stream;
+    return node;
+}
+
+
+/* create a word node holding a number */
+struct eml_node *eml_node_number(double d)
+{
+    return eml_node_word(number_word(d));
+}
+
+
+/* create an array of empty lists */
+struct eml_array *eml_array_alloc(int size)
+{
+    struct eml_array *array = eml_calloc(EML_MEM_NODE, 1, sizeof(struct eml_array));
+
+    array->size = size;
+    array->item = eml_calloc(EML_MEM_NODE, size ? size : 1, sizeof(struct eml_node*));
+    return array;
+}
+
+
+/* create a numeric array of zeros */
+struct eml_array *eml_array_numeric(int size)
+{
+    struct eml_array *array = eml_calloc(EML_MEM_NODE, 1, sizeof(struct eml_array));
+
+    array->size = size;
+    array->num = eml_calloc(EML_MEM_NODE, size ? size : 1, sizeof(double));
+    return array;
+}
+
+
+/* create an array holding the same items as another */
+struct eml_array *eml_array_dup(struct eml_array *array)
+{
+    struct eml_array *dup;
+    int i;
+
+    if(array->num) {
+        dup = eml_array_numeric(array->size);
+        memcpy(dup->num, array->num, array->size * sizeof(double));
+        return dup;
+    }
+
+    dup = eml_array_alloc(array->size);
+    for(i=0; i<array->size; i++) {
+        if(array->item[i]) {
+            dup->item[i] = eml_node_copy(array->item[i]);
+        }
+    }
+    return dup;
+}
+
+
+/* create an array of a list's items */
+struct eml_array *eml_array_list(struct eml_list *list)
+{
+    struct eml_list_node *cur;
+    struct eml_array *array;
+    int n = 0;
+
+    for(cur = list->head; cur; cur = cur->next) {
+        n++;
+    }
+    array = eml_array_alloc(n);
+    for(n = 0, cur = list->head; cur; cur = cur->next) {
+        array->item[n++] = cur->data;
+    }
+    eml_list_free(list);
+    return array;
+}
+
+
+/* the value of an item, as a new node */
+struct eml_node *eml_array_get(struct eml_array *array, int i)
+{
+    if(array->num) {
+        return eml_node_number(array->num[i]);
+    }
+    if(!array->item[i]) {
+        return eml_node_list(eml_list_alloc());
+    }
+    return eml_node_copy(array->item[i]);
+}
+
+
+/* replace an item, which the array takes */
+void eml_array_set(struct eml_array *array, int i, struct eml_node *value)
+{
+    struct eml_word *w = value->data;
+    int j;
+
+    if(array->num) {
+        if(value->type == EML_WORD && (w->type == INTEGER || w->type == FLOAT)) {
+            array->num[i] = w->type == INTEGER ? w->field.i : w->field.d;
+            eml_node_free(value);
+            return;
+        }
+
+        /* anything else needs nodes for all of the items */
+        array->item = eml_malloc(EML_MEM_NODE, (array->size ? array->size : 1) * sizeof(struct eml_node*));
+        for(j=0; j<array->size; j++) {
+            array->item[j] = eml_node_number(array->num[j]);
+        }
+        eml_free(EML_MEM_NODE, array->num);
+        array->num = NULL;
+    }
+
+    if(array->item[i]) {
+        eml_node_free(array->item[i]);
+    }
+    array->item[i] = value;
+}
+
+
+/* is the array the node, or anywhere inside it? */
+int eml_node_holds(struct eml_node *node, struct eml_array *array)
+{
+    struct ptr_stack stack = {0};  /* nodes still to look through */
+    struct eml_list_node *cur;
+    struct eml_stream *st;
+    struct eml_array *a;
+    int found = 0;
+    int i;
+
+    for(;;) {
+        if(node->type == EML_LIST) {
+            for(cur = ((struct eml_list*)node->data)->head; cur; cur = cur->next) {
+                stack_push(&stack, cur->data);
+            }
+        } else if(node->type == EML_ARRAY) {
+            a = node->data;
+            if(a == array) {
+                found = 1;
+                break;
+            }
+            for(i=0; a->item && i<a->size; i++) {
+                if(a->item[i]) {
+                    stack_push(&stack, a->item[i]);
+                }
+            }
+        } else if(node->type == EML_STREAM) {
+            st = node->data;
+            stack_push(&stack, st->first);
+            if(st->rest) {
+                stack_push(&stack, st->rest);
+            }
+            if(st->src) {
+                stack_push(&stack, st->src);
+            }
+        }
+
+        if(!stack.size) {
+            break;
+        }
+        node = stack_pop(&stack);
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    return found;
+}
+
+
+/* make a deep copy of a node */
+struct eml_node* eml_node_copy(struct eml_node *node)
+{
+    struct ptr_stack stack = {0};  /* (position, list) of enclosing lists */
+    struct eml_list_node *cur;
+    struct eml_list *list;
+    struct eml_node *result, *copy;
+
+    if(node->refs) {
+        node->refs++;
+        return node;
+    }
+    if(node->type == EML_WORD) {
+        return eml_node_word(eml_word_copy(node->data));
+    }
+    if(node->type != EML_LIST) {
+        return share_data(node);
+    }
+
+    list = eml_list_alloc();
+    result = eml_node_list(list);
+    cur = ((struct eml_list*)node->data)->head;
+    for(;;) {
+        /* finished a list, resume its parent */
+        if(!cur) {
+            if(!stack.size) {
+                break;
+            }
+            list = stack_pop(&stack);
+            cur = stack_pop(&stack);
+            continue;
+        }
+
+        node = cur->data;
+        cur = cur->next;
+        if(node->refs) {
+            node->refs++;
+            eml_list_append(list, node);
+        } else if(node->type == EML_WORD) {
+            eml_list_append(list, eml_node_word(eml_word_copy(node->data)));
+        } else if(node->type != EML_LIST) {
+            eml_list_append(list, share_data(node));
+        } else {
+            copy = eml_node_list(eml_list_alloc());
+            eml_list_append(list, copy);
+            stack_push(&stack, cur);
+            stack_push(&stack, list);
+            list = copy->data;
+            cur = ((struct eml_list*)node->data)->head;
+        }
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    return result;
+}
+
+
+/* copy a node so the copy shares nothing with it, changing nothing in it */
+struct eml_node *eml_node_clone(struct eml_node *node)
+{
+    struct ptr_stack stack = {0};  /* (original, copy) of lists and arrays still to fill */
+    struct eml_list_node *cur;
+    struct eml_array *array, *copy_array;
+    struct eml_node *result, *copy;
+    int failed = 0;
+    int i;
+
+    result = clone_start(node, &stack, &failed);
+    while(stack.size) {
+        copy = stack_pop(&stack);
+        node = stack_pop(&stack);
+        if(node->type == EML_LIST) {
+            for(cur = ((struct eml_list*)node->data)->head; cur; cur = cur->next) {
+                eml_list_append(copy->data, clone_start(cur->data, &stack, &failed));
+            }
+        } else {
+            array = node->data;
+            copy_array = copy->data;
+            for(i=0; i<array->size; i++) {
+                if(array->item[i]) {
+                    copy_array->item[i] = clone_start(array->item[i], &stack, &failed);
+                }
+            }
+        }
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    if(failed) {
+        eml_node_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+
+/* destroy a node and the thing it points to */
+void eml_node_free(struct eml_node *node)
+{
+    struct ptr_stack items = {0};  /* what freed arrays and streams held, still to free */
+
+    /* shared nodes belong to someone else too */
+    if(node->refs) {
+        node->refs--;
+        return;
+    }
+
+    /* words need no traversal */
+    if(node->type == EML_WORD) {
+        eml_free_word(node->data);
+        eml_free(EML_MEM_NODE, node);
+        return;
+    }
+
+    free_tree(node, &items);
+    while(items.size) {
+        free_tree(stack_pop(&items), &items);
+    }
+    eml_free(EML_MEM_NODE, items.item);
+}
+
+
+/* structural hash of a node */
+unsigned int eml_node_hash(struct eml_node *node)
+{
+    struct ptr_stack stack = {0};
+    struct eml_list_node *cur;
+    unsigned int hash = HASH_INIT;
+
+    if(node->type == EML_WORD) {
+        return ((struct eml_word*) node->data)->hash;
+    }
+    if(node->type != EML_LIST) {
+        return identity_hash(node);
+    }
+
+    /* hash the words in order, along with where each list opens and closes */
+    hash = HASH_MIX(hash, '[');
+    cur = ((struct eml_list*)node->data)->head;
+    for(;;) {
+        if(!cur) {
+            hash = HASH_MIX(hash, ']');
+            if(!stack.size) {
+                break;
+            }
+            cur = stack_pop(&stack);
+            continue;
+        }
+
+        node = cur->data;
+        cur = cur->next;
+        if(node->type == EML_WORD) {
+            hash = HASH_MIX(hash, ((struct eml_word*) node->data)->hash);
+        } else if(node->type != EML_LIST) {
+            hash = HASH_MIX(hash, identity_hash(node));
+        } else {
+            hash = HASH_MIX(hash, '[');
+            stack_push(&stack, cur);
+            cur = ((struct eml_list*)node->data)->head;
+        }
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    return hash;
+}
+
+
+/* compare the structure and words of two nodes */
+int eml_node_equals(struct eml_node *a, struct eml_node *b)
+{
+    struct ptr_stack stack = {0};  /* (a, b) positions in enclosing lists */
+    struct eml_list_node *ca, *cb;
+    int equal = 1;
+
+    if(a->type != b->type) {
+        return 0;
+    }
+    if(a->type == EML_WORD) {
+        return eml_word_equals(a->data, b->data);
+    }
+    if(a->type != EML_LIST) {
+        return a->data == b->data;
+    }
+
+    ca = ((struct eml_list*)a->data)->head;
+    cb = ((struct eml_list*)b->data)->head;
+    for(;;) {
+        /* finished a pair of lists, they must end together */
+        if(!ca || !cb) {
+            if(ca != cb) {
+                equal = 0;
+                break;
+            }
+            if(!stack.size) {
+                break;
+            }
+            cb = stack_pop(&stack);
+            ca = stack_pop(&stack);
+            continue;
+        }
+
+        a = ca->data;
+        b = cb->data;
+        ca = ca->next;
+        cb = cb->next;
+
+        /* shared nodes are equal to themselves */
+        if(a == b) {
+            continue;
+        }
+        if(a->type != b->type) {
+            equal = 0;
+            break;
+        }
+        if(a->type == EML_WORD) {
+            if(!eml_word_equals(a->data, b->data)) {
+                equal = 0;
+                break;
+            }
+        } else if(a->type != EML_LIST) {
+            if(a->data != b->data) {
+                equal = 0;
+                break;
+            }
+        } else {
+            stack_push(&stack, ca);
+            stack_push(&stack, cb);
+            ca = ((struct eml_list*)a->data)->head;
+            cb = ((struct eml_list*)b->data)->head;
+        }
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    return equal;
+}
+
+
+/* print a node */
+void eml_node_print(struct eml_node *node)
+{
+    eml_node_fprint(stdout, node);
+}
+
+
+/* print a node to the given stream */
+void eml_node_fprint(FILE *out, struct eml_node *node)
+{
+    struct eml_writer *w = eml_writer_file(out);
+
+    eml_node_write(w, node);
+    eml_writer_free(w);
+}
+
+
+/* write a node */
+void eml_node_write(struct eml_writer *w, struct eml_node *node)
+{
+    struct ptr_stack stack = {0};  /* (list, array or stream, position) of enclosing ones */
+    struct eml_node *outer = NULL; /* the list, array or stream being written */
+    void *pos = NULL;              /* its next list node, index or stream */
+    struct eml_array *array;
+    struct eml_stream *stream;
+    struct eml_word *word;
+    intptr_t i;
+
+    if(node->type == EML_WORD) {
+        eml_writer_word(w, node->data);
+        eml_writer_char(w, ' ');
+        return;
+    }
+
+    /* walk the tree, keeping the position in each enclosing list, array or stream */
+    for(;;) {
+        if(!node) {
+            /* an empty item of an array */
+            eml_writer_bytes(w, "[ ] ", 4);
+        } else if(node->type == EML_WORD) {
+            eml_writer_word(w, node->data);
+            eml_writer_char(w, ' ');
+        } else if(node->type == EML_LIST || node->type == EML_STREAM) {
+            eml_writer_bytes(w, "[ ", 2);
+            stack_push(&stack, outer);
+            stack_push(&stack, pos);
+            outer = node;
+            if(node->type == EML_LIST) {
+                pos = ((struct eml_list*)node->data)->head;
+            } else {
+                pos = node->data;
+            }
+        } else if((array = node->data)->num) {
+            /* numeric arrays hold nothing to descend into */
+            eml_writer_bytes(w, "{ ", 2);
+            for(i=0; i<array->size; i++) {
+                word = number_word(array->num[i]);
+                eml_writer_word(w, word);
+                eml_writer_char(w, ' ');
+                eml_free_word(word);
+            }
+            eml_writer_bytes(w, "} ", 2);
+        } else {
+            eml_writer_bytes(w, "{ ", 2);
+            stack_push(&stack, outer);
+            stack_push(&stack, pos);
+            outer = node;
+            pos = (void*) 0;
+        }
+
+        /* move on to the next item, closing what has run out */
+        for(;;) {
+            if(!outer) {
+                eml_free(EML_MEM_NODE, stack.item);
+                return;
+            }
+            if(outer->type == EML_LIST && pos) {
+                node = ((struct eml_list_node*) pos)->data;
+                pos = ((struct eml_list_node*) pos)->next;
+                break;
+            }
+            array = outer->data;
+            if(outer->type == EML_ARRAY && (i = (intptr_t) pos) < array->size) {
+                node = array->item[i];
+                pos = (void*) (i + 1);
+                break;
+            }
+
+            /* a stream goes on for as long as its rest is known */
+            stream = pos;
+            if(outer->type == EML_STREAM && stream && stream != &unknown_rest) {
+                node = stream->first;
+                if(!stream->rest) {
+                    pos = &unknown_rest;
+                } else if(stream->rest->type == EML_STREAM) {
+                    pos = stream->rest->data;
+                } else {
+                    pos = NULL;
+                }
+                break;
+            }
+            if(stream == &unknown_rest) {
+                eml_writer_bytes(w, "... ", 4);
+            }
+
+            eml_writer_bytes(w, outer->type == EML_ARRAY ? "} " : "] ", 2);
+            pos = stack_pop(&stack);
+            outer = stack_pop(&stack);
+        }
+    }
+}
+
+
+/* parse the words from the lexer into a list node */
+struct eml_node* eml_node_parse(struct eml_lexer *lex, eml_refill refill)
+{
+    return eml_node_parse_shared(lex, refill, NULL);
+}
+
+
+/* parse, sharing identical words and sublists through the table */
+struct eml_node* eml_node_parse_shared(struct eml_lexer *lex, eml_refill refill, struct eml_hashcons *table)
+{
+    struct ptr_stack stack = {0};  /* enclosing open lists, and what opened each */
+    struct eml_list *list;
+    struct eml_node *node;
+    struct eml_word *word;
+    intptr_t open = 0;             /* the token which opened list */
+
+    EML_TRACE_BEGIN("parse", 0);
+    list = eml_list_alloc();
+    for(;;) {
+        word = eml_lexer_next(lex);
+
+        /* handle the end of input */
+        if(!word) {
+            if(!stack.size) {
+                break;
+            }
+            if(refill && refill()) {
+                continue;
+            }
+
+            /* no more input, so close everything that is open */
+            while(stack.size) {
+                EML_TRACE_INSTANT("list parsed", stack.size / 2);
+                node = close_list(table, list, open);
+                open = (intptr_t) stack_pop(&stack);
+                list = stack_pop(&stack);
+                eml_list_append(list, node);
+            }
+            break;
+        }
+
+        if(word->type != TOKEN) {
+            eml_list_append(list, share(table, eml_node_word(word)));
+            continue;
+        }
+
+        /* open and close lists and arrays, by whichever closer comes */
+        if(word->field.s[0] == '[' || word->field.s[0] == '{') {
+            stack_push(&stack, list);
+            stack_push(&stack, (void*) open);
+            list = eml_list_alloc();
+            open = word->field.s[0];
+        } else if(word->field.s[0] == ']' || word->field.s[0] == '}') {
+            /* TODO: Handle error on unexpected ] */
+            if(!stack.size) {
+                eml_free_word(word);
+                break;
+            }
+            EML_TRACE_INSTANT("list parsed", stack.size / 2);
+            node = close_list(table, list, open);
+            open = (intptr_t) stack_pop(&stack);
+            list = stack_pop(&stack);
+            eml_list_append(list, node);
+        }
+        eml_free_word(word);
+    }
+
+    eml_free(EML_MEM_NODE, stack.item);
+    EML_TRACE_END("parse");
+    return eml_node_list(list);
+}
+
+
+/* create an empty hash-consing table */
+struct eml_hashcons *eml_hashcons_alloc()
+{
+    struct eml_hashcons *table = eml_calloc(EML_MEM_NODE, 1, sizeof(struct eml_hashcons));
+
+    table->cap = HASHCONS_INIT_CAP;
+    table->slot = eml_calloc(EML_MEM_NODE, table->cap, sizeof(struct eml_hashcons_slot));
+    return table;
+}
+
+
+/* destroy a table, releasing its references */
+void eml_hashcons_free(struct eml_hashcons *table)
+{
+    int i;
+
+    for(i=0; i<table->cap; i++) {
+        if(table->slot[i].node) {
+            eml_node_free(table->slot[i].node);
+        }
+    }
+    eml_free(EML_MEM_NODE, table->slot);
+    eml_free(EML_MEM_NODE, table);
+}
+
+
+/******************************************
+ * Array and stream helpers
+ ******************************************/
+/* another node holding a node's array or stream */
+static struct eml_node *share_data(struct eml_node *node)
+{
+    if(node->type == EML_ARRAY) {
+        ((struct eml_array*) node->data)->refs++;
+        return eml_node_array(node->data);
+    }
+    ((struct eml_stream*) node->data)->refs++;
+    return eml_node_stream(node->data);
+}
+
+
+/* hash an array or stream by its identity */
+static unsigned int identity_hash(struct eml_node *node)
+{
+    return HASH_MIX(HASH_MIX(HASH_INIT, '{'), (unsigned int) ((uintptr_t) node->data >> 4));
+}
+
+
+/* Start cloning a node. Words and numeric arrays are copied whole, but
+   lists and arrays of nodes are left on the stack with their empty copies,
+   to be filled in. A stream can't be cloned, so it sets failed and leaves
+   an empty list in its place. */
+static struct eml_node *clone_start(struct eml_node *node, struct ptr_stack *stack, int *failed)
+{
+    struct eml_array *array, *copy_array;
+    struct eml_node *copy;
+
+    if(node->type == EML_WORD) {
+        return eml_node_word(eml_word_clone(node->data));
+    } else if(node->type == EML_STREAM) {
+        *failed = 1;
+        return eml_node_list(eml_list_alloc());
+    } else if(node->type == EML_ARRAY) {
+        array = node->data;
+        if(array->num) {
+            copy_array = eml_array_numeric(array->size);
+            memcpy(copy_array->num, array->num, array->size * sizeof(double));
+            return eml_node_array(copy_array);
+        }
+        copy = eml_node_array(eml_array_alloc(array->size));
+    } else {
+        copy = eml_node_list(eml_list_alloc());
+    }
+
+    stack_push(stack, node);
+    stack_push(stack, copy);
+    return copy;
+}
+
+
+/* a word holding a number, an integer when it is a whole one */
+static struct eml_word *number_word(double d)
+{
+    if(d >= INT_MIN && d <= INT_MAX && d == (int) d) {
+        return eml_itow((int) d);
+    }
+    return eml_dtow(d);
+}
+
+
+/* Free a node and everything under it, except that what is held by
+   arrays and streams which no other node holds is pushed onto items, to be
+   freed later. That keeps nested arrays and long streams from recursing. */
+static void free_tree(struct eml_node *node, struct ptr_stack *items)
+{
+    struct eml_list_node *work, *cur;
+    struct eml_list *list;
+
+    if(node->refs) {
+        node->refs--;
+        return;
+    }
+    if(node->type != EML_LIST) {
+        free_leaf(node, items);
+        return;
+    }
+
+    /* The list nodes themselves serve as the work list. Each sublist we
+       meet has its chain spliced onto the front of the work list, so no
+       extra memory is needed no matter how deep the tree goes. */
+    list = node->data;
+    work = list->head;
+    eml_free(EML_MEM_LIST, list);
+    eml_free(EML_MEM_NODE, node);
+    while(work) {
+        cur = work;
+        work = cur->next;
+        node = cur->data;
+
+        if(node->refs) {
+            node->refs--;
+        } else if(node->type == EML_LIST) {
+            list = node->data;
+            if(list->head) {
+                list->tail->next = work;
+                work = list->head;
+            }
+            eml_free(EML_MEM_LIST, list);
+            eml_free(EML_MEM_NODE, node);
+        } else {
+            free_leaf(node, items);
+        }
+        eml_free(EML_MEM_LIST, cur);
+    }
+}
+
+
+/* free a word node, or an array or stream node along with its array or
+   stream once no other node holds it */
+static void free_leaf(struct eml_node *node, struct ptr_stack *items)
+{
+    struct eml_array *array = node->data;
+    struct eml_stream *stream = node->data;
+    struct eml_node *item;
+    int i;
+
+    if(node->type == EML_WORD) {
+        eml_free_word(node->data);
+    } else if(node->type == EML_STREAM) {
+        if(stream->refs) {
+            stream->refs--;
+        } else {
+            /* a long stream is freed a cell at a time through items */
+            stack_push(items, stream->first);
+            if(stream->rest) {
+                stack_push(items, stream->rest);
+            }
+            if(stream->fn) {
+                stack_push(items, stream->fn);
+            }
+            if(stream->src) {
+                stack_push(items, stream->src);
+            }
+            eml_free(EML_MEM_NODE, stream);
+        }
+    } else if(array->refs) {
+        array->refs--;
+    } else {
+        for(i=0; array->item && i<array->size; i++) {
+            /* unshared words are freed on the spot, the rest wait */
+            item = array->item[i];
+            if(item && !item->refs && item->type == EML_WORD) {
+                eml_free_word(item->data);
+                eml_free(EML_MEM_NODE, item);
+            } else if(item) {
+                stack_push(items, item);
+            }
+        }
+        eml_free(EML_MEM_NODE, array->item);
+        eml_free(EML_MEM_NODE, array->num);
+        eml_free(EML_MEM_NODE, array);
+    }
+    eml_free(EML_MEM_NODE, node);
+}
+
+
+/* Finish a parsed list, as an array if a brace opened it. Arrays are never
+   shared, since they may be changed. */
+static struct eml_node *close_list(struct eml_hashcons *table, struct eml_list *list, int open)
+{
+    if(open != '{') {
+        return share(table, eml_node_list(list));
+    }
+    return eml_node_array(eml_array_list(list));
+}
+
+
+/******************************************
+ * Hash-consing
+ ******************************************/
+/* Children are shared before their parents, so two lists are the same
+   exactly when their children are the same nodes. That keeps hashing and
+   comparing each list down to one pass over its own elements. */
+
+/* Swap a freshly parsed node for the shared one like it, or make it the
+   shared one. Does nothing without a table. */
+static struct eml_node *share(struct eml_hashcons *table, struct eml_node *node)
+{
+    unsigned int hash;
+    int i;
+
+    if(!table) {
+        return node;
+    }
+
+    if(table->size * 2 >= table->cap) {
+        hashcons_grow(table);
+    }
+
+    table->nodes++;
+    hash = shallow_hash(node);
+    for(i = hash & (table->cap - 1); table->slot[i].node; i = (i + 1) & (table->cap - 1)) {
+        if(table->slot[i].hash == hash && shallow_equals(table->slot[i].node, node)) {
+            table->shared++;
+            table->slot[i].node->refs++;
+            eml_node_free(node);
+            return table->slot[i].node;
+        }
+    }
+
+    /* the table is one owner, the parent is the other */
+    table->slot[i].hash = hash;
+    table->slot[i].node = node;
+    table->size++;
+    node->refs++;
+    return node;
+}
+
+
+/* hash a word, or a list by the identity of its children */
+static unsigned int shallow_hash(struct eml_node *node)
+{
+    struct eml_list_node *cur;
+    struct eml_word *w;
+    unsigned int hash = HASH_INIT;
+
+    if(node->type == EML_WORD) {
+        w = node->data;
+        return HASH_MIX(w->hash, w->type);
+    }
+
+    hash = HASH_MIX(hash, '[');
+    for(cur = ((struct eml_list*)node->data)->head; cur; cur = cur->next) {
+        hash = HASH_MIX(hash, (unsigned int) ((uintptr_t) cur->data >> 4));
+    }
+    return hash;
+}
+
+
+/* compare words exactly, or lists by the identity of their children */
+static int shallow_equals(struct eml_node *a, struct eml_node *b)
+{
+    struct eml_list_node *ca, *cb;
+    struct eml_word *wa, *wb;
+
+    if(a->type != b->type) {
+        return 0;
+    }
+
+    if(a->type == EML_WORD) {
+        wa = a->data;
+        wb = b->data;
+        if(wa->type != wb->type) {
+            return 0;
+        } else if(wa->type == INTEGER) {
+            return wa->field.i == wb->field.i;
+        } else if(wa->type == FLOAT) {
+            /* bitwise, so 0 and -0 stay apart */
+            return memcmp(&wa->field.d, &wb->field.d, sizeof(double)) == 0;
+        } else if(wa->type == BIGNUM) {
+            return eml_bignum_cmp(wa->field.b, wb->field.b) == 0;
+        }
+        return strcmp(eml_word_str(wa), eml_word_str(wb)) == 0;
+    }
+
+    ca = ((struct eml_list*)a->data)->head;
+    cb = ((struct eml_list*)b->data)->head;
+    while(ca && cb && ca->data == cb->data) {
+        ca = ca->next;
+        cb = cb->next;
+    }
+    return !ca && !cb;
+}
+
+
+/* double the size of the table */
+static void hashcons_grow(struct eml_hashcons *table)
+{
+    struct eml_hashcons_slot *old = table->slot;
+    int ocap = table->cap;
+    int i, j;
+
+    table->cap *= 2;
+    table->slot = eml_calloc(EML_MEM_NODE, table->cap, sizeof(struct eml_hashcons_slot));
+    for(i=0; i<ocap; i++) {
+        if(old[i].node) {
+            for(j = old[i].hash & (table->cap - 1); table->slot[j].node; j = (j + 1) & (table->cap - 1));
+            table->slot[j] = old[i];
+        }
+    }
+    eml_free(EML_MEM_NODE, old);
+}
@@ -0,0 +1,912 @@
+/*
+ * File: optimize.c
+ * Purpose: This is the implementation file for the emlogo optimizer.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <string.h>
+#include <strings.h>
+#include "optimize.h"
+#include "alloc.h"
+#include "buf.h"
+
+/* the C stack parsing may use, which the passes over what it parses can
+   use a few times over, before an instruction is left unoptimized */
+#define OPT_STACK (64 * 1024)
+
+/* how calls to a procedure may be inlined */
+#define INLINE_NONE 0
+#define INLINE_OUTPUT 1     /* its body outputs an expression, which replaces the call */
+#define INLINE_COMMANDS 2   /* its body is commands, which replace the instruction */
+
+/* the inputs of a name the list defines differently than it is defined now */
+#define UNKNOWN_INPUTS (EML_MAX_ARGS + 2)
+
+/* where an expression is, for what may take its place */
+#define FOLLOWED 1          /* an infix operator comes after it */
+#define OPERAND 2           /* it is the right side of an infix operator */
+
+/* an expression, parsed as the interpreter evaluates it */
+enum expr_kind {LEAF, CALL, INFIX};
+struct expr {
+    enum expr_kind kind;
+    struct eml_node *node;          /* the value, the name called or the operator */
+    const struct eml_prim *prim;    /* CALL: the primitive called, if it is one */
+    struct eml_proc *proc;          /* CALL: the procedure called, if it is one */
+    int op;                         /* INFIX: which operator */
+    int nargs;
+    struct expr *arg[EML_MAX_ARGS]; /* the inputs, or the two operands */
+};
+
+/* an optimization in progress */
+struct opt {
+    struct eml_interp *in;
+    int flags;                              /* EML_OPT_* */
+    const struct eml_prim *infix[EML_NINFIX]; /* the primitive for each operator */
+    struct eml_hashmap *defined;    /* name -> inputs + 1, for procedures the list defines */
+    struct eml_proc *callee;        /* the procedure being inlined, if one is */
+    struct expr **inputs;           /* what goes in place of its inputs */
+    int uses[EML_MAX_ARGS];         /* and how many times each went in */
+    uintptr_t stack;                /* where the C stack was when it began */
+};
+
+/* helper function prototypes */
+static void opt_init(struct opt *o, struct eml_interp *in);
+static struct eml_list *opt_list(struct opt *o, struct eml_list *list, int *exits);
+static void statement(struct opt *o, struct expr *e, struct eml_list *out, int *exits);
+static struct expr *opt_expr(struct opt *o, struct expr *e, int where);
+static struct expr *opt_arg(struct opt *o, struct expr *e, int i, int where);
+static struct expr *substitute(struct opt *o, struct expr *e);
+static struct expr *fold(struct opt *o, struct expr *e, const struct eml_prim *prim);
+static struct expr *inline_output(struct opt *o, struct expr *e, int where);
+static int inline_commands(struct opt *o, struct expr *e, struct eml_list *out);
+static int inlinable(struct opt *o, struct expr *e, int kind);
+static void inline_begin(struct opt *sub, struct opt *o, struct expr *e);
+static int inputs_used(struct opt *sub, struct expr *e);
+static struct expr *to_prefix(struct opt *o, struct expr *e);
+static int inline_kind(struct opt *o, struct eml_list *code);
+static int safe_list(struct opt *o, struct eml_list *list);
+static int safe_command(struct opt *o, struct expr *e);
+static int pure_expr(struct expr *e);
+static int count_nodes(struct eml_node *node, int limit);
+static void find_defs(struct opt *o, struct eml_node *list);
+static struct expr *parse_expr(struct opt *o, struct eml_list_node **cur, int prec);
+static struct expr *parse_primary(struct opt *o, struct eml_list_node **cur);
+static const struct eml_prim *lookup_prim(struct eml_interp *in, struct eml_word *w);
+static int is_const(struct expr *e);
+static int is_list(struct expr *e);
+static struct eml_node *const_value(struct expr *e);
+static struct expr *value_leaf(struct eml_node *value);
+static int const_bool(struct expr *e, int *b);
+static int is_word(struct eml_node *node, const char *s);
+static int is_prim(struct expr *e, const char *name);
+static struct expr *expr_alloc(enum expr_kind kind, struct eml_node *node);
+static void expr_free(struct expr *e);
+static void emit(struct expr *e, struct eml_list *out);
+static void splice(struct eml_list *out, struct eml_list *list);
+static struct eml_node *share(struct eml_node *node);
+
+
+/* optimize a list of instructions */
+struct eml_node *eml_optimize(struct eml_interp *in, struct eml_node *list)
+{
+    struct eml_list *result;
+    struct opt o;
+    int exits;
+
+    opt_init(&o, in);
+    o.defined = eml_hashmap_alloc();
+    find_defs(&o, list);
+    result = opt_list(&o, list->data, &exits);
+    eml_hashmap_free(o.defined);
+    return eml_node_list(result);
+}
+
+
+/* run a list, optimizing a stretch at a time */
+int eml_optimize_run(struct eml_interp *in, struct eml_node *list)
+{
+    struct eml_list_node *cur = ((struct eml_list*) list->data)->head;
+    struct eml_node *part, *opt;
+    int to;
+
+    while(cur && !in->error) {
+        /* a definition, through its END, or everything up to the next */
+        part = eml_node_list(eml_list_alloc());
+        to = is_word(cur->data, "to");
+        do {
+            eml_list_append(part->data, share(cur->data));
+            cur = cur->next;
+        } while(cur && (to ? !is_word(((struct eml_list*) part->data)->tail->data, "end")
+                           : !is_word(cur->data, "to")));
+
+        if(to) {
+            eml_interp_run(in, part->data);
+        } else {
+            opt = eml_optimize(in, part);
+            eml_interp_run(in, opt->data);
+            eml_node_free(opt);
+        }
+        eml_node_free(part);
+    }
+
+    return in->error ? -1 : 0;
+}
+
+
+/* make a procedure's optimized body */
+void eml_optimize_proc(struct eml_interp *in, struct eml_proc *proc)
+{
+    struct opt o;
+    int exits;
+
+    if(proc->code) {
+        eml_node_free(proc->code);
+        proc->code = NULL;
+    }
+
+    /* marked up to date first, so that a recursive call isn't inlined */
+    proc->optimized = in->generation;
+    proc->inline_kind = INLINE_NONE;
+    if(!in->optimize) {
+        return;
+    }
+
+    opt_init(&o, in);
+    proc->code = eml_node_list(opt_list(&o, proc->body->data, &exits));
+    if(o.flags & EML_OPT_INLINE && count_nodes(proc->body, EML_INLINE_MAX + 1) <= EML_INLINE_MAX) {
+        proc->inline_kind = inline_kind(&o, proc->code->data);
+    }
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* start an optimization with the interpreter's passes */
+static void opt_init(struct opt *o, struct eml_interp *in)
+{
+    struct eml_word *w;
+    int i;
+
+    memset(o, 0, sizeof(*o));
+    o->in = in;
+    o->stack = (uintptr_t) o;
+    o->flags = in->optimize;
+    for(i=0; i<EML_NINFIX; i++) {
+        w = eml_stow((char*) EML_INFIX[i].prim);
+        o->infix[i] = lookup_prim(in, w);
+        eml_free_word(w);
+    }
+}
+
+
+/* Optimize a list of instructions, returning the new one. exits is set
+   if the list ends the procedure, and nothing after it can run. */
+static struct eml_list *opt_list(struct opt *o, struct eml_list *list, int *exits)
+{
+    struct eml_list *out = eml_list_alloc();
+    struct eml_list_node *cur = list->head, *start;
+    struct expr *e;
+
+    *exits = 0;
+    while(cur && !*exits) {
+        /* definitions are optimized when they are called */
+        if(is_word(cur->data, "to")) {
+            eml_list_append(out, share(cur->data));
+            cur = cur->next;
+            if(cur) {
+                eml_list_append(out, share(cur->data));
+                cur = cur->next;
+            }
+            while(cur) {
+                eml_list_append(out, share(cur->data));
+                cur = cur->next;
+                if(is_word(out->tail->data, "end")) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        /* past a call to something unknown, there's no telling where
+           instructions begin and end */
+        start = cur;
+        e = parse_expr(o, &cur, 0);
+        if(!e) {
+            for(cur = start; cur; cur = cur->next) {
+                eml_list_append(out, share(cur->data));
+            }
+            break;
+        }
+        statement(o, e, out, exits);
+    }
+
+    return out;
+}
+
+
+/* optimize an instruction onto the end of out */
+static void statement(struct opt *o, struct expr *e, struct eml_list *out, int *exits)
+{
+    struct expr *chosen = NULL;
+    int b, i;
+
+    /* IF and IFELSE of a constant are replaced by what they would run */
+    if(o->flags & EML_OPT_DEAD && (is_prim(e, "if") || is_prim(e, "ifelse"))) {
+        e->arg[0] = opt_expr(o, e->arg[0], 0);
+        if(const_bool(e->arg[0], &b) && is_list(e->arg[1]) && (e->nargs < 3 || is_list(e->arg[2]))) {
+            if(b) {
+                chosen = e->arg[1];
+            } else if(e->nargs == 3) {
+                chosen = e->arg[2];
+            }
+            if(chosen) {
+                splice(out, opt_list(o, chosen->node->data, exits));
+            }
+            expr_free(e);
+            return;
+        }
+        for(i=1; i<e->nargs; i++) {
+            e->arg[i] = opt_arg(o, e, i, 0);
+        }
+    } else {
+        e = opt_expr(o, e, 0);
+    }
+
+    if(o->flags & EML_OPT_INLINE && e->kind == CALL && e->proc && inline_commands(o, e, out)) {
+        expr_free(e);
+        return;
+    }
+
+    /* nothing after STOP or OUTPUT runs */
+    *exits = o->flags & EML_OPT_DEAD && e->kind == CALL && e->prim && e->prim->flags & EML_PRIM_EXIT;
+    emit(e, out);
+    expr_free(e);
+}
+
+
+/* Optimize an expression, returning what replaces it. where says what
+   is around it: an infix operator after it would take the last input of
+   a call put in its place, and one before it would regroup an infix
+   expression put in its place. */
+static struct expr *opt_expr(struct opt *o, struct expr *e, int where)
+{
+    int i;
+
+    if(e->kind == LEAF) {
+        return substitute(o, e);
+    }
+    if(e->kind == INFIX) {
+        e->arg[0] = opt_expr(o, e->arg[0], FOLLOWED);
+        e->arg[1] = opt_expr(o, e->arg[1], OPERAND | (where & FOLLOWED));
+        return o->flags & EML_OPT_FOLD ? fold(o, e, o->infix[e->op]) : e;
+    }
+
+    for(i=0; i<e->nargs; i++) {
+        e->arg[i] = opt_arg(o, e, i, i == e->nargs - 1 ? where & FOLLOWED : 0);
+    }
+    if(o->flags & EML_OPT_FOLD && e->prim && e->prim->flags & EML_PRIM_PURE) {
+        return fold(o, e, e->prim);
+    }
+    if(o->flags & EML_OPT_INLINE && e->proc) {
+        return inline_output(o, e, where);
+    }
+    return e;
+}
+
+
+/* optimize an input to a call, where lists given to control primitives
+   are instructions */
+static struct expr *opt_arg(struct opt *o, struct expr *e, int i, int where)
+{
+    struct expr *arg = e->arg[i];
+    struct eml_list *code;
+    int exits;
+
+    if(i && e->prim && e->prim->flags & EML_PRIM_CONTROL && is_list(arg)) {
+        code = opt_list(o, arg->node->data, &exits);
+        eml_node_free(arg->node);
+        arg->node = eml_node_list(code);
+        return arg;
+    }
+    return opt_expr(o, arg, where);
+}
+
+
+/* put an input in place of a reference to it in an inlined body */
+static struct expr *substitute(struct opt *o, struct expr *e)
+{
+    struct eml_word *w = e->node->data;
+    int i;
+
+    if(!o->callee || e->node->type != EML_WORD || w->type != WORD || w->field.s[0] != ':') {
+        return e;
+    }
+
+    for(i=0; i<o->callee->nargs; i++) {
+        if(strcasecmp(o->callee->params[i]->field.s, w->field.s + 1) == 0) {
+            o->uses[i]++;
+            expr_free(e);
+            return expr_alloc(LEAF, share(o->inputs[i]->node));
+        }
+    }
+    return e;
+}
+
+
+/* Work out a pure primitive whose inputs are all constants. One which
+   fails is left alone, to fail when it runs, if it ever does. */
+static struct expr *fold(struct opt *o, struct expr *e, const struct eml_prim *prim)
+{
+    struct eml_node *args[EML_MAX_ARGS] = {NULL};
+    struct eml_node *result;
+    struct eml_interp *in = o->in;
+    int i;
+
+    if(!prim || in->error) {
+        return e;
+    }
+    for(i=0; i<e->nargs; i++) {
+        if(!is_const(e->arg[i])) {
+            return e;
+        }
+    }
+
+    for(i=0; i<e->nargs; i++) {
+        args[i] = const_value(e->arg[i]);
+    }
+    result = prim->fn(in, args);
+    for(i=0; i<e->nargs; i++) {
+        if(args[i]) {
+            eml_node_free(args[i]);
+        }
+    }
+
+    if(in->error) {
+        in->error = 0;
+        in->errmsg[0] = '\0';
+        if(result) {
+            eml_node_free(result);
+        }
+        return e;
+    }
+    if(!result) {
+        return e;
+    }
+    expr_free(e);
+    return value_leaf(result);
+}
+
+
+/* replace a call to a procedure which outputs an expression with it */
+static struct expr *inline_output(struct opt *o, struct expr *e, int where)
+{
+    struct eml_list_node *cur;
+    struct expr *body, *result;
+    struct opt sub;
+
+    if(!inlinable(o, e, INLINE_OUTPUT)) {
+        return e;
+    }
+
+    /* the body is OUTPUT and its input, which is what we're after */
+    inline_begin(&sub, o, e);
+    cur = ((struct eml_list*) e->proc->code->data)->head;
+    body = parse_expr(&sub, &cur, 0);
+    if(!body) {
+        return e;
+    }
+    result = opt_expr(&sub, body->arg[0], 0);
+    body->arg[0] = NULL;
+    expr_free(body);
+
+    /* infix is quicker to run, but after an operator it has to be written
+       out as prefix calls to keep its grouping */
+    if(where & OPERAND) {
+        result = to_prefix(o, result);
+    }
+    if(!inputs_used(&sub, e) || (where & FOLLOWED && result->kind != LEAF)) {
+        expr_free(result);
+        return e;
+    }
+    expr_free(e);
+    return result;
+}
+
+
+/* Replace a call to a procedure of commands with them. Returns 1 if they
+   went onto out, or 0 if the call has to stay. */
+static int inline_commands(struct opt *o, struct expr *e, struct eml_list *out)
+{
+    struct eml_list *body;
+    struct opt sub;
+    int exits;
+
+    if(!inlinable(o, e, INLINE_COMMANDS)) {
+        return 0;
+    }
+
+    inline_begin(&sub, o, e);
+    body = opt_list(&sub, e->proc->code->data, &exits);
+    if(!inputs_used(&sub, e)) {
+        eml_node_free(eml_node_list(body));
+        return 0;
+    }
+    splice(out, body);
+    return 1;
+}
+
+
+/* Can the call be inlined that way? The procedure must be up to date and
+   the inputs must be constants or variables, so that evaluating them
+   again, or not at all, is the same as evaluating them once. */
+static int inlinable(struct opt *o, struct expr *e, int kind)
+{
+    int i;
+
+    if(e->proc->optimized != o->in->generation) {
+        eml_optimize_proc(o->in, e->proc);
+    }
+    if(e->proc->inline_kind != kind || e->proc->memo) {
+        return 0;
+    }
+    for(i=0; i<e->nargs; i++) {
+        if(e->arg[i]->kind != LEAF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* set up to optimize a procedure's body in place of a call to it */
+static void inline_begin(struct opt *sub, struct opt *o, struct expr *e)
+{
+    *sub = *o;
+    sub->defined = NULL;
+    sub->callee = e->proc;
+    sub->inputs = e->arg;
+    memset(sub->uses, 0, sizeof(sub->uses));
+}
+
+
+/* A variable given as an input has to be read, even if the body doesn't
+   use it, for the error if it has no value. */
+static int inputs_used(struct opt *sub, struct expr *e)
+{
+    int i;
+
+    for(i=0; i<e->nargs; i++) {
+        if(!is_const(e->arg[i]) && !sub->uses[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* turn infix operators into calls to their primitives */
+static struct expr *to_prefix(struct opt *o, struct expr *e)
+{
+    int i;
+
+    for(i=0; i<e->nargs; i++) {
+        e->arg[i] = to_prefix(o, e->arg[i]);
+    }
+    if(e->kind == INFIX) {
+        eml_node_free(e->node);
+        e->node = eml_node_word(eml_stow((char*) EML_INFIX[e->op].prim));
+        e->prim = o->infix[e->op];
+        e->kind = CALL;
+    }
+    return e;
+}
+
+
+/* How can calls to a procedure with this optimized body be inlined? Its
+   body may only call primitives, and can't stop or output early. */
+static int inline_kind(struct opt *o, struct eml_list *code)
+{
+    struct eml_list_node *cur = code->head;
+    struct expr *e = cur ? parse_expr(o, &cur, 0) : NULL;
+    int output;
+
+    output = e && !cur && e->kind == CALL && e->prim && e->prim->flags & EML_PRIM_EXIT &&
+             e->nargs == 1 && pure_expr(e->arg[0]);
+    if(e) {
+        expr_free(e);
+    }
+    if(output) {
+        return INLINE_OUTPUT;
+    }
+    return safe_list(o, code) ? INLINE_COMMANDS : INLINE_NONE;
+}
+
+
+/* is every instruction in the list a command which is safe to inline? */
+static int safe_list(struct opt *o, struct eml_list *list)
+{
+    struct eml_list_node *cur = list->head;
+    struct expr *e;
+    int safe = 1;
+
+    while(cur && safe) {
+        e = parse_expr(o, &cur, 0);
+        safe = e && safe_command(o, e);
+        if(e) {
+            expr_free(e);
+        }
+    }
+    return safe;
+}
+
+
+/* Is the instruction safe to inline? It has to be a command which only
+   touches the turtle or the output, or a control primitive running literal
+   lists of them, with pure inputs. */
+static int safe_command(struct opt *o, struct expr *e)
+{
+    int i;
+
+    if(e->kind != CALL || !e->prim || !(e->prim->flags & (EML_PRIM_COMMAND | EML_PRIM_CONTROL))) {
+        return 0;
+    }
+    for(i=0; i<e->nargs; i++) {
+        if(i && e->prim->flags & EML_PRIM_CONTROL) {
+            if(!is_list(e->arg[i]) || !safe_list(o, e->arg[i]->node->data)) {
+                return 0;
+            }
+        } else if(!pure_expr(e->arg[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* does the expression call nothing but pure primitives? */
+static int pure_expr(struct expr *e)
+{
+    int i;
+
+    if(e->kind == CALL && !(e->prim && e->prim->flags & EML_PRIM_PURE)) {
+        return 0;
+    }
+    for(i=0; i<e->nargs; i++) {
+        if(!pure_expr(e->arg[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/* count the nodes in a tree, stopping at limit */
+static int count_nodes(struct eml_node *node, int limit)
+{
+    struct eml_list_node *cur;
+    int n = 1;
+
+    if(node->type == EML_LIST) {
+        for(cur = ((struct eml_list*)node->data)->head; cur && n < limit; cur = cur->next) {
+            n += count_nodes(cur->data, limit - n);
+        }
+    }
+    return n;
+}
+
+
+/* Note the procedures a list defines anywhere in it, with their inputs.
+   Lists can nest deeply, so they are walked with a stack of our own. */
+static void find_defs(struct opt *o, struct eml_node *list)
+{
+    struct eml_list_node **stack = NULL, *cur, *p;
+    struct eml_node *node;
+    struct eml_proc *proc;
+    struct eml_word *name;
+    long nargs, had;
+    int size = 0, cap = 0;
+
+    cur = ((struct eml_list*) list->data)->head;
+    for(;;) {
+        if(!cur) {
+            if(!size) {
+                break;
+            }
+            cur = stack[--size];
+            continue;
+        }
+
+        node = cur->data;
+        cur = cur->next;
+        if(node->type == EML_LIST) {
+            if(size == cap) {
+                cap = cap ? cap * 2 : 16;
+                stack = eml_realloc(EML_MEM_OTHER, stack, cap * sizeof(*stack));
+            }
+            stack[size++] = cur;
+            cur = ((struct eml_list*) node->data)->head;
+            continue;
+        }
+        if(!is_word(node, "to") || !cur || ((struct eml_node*) cur->data)->type != EML_WORD) {
+            continue;
+        }
+
+        /* TO name :input ... */
+        name = ((struct eml_node*) cur->data)->data;
+        nargs = 0;
+        for(p = cur->next; p; p = p->next) {
+            node = p->data;
+            if(node->type != EML_WORD || ((struct eml_word*) node->data)->type != WORD ||
+               ((struct eml_word*) node->data)->field.s[0] != ':') {
+                break;
+            }
+            nargs++;
+        }
+
+        /* calls can only be followed if every definition agrees */
+        had = (long) eml_hashmap_get(o->defined, name);
+        proc = eml_hashmap_get(o->in->procs, name);
+        if((had && had != nargs + 1) || (proc && proc->nargs != nargs) || nargs > EML_MAX_ARGS) {
+            nargs = UNKNOWN_INPUTS - 1;
+        }
+        eml_hashmap_set(o->defined, name, (void*) (nargs + 1));
+    }
+
+    eml_free(EML_MEM_OTHER, stack);
+}
+
+
+/* parse an expression whose infix operators bind tighter than prec */
+static struct expr *parse_expr(struct opt *o, struct eml_list_node **cur, int prec)
+{
+    struct expr *e, *infix;
+    int op;
+
+    e = parse_primary(o, cur);
+    while(e && (op = eml_infix_op(*cur, prec)) >= 0) {
+        infix = expr_alloc(INFIX, share((*cur)->data));
+        infix->op = op;
+        infix->nargs = 2;
+        infix->arg[0] = e;
+        e = infix;
+        *cur = (*cur)->next;
+        if(!*cur || !(e->arg[1] = parse_expr(o, cur, EML_INFIX[op].prec))) {
+            expr_free(e);
+            return NULL;
+        }
+    }
+    return e;
+}
+
+
+/* parse a single value, call or variable reference */
+static struct expr *parse_primary(struct opt *o, struct eml_list_node **cur)
+{
+    struct eml_node *node = (*cur)->data;
+    struct eml_word *w = node->data;
+    struct expr *e;
+    long defined = 0;
+    int i;
+
+    /* code nested too deeply to walk on the stack is left as it is */
+    if(o->stack - (uintptr_t) &e > OPT_STACK) {
+        return NULL;
+    }
+
+    *cur = (*cur)->next;
+    if(node->type != EML_WORD || w->type != WORD || w->field.s[0] == '"' || w->field.s[0] == ':') {
+        return expr_alloc(LEAF, share(node));
+    }
+
+    /* calls, looked up in the order the interpreter does */
+    e = expr_alloc(CALL, share(node));
+    e->prim = lookup_prim(o->in, w);
+    if(!e->prim && o->defined) {
+        defined = (long) eml_hashmap_get(o->defined, w);
+    }
+    if(e->prim) {
+        e->nargs = e->prim->nargs;
+    } else if(defined && defined != UNKNOWN_INPUTS) {
+        e->nargs = defined - 1;
+    } else if(!defined && (e->proc = eml_hashmap_get(o->in->procs, w))) {
+        e->nargs = e->proc->nargs;
+    } else {
+        expr_free(e);
+        return NULL;
+    }
+
+    for(i=0; i<e->nargs; i++) {
+        if(!*cur || !(e->arg[i] = parse_expr(o, cur, 0))) {
+            expr_free(e);
+            return NULL;
+        }
+    }
+    return e;
+}
+
+
+/* the primitive a word names, as the interpreter finds it */
+static const struct eml_prim *lookup_prim(struct eml_interp *in, struct eml_word *w)
+{
+    if(w->prim) {
+        return in->prim_ids[w->prim];
+    }
+    return eml_hashmap_get(in->prims, w);
+}
+
+
+/* Is the expression a constant, a leaf which isn't a variable? Arrays
+   aren't, since each evaluation of one makes a new array. */
+static int is_const(struct expr *e)
+{
+    struct eml_word *w = e->node->data;
+
+    return e->kind == LEAF && e->node->type != EML_ARRAY &&
+           (e->node->type == EML_LIST || w->type != WORD || w->field.s[0] != ':');
+}
+
+
+/* is the expression a literal list? */
+static int is_list(struct expr *e)
+{
+    return e->kind == LEAF && e->node->type == EML_LIST;
+}
+
+
+/* the value of a constant, as the interpreter evaluates it */
+static struct eml_node *const_value(struct expr *e)
+{
+    struct eml_word *w = e->node->data;
+
+    if(e->node->type == EML_WORD && w->type == WORD) {
+        return eml_node_word(eml_stow(w->field.s + 1));
+    }
+    return share(e->node);
+}
+
+
+/* a constant which evaluates to value, which it takes */
+static struct expr *value_leaf(struct eml_node *value)
+{
+    struct eml_word *w = value->data;
+    const char *s;
+    char *quoted;
+
+    /* words which aren't numbers are quoted */
+    if(value->type == EML_WORD && (w->type == WORD || w->type == TOKEN || w->type == ROPE)) {
+        s = eml_word_str(w);
+        quoted = eml_buf_alloc();
+        eml_buf_putc(&quoted, '"');
+        eml_buf_put(&quoted, s, strlen(s) + 1);
+        eml_node_free(value);
+        value = eml_node_word(eml_stow(quoted));
+        eml_buf_free(quoted);
+    }
+    return expr_alloc(LEAF, value);
+}
+
+
+/* is the expression a constant TRUE or FALSE? */
+static int const_bool(struct expr *e, int *b)
+{
+    struct eml_word *w = e->node->data;
+
+    if(e->kind != LEAF || e->node->type != EML_WORD || w->type != WORD || w->field.s[0] != '"') {
+        return 0;
+    }
+    if(strcasecmp(w->field.s + 1, "true") == 0) {
+        *b = 1;
+        return 1;
+    }
+    if(strcasecmp(w->field.s + 1, "false") == 0) {
+        *b = 0;
+        return 1;
+    }
+    return 0;
+}
+
+
+/* is the node the given word? */
+static int is_word(struct eml_node *node, const char *s)
+{
+    struct eml_word *w = node->data;
+
+    return node->type == EML_WORD && w->type == WORD && strcasecmp(w->field.s, s) == 0;
+}
+
+
+/* is the expression a call to the named primitive? */
+static int is_prim(struct expr *e, const char *name)
+{
+    return e->kind == CALL && e->prim && strcasecmp(e->prim->name, name) == 0;
+}
+
+
+/* create an expression holding a node */
+static struct expr *expr_alloc(enum expr_kind kind, struct eml_node *node)
+{
+    struct expr *e = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct expr));
+
+    e->kind = kind;
+    e->node = node;
+    return e;
+}
+
+
+/* destroy an expression, and any nodes it still holds */
+static void expr_free(struct expr *e)
+{
+    int i;
+
+    for(i=0; i<e->nargs; i++) {
+        if(e->arg[i]) {
+            expr_free(e->arg[i]);
+        }
+    }
+    if(e->node) {
+        eml_node_free(e->node);
+    }
+    eml_free(EML_MEM_OTHER, e);
+}
+
+
+/* write an expression's nodes onto the end of a list, in the order they
+   are evaluated, handing them over */
+static void emit(struct expr *e, struct eml_list *out)
+{
+    int i;
+
+    if(e->kind == INFIX) {
+        emit(e->arg[0], out);
+        eml_list_append(out, e->node);
+        emit(e->arg[1], out);
+    } else {
+        eml_list_append(out, e->node);
+        for(i=0; i<e->nargs; i++) {
+            emit(e->arg[i], out);
+        }
+    }
+    e->node = NULL;
+}
+
+
+/* move the items of a list onto the end of out, destroying the list */
+static void splice(struct eml_list *out, struct eml_list *list)
+{
+    struct eml_list_node *cur;
+
+    for(cur = list->head; cur; cur = cur->next) {
+        eml_list_append(out, cur->data);
+    }
+    eml_list_free(list);
+}
+
+
+/* another reference to a node */
+static struct eml_node *share(struct eml_node *node)
+{
+    node->refs++;
+    return node;
+}
@@ -0,0 +1,519 @@
+/*
+ * File: pool.c
+ * Purpose: This is the implementation file for the emlogo worker pool.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "pool.h"
+#include "interp.h"
+#include "alloc.h"
+#include "buf.h"
+
+/* A list is cut into this many chunks, or into single items when it is
+   shorter. The chunks depend only on the length of the list, never on the
+   number of threads, so PREDUCE groups the items the same way however many
+   threads it has. */
+#define CHUNKS 1024
+
+enum job_kind {JOB_MAP, JOB_FILTER, JOB_REDUCE};
+
+/* a piece of the input, and what came of it */
+struct chunk {
+    struct eml_list *out;           /* outputs, or the items kept */
+    struct eml_node *value;         /* PREDUCE's result for the piece */
+    char *text;                     /* what it printed, an eml_buf, or NULL */
+    struct eml_interp *failed;      /* the interpreter holding its error */
+};
+
+/* One call of PMAP, PFILTER or PREDUCE. Workers take chunks in order, so
+   once one fails, every chunk before it has been taken and will finish,
+   and the first error is the same one a sequential run would meet. */
+struct job {
+    enum job_kind kind;
+    const char *who;
+    struct eml_node *fn;            /* the procedure name, the caller's */
+    struct eml_node *src;           /* the list or array, the caller's */
+    struct eml_list_node **at;      /* for a list, where each chunk starts */
+    int n;                          /* items */
+    int size;                       /* items in each chunk but the last */
+    int nchunks;
+    struct chunk *chunk;
+    int local;                      /* run in the caller's interpreter */
+    int next;                       /* the next chunk to run, taken atomically */
+    int stop;                       /* set once a chunk has failed */
+};
+
+struct worker {
+    struct eml_interp *in;
+    struct job *job;
+    pthread_t tid;
+    int started;                    /* tid is a running thread to join */
+};
+
+/* Workers keep their interpreters between jobs, so procedures are only
+   copied and compiled again once they change. */
+struct eml_pool {
+    int size;
+    struct worker *worker;
+};
+
+/* helper function prototypes */
+static struct eml_node *run(struct eml_interp *in, struct eml_node **args, enum job_kind kind, const char *who);
+static void run_workers(struct eml_interp *in, struct job *job, int nthreads);
+static void *work(void *arg);
+static void *work_thread(void *arg);
+static void run_chunk(struct job *job, struct eml_interp *in, struct eml_node *fn, int c);
+static struct eml_node *item(struct job *job, struct eml_interp *in, struct eml_list_node **cur, int i);
+static struct eml_node *hand_back(struct job *job, struct eml_interp *in, struct eml_node *node);
+static struct eml_node *call(struct job *job, struct eml_interp *in, struct eml_node *fn, struct eml_node **args, int nargs);
+static struct eml_node *finish(struct eml_interp *in, struct job *job);
+
+/* pool primitives */
+static struct eml_node *prim_pmap(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_pfilter(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_preduce(struct eml_interp *in, struct eml_node **args);
+
+static const struct eml_prim pool_prims[] = {
+    {"pmap", 2, prim_pmap, 0},
+    {"pfilter", 2, prim_pfilter, 0},
+    {"preduce", 2, prim_preduce, 0},
+    {NULL, 0, NULL}
+};
+
+
+/* the number of threads to run on by default */
+int eml_pool_threads()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+
+/* destroy a pool and its workers */
+void eml_pool_free(struct eml_pool *pool)
+{
+    int i;
+
+    for(i=0; i<pool->size; i++) {
+        eml_interp_free(pool->worker[i].in);
+    }
+    eml_free(EML_MEM_OTHER, pool->worker);
+    eml_free(EML_MEM_OTHER, pool);
+}
+
+
+/* add the pool primitives to the interpreter */
+void eml_pool_defprims(struct eml_interp *in)
+{
+    eml_interp_defprims(in, pool_prims);
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* run a job over the list or array in args[1] */
+static struct eml_node *run(struct eml_interp *in, struct eml_node **args, enum job_kind kind, const char *who)
+{
+    struct job job = {0};
+    struct eml_list_node *cur;
+    struct eml_array *array;
+    int c, i, nthreads;
+
+    if(!eml_arg_word(in, who, args[0])) {
+        return NULL;
+    }
+    if(args[1]->type == EML_LIST) {
+        for(cur = ((struct eml_list*) args[1]->data)->head; cur; cur = cur->next) {
+            job.n++;
+        }
+    } else if(args[1]->type == EML_ARRAY) {
+        array = args[1]->data;
+        job.n = array->size;
+    } else {
+        eml_interp_error(in, "%s doesn't like %s as input", who,
+                         args[1]->type == EML_WORD ? eml_word_str(args[1]->data) : "[...]");
+        return NULL;
+    }
+    if(kind == JOB_REDUCE && !job.n) {
+        eml_interp_error(in, "%s doesn't like %s as input", who, args[1]->type == EML_LIST ? "[]" : "{}");
+        return NULL;
+    }
+
+    job.kind = kind;
+    job.who = who;
+    job.fn = args[0];
+    job.src = args[1];
+    job.size = job.n > CHUNKS ? (job.n + CHUNKS - 1) / CHUNKS : 1;
+    job.nchunks = job.n ? (job.n + job.size - 1) / job.size : 0;
+    job.chunk = eml_calloc(EML_MEM_OTHER, job.nchunks ? job.nchunks : 1, sizeof(struct chunk));
+
+    /* a list can only be walked, so the start of each chunk is found first */
+    if(job.src->type == EML_LIST) {
+        job.at = eml_malloc(EML_MEM_OTHER, (job.nchunks ? job.nchunks : 1) * sizeof(struct eml_list_node*));
+        cur = ((struct eml_list*) job.src->data)->head;
+        for(i=0; cur; cur = cur->next, i++) {
+            if(i % job.size == 0) {
+                job.at[i / job.size] = cur;
+            }
+        }
+    }
+
+    /* Even one thread runs the job on a worker, so what the job does to
+       globals and the turtle is lost however many threads there are.
+       Workers don't start workers of their own; they run the job
+       themselves, and the worker's globals are thrown away anyway. */
+    if(in->parent) {
+        job.local = 1;
+        for(c=0; c<job.nchunks && !in->error; c++) {
+            run_chunk(&job, in, job.fn, c);
+        }
+    } else if(job.nchunks) {
+        nthreads = in->threads < job.nchunks ? in->threads : job.nchunks;
+        run_workers(in, &job, nthreads > 1 ? nthreads : 1);
+    }
+
+    return finish(in, &job);
+}
+
+
+/* run a job on the pool, the calling thread running the first worker */
+static void run_workers(struct eml_interp *in, struct job *job, int nthreads)
+{
+    struct eml_pool *pool = in->pool;
+    struct worker *w;
+    pthread_attr_t attr;
+    int i;
+
+    if(!pool) {
+        pool = in->pool = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_pool));
+    }
+    if(pool->size < nthreads) {
+        pool->worker = eml_realloc(EML_MEM_OTHER, pool->worker, nthreads * sizeof(struct worker));
+        for(; pool->size < nthreads; pool->size++) {
+            w = pool->worker + pool->size;
+            w->in = eml_interp_alloc_worker();
+            w->in->parent = in;
+            w->in->inherited = -1;
+            w->in->threads = 1;
+
+            /* what a worker prints is passed on in order by the caller */
+            eml_writer_free(w->in->out);
+            w->in->out = eml_writer_buf();
+        }
+    }
+
+    /* Every worker is as deep in calls as the caller, so a chunk runs out
+       of stack at the same depth on any thread. The first runs on the
+       caller's own stack, the others on stacks as big as the main one. */
+    for(i=0; i<nthreads; i++) {
+        w = pool->worker + i;
+        w->job = job;
+        w->in->optimize = in->optimize;
+        w->in->jit = in->jit;
+        w->in->depth = in->depth;
+    }
+    pool->worker[0].in->stack_limit = in->stack_limit;
+    pool->worker[0].in->max_depth = in->max_depth;
+
+    /* A thread that can't be started leaves its chunks to the others,
+       which take every chunk there is between them. */
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, eml_interp_stack_size());
+    for(i=1; i<nthreads; i++) {
+        w = pool->worker + i;
+        w->started = !pthread_create(&w->tid, &attr, work_thread, w);
+    }
+    pthread_attr_destroy(&attr);
+    work(pool->worker);
+    for(i=1; i<nthreads; i++) {
+        if(pool->worker[i].started) {
+            pthread_join(pool->worker[i].tid, NULL);
+        }
+    }
+}
+
+
+/* run chunks until there are none left, or one has failed */
+static void *work(void *arg)
+{
+    struct worker *w = arg;
+    struct job *job = w->job;
+    struct eml_interp *in = w->in;
+    struct eml_node *fn;
+    int c;
+
+    eml_interp_clear_error(in);
+    eml_interp_inherit(in);
+    fn = eml_node_word(eml_word_clone(job->fn->data));
+
+    while(!__atomic_load_n(&job->stop, __ATOMIC_RELAXED) &&
+          (c = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->nchunks) {
+        run_chunk(job, in, fn, c);
+        if(in->error) {
+            __atomic_store_n(&job->stop, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    eml_node_free(fn);
+    return NULL;
+}
+
+
+/* Start a worker thread. The profiler's ticks are left to the calling
+   thread, which charges them to the running call. */
+static void *work_thread(void *arg)
+{
+    struct worker *w = arg;
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    eml_interp_set_stack(w->in, eml_interp_stack_size());
+    return work(arg);
+}
+
+
+/* run one chunk of a job in an interpreter */
+static void run_chunk(struct job *job, struct eml_interp *in, struct eml_node *fn, int c)
+{
+    struct chunk *ch = job->chunk + c;
+    struct eml_list_node *cur = job->at ? job->at[c] : NULL;
+    struct eml_node *args[2], *x, *value;
+    int i = c * job->size;
+    int last = i + job->size < job->n ? i + job->size : job->n;
+    int b;
+
+    ch->out = eml_list_alloc();
+    for(; i<last && !in->error; i++) {
+        x = item(job, in, &cur, i);
+        if(!x) {
+            break;
+        }
+
+        if(job->kind == JOB_MAP) {
+            args[0] = x;
+            value = call(job, in, fn, args, 1);
+            if(value && (value = hand_back(job, in, value))) {
+                eml_list_append(ch->out, value);
+            }
+        } else if(job->kind == JOB_FILTER) {
+            args[0] = eml_node_copy(x);
+            value = call(job, in, fn, args, 1);
+            if(value && eml_arg_bool(in, job->who, value, &b) && b) {
+                x = hand_back(job, in, x);
+                if(x) {
+                    eml_list_append(ch->out, x);
+                }
+            } else {
+                eml_node_free(x);
+            }
+            if(value) {
+                eml_node_free(value);
+            }
+        } else if(!ch->value) {
+            ch->value = x;
+        } else {
+            /* the running value is always the first input */
+            args[0] = ch->value;
+            args[1] = x;
+            ch->value = call(job, in, fn, args, 2);
+        }
+    }
+
+    if(ch->value && !in->error) {
+        ch->value = hand_back(job, in, ch->value);
+    }
+    if(in->error) {
+        ch->failed = in;
+    }
+
+    /* a worker's printing is kept with the chunk that did it */
+    if(!job->local && !eml_writer_flush(in->out) && eml_buf_length(in->out->text)) {
+        ch->text = in->out->text;
+        in->out->text = eml_buf_alloc();
+    }
+}
+
+
+/* item i of the input, as a node of the interpreter's own */
+static struct eml_node *item(struct job *job, struct eml_interp *in, struct eml_list_node **cur, int i)
+{
+    struct eml_array *array = job->src->data;
+    struct eml_node *node, *copy;
+
+    if(job->src->type == EML_LIST) {
+        node = (*cur)->data;
+        *cur = (*cur)->next;
+    } else if(array->num) {
+        return eml_node_number(array->num[i]);
+    } else if(!array->item[i]) {
+        return eml_node_list(eml_list_alloc());
+    } else {
+        node = array->item[i];
+    }
+
+    if(job->local) {
+        return eml_node_copy(node);
+    }
+    copy = eml_node_clone(node);
+    if(!copy) {
+        eml_interp_error(in, "%s can't pass a stream to another thread", job->who);
+    }
+    return copy;
+}
+
+
+/* Give a worker's node to the caller, as a clone which shares nothing
+   with anything the worker keeps. Returns NULL after flagging an error. */
+static struct eml_node *hand_back(struct job *job, struct eml_interp *in, struct eml_node *node)
+{
+    struct eml_node *copy;
+
+    if(job->local) {
+        return node;
+    }
+    copy = eml_node_clone(node);
+    eml_node_free(node);
+    if(!copy) {
+        eml_interp_error(in, "%s can't pass a stream to another thread", job->who);
+    }
+    return copy;
+}
+
+
+/* Call fn with inputs, which it takes. Returns its output, or NULL after
+   flagging an error. */
+static struct eml_node *call(struct job *job, struct eml_interp *in, struct eml_node *fn, struct eml_node **args, int nargs)
+{
+    struct eml_node *result = eml_interp_apply(in, job->who, fn->data, args, nargs);
+
+    if(in->error && result) {
+        eml_node_free(result);
+        return NULL;
+    } else if(!result && !in->error) {
+        eml_interp_error(in, "%s didn't output to %s", eml_word_str(fn->data), job->who);
+    }
+    return result;
+}
+
+
+/* Put the chunks' results together in order, passing on what they
+   printed, up to the first that failed. Later chunks may have run too,
+   but what they did is thrown away. */
+static struct eml_node *finish(struct eml_interp *in, struct job *job)
+{
+    struct eml_list *out = eml_list_alloc();
+    struct eml_node *result = NULL, *args[2];
+    struct chunk *ch;
+    int failed = 0;
+    int c;
+
+    for(c=0; c<job->nchunks; c++) {
+        ch = job->chunk + c;
+        if(ch->text) {
+            if(!failed) {
+                eml_writer_bytes(in->out, ch->text, eml_buf_length(ch->text));
+            }
+            eml_buf_free(ch->text);
+        }
+        if(ch->failed && !failed) {
+            eml_interp_error(in, "%s", ch->failed->errmsg);
+            failed = 1;
+        }
+
+        if(failed || !ch->out) {
+            if(ch->out) {
+                eml_node_free(eml_node_list(ch->out));
+            }
+            if(ch->value) {
+                eml_node_free(ch->value);
+            }
+            continue;
+        }
+        eml_list_join(out, ch->out);
+
+        /* the chunks' values are reduced in order, in the caller */
+        if(ch->value && !result) {
+            result = ch->value;
+        } else if(ch->value) {
+            args[0] = result;
+            args[1] = ch->value;
+            result = call(job, in, job->fn, args, 2);
+            failed = !result;
+        }
+    }
+
+    eml_free(EML_MEM_OTHER, job->chunk);
+    eml_free(EML_MEM_OTHER, job->at);
+    if(failed) {
+        if(result) {
+            eml_node_free(result);
+        }
+        eml_node_free(eml_node_list(out));
+        return NULL;
+    }
+
+    if(job->kind == JOB_REDUCE) {
+        eml_node_free(eml_node_list(out));
+        return result;
+    }
+    if(job->src->type == EML_ARRAY) {
+        return eml_node_array(eml_array_list(out));
+    }
+    return eml_node_list(out);
+}
+
+
+/******************************************
+ * Pool primitives
+ ******************************************/
+/* PMAP procname thing, the procedure of each item of a list or array,
+   worked out on all of the threads */
+static struct eml_node *prim_pmap(struct eml_interp *in, struct eml_node **args)
+{
+    return run(in, args, JOB_MAP, "pmap");
+}
+
+
+/* PFILTER procname thing, the items of a list or array for which the
+   procedure outputs TRUE */
+static struct eml_node *prim_pfilter(struct eml_interp *in, struct eml_node **args)
+{
+    return run(in, args, JOB_FILTER, "pfilter");
+}
+
+
+/* PREDUCE procname thing, as REDUCE, but with the items grouped into
+   chunks which are reduced at once, so the procedure should be
+   associative */
+static struct eml_node *prim_preduce(struct eml_interp *in, struct eml_node **args)
+{
+    return run(in, args, JOB_REDUCE, "preduce");
+}
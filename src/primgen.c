@@ -0,0 +1,179 @@
+/*
+ * File: primgen.c
+ * Purpose: Generate the perfect hash of the emlogo primitive names.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * primgen < prims.txt > primid.c
+ *
+ * Reads primitive names, one per line, and writes eml_prim_id. A name's
+ * slot in the table is (hash * SEED) >> SHIFT, where hash is the word
+ * hash which eml_stow has already computed. The table is the smallest
+ * power of two, at least twice the number of names, for which some SEED
+ * puts every name in a slot of its own. A lookup is then a multiply, a
+ * load and a comparison of hashes, and only a word whose hash matches
+ * has its text compared.
+ */
+
+#define MAX_NAMES 1024
+#define MAX_LEN 64
+
+/* seeds tried at each table size before trying the next size up */
+#define SEED_TRIES 1000000
+
+static char names[MAX_NAMES][MAX_LEN];
+static unsigned int hashes[MAX_NAMES];
+static int n;
+
+/* helper function prototypes */
+static unsigned int word_hash(const char *s);
+static int try_seed(unsigned int seed, int shift, unsigned short *slot, int size);
+static void write_table(unsigned int seed, int shift, unsigned short *slot, int size);
+
+
+int main()
+{
+    char line[256];
+    unsigned short *slot;
+    unsigned int seed = 0;
+    int bits, size, len, i, tries;
+
+    /* read the names, skipping blank lines and comments */
+    while(fgets(line, sizeof(line), stdin)) {
+        len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if(!len || line[0] == '#') {
+            continue;
+        }
+        if(n == MAX_NAMES || len >= MAX_LEN) {
+            fprintf(stderr, "primgen: too many names, or %s is too long\n", line);
+            return 1;
+        }
+        for(i=0; i<n; i++) {
+            if(strcasecmp(names[i], line) == 0) {
+                fprintf(stderr, "primgen: %s is listed twice\n", line);
+                return 1;
+            }
+        }
+        strcpy(names[n], line);
+        hashes[n] = word_hash(line);
+        n++;
+    }
+
+    /* search for a seed, growing the table until one turns up */
+    for(bits = 1; (1 << bits) < 2 * n; bits++);
+    for(;; bits++) {
+        size = 1 << bits;
+        slot = calloc(size, sizeof(*slot));
+        seed = 2654435769u;
+        for(tries = 0; tries < SEED_TRIES; tries++) {
+            if(try_seed(seed, 32 - bits, slot, size)) {
+                write_table(seed, 32 - bits, slot, size);
+                free(slot);
+                return 0;
+            }
+            seed += 2;
+        }
+        free(slot);
+    }
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* the hash eml_stow gives a word, FNV-1a without regard to case */
+static unsigned int word_hash(const char *s)
+{
+    unsigned int hash = 2166136261u;
+
+    for(; *s; s++) {
+        hash ^= toupper((unsigned char) *s);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/* Place every name with a seed. Returns 1 if none collide, filling in
+   slot with the IDs, or 0 if two do. */
+static int try_seed(unsigned int seed, int shift, unsigned short *slot, int size)
+{
+    int i, k;
+
+    memset(slot, 0, size * sizeof(*slot));
+    for(i=0; i<n; i++) {
+        k = (hashes[i] * seed) >> shift;
+        if(slot[k]) {
+            return 0;
+        }
+        slot[k] = i + 1;
+    }
+    return 1;
+}
+
+
+/* write out primid.c */
+static void write_table(unsigned int seed, int shift, unsigned short *slot, int size)
+{
+    int i;
+
+    printf("/* Generated by primgen from prims.txt; edit that instead. */\n");
+    printf("#include <strings.h>\n");
+    printf("#include \"primid.h\"\n\n");
+    printf("const int eml_prim_count = %d;\n\n", n);
+
+    printf("/* the names and their word hashes, by ID */\n");
+    printf("static const char *const names[] = {\n    0");
+    for(i=0; i<n; i++) {
+        printf(",%s\"%s\"", i % 6 ? " " : "\n    ", names[i]);
+    }
+    printf("\n};\n\n");
+    printf("static const unsigned int hashes[] = {\n    0");
+    for(i=0; i<n; i++) {
+        printf(",%s%uu", i % 6 ? " " : "\n    ", hashes[i]);
+    }
+    printf("\n};\n\n");
+
+    printf("/* the ID in each slot, or 0 */\n");
+    printf("static const unsigned short slots[%d] = {", size);
+    for(i=0; i<size; i++) {
+        printf("%s%s%d", i ? "," : "", i % 16 ? " " : "\n    ", slot[i]);
+    }
+    printf("\n};\n\n");
+
+    printf("int eml_prim_id(const char *s, unsigned int hash)\n");
+    printf("{\n");
+    printf("    int id = slots[(hash * %uu) >> %d];\n\n", seed, shift);
+    printf("    if(id && hashes[id] == hash && strcasecmp(names[id], s) == 0) {\n");
+    printf("        return id;\n");
+    printf("    }\n");
+    printf("    return 0;\n");
+    printf("}\n");
+}
@@ -0,0 +1,317 @@
+/*
+ * File: profile.c
+ * Purpose: This is the implementation file for the emlogo procedure profiler.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "profile.h"
+#include "alloc.h"
+
+/* one line of the flat report */
+struct prof_record {
+    const void *id;
+    const char *name;
+    long calls;
+    long total;         /* inclusive samples, counting only the outermost call */
+    long self;          /* exclusive samples */
+    int active;         /* enclosing calls while walking the tree */
+};
+
+/* the profile which owns the timer */
+static struct eml_profile *volatile sampled;
+static struct sigaction old_action;
+
+/* helper function prototypes */
+static void on_sample(int sig);
+static void set_timer(long usec);
+static struct prof_record *find_record(struct prof_record **rec, int *n, int *cap, const void *id);
+static int record_cmp(const void *a, const void *b);
+
+
+/* create an empty profile and start sampling */
+struct eml_profile *eml_profile_alloc()
+{
+    struct eml_profile *p = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_profile));
+    struct sigaction sa;
+
+    p->cur = &p->root;
+
+    if(!sampled) {
+        sampled = p;
+        p->sampling = 1;
+
+        /* restart system calls, the REPL may be waiting for input */
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_sample;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, &old_action);
+        set_timer(EML_PROFILE_INTERVAL);
+    }
+
+    return p;
+}
+
+
+/* stop sampling and destroy a profile */
+void eml_profile_free(struct eml_profile *p)
+{
+    struct eml_prof_node *node, *up;
+
+    if(p->sampling) {
+        set_timer(0);
+        sigaction(SIGPROF, &old_action, NULL);
+        sampled = NULL;
+    }
+
+    /* free the leaves, climbing as each parent runs out of children */
+    node = p->root.child;
+    while(node && node != &p->root) {
+        if(node->child) {
+            node = node->child;
+            continue;
+        }
+        up = node->parent;
+        up->child = node->next;
+        eml_free(EML_MEM_OTHER, node->name);
+        eml_free(EML_MEM_OTHER, node);
+        node = up->child ? up->child : up;
+    }
+
+    eml_free(EML_MEM_OTHER, p);
+}
+
+
+/* record entry into a call */
+void eml_profile_enter(struct eml_profile *p, const void *id, const char *name)
+{
+    struct eml_prof_node *parent = p->cur;
+    struct eml_prof_node *node, *prev = NULL;
+
+    for(node = parent->child; node && node->id != id; node = node->next) {
+        prev = node;
+    }
+
+    if(!node) {
+        node = eml_calloc(EML_MEM_OTHER, 1, sizeof(struct eml_prof_node));
+        node->id = id;
+        node->name = eml_malloc(EML_MEM_OTHER, strlen(name) + 1);
+        strcpy(node->name, name);
+        node->parent = parent;
+        node->next = parent->child;
+        parent->child = node;
+    } else if(prev) {
+        /* move to the front, loops call the same things over and over */
+        prev->next = node->next;
+        node->next = parent->child;
+        parent->child = node;
+    }
+
+    node->calls++;
+    p->cur = node;
+}
+
+
+/* record the return from the innermost call */
+void eml_profile_leave(struct eml_profile *p)
+{
+    if(p->cur != &p->root) {
+        p->cur = p->cur->parent;
+    }
+}
+
+
+/* write the profile in the collapsed stack format */
+void eml_profile_write_folded(struct eml_profile *p, FILE *out)
+{
+    struct eml_prof_node *node;
+    char *path = NULL;
+    int len = 0, cap = 0;
+    int n;
+
+    node = p->root.child;
+    while(node) {
+        /* extend the path with this node */
+        n = strlen(node->name);
+        if(len + n + 2 > cap) {
+            cap = (len + n + 2) * 2;
+            path = eml_realloc(EML_MEM_OTHER, path, cap);
+        }
+        if(len) {
+            path[len++] = ';';
+        }
+        memcpy(path + len, node->name, n);
+        len += n;
+        path[len] = '\0';
+
+        if(node->samples) {
+            fprintf(out, "%s %ld\n", path, node->samples);
+        }
+
+        if(node->child) {
+            node = node->child;
+            continue;
+        }
+
+        /* back out of finished nodes until one has a sibling */
+        for(;;) {
+            len -= strlen(node->name);
+            if(len) {
+                len--;
+            }
+            if(node->next) {
+                node = node->next;
+                break;
+            }
+            node = node->parent;
+            if(node == &p->root) {
+                node = NULL;
+                break;
+            }
+        }
+    }
+
+    eml_free(EML_MEM_OTHER, path);
+}
+
+
+/* write a flat report sorted by exclusive time */
+void eml_profile_write_report(struct eml_profile *p, FILE *out)
+{
+    struct prof_record *rec = NULL, *r;
+    int n = 0, cap = 0;
+    struct eml_prof_node *node;
+    double ms = EML_PROFILE_INTERVAL / 1000.0;
+    int i;
+
+    /* walk the tree, summing up each callee's contexts */
+    node = p->root.child;
+    while(node) {
+        r = find_record(&rec, &n, &cap, node->id);
+        if(!r->name) {
+            r->name = node->name;
+        }
+        r->calls += node->calls;
+        r->self += node->samples;
+        r->active++;
+        node->total = node->samples;
+
+        if(node->child) {
+            node = node->child;
+            continue;
+        }
+
+        /* finished nodes pass their totals up */
+        for(;;) {
+            node->parent->total += node->total;
+            r = find_record(&rec, &n, &cap, node->id);
+            if(--r->active == 0) {
+                r->total += node->total;
+            }
+            if(node->next) {
+                node = node->next;
+                break;
+            }
+            node = node->parent;
+            if(node == &p->root) {
+                node = NULL;
+                break;
+            }
+        }
+    }
+
+    qsort(rec, n, sizeof(struct prof_record), record_cmp);
+    fprintf(out, "%-24s %12s %14s %14s\n", "name", "calls", "inclusive ms", "exclusive ms");
+    for(i=0; i<n; i++) {
+        fprintf(out, "%-24s %12ld %14.1f %14.1f\n", rec[i].name, rec[i].calls,
+                rec[i].total * ms, rec[i].self * ms);
+    }
+
+    eml_free(EML_MEM_OTHER, rec);
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* charge a timer tick to the running call */
+static void on_sample(int sig)
+{
+    struct eml_profile *p = sampled;
+
+    if(p) {
+        p->cur->samples++;
+    }
+}
+
+
+/* set the profiling timer, 0 stops it */
+static void set_timer(long usec)
+{
+    struct itimerval it;
+
+    it.it_interval.tv_sec = usec / 1000000;
+    it.it_interval.tv_usec = usec % 1000000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+
+/* find (or add) the report record for a callee */
+static struct prof_record *find_record(struct prof_record **rec, int *n, int *cap, const void *id)
+{
+    int i;
+
+    for(i=0; i<*n; i++) {
+        if((*rec)[i].id == id) {
+            return *rec + i;
+        }
+    }
+
+    if(*n == *cap) {
+        *cap = *cap ? *cap * 2 : 32;
+        *rec = eml_realloc(EML_MEM_OTHER, *rec, *cap * sizeof(struct prof_record));
+    }
+    memset(*rec + *n, 0, sizeof(struct prof_record));
+    (*rec)[*n].id = id;
+    return *rec + (*n)++;
+}
+
+
+/* order records by decreasing exclusive time, then inclusive time and calls */
+static int record_cmp(const void *a, const void *b)
+{
+    const struct prof_record *x = a, *y = b;
+
+    if(x->self != y->self) {
+        return x->self < y->self ? 1 : -1;
+    }
+    if(x->total != y->total) {
+        return x->total < y->total ? 1 : -1;
+    }
+    return x->calls < y->calls ? 1 : x->calls > y->calls ? -1 : 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * File: stream.c
+ * Purpose: This is the implementation file for emlogo lazy streams.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "stream.h"
+#include "interp.h"
+#include "alloc.h"
+
+/* helper function prototypes */
+static struct eml_node *iseq(double next, double last);
+static struct eml_node *iterate(struct eml_node *fn, struct eml_node *first);
+static struct eml_node *map(struct eml_interp *in, struct eml_node *fn, struct eml_node *src, struct eml_list_node *cur);
+static struct eml_node *filter(struct eml_interp *in, struct eml_node *fn, struct eml_node *src, struct eml_list_node *cur);
+static struct eml_node *source_start(struct eml_node *src, struct eml_list_node **cur);
+static int source_next(struct eml_interp *in, struct eml_node **src, struct eml_list_node **cur);
+static struct eml_node *source_item(struct eml_node *src, struct eml_list_node *cur);
+static struct eml_node *call(struct eml_interp *in, const char *who, struct eml_node *fn, struct eml_node *arg);
+static struct eml_node *apply(struct eml_interp *in, const char *who, struct eml_node *fn, struct eml_node **args, int nargs);
+static struct eml_node *share(struct eml_node *node);
+static struct eml_node *empty();
+
+/* stream primitives */
+static struct eml_node *prim_iseq(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_iterate(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_map(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_filter(struct eml_interp *in, struct eml_node **args);
+static struct eml_node *prim_reduce(struct eml_interp *in, struct eml_node **args);
+
+static const struct eml_prim stream_prims[] = {
+    {"iseq", 2, prim_iseq, 0},
+    {"iterate", 2, prim_iterate, 0},
+    {"map", 2, prim_map, 0},
+    {"filter", 2, prim_filter, 0},
+    {"reduce", 2, prim_reduce, 0},
+    {NULL, 0, NULL}
+};
+
+
+/* work out the rest of a stream */
+struct eml_node *eml_stream_rest(struct eml_interp *in, struct eml_stream *stream)
+{
+    struct eml_node *fn = stream->fn, *src = stream->src, *value;
+    struct eml_list_node *cur = stream->cur;
+    struct eml_node *rest = NULL;
+    int kind = stream->kind;
+
+    if(kind == EML_STREAM_DONE) {
+        return stream->rest;
+    } else if(kind == EML_STREAM_BUSY) {
+        eml_interp_error(in, "a stream can't need its own rest");
+        return NULL;
+    } else if(kind == EML_STREAM_FAILED) {
+        eml_interp_error(in, "the rest of this stream had an error");
+        return NULL;
+    }
+
+    /* The stream lets go of its source first, so that nothing holds the
+       items a filter passes over while it looks for the next one. */
+    stream->kind = EML_STREAM_BUSY;
+    stream->fn = NULL;
+    stream->src = NULL;
+    switch(kind) {
+    case EML_STREAM_ISEQ:
+        if(stream->next == stream->last) {
+            rest = empty();
+        } else {
+            rest = iseq(stream->next + (stream->next < stream->last ? 1 : -1), stream->last);
+        }
+        break;
+    case EML_STREAM_ITERATE:
+        value = call(in, "iterate", fn, eml_node_copy(stream->first));
+        rest = value ? iterate(share(fn), value) : NULL;
+        break;
+    case EML_STREAM_MAP:
+    case EML_STREAM_FILTER:
+        if(!source_next(in, &src, &cur)) {
+            eml_node_free(src);
+            break;
+        }
+        src = source_start(src, &cur);
+        if(kind == EML_STREAM_MAP) {
+            rest = map(in, share(fn), src, cur);
+        } else {
+            rest = filter(in, share(fn), src, cur);
+        }
+        break;
+    }
+    if(fn) {
+        eml_node_free(fn);
+    }
+
+    stream->kind = rest ? EML_STREAM_DONE : EML_STREAM_FAILED;
+    stream->rest = rest;
+    return rest;
+}
+
+
+/* add the stream primitives to the interpreter */
+void eml_stream_defprims(struct eml_interp *in)
+{
+    eml_interp_defprims(in, stream_prims);
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* the numbers from next to last, counting up or down */
+static struct eml_node *iseq(double next, double last)
+{
+    struct eml_stream *stream = eml_stream_alloc(eml_node_number(next));
+
+    stream->kind = EML_STREAM_ISEQ;
+    stream->next = next;
+    stream->last = last;
+    return eml_node_stream(stream);
+}
+
+
+/* first, then fn of it, and so on, taking both */
+static struct eml_node *iterate(struct eml_node *fn, struct eml_node *first)
+{
+    struct eml_stream *stream = eml_stream_alloc(first);
+
+    stream->kind = EML_STREAM_ITERATE;
+    stream->fn = fn;
+    return eml_node_stream(stream);
+}
+
+
+/* fn of each item of src from cur on, taking fn and src, which is NULL
+   at its end */
+static struct eml_node *map(struct eml_interp *in, struct eml_node *fn, struct eml_node *src, struct eml_list_node *cur)
+{
+    struct eml_stream *stream;
+    struct eml_node *value;
+
+    if(!src) {
+        eml_node_free(fn);
+        return empty();
+    }
+
+    value = call(in, "map", fn, source_item(src, cur));
+    if(!value) {
+        eml_node_free(fn);
+        eml_node_free(src);
+        return NULL;
+    }
+
+    stream = eml_stream_alloc(value);
+    stream->kind = EML_STREAM_MAP;
+    stream->fn = fn;
+    stream->src = src;
+    stream->cur = cur;
+    return eml_node_stream(stream);
+}
+
+
+/* the items of src from cur on for which fn is true, taking fn and src */
+static struct eml_node *filter(struct eml_interp *in, struct eml_node *fn, struct eml_node *src, struct eml_list_node *cur)
+{
+    struct eml_stream *stream;
+    struct eml_node *item, *value;
+    int b;
+
+    /* look for the first item which passes, letting go of the others */
+    while(src) {
+        item = source_item(src, cur);
+        value = call(in, "filter", fn, eml_node_copy(item));
+        if(!value || !eml_arg_bool(in, "filter", value, &b)) {
+            if(value) {
+                eml_node_free(value);
+            }
+            eml_node_free(item);
+            eml_node_free(fn);
+            eml_node_free(src);
+            return NULL;
+        }
+        eml_node_free(value);
+
+        if(b) {
+            stream = eml_stream_alloc(item);
+            stream->kind = EML_STREAM_FILTER;
+            stream->fn = fn;
+            stream->src = src;
+            stream->cur = cur;
+            return eml_node_stream(stream);
+        }
+
+        eml_node_free(item);
+        if(!source_next(in, &src, &cur)) {
+            eml_node_free(fn);
+            eml_node_free(src);
+            return NULL;
+        }
+        src = source_start(src, &cur);
+    }
+
+    eml_node_free(fn);
+    return empty();
+}
+
+
+/* Start reading a list or stream, which is taken. Returns it, or NULL
+   after freeing it if it is empty. */
+static struct eml_node *source_start(struct eml_node *src, struct eml_list_node **cur)
+{
+    if(!src || src->type == EML_STREAM) {
+        return src;
+    }
+
+    /* a list is read from where cur already is, or from its head */
+    if(!*cur) {
+        *cur = ((struct eml_list*) src->data)->head;
+    }
+    if(!*cur) {
+        eml_node_free(src);
+        return NULL;
+    }
+    return src;
+}
+
+
+/* Move a source on past its current item. At the end of a list cur
+   becomes NULL, and at the end of a stream src becomes the empty list.
+   Returns 0 after an error. */
+static int source_next(struct eml_interp *in, struct eml_node **src, struct eml_list_node **cur)
+{
+    struct eml_node *rest;
+
+    if((*src)->type == EML_LIST) {
+        *cur = (*cur)->next;
+        if(!*cur) {
+            eml_node_free(*src);
+            *src = NULL;
+        }
+        return 1;
+    }
+
+    rest = eml_stream_rest(in, (*src)->data);
+    if(!rest) {
+        return 0;
+    }
+    rest = eml_node_copy(rest);
+    eml_node_free(*src);
+    *src = rest;
+    *cur = NULL;
+    return 1;
+}
+
+
+/* the current item of a source, as a new node */
+static struct eml_node *source_item(struct eml_node *src, struct eml_list_node *cur)
+{
+    if(src->type == EML_STREAM) {
+        return eml_node_copy(((struct eml_stream*) src->data)->first);
+    }
+    return eml_node_copy(cur->data);
+}
+
+
+/* Call fn with one input, which it takes. Returns its output, or NULL
+   after flagging an error. */
+static struct eml_node *call(struct eml_interp *in, const char *who, struct eml_node *fn, struct eml_node *arg)
+{
+    return apply(in, who, fn, &arg, 1);
+}
+
+
+/* call fn with inputs, which it takes, as call does */
+static struct eml_node *apply(struct eml_interp *in, const char *who, struct eml_node *fn, struct eml_node **args, int nargs)
+{
+    struct eml_node *result = eml_interp_apply(in, who, fn->data, args, nargs);
+
+    if(in->error && result) {
+        eml_node_free(result);
+        return NULL;
+    } else if(!result && !in->error) {
+        eml_interp_error(in, "%s didn't output to %s", eml_word_str(fn->data), who);
+    }
+    return result;
+}
+
+
+/* another owner for a node which won't be changed */
+static struct eml_node *share(struct eml_node *node)
+{
+    node->refs++;
+    return node;
+}
+
+
+/* the empty list, which ends every finite stream */
+static struct eml_node *empty()
+{
+    return eml_node_list(eml_list_alloc());
+}
+
+
+/******************************************
+ * Stream primitives
+ ******************************************/
+/* ISEQ from to, the whole numbers from one to the other */
+static struct eml_node *prim_iseq(struct eml_interp *in, struct eml_node **args)
+{
+    double from, to;
+
+    if(!eml_arg_number(in, "iseq", args[0], &from) || !eml_arg_number(in, "iseq", args[1], &to)) {
+        return NULL;
+    }
+    if(from != (long long) from || to != (long long) to) {
+        eml_interp_error(in, "iseq doesn't like %s as input",
+                         eml_word_str((from != (long long) from ? args[0] : args[1])->data));
+        return NULL;
+    }
+    return iseq(from, to);
+}
+
+
+/* ITERATE procname value, the value, the procedure of it, and so on */
+static struct eml_node *prim_iterate(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_node *result;
+
+    if(!eml_arg_word(in, "iterate", args[0])) {
+        return NULL;
+    }
+
+    /* the stream keeps both inputs */
+    result = iterate(args[0], args[1]);
+    args[0] = args[1] = NULL;
+    return result;
+}
+
+
+/* MAP procname thing, the procedure of each item of a list or stream */
+static struct eml_node *prim_map(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list_node *cur = NULL;
+    struct eml_node *fn = args[0], *src = args[1];
+
+    if(!eml_arg_word(in, "map", fn)) {
+        return NULL;
+    }
+    if(src->type != EML_LIST && src->type != EML_STREAM) {
+        eml_interp_error(in, "map doesn't like %s as input", src->type == EML_WORD ? eml_word_str(src->data) : "{...}");
+        return NULL;
+    }
+
+    args[0] = args[1] = NULL;
+    src = source_start(src, &cur);
+    return map(in, fn, src, cur);
+}
+
+
+/* FILTER procname thing, the items of a list or stream for which the
+   procedure outputs TRUE */
+static struct eml_node *prim_filter(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list_node *cur = NULL;
+    struct eml_node *fn = args[0], *src = args[1];
+
+    if(!eml_arg_word(in, "filter", fn)) {
+        return NULL;
+    }
+    if(src->type != EML_LIST && src->type != EML_STREAM) {
+        eml_interp_error(in, "filter doesn't like %s as input", src->type == EML_WORD ? eml_word_str(src->data) : "{...}");
+        return NULL;
+    }
+
+    args[0] = args[1] = NULL;
+    src = source_start(src, &cur);
+    return filter(in, fn, src, cur);
+}
+
+
+/* REDUCE procname thing, the procedure of the first two items of a list
+   or stream, then of that and the third, and so on to the last */
+static struct eml_node *prim_reduce(struct eml_interp *in, struct eml_node **args)
+{
+    struct eml_list_node *cur = NULL;
+    struct eml_node *fn = args[0], *src = args[1];
+    struct eml_node *pair[2];
+
+    if(!eml_arg_word(in, "reduce", fn)) {
+        return NULL;
+    }
+    if(src->type != EML_LIST && src->type != EML_STREAM) {
+        eml_interp_error(in, "reduce doesn't like %s as input", src->type == EML_WORD ? eml_word_str(src->data) : "{...}");
+        return NULL;
+    }
+
+    args[1] = NULL;
+    src = source_start(src, &cur);
+    if(!src) {
+        eml_interp_error(in, "reduce doesn't like [] as input");
+        return NULL;
+    }
+
+    /* the running value is always the first input */
+    pair[0] = source_item(src, cur);
+    while(pair[0]) {
+        if(!source_next(in, &src, &cur)) {
+            eml_node_free(pair[0]);
+            pair[0] = NULL;
+            break;
+        }
+        src = source_start(src, &cur);
+        if(!src) {
+            break;
+        }
+        pair[1] = source_item(src, cur);
+        pair[0] = apply(in, "reduce", fn, pair, 2);
+    }
+
+    if(src) {
+        eml_node_free(src);
+    }
+    return pair[0];
+}
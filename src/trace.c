@@ -0,0 +1,129 @@
+/*
+ * File: trace.c
+ * Purpose: This is the implementation file for emlogo event tracing.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <time.h>
+#include "trace.h"
+#include "alloc.h"
+
+/* every ring, newest first, and the calling thread's own */
+static struct eml_trace_ring *rings;
+static __thread struct eml_trace_ring *ring;
+static int next_tid;
+
+/* helper function prototypes */
+static struct eml_trace_ring *ring_alloc();
+
+
+/* record an event in the calling thread's ring */
+void eml_trace_event(const char *name, char phase, long arg)
+{
+    struct eml_trace_event *e;
+    struct timespec ts;
+
+    if(!ring) {
+        ring = ring_alloc();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    e = ring->event + (ring->head & (EML_TRACE_RING - 1));
+    e->ts = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    e->name = name;
+    e->arg = arg;
+    e->phase = phase;
+
+    /* publish the event only once it is complete */
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+
+/* write every ring as Chrome trace event JSON */
+void eml_trace_write_json(FILE *out)
+{
+    struct eml_trace_ring *r;
+    struct eml_trace_event *e;
+    unsigned long i, head;
+    int first = 1;
+    int depth;
+
+    fputs("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [", out);
+    for(r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        i = head > EML_TRACE_RING ? head - EML_TRACE_RING : 0;
+
+        /* ends whose beginnings were overwritten are left out */
+        depth = 0;
+        for(; i < head; i++) {
+            e = r->event + (i & (EML_TRACE_RING - 1));
+            if(e->phase == 'E' && !depth) {
+                continue;
+            }
+            depth += e->phase == 'B' ? 1 : e->phase == 'E' ? -1 : 0;
+
+            fprintf(out, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d",
+                    first ? "" : ",", e->name, e->phase, e->ts / 1e3, r->tid);
+            if(e->phase == 'i') {
+                fputs(", \"s\": \"t\"", out);
+            }
+            if(e->phase != 'E') {
+                fprintf(out, ", \"args\": {\"n\": %ld}", e->arg);
+            }
+            fputc('}', out);
+            first = 0;
+        }
+    }
+    fputs("\n]}\n", out);
+}
+
+
+/* discard all of the rings */
+void eml_trace_free()
+{
+    struct eml_trace_ring *r, *next;
+
+    for(r = rings; r; r = next) {
+        next = r->next;
+        eml_free(EML_MEM_OTHER, r);
+    }
+    rings = NULL;
+    ring = NULL;
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* create the calling thread's ring and add it to the list */
+static struct eml_trace_ring *ring_alloc()
+{
+    struct eml_trace_ring *r = eml_malloc(EML_MEM_OTHER, sizeof(struct eml_trace_ring));
+
+    r->head = 0;
+    r->tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+    r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&rings, &r->next, r, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return r;
+}
@@ -0,0 +1,514 @@
+/*
+ * File: turtle.c
+ * Purpose: This is the implementation file for the emlogo turtle.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "turtle.h"
+#include "interp.h"
+#include "alloc.h"
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+/* sines of the whole degrees 0 through 90, filled in once by whichever
+   thread needs them first */
+static double sin_table[91];
+static pthread_once_t sin_once = PTHREAD_ONCE_INIT;
+
+/* the standard Logo palette */
+static const uint32_t palette[16] = {
+    EML_RGBA(0, 0, 0, 255),       /* 0 black */
+    EML_RGBA(0, 0, 255, 255),     /* 1 blue */
+    EML_RGBA(0, 255, 0, 255),     /* 2 green */
+    EML_RGBA(0, 255, 255, 255),   /* 3 cyan */
+    EML_RGBA(255, 0, 0, 255),     /* 4 red */
+    EML_RGBA(255, 0, 255, 255),   /* 5 magenta */
+    EML_RGBA(255, 255, 0, 255),   /* 6 yellow */
+    EML_RGBA(255, 255, 255, 255), /* 7 white */
+    EML_RGBA(155, 96, 59, 255),   /* 8 brown */
+    EML_RGBA(197, 136, 18, 255),  /* 9 tan */
+    EML_RGBA(100, 162, 64, 255),  /* 10 forest */
+    EML_RGBA(120, 187, 187, 255), /* 11 aqua */
+    EML_RGBA(255, 149, 119, 255), /* 12 salmon */
+    EML_RGBA(144, 113, 208, 255), /* 13 purple */
+    EML_RGBA(255, 163, 0, 255),   /* 14 orange */
+    EML_RGBA(183, 183, 183, 255)  /* 15 grey */
+};
+
+
+/* Fill in the sine table. The values are computed in long double and
+   rounded once, so each entry is the correctly rounded sine in nearly
+   every case. The ends are set exactly. */
+static void sin_table_init()
+{
+    long double rad = 3.14159265358979323846264338327950288L / 180;
+    int i;
+
+    for(i=1; i<90; i++) {
+        sin_table[i] = (double) sinl(i * rad);
+    }
+    sin_table[0] = 0.0;
+    sin_table[90] = 1.0;
+}
+
+
+/* move to (x, y), drawing if the pen is down */
+static void move_to(struct eml_turtle *t, double x, double y)
+{
+    if(t->pendown) {
+        eml_dlist_add(t->dlist, t->x, t->y, x, y, t->color);
+    }
+    t->x = x;
+    t->y = y;
+}
+
+
+/* create a turtle at home on the given canvas */
+struct eml_turtle *eml_turtle_alloc(struct eml_canvas *canvas)
+{
+    struct eml_turtle *t = eml_malloc(EML_MEM_TURTLE, sizeof(struct eml_turtle));
+
+    t->x = 0;
+    t->y = 0;
+    t->heading = 0;
+    t->sin_h = 0;
+    t->cos_h = 1;
+    t->pendown = 1;
+    t->color = palette[0];
+    t->background = palette[7];
+    t->dlist = eml_dlist_alloc();
+    t->canvas = canvas;
+    t->threads = eml_dlist_threads();
+
+    return t;
+}
+
+
+/* destroy a turtle and its display list */
+void eml_turtle_free(struct eml_turtle *t)
+{
+    eml_dlist_free(t->dlist);
+    eml_free(EML_MEM_TURTLE, t);
+}
+
+
+/* flood fill the area around the turtle with the pen color */
+void eml_turtle_fill(struct eml_turtle *t)
+{
+    eml_dlist_fill(t->dlist, t->x, t->y, t->color);
+}
+
+
+/* render the display list onto a freshly cleared canvas */
+void eml_turtle_render(struct eml_turtle *t)
+{
+    eml_canvas_clear(t->canvas, t->background);
+    eml_dlist_render(t->dlist, t->canvas, t->threads);
+}
+
+
+/* move forward */
+void eml_turtle_forward(struct eml_turtle *t, double dist)
+{
+    move_to(t, t->x + dist * t->sin_h, t->y + dist * t->cos_h);
+}
+
+
+/* turn right */
+void eml_turtle_right(struct eml_turtle *t, double angle)
+{
+    eml_turtle_setheading(t, t->heading + angle);
+}
+
+
+/* move to an absolute position */
+void eml_turtle_setpos(struct eml_turtle *t, double x, double y)
+{
+    move_to(t, x, y);
+}
+
+
+/* turn to an absolute heading */
+void eml_turtle_setheading(struct eml_turtle *t, double heading)
+{
+    /* a single turn rarely needs more than one correction */
+    if(heading >= 360.0 && heading < 720.0) {
+        heading -= 360.0;
+    } else if(heading < 0 && heading >= -360.0) {
+        heading += 360.0;
+    } else if(heading < 0 || heading >= 360.0) {
+        heading = fmod(heading, 360.0);
+        if(heading < 0) {
+            heading += 360.0;
+        }
+    }
+    if(heading >= 360.0) {
+        heading = 0;
+    }
+    t->heading = heading;
+    eml_heading_sincos(heading, &t->sin_h, &t->cos_h);
+}
+
+
+/* sine and cosine of a heading in degrees */
+void eml_heading_sincos(double heading, double *s, double *c)
+{
+    double sr, cr;
+    int deg;
+
+    /* Whole degrees come from the table, using the symmetries of the
+       quadrants, so the cardinal directions are exact. */
+    if(heading >= 0 && heading < 360 && heading == (int) heading) {
+        pthread_once(&sin_once, sin_table_init);
+        deg = (int) heading;
+        sr = sin_table[deg % 90];
+        cr = sin_table[90 - deg % 90];
+        switch(deg / 90) {
+        case 0: *s = sr;  *c = cr;  break;
+        case 1: *s = cr;  *c = -sr; break;
+        case 2: *s = -sr; *c = -cr; break;
+        default: *s = -cr; *c = sr; break;
+        }
+        return;
+    }
+
+    *s = sin(heading * DEG_TO_RAD);
+    *c = cos(heading * DEG_TO_RAD);
+}
+
+
+/* raise or lower the pen */
+void eml_turtle_pen(struct eml_turtle *t, int down)
+{
+    t->pendown = down;
+}
+
+
+/* set the pen color */
+void eml_turtle_setcolor(struct eml_turtle *t, uint32_t color)
+{
+    t->color = color;
+}
+
+
+/******************************************
+ * Primitives
+ ******************************************/
+/* Returns 1 if there is a turtle to use, or flags an error. There isn't
+   one while PMAP, PFILTER or PREDUCE runs. */
+static int has_turtle(struct eml_interp *in, const char *who)
+{
+    if(!in->turtle) {
+        eml_interp_error(in, "%s can't be used inside PMAP, PFILTER or PREDUCE", who);
+        return 0;
+    }
+    return 1;
+}
+
+static struct eml_node *prim_forward(struct eml_interp *in, struct eml_node **args)
+{
+    double d;
+    if(has_turtle(in, "forward") && eml_arg_number(in, "forward", args[0], &d)) {
+        eml_turtle_forward(in->turtle, d);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_back(struct eml_interp *in, struct eml_node **args)
+{
+    double d;
+    if(has_turtle(in, "back") && eml_arg_number(in, "back", args[0], &d)) {
+        eml_turtle_forward(in->turtle, -d);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_right(struct eml_interp *in, struct eml_node **args)
+{
+    double a;
+    if(has_turtle(in, "right") && eml_arg_number(in, "right", args[0], &a)) {
+        eml_turtle_right(in->turtle, a);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_left(struct eml_interp *in, struct eml_node **args)
+{
+    double a;
+    if(has_turtle(in, "left") && eml_arg_number(in, "left", args[0], &a)) {
+        eml_turtle_right(in->turtle, -a);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_penup(struct eml_interp *in, struct eml_node **args)
+{
+    if(has_turtle(in, "penup")) {
+        eml_turtle_pen(in->turtle, 0);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_pendown(struct eml_interp *in, struct eml_node **args)
+{
+    if(has_turtle(in, "pendown")) {
+        eml_turtle_pen(in->turtle, 1);
+    }
+    return NULL;
+}
+
+/* Get exactly n numbers out of a list or array. Returns 0 after flagging
+   an error if there aren't n of them or they aren't all numbers. */
+static int number_list(struct eml_interp *in, const char *who, struct eml_node *arg,
+                       double *d, int n)
+{
+    struct eml_list_node *cur;
+    struct eml_array *array;
+    int i = 0;
+
+    if(arg->type == EML_LIST) {
+        for(cur = ((struct eml_list*)arg->data)->head; cur && i < n; cur = cur->next) {
+            if(!eml_arg_number(in, who, cur->data, d + i++)) {
+                return 0;
+            }
+        }
+        if(!cur && i == n) {
+            return 1;
+        }
+    } else if(arg->type == EML_ARRAY && (array = arg->data)->size == n) {
+        for(i=0; i<n; i++) {
+            if(array->num) {
+                d[i] = array->num[i];
+            } else if(!array->item[i]) {
+                /* an item never set is an empty list */
+                eml_interp_error(in, "%s doesn't like [] as input", who);
+                return 0;
+            } else if(!eml_arg_number(in, who, array->item[i], d + i)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    eml_interp_error(in, "%s doesn't like %s as input", who,
+                     arg->type == EML_WORD ? eml_word_str(arg->data) :
+                     arg->type == EML_ARRAY ? "{...}" : "[...]");
+    return 0;
+}
+
+static struct eml_node *prim_setpos(struct eml_interp *in, struct eml_node **args)
+{
+    double pos[2];
+
+    if(has_turtle(in, "setpos") && number_list(in, "setpos", args[0], pos, 2)) {
+        eml_turtle_setpos(in->turtle, pos[0], pos[1]);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_setheading(struct eml_interp *in, struct eml_node **args)
+{
+    double h;
+    if(has_turtle(in, "setheading") && eml_arg_number(in, "setheading", args[0], &h)) {
+        eml_turtle_setheading(in->turtle, h);
+    }
+    return NULL;
+}
+
+/* SETPENCOLOR takes a palette number or an [r g b] list of 0-255 values */
+static struct eml_node *prim_setpencolor(struct eml_interp *in, struct eml_node **args)
+{
+    double rgb[3];
+    int i;
+
+    if(!has_turtle(in, "setpencolor")) {
+        return NULL;
+    }
+    if(args[0]->type == EML_WORD) {
+        if(!eml_arg_number(in, "setpencolor", args[0], rgb)) {
+            return NULL;
+        }
+        if(!isfinite(rgb[0])) {
+            eml_interp_error(in, "setpencolor doesn't like %s as input", eml_word_str(args[0]->data));
+            return NULL;
+        }
+
+        /* reduced first, since a double beyond an int can't be cast */
+        i = (int) fmod(rgb[0], 16);
+        eml_turtle_setcolor(in->turtle, palette[(i + 16) % 16]);
+        return NULL;
+    }
+
+    if(!number_list(in, "setpencolor", args[0], rgb, 3)) {
+        return NULL;
+    }
+    for(i=0; i<3; i++) {
+        if(isnan(rgb[i])) {
+            eml_interp_error(in, "setpencolor doesn't like %s as input",
+                             args[0]->type == EML_ARRAY ? "{...}" : "[...]");
+            return NULL;
+        }
+        rgb[i] = rgb[i] < 0 ? 0 : rgb[i] > 255 ? 255 : rgb[i];
+    }
+    eml_turtle_setcolor(in->turtle, EML_RGBA(rgb[0], rgb[1], rgb[2], 255));
+    return NULL;
+}
+
+static struct eml_node *prim_fill(struct eml_interp *in, struct eml_node **args)
+{
+    if(has_turtle(in, "fill")) {
+        eml_turtle_fill(in->turtle);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_home(struct eml_interp *in, struct eml_node **args)
+{
+    if(has_turtle(in, "home")) {
+        eml_turtle_setpos(in->turtle, 0, 0);
+        eml_turtle_setheading(in->turtle, 0);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_clean(struct eml_interp *in, struct eml_node **args)
+{
+    if(has_turtle(in, "clean")) {
+        eml_dlist_clear(in->turtle->dlist);
+    }
+    return NULL;
+}
+
+static struct eml_node *prim_clearscreen(struct eml_interp *in, struct eml_node **args)
+{
+    int pen;
+
+    if(!has_turtle(in, "clearscreen")) {
+        return NULL;
+    }
+    pen = in->turtle->pendown;
+    prim_clean(in, args);
+    in->turtle->pendown = 0;
+    prim_home(in, args);
+    in->turtle->pendown = pen;
+    return NULL;
+}
+
+/* write the turtle's drawing to a file */
+static void save(struct eml_interp *in, const char *who, struct eml_node *arg,
+                 int (*write)(struct eml_turtle*, FILE*))
+{
+    struct eml_word *name;
+    FILE *f;
+
+    if(!has_turtle(in, who)) {
+        return;
+    }
+    name = eml_arg_word(in, who, arg);
+    if(!name) {
+        return;
+    }
+    f = fopen(eml_word_str(name), "wb");
+    if(!f) {
+        eml_interp_error(in, "%s can't open %s", who, eml_word_str(name));
+        return;
+    }
+    if(write(in->turtle, f)) {
+        eml_interp_error(in, "%s failed writing %s", who, eml_word_str(name));
+    }
+    fclose(f);
+}
+
+static int write_ppm(struct eml_turtle *t, FILE *f)
+{
+    eml_turtle_render(t);
+    return eml_canvas_write_ppm(t->canvas, f);
+}
+
+static int write_png(struct eml_turtle *t, FILE *f)
+{
+    eml_turtle_render(t);
+    return eml_canvas_write_png(t->canvas, f);
+}
+
+static int write_svg(struct eml_turtle *t, FILE *f)
+{
+    return eml_dlist_write_svg(t->dlist, t->canvas->width, t->canvas->height, t->background, f);
+}
+
+static struct eml_node *prim_saveppm(struct eml_interp *in, struct eml_node **args)
+{
+    save(in, "saveppm", args[0], write_ppm);
+    return NULL;
+}
+
+static struct eml_node *prim_savepng(struct eml_interp *in, struct eml_node **args)
+{
+    save(in, "savepng", args[0], write_png);
+    return NULL;
+}
+
+static struct eml_node *prim_savesvg(struct eml_interp *in, struct eml_node **args)
+{
+    save(in, "savesvg", args[0], write_svg);
+    return NULL;
+}
+
+static const struct eml_prim turtle_prims[] = {
+    {"forward", 1, prim_forward, EML_PRIM_COMMAND},
+    {"fd", 1, prim_forward, EML_PRIM_COMMAND},
+    {"back", 1, prim_back, EML_PRIM_COMMAND},
+    {"bk", 1, prim_back, EML_PRIM_COMMAND},
+    {"right", 1, prim_right, EML_PRIM_COMMAND},
+    {"rt", 1, prim_right, EML_PRIM_COMMAND},
+    {"left", 1, prim_left, EML_PRIM_COMMAND},
+    {"lt", 1, prim_left, EML_PRIM_COMMAND},
+    {"penup", 0, prim_penup, EML_PRIM_COMMAND},
+    {"pu", 0, prim_penup, EML_PRIM_COMMAND},
+    {"pendown", 0, prim_pendown, EML_PRIM_COMMAND},
+    {"pd", 0, prim_pendown, EML_PRIM_COMMAND},
+    {"setpos", 1, prim_setpos, EML_PRIM_COMMAND},
+    {"setheading", 1, prim_setheading, EML_PRIM_COMMAND},
+    {"seth", 1, prim_setheading, EML_PRIM_COMMAND},
+    {"setpencolor", 1, prim_setpencolor, EML_PRIM_COMMAND},
+    {"setpc", 1, prim_setpencolor, EML_PRIM_COMMAND},
+    {"fill", 0, prim_fill, EML_PRIM_COMMAND},
+    {"home", 0, prim_home, EML_PRIM_COMMAND},
+    {"clean", 0, prim_clean, EML_PRIM_COMMAND},
+    {"clearscreen", 0, prim_clearscreen, EML_PRIM_COMMAND},
+    {"cs", 0, prim_clearscreen, EML_PRIM_COMMAND},
+    {"saveppm", 1, prim_saveppm, EML_PRIM_COMMAND},
+    {"savepng", 1, prim_savepng, EML_PRIM_COMMAND},
+    {"savesvg", 1, prim_savesvg, EML_PRIM_COMMAND},
+    {NULL, 0, NULL}
+};
+
+/* add the turtle primitives to the interpreter */
+void eml_turtle_defprims(struct eml_interp *in)
+{
+    eml_interp_defprims(in, turtle_prims);
+}
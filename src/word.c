@@ -25,83 +25,246 @@
  * SOFTWARE.
  */
 #include "word.h"
+#include "bignum.h"
+#include "alloc.h"
+#include "trace.h"
+#include "primid.h"
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /* constants */
-const char *EML_TOKENS = "[]";
+const char *EML_TOKENS = "[]{}";
 
-/* some buffer space for us to use */
-static char buf[200];
+/* some buffer space for us to use, one for each thread */
+static __thread char buf[200];
 
 /* helper function to allocate words */
 static struct eml_word *eml_word_alloc()
 {
-    return malloc(sizeof(struct eml_word));
+    struct eml_word *w = eml_malloc(EML_MEM_WORD, sizeof(struct eml_word));
+
+    w->prim = EML_PRIM_NONE;
+    return w;
 }
 
-/* helper function to compute hash for bytes */
-static unsigned int byte_hash(void *ptr, int n)
+/* Helper function to carry a hash on over more bytes. This is FNV-1a,
+   without regard to case because words are compared that way. The hash
+   is all of its state, so the hash of a concatenation carries on from
+   the hash of its first part. */
+static unsigned int hash_more(unsigned int hash, const void *ptr, int n)
 {
-    unsigned char *byte;
-    unsigned int hash = 0;
+    const unsigned char *byte;
     for (byte = ptr; n; n--, byte++) {
-        hash += 31 * toupper(*byte);
+        hash ^= toupper(*byte);
+        hash *= 16777619u;
     }
 
     return hash;
 }
 
-/* word creation functions */
-struct eml_word *eml_stow(char *s)
+/* Helper function to compute hash for bytes */
+static unsigned int byte_hash(const void *ptr, int n)
 {
-    int len;
-    struct eml_word *w;
-    enum eml_word_type type;
+    return hash_more(2166136261u, ptr, n);
+}
+
+/* Helper function to hash the limbs of a bignum. They have no case, so
+   FNV-1a takes a whole limb at a time. */
+static unsigned int limb_hash(struct eml_bignum *b)
+{
+    unsigned int hash = 2166136261u;
     int i;
-    const char *tptr;
 
-    /* initialize things */
-    len = strlen(s);
+    for (i = 0; i < b->size; i++) {
+        hash ^= b->limb[i];
+        hash *= 16777619u;
+    }
 
-    /* scan the string for numeric type */
-    if ((len > 1 && *s == '-') || isdigit(*s)) {
-        type = INTEGER;
-    } else if (*s == '.' && len > 1) {
-        type = FLOAT;
-    } else {
-        type = WORD;
+    return b->sign < 0 ? ~hash : hash;
+}
+
+/* concatenations shorter than this are copied rather than made ropes */
+#define ROPE_MIN 32
+
+/* Helper function to test whether text is an integer as it prints, with
+   no leading zeros. When more is set the text follows such an integer,
+   so it need only be digits. */
+static int integer_text(const char *s, int n, int more)
+{
+    if (!more) {
+        if (n && *s == '-') {
+            s++;
+            n--;
+        }
+        if (!n || *s < '1' || *s > '9') {
+            return 0;
+        }
     }
 
-    for (i = 1; type != WORD && i < len; i++) {
-        /* digits pass */
-        if (isdigit(s[i])) {
-            continue;
+    for (; n; n--, s++) {
+        if (*s < '0' || *s > '9') {
+            return 0;
         }
+    }
+
+    return 1;
+}
+
+/* Helper function to make a rope chunk holding n bytes of s after prev,
+   whose reference it takes */
+static struct eml_rope *rope_chunk(struct eml_rope *prev, const char *s, int n)
+{
+    struct eml_rope *r = eml_malloc(EML_MEM_WORD, sizeof(struct eml_rope) + n);
+
+    r->refs = 1;
+    r->len = (prev ? prev->len : 0) + n;
+    r->n = n;
+    r->prev = prev;
+    r->digits = prev ? prev->digits && integer_text(s, n, 1) : integer_text(s, n, 0);
+    memcpy(r->s, s, n);
+    return r;
+}
 
-        /* a float is born */
-        if (type == INTEGER && s[i] == '.') {
+/* Helper function to drop a reference to a rope. Chains can be very
+   long, so this loops rather than recursing. */
+static void rope_release(struct eml_rope *r)
+{
+    struct eml_rope *prev;
+
+    while (r && --r->refs == 0) {
+        prev = r->prev;
+        eml_free(EML_MEM_WORD, r);
+        r = prev;
+    }
+}
+
+/* Helper function to copy a rope's text into one string. The chunks are
+   walked from the last, filling the string from its end. */
+static char *rope_flatten(struct eml_rope *r)
+{
+    char *s = eml_malloc(EML_MEM_WORD, r->len + 1);
+    int pos = r->len;
+
+    s[pos] = '\0';
+    for (; r; r = r->prev) {
+        pos -= r->n;
+        memcpy(s + pos, r->s, r->n);
+    }
+
+    return s;
+}
+
+/* Helper function to test whether text could be part of a number. A
+   word with any other character in it stays a word however it grows. */
+static int numeric_text(const char *s, int n)
+{
+    for (; n; n--, s++) {
+        if (!(*s >= '0' && *s <= '9') && *s != '.' && *s != '-') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* the powers of ten which a double holds exactly */
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Helper function to classify and convert a number in one pass. A number
+   is an optional minus sign and digits with at most one decimal point.
+   Returns INTEGER, FLOAT, or WORD if s isn't a number. Integers are put
+   in *i, unless they don't fit in an int, when *overflow is set instead.
+   Floats are put in *d, correctly rounded. */
+static enum eml_word_type scan_number(const char *s, int *i, double *d, int *overflow)
+{
+    enum eml_word_type type = INTEGER;
+    uint64_t m = 0;     /* the first 19 significant digits */
+    int sig = 0;        /* how many digits are in m */
+    int frac = 0;       /* how many of them follow the point */
+    int lost = 0;       /* digits which didn't fit in m */
+    int digits = 0;
+    const char *p = s;
+
+    if (*p == '-') {
+        p++;
+    }
+
+    for (; *p; p++) {
+        if (*p >= '0' && *p <= '9') {
+            digits++;
+            if (sig < 19) {
+                m = m * 10 + (*p - '0');
+                sig += m != 0;
+                frac += type == FLOAT;
+            } else {
+                lost++;
+            }
+        } else if (*p == '.' && type == INTEGER) {
             type = FLOAT;
-            continue;
+        } else {
+            return WORD;
         }
+    }
+    if (!digits) {
+        return WORD;
+    }
 
-        /* aaaand, if we make it here, it's just a word */
-        type = WORD;
+    if (type == INTEGER) {
+        *overflow = lost || m > (uint64_t) INT_MAX + (*s == '-');
+        if (!*overflow) {
+            *i = *s == '-' ? (int) -(int64_t) m : (int) m;
+        }
+        return INTEGER;
+    }
+
+    /* Clinger's fast path: when the digits and the power of ten are both
+       exact doubles, one correctly rounded division gives the answer.
+       Anything else goes to strtod, which is correctly rounded too. */
+    if (!lost && m <= (1ull << 53) && frac <= 22) {
+        *d = *s == '-' ? -(m / exact_pow10[frac]) : m / exact_pow10[frac];
+    } else {
+        *d = strtod(s, NULL);
     }
+    return FLOAT;
+}
+
+/* word creation functions */
+struct eml_word *eml_stow(char *s)
+{
+    int len;
+    struct eml_word *w;
+    enum eml_word_type type;
+    int i, overflow;
+    double d;
+    const char *tptr;
+
+    /* initialize things */
+    EML_TRACE_BEGIN("stow", 0);
+    type = scan_number(s, &i, &d, &overflow);
 
     /* handle the types */
-    if (type == INTEGER) {
-        w = eml_itow(atoi(s));
+    if (type == INTEGER && overflow) {
+        /* too big for an int, so it becomes a bignum */
+        w = eml_int_parse(s);
+    } else if (type == INTEGER) {
+        w = eml_itow(i);
     } else if (type == FLOAT) {
-        w = eml_dtow(atof(s));
+        w = eml_dtow(d);
     } else {
+        len = strlen(s);
         w = eml_word_alloc();
-        w->field.s = malloc(len + 1);
+        w->field.s = eml_malloc(EML_MEM_WORD, len + 1);
         w->type = type;
         strcpy(w->field.s, s);
         w->hash = byte_hash(s, len);
+        w->prim = eml_prim_id(s, w->hash);
 
         /* detect tokens */
         if (len == 1) {
@@ -114,6 +277,7 @@ struct eml_word *eml_stow(char *s)
         }
     }
 
+    EML_TRACE_END("stow");
     return w;
 }
 
@@ -135,6 +299,57 @@ struct eml_word *eml_dtow(double d)
     return w;
 }
 
+struct eml_word *eml_btow(struct eml_bignum *b)
+{
+    struct eml_word *w = eml_word_alloc();
+    w->type = BIGNUM;
+    w->field.b = b;
+    w->hash = limb_hash(b);
+    return w;
+}
+
+/* Copy a word */
+struct eml_word *eml_word_copy(struct eml_word *w)
+{
+    struct eml_word *c = eml_word_alloc();
+
+    *c = *w;
+    if (w->type == ROPE) {
+        w->field.r->refs++;
+    } else if (w->type == WORD || w->type == TOKEN) {
+        c->field.s = eml_malloc(EML_MEM_WORD, strlen(w->field.s) + 1);
+        strcpy(c->field.s, w->field.s);
+    } else if (w->type == BIGNUM) {
+        c->field.b = eml_bignum_copy(w->field.b);
+    }
+
+    return c;
+}
+
+/* Copy a word without changing it, so other threads may be reading it */
+struct eml_word *eml_word_clone(struct eml_word *w)
+{
+    struct eml_word *c;
+    char *s;
+
+    if (w->type != ROPE) {
+        return eml_word_copy(w);
+    }
+
+    /* the copy gets the text in one piece rather than sharing the chunks */
+    if (w->field.r->digits) {
+        s = rope_flatten(w->field.r);
+        c = eml_stow(s);
+        eml_free(EML_MEM_WORD, s);
+        return c;
+    }
+    c = eml_word_alloc();
+    *c = *w;
+    c->type = WORD;
+    c->field.s = rope_flatten(w->field.r);
+    return c;
+}
+
 static char *word_as_str(char *bstart, struct eml_word *w)
 {
     /* handle the easy case */
@@ -147,6 +362,17 @@ static char *word_as_str(char *bstart, struct eml_word *w)
         sprintf(bstart, "%d", w->field.i);
     } else if (w->type == FLOAT) {
         sprintf(bstart, "%g", w->field.d);
+    } else if (w->type == BIGNUM) {
+        return (char *) eml_bignum_str(w->field.b);
+    } else if (w->type == ROPE && w->field.r->digits) {
+        eml_word_parse(w);
+        return word_as_str(bstart, w);
+    } else if (w->type == ROPE) {
+        /* the text is wanted in one piece, so the rope becomes a WORD */
+        bstart = rope_flatten(w->field.r);
+        rope_release(w->field.r);
+        w->type = WORD;
+        w->field.s = bstart;
     }
 
     return bstart;
@@ -155,28 +381,62 @@ static char *word_as_str(char *bstart, struct eml_word *w)
 /* Concatenate two words */
 struct eml_word *eml_wcat(struct eml_word *a, struct eml_word *b)
 {
+    char na[32], nb[32]; /* room to render numbers */
     int la, lb;    /* string lengths */
     char *sa, *sb; /* a and b as strings */
     char *s;       /* the string we are building */
+    char *t;
+    struct eml_rope *r;
     struct eml_word *w;
 
-    /* get the word strings */
-    sa = word_as_str(buf, a);
-    sb = word_as_str(buf + 100, b);
+    /* get the word strings, leaving a as a rope if it is one */
+    sa = a->type == ROPE ? NULL : word_as_str(na, a);
+    sb = b->type == ROPE ? NULL : word_as_str(nb, b);
+    la = sa ? strlen(sa) : a->field.r->len;
+    lb = sb ? strlen(sb) : b->field.r->len;
 
-    /* build the string */
-    la = strlen(sa);
-    lb = strlen(sb);
-    s = malloc(la + lb);
-    strncpy(s, sa, la);
-    strncpy(s + la, sb, lb + 1);
+    /* Long words are ropes. The rope of a is shared, and b is added as a
+       chunk after it. Digits added to an integer are kept as a rope too,
+       so a number built a digit at a time is only parsed once it is used. */
+    if (la + lb >= ROPE_MIN) {
+        if (sa) {
+            r = la ? rope_chunk(NULL, sa, la) : NULL;
+        } else {
+            r = a->field.r;
+            r->refs++;
+        }
 
-    /* build the word */
-    w = eml_stow(s);
-    if (w->type != WORD) {
-        free(s);
+        s = sb ? sb : rope_flatten(b->field.r);
+        if (lb) {
+            r = rope_chunk(r, s, lb);
+        }
+
+        if (!r->digits && (sa ? numeric_text(sa, la) : a->field.r->digits) && numeric_text(s, lb)) {
+            /* this may be a number which doesn't print as its text, like 1.50 */
+            t = rope_flatten(r);
+            w = eml_stow(t);
+            eml_free(EML_MEM_WORD, t);
+            rope_release(r);
+        } else {
+            w = eml_word_alloc();
+            w->type = ROPE;
+            w->field.r = r;
+            w->hash = hash_more(sa ? byte_hash(sa, la) : a->hash, s, lb);
+        }
+        if (!sb) {
+            eml_free(EML_MEM_WORD, s);
+        }
+        return w;
     }
 
+    /* build the string, and the word from it, which may be a number */
+    s = eml_malloc(EML_MEM_WORD, la + lb + 1);
+    memcpy(s, sa, la);
+    memcpy(s + la, sb, lb);
+    s[la + lb] = '\0';
+    w = eml_stow(s);
+    eml_free(EML_MEM_WORD, s);
+
     return w;
 }
 
@@ -186,15 +446,37 @@ char *eml_word_str(struct eml_word *w)
     return word_as_str(buf, w);
 }
 
+/* Turn a rope of an integer's digits into that integer */
+void eml_word_parse(struct eml_word *w)
+{
+    struct eml_word *n;
+    char *s;
+
+    if (w->type != ROPE || !w->field.r->digits) {
+        return;
+    }
+
+    s = rope_flatten(w->field.r);
+    n = eml_stow(s);
+    eml_free(EML_MEM_WORD, s);
+    rope_release(w->field.r);
+    *w = *n;
+    eml_free(EML_MEM_WORD, n);
+}
+
 /* word destructor */
 void eml_free_word(struct eml_word *w)
 {
     /* free any dynamically allocated character data */
     if (w->type == WORD || w->type == TOKEN) {
-        free(w->field.s);
+        eml_free(EML_MEM_WORD, w->field.s);
+    } else if (w->type == BIGNUM) {
+        eml_bignum_free(w->field.b);
+    } else if (w->type == ROPE) {
+        rope_release(w->field.r);
     }
 
-    free(w);
+    eml_free(EML_MEM_WORD, w);
 }
 
 /*
@@ -202,6 +484,18 @@ void eml_free_word(struct eml_word *w)
  */
 int eml_word_equals(struct eml_word *w1, struct eml_word *w2)
 {
+    /* a rope of digits is a number which hasn't been parsed yet */
+    if (w1->type != w2->type) {
+        eml_word_parse(w1);
+        eml_word_parse(w2);
+    }
+
+    /* a rope is a word whose text hasn't been put together yet */
+    if((w1->type == ROPE || w2->type == ROPE) && w1->hash == w2->hash &&
+       (w1->type == WORD || w1->type == ROPE) && (w2->type == WORD || w2->type == ROPE)) {
+        return strcasecmp(eml_word_str(w1), eml_word_str(w2)) == 0;
+    }
+
     /* first compare their easy parts */
     if(w1->type != w2->type || w1->hash != w2->hash) {
         return 0;
@@ -212,6 +506,8 @@ int eml_word_equals(struct eml_word *w1, struct eml_word *w2)
         return w1->field.i == w2->field.i;
     } else if(w2->type == FLOAT) {
         return w1->field.d == w2->field.d;
+    } else if(w1->type == BIGNUM) {
+        return eml_bignum_cmp(w1->field.b, w2->field.b) == 0;
     } else {
         return strcasecmp(w1->field.s, w2->field.s) == 0;
     }
@@ -0,0 +1,245 @@
+/*
+ * File: writer.c
+ * Purpose: This is the implementation file for the emlogo buffered output writer.
+ *
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <string.h>
+#include "writer.h"
+#include "bignum.h"
+#include "buf.h"
+#include "alloc.h"
+
+/* helper function prototypes */
+static int file_sink(void *ctx, const char *bytes, int n);
+static int buf_sink(void *ctx, const char *bytes, int n);
+static void write_int(struct eml_writer *w, int i);
+static void write_float(struct eml_writer *w, double d);
+
+/* the powers of ten tried when writing floats */
+static const double exact_pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6};
+
+
+/* create a writer for a sink */
+struct eml_writer *eml_writer_alloc(eml_sink sink, void *ctx)
+{
+    struct eml_writer *w = eml_malloc(EML_MEM_BUF, sizeof(struct eml_writer));
+
+    w->sink = sink;
+    w->ctx = ctx;
+    w->text = NULL;
+    w->len = 0;
+    w->error = 0;
+    return w;
+}
+
+
+/* create a writer for a stdio stream */
+struct eml_writer *eml_writer_file(FILE *f)
+{
+    return eml_writer_alloc(file_sink, f);
+}
+
+
+/* create a writer which collects its output */
+struct eml_writer *eml_writer_buf()
+{
+    struct eml_writer *w = eml_writer_alloc(buf_sink, NULL);
+
+    w->ctx = w;
+    w->text = eml_buf_alloc();
+    return w;
+}
+
+
+/* flush and destroy a writer */
+void eml_writer_free(struct eml_writer *w)
+{
+    eml_writer_flush(w);
+    if(w->text) {
+        eml_buf_free(w->text);
+    }
+    eml_free(EML_MEM_BUF, w);
+}
+
+
+/* pass the waiting bytes on */
+int eml_writer_flush(struct eml_writer *w)
+{
+    if(w->len && !w->error && w->sink(w->ctx, w->buf, w->len)) {
+        w->error = 1;
+    }
+    w->len = 0;
+    return w->error ? -1 : 0;
+}
+
+
+/* write bytes */
+void eml_writer_bytes(struct eml_writer *w, const char *s, int n)
+{
+    int k;
+
+    while(n) {
+        if(w->len == EML_WRITER_SIZE) {
+            eml_writer_flush(w);
+        }
+
+        /* a block at least as big as buf skips it */
+        if(!w->len && n >= EML_WRITER_SIZE) {
+            if(!w->error && w->sink(w->ctx, s, n)) {
+                w->error = 1;
+            }
+            return;
+        }
+
+        k = EML_WRITER_SIZE - w->len < n ? EML_WRITER_SIZE - w->len : n;
+        memcpy(w->buf + w->len, s, k);
+        w->len += k;
+        s += k;
+        n -= k;
+    }
+}
+
+
+/* write a string */
+void eml_writer_str(struct eml_writer *w, const char *s)
+{
+    eml_writer_bytes(w, s, strlen(s));
+}
+
+
+/* write a character */
+void eml_writer_char(struct eml_writer *w, char c)
+{
+    if(w->len == EML_WRITER_SIZE) {
+        eml_writer_flush(w);
+    }
+    w->buf[w->len++] = c;
+}
+
+
+/* write a word */
+void eml_writer_word(struct eml_writer *w, struct eml_word *word)
+{
+    switch(word->type) {
+    case INTEGER:
+        write_int(w, word->field.i);
+        break;
+    case FLOAT:
+        write_float(w, word->field.d);
+        break;
+    case BIGNUM:
+        eml_writer_str(w, eml_bignum_str(word->field.b));
+        break;
+    default:
+        eml_writer_str(w, eml_word_str(word));
+    }
+}
+
+
+/******************************************
+ * Helper functions
+ ******************************************/
+/* sink for a stdio stream */
+static int file_sink(void *ctx, const char *bytes, int n)
+{
+    return fwrite(bytes, 1, n, ctx) == n ? 0 : -1;
+}
+
+
+/* sink which appends to the writer's text */
+static int buf_sink(void *ctx, const char *bytes, int n)
+{
+    struct eml_writer *w = ctx;
+
+    eml_buf_put(&w->text, bytes, n);
+    return 0;
+}
+
+
+/* write an integer, digits from the right */
+static void write_int(struct eml_writer *w, int i)
+{
+    char digits[12];
+    char *p = digits + sizeof(digits);
+    unsigned int u = i < 0 ? -(unsigned int) i : i;
+
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while(u);
+    if(i < 0) {
+        *--p = '-';
+    }
+    eml_writer_bytes(w, p, digits + sizeof(digits) - p);
+}
+
+
+/* Write a float as %g does. Most floats are short decimals, like 2.5 or
+   0.125, which %g writes exactly in fixed point. If d times a small power
+   of ten is a whole number below 10^6, it is one of those, and its digits
+   can be written straight out. Anything else goes to snprintf. */
+static void write_float(struct eml_writer *w, double d)
+{
+    char text[32], *p;
+    double a = d < 0 ? -d : d, t;
+    unsigned int m;
+    int k, n;
+
+    for(k = 0; a >= 1e-4 && k < sizeof(exact_pow10) / sizeof(exact_pow10[0]); k++) {
+        t = a * exact_pow10[k];
+        if(t >= 1e6) {
+            break;
+        }
+        if(t != (unsigned int) t) {
+            continue;
+        }
+
+        /* the digits of m, with a point k from the right, less any zeros
+           the rounding of t left at the end */
+        for(m = t; k && m % 10 == 0; k--) {
+            m /= 10;
+        }
+        p = text + sizeof(text);
+        for(n = 0; n < k || m; n++) {
+            if(n == k && k) {
+                *--p = '.';
+            }
+            *--p = '0' + m % 10;
+            m /= 10;
+        }
+        if(n == k) {
+            /* below 1, so a 0 before the point */
+            *--p = '.';
+            *--p = '0';
+        }
+        if(d < 0) {
+            *--p = '-';
+        }
+        eml_writer_bytes(w, p, text + sizeof(text) - p);
+        return;
+    }
+
+    n = snprintf(text, sizeof(text), "%g", d);
+    eml_writer_bytes(w, text, n);
+}
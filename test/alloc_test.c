@@ -0,0 +1,68 @@
+/*
+ * File: alloc_test.c
+ * Purpose: A simple test of the instrumented allocator.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include "emlogo.h"
+
+static void print_stats(const char *when)
+{
+    struct eml_mem_stats s;
+    int k;
+
+    printf("%s:\n", when);
+    for(k=0; k<=EML_MEM_KINDS; k++) {
+        eml_mem_stats(k, &s);
+        printf("  %-9s allocs %8ld frees %8ld bytes %10ld current %10ld peak %10ld\n",
+               eml_mem_kind_name(k), s.allocs, s.frees, s.bytes, s.current, s.peak);
+    }
+}
+
+/* Parses and runs a program from stdin with the instrumented allocator,
+   reporting the memory used along the way. Everything should be back to
+   zero bytes in use at the end. */
+int main()
+{
+    struct eml_interp *in;
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+
+    eml_mem_instrument();
+
+    lex = eml_alloc_lexer(getchar);
+    prog = eml_node_parse(lex, NULL);
+    print_stats("After parsing");
+
+    in = eml_interp_alloc();
+    if(eml_interp_run(in, prog->data)) {
+        printf("Error: %s\n", in->errmsg);
+    }
+    print_stats("After running");
+
+    eml_interp_free(in);
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    print_stats("After freeing");
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * File: pool_test.c
+ * Purpose: A test that PMAP, PFILTER and PREDUCE agree on any number of threads.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "emlogo.h"
+#include "buf.h"
+
+/* the thread counts compared */
+static const int threads[] = {1, 2, 4, 8};
+#define NRUNS (sizeof(threads) / sizeof(threads[0]))
+
+/* Run the program on the given number of threads, returning what it
+   printed, an eml_buf which the caller frees. */
+static char *run(struct eml_node *prog, int nthreads)
+{
+    struct eml_interp *in = eml_interp_alloc();
+    char *text;
+
+    in->threads = nthreads;
+    eml_writer_free(in->out);
+    in->out = eml_writer_buf();
+    if(eml_interp_run(in, prog->data)) {
+        eml_writer_str(in->out, "Error: ");
+        eml_writer_str(in->out, in->errmsg);
+        eml_writer_str(in->out, "\n");
+    }
+    eml_writer_flush(in->out);
+    text = in->out->text;
+    in->out->text = eml_buf_alloc();
+    eml_interp_free(in);
+    return text;
+}
+
+/* Reads a program from stdin, such as test/pool_test.logo, and runs it on
+   1, 2, 4 and 8 threads. What the first run printed is shown, followed by
+   whether every run printed the same. Returns 1 if they didn't. */
+int main()
+{
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    char *text[NRUNS];
+    int i, same = 1;
+
+    lex = eml_alloc_lexer(getchar);
+    prog = eml_node_parse(lex, NULL);
+    for(i=0; i<NRUNS; i++) {
+        text[i] = run(prog, threads[i]);
+    }
+
+    fwrite(text[0], 1, eml_buf_length(text[0]), stdout);
+    for(i=1; i<NRUNS; i++) {
+        if(eml_buf_length(text[i]) != eml_buf_length(text[0]) ||
+           memcmp(text[i], text[0], eml_buf_length(text[0]))) {
+            printf("Threads 1 and %d differ:\n", threads[i]);
+            fwrite(text[i], 1, eml_buf_length(text[i]), stdout);
+            same = 0;
+        }
+    }
+    if(same) {
+        printf("Threads 1 through %d agree\n", threads[NRUNS-1]);
+    }
+
+    for(i=0; i<NRUNS; i++) {
+        eml_buf_free(text[i]);
+    }
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    return !same;
+}
@@ -0,0 +1,74 @@
+/*
+ * File: turtle_test.c
+ * Purpose: A simple test of the emlogo turtle.
+ * MIT License
+ *
+ * Copyright (c) 2023 Robert Lowe
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <stdio.h>
+#include "emlogo.h"
+
+/* Reads a turtle program from stdin, runs it, and reports where the
+   turtle ended up and how much ink it used. The drawing is saved in
+   turtle_test.ppm, turtle_test.png, and turtle_test.svg. */
+int main()
+{
+    struct eml_interp *in;
+    struct eml_lexer *lex;
+    struct eml_node *prog;
+    struct eml_turtle *t;
+    struct eml_canvas *c;
+    FILE *f;
+    int i, ink = 0;
+
+    in = eml_interp_alloc();
+    lex = eml_alloc_lexer(getchar);
+    prog = eml_node_parse(lex, NULL);
+    if(eml_interp_run(in, prog->data)) {
+        printf("Error: %s\n", in->errmsg);
+    }
+
+    t = in->turtle;
+    c = t->canvas;
+    eml_turtle_render(t);
+    for(i=0; i<c->width * c->height; i++) {
+        if(c->pixels[i] != EML_RGBA(255, 255, 255, 255)) {
+            ink++;
+        }
+    }
+    printf("Position: %g %g Heading: %g Pen: %d Segments: %d Ink: %d\n",
+           t->x, t->y, t->heading, t->pendown, t->dlist->size, ink);
+
+    f = fopen("turtle_test.ppm", "wb");
+    eml_canvas_write_ppm(c, f);
+    fclose(f);
+    f = fopen("turtle_test.png", "wb");
+    eml_canvas_write_png(c, f);
+    fclose(f);
+    f = fopen("turtle_test.svg", "wb");
+    eml_dlist_write_svg(t->dlist, c->width, c->height, t->background, f);
+    fclose(f);
+
+    eml_node_free(prog);
+    eml_free_lexer(lex);
+    eml_interp_free(in);
+    return 0;
+}